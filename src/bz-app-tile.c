@@ -19,12 +19,21 @@
  */
 
 #include "bz-app-tile.h"
+#include "bz-async-texture.h"
+#include "bz-flathub-stats.h"
+
+/* Matches the pixel-size of the icon in bz-app-tile.blp */
+#define ICON_SIZE 64
 
 struct _BzAppTile
 {
   GtkButton parent_instance;
 
   BzEntryGroup *group;
+  /* The icon we added a waiter to, since the
+   * group can get one after we were bound
+   */
+  BzAsyncTexture *waited_icon;
 };
 
 G_DEFINE_FINAL_TYPE (BzAppTile, bz_app_tile, GTK_TYPE_BUTTON);
@@ -44,6 +53,11 @@ bz_app_tile_dispose (GObject *object)
 {
   BzAppTile *self = BZ_APP_TILE (object);
 
+  if (self->waited_icon != NULL)
+    bz_async_texture_remove_waiter (
+        self->waited_icon,
+        BZ_ASYNC_TEXTURE_PRIORITY_PREFETCH);
+  g_clear_object (&self->waited_icon);
   g_clear_object (&self->group);
 
   G_OBJECT_CLASS (bz_app_tile_parent_class)->dispose (object);
@@ -156,9 +170,37 @@ bz_app_tile_set_group (BzAppTile    *self,
 {
   g_return_if_fail (BZ_IS_APP_TILE (self));
 
+  /* Scrolled away, so a load which has not started
+   * yet can be dropped if nobody else waits on it
+   */
+  if (self->waited_icon != NULL)
+    bz_async_texture_remove_waiter (
+        self->waited_icon,
+        BZ_ASYNC_TEXTURE_PRIORITY_PREFETCH);
+  g_clear_object (&self->waited_icon);
   g_clear_object (&self->group);
   if (group != NULL)
-    self->group = g_object_ref (group);
+    {
+      GdkPaintable *icon = NULL;
+
+      self->group = g_object_ref (group);
+
+      icon = bz_entry_group_get_icon_paintable (group);
+      if (BZ_IS_ASYNC_TEXTURE (icon))
+        {
+          self->waited_icon = g_object_ref (BZ_ASYNC_TEXTURE (icon));
+          bz_async_texture_add_waiter (
+              self->waited_icon,
+              BZ_ASYNC_TEXTURE_PRIORITY_PREFETCH);
+          bz_async_texture_request_size (
+              BZ_ASYNC_TEXTURE (icon),
+              ICON_SIZE * gtk_widget_get_scale_factor (GTK_WIDGET (self)));
+        }
+
+      /* So the app page can show its stats right away */
+      if (bz_entry_group_get_is_flathub (group))
+        bz_flathub_stats_prefetch (bz_entry_group_get_id (group));
+    }
 
   g_object_notify_by_pspec (G_OBJECT (self), props[PROP_GROUP]);
 }
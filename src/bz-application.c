@@ -20,6 +20,8 @@
 
 #define G_LOG_DOMAIN "BAZAAR::CORE"
 
+#define DEFAULT_REMOTE_SYNC_WINDOW_SEC 3600
+
 #include "config.h"
 
 // #include <bazaar-ui.h>
@@ -28,6 +30,7 @@
 #include "bz-application-map-factory.h"
 #include "bz-application.h"
 #include "bz-backend-notification.h"
+#include "bz-catalog-snapshot.h"
 #include "bz-content-provider.h"
 #include "bz-download-worker.h"
 #include "bz-entry-cache-manager.h"
@@ -38,9 +41,12 @@
 #include "bz-flatpak-entry.h"
 #include "bz-flatpak-instance.h"
 #include "bz-gnome-shell-search-provider.h"
+#include "bz-image-cache.h"
 #include "bz-inspector.h"
+#include "bz-mini-icon-store.h"
 #include "bz-preferences-dialog.h"
 #include "bz-result.h"
+#include "bz-serializable.h"
 #include "bz-state-info.h"
 #include "bz-transaction-manager.h"
 #include "bz-util.h"
@@ -80,6 +86,7 @@ struct _BzApplication
   GListStore *groups;
   GHashTable *ids_to_groups;
   GListStore *installed_apps;
+  GHashTable *installed_apps_set;
 
   BzApplicationMapFactory *entry_factory;
   GtkCustomFilter         *application_filter;
@@ -122,6 +129,10 @@ refresh_fiber (BzApplication *self);
 static DexFuture *
 watch_backend_notifs_fiber (BzApplication *self);
 
+static void
+sync_installed_set (BzApplication *self,
+                    GHashTable    *installed_set);
+
 static void
 refresh (BzApplication *self);
 
@@ -150,6 +161,22 @@ cmp_group (BzEntryGroup *a,
            BzEntryGroup *b,
            gpointer      user_data);
 
+static void
+restore_snapshot (BzApplication     *self,
+                  BzCatalogSnapshot *snapshot);
+
+static void
+add_installed_group (BzApplication *self,
+                     BzEntryGroup  *group);
+
+static void
+remove_installed_group (BzApplication *self,
+                        BzEntryGroup  *group);
+
+static void
+apply_groups_diff (GListStore *store,
+                   GPtrArray  *fresh);
+
 static void
 bz_application_dispose (GObject *object)
 {
@@ -175,6 +202,7 @@ bz_application_dispose (GObject *object)
   g_clear_object (&self->cache);
   g_clear_object (&self->groups);
   g_clear_object (&self->installed_apps);
+  g_clear_pointer (&self->installed_apps_set, g_hash_table_unref);
   g_clear_object (&self->state);
   g_clear_pointer (&self->waiting_to_open_appstream, g_free);
   g_clear_pointer (&self->init_timer, g_timer_destroy);
@@ -986,6 +1014,15 @@ init_service_struct (BzApplication *self)
   g_clear_pointer (&local_error, g_error_free);
 #endif
 
+  if (self->config != NULL &&
+      g_hash_table_contains (self->config, "/image-cache-size"))
+    bz_image_cache_set_budget (
+        (guint64) g_variant_get_uint32 (
+            g_value_get_variant (
+                g_hash_table_lookup (
+                    self->config, "/image-cache-size"))) *
+        1024 * 1024);
+
   self->init_timer = g_timer_new ();
 
   (void) bz_download_worker_get_default ();
@@ -995,9 +1032,11 @@ init_service_struct (BzApplication *self)
   g_debug ("Constructing gsettings for %s ...", app_id);
   self->settings = g_settings_new (app_id);
 
-  self->groups         = g_list_store_new (BZ_TYPE_ENTRY_GROUP);
-  self->installed_apps = g_list_store_new (BZ_TYPE_ENTRY_GROUP);
-  self->ids_to_groups  = g_hash_table_new_full (
+  self->groups             = g_list_store_new (BZ_TYPE_ENTRY_GROUP);
+  self->installed_apps     = g_list_store_new (BZ_TYPE_ENTRY_GROUP);
+  self->installed_apps_set = g_hash_table_new_full (
+      g_direct_hash, g_direct_equal, g_object_unref, NULL);
+  self->ids_to_groups      = g_hash_table_new_full (
       g_str_hash, g_str_equal, g_free, g_object_unref);
 
   self->entry_factory = bz_application_map_factory_new (
@@ -1024,6 +1063,18 @@ init_service_struct (BzApplication *self)
 
   self->flathub = bz_flathub_state_new ();
   bz_flathub_state_set_map_factory (self->flathub, self->application_factory);
+  if (self->config != NULL &&
+      g_hash_table_contains (self->config, "/flathub-page-size"))
+    {
+      guint page_size = 0;
+
+      page_size = g_variant_get_uint32 (
+          g_value_get_variant (
+              g_hash_table_lookup (
+                  self->config, "/flathub-page-size")));
+      if (page_size > 0)
+        bz_flathub_state_set_page_size (self->flathub, page_size);
+    }
 
   self->transactions = bz_transaction_manager_new ();
   if (self->config != NULL)
@@ -1168,14 +1219,7 @@ transaction_success (BzApplication        *self,
 
           group = g_hash_table_lookup (self->ids_to_groups, bz_entry_get_id (entry));
           if (group != NULL)
-            {
-              gboolean found    = FALSE;
-              guint    position = 0;
-
-              found = g_list_store_find (self->installed_apps, group, &position);
-              if (!found)
-                g_list_store_insert_sorted (self->installed_apps, group, (GCompareDataFunc) cmp_group, NULL);
-            }
+            add_installed_group (self, group);
         }
       dex_future_disown (bz_entry_cache_manager_add (self->cache, entry));
     }
@@ -1200,14 +1244,7 @@ transaction_success (BzApplication        *self,
 
           group = g_hash_table_lookup (self->ids_to_groups, bz_entry_get_id (entry));
           if (group != NULL && !bz_entry_group_get_removable (group))
-            {
-              gboolean found    = FALSE;
-              guint    position = 0;
-
-              found = g_list_store_find (self->installed_apps, group, &position);
-              if (found)
-                g_list_store_remove (self->installed_apps, position);
-            }
+            remove_installed_group (self, group);
         }
       dex_future_disown (bz_entry_cache_manager_add (self->cache, entry));
     }
@@ -1296,9 +1333,35 @@ refresh_fiber (BzApplication *self)
   g_autoptr (GHashTable) sys_name_to_addons = NULL;
   g_autoptr (GHashTable) usr_name_to_addons = NULL;
   g_autoptr (GPtrArray) cache_futures       = NULL;
+  g_autoptr (GHashTable) cached_checksums   = NULL;
+  g_autoptr (GPtrArray) groups              = NULL;
+  g_autoptr (GHashTable) ids_to_groups      = NULL;
+  g_autoptr (GPtrArray) installed_apps      = NULL;
+  g_autoptr (GHashTable) installed_apps_set = NULL;
+  g_autoptr (BzCatalogSnapshot) snapshot    = NULL;
   GtkWindow    *window                      = NULL;
   gboolean      result                      = FALSE;
   const GValue *sync_value                  = NULL;
+  gboolean      revalidating                = FALSE;
+  guint         n_groups                    = 0;
+
+  if (self->flatpak == NULL)
+    {
+      /* Show whatever we knew at the end of the last
+       * session right away and revalidate it against
+       * the remotes in the background
+       */
+      bz_state_info_set_busy_step_label (self->state, _ ("Restoring last session..."));
+      snapshot = dex_await_object (
+          bz_catalog_snapshot_load (self->entry_factory),
+          &local_error);
+      if (snapshot != NULL &&
+          g_list_model_get_n_items (bz_catalog_snapshot_get_groups (snapshot)) == 0)
+        g_clear_object (&snapshot);
+      else if (snapshot == NULL && local_error != NULL)
+        g_debug ("Not restoring catalog snapshot: %s", local_error->message);
+      g_clear_pointer (&local_error, g_error_free);
+    }
 
   if (self->flatpak == NULL)
     {
@@ -1310,6 +1373,18 @@ refresh_fiber (BzApplication *self)
       bz_transaction_manager_set_backend (self->transactions, BZ_BACKEND (self->flatpak));
       bz_state_info_set_backend (self->state, BZ_BACKEND (self->flatpak));
 
+      if (self->config != NULL &&
+          g_hash_table_contains (self->config, "/remote-sync-window"))
+        bz_flatpak_instance_set_remote_sync_window (
+            self->flatpak,
+            g_variant_get_uint32 (
+                g_value_get_variant (
+                    g_hash_table_lookup (
+                        self->config, "/remote-sync-window"))));
+      else
+        bz_flatpak_instance_set_remote_sync_window (
+            self->flatpak, DEFAULT_REMOTE_SYNC_WINDOW_SEC);
+
       dex_clear (&self->notif_watch);
       self->notif_watch = dex_scheduler_spawn (
           dex_scheduler_get_default (),
@@ -1321,6 +1396,21 @@ refresh_fiber (BzApplication *self)
     {
       bz_state_info_set_busy_step_label (self->state, _ ("Reusing last Flatpak instance..."));
       g_debug ("Reusing previous flatpak instance...");
+
+      /* The user asked for this refresh, so
+       * always pull fresh data from the remotes
+       */
+      bz_flatpak_instance_set_remote_sync_window (self->flatpak, 0);
+    }
+
+  /* Only publish the restored groups once the backend
+   * is attached, since clearing busy lets the user
+   * start transactions on them right away
+   */
+  if (snapshot != NULL)
+    {
+      restore_snapshot (self, snapshot);
+      revalidating = TRUE;
     }
 
   has_flathub = dex_await_boolean (
@@ -1407,7 +1497,15 @@ refresh_fiber (BzApplication *self)
       g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
   usr_name_to_addons = g_hash_table_new_full (
       g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
-  cache_futures = g_ptr_array_new_with_free_func (dex_unref);
+  cache_futures    = g_ptr_array_new_with_free_func (dex_unref);
+  cached_checksums = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  groups           = g_ptr_array_new_with_free_func (g_object_unref);
+  ids_to_groups    = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  installed_apps   = g_ptr_array_new_with_free_func (g_object_unref);
+  /* Avoid a linear search of installed_apps for every
+   * installed entry, of which there may be many per group
+   */
+  installed_apps_set = g_hash_table_new (g_direct_hash, g_direct_equal);
 
   sync_future = bz_backend_retrieve_remote_entries_with_blocklists (
       BZ_BACKEND (self->flatpak),
@@ -1478,12 +1576,12 @@ refresh_fiber (BzApplication *self)
             {
               BzEntryGroup *group = NULL;
 
-              group = g_hash_table_lookup (self->ids_to_groups, id);
+              group = g_hash_table_lookup (ids_to_groups, id);
               if (group != NULL)
                 {
                   bz_entry_group_add (group, entry);
-                  if (installed && !g_list_store_find (self->installed_apps, group, NULL))
-                    g_list_store_append (self->installed_apps, group);
+                  if (installed && g_hash_table_add (installed_apps_set, group))
+                    g_ptr_array_add (installed_apps, g_object_ref (group));
                 }
               else
                 {
@@ -1492,12 +1590,15 @@ refresh_fiber (BzApplication *self)
                   g_debug ("Creating new application group for id %s", id);
                   new_group = bz_entry_group_new (self->entry_factory);
 
-                  g_list_store_append (self->groups, new_group);
-                  g_hash_table_replace (self->ids_to_groups, g_strdup (id), g_object_ref (new_group));
+                  g_ptr_array_add (groups, g_object_ref (new_group));
+                  g_hash_table_replace (ids_to_groups, g_strdup (id), g_object_ref (new_group));
                   bz_entry_group_add (new_group, entry);
 
                   if (installed)
-                    g_list_store_append (self->installed_apps, new_group);
+                    {
+                      g_hash_table_add (installed_apps_set, new_group);
+                      g_ptr_array_add (installed_apps, g_object_ref (new_group));
+                    }
                 }
             }
 
@@ -1536,6 +1637,7 @@ refresh_fiber (BzApplication *self)
 
           cache_task = bz_entry_cache_manager_add (self->cache, entry);
           g_ptr_array_add (cache_futures, g_steal_pointer (&cache_task));
+          g_hash_table_add (cached_checksums, g_strdup (bz_entry_get_unique_id_checksum (entry)));
 
           total++;
         }
@@ -1551,10 +1653,8 @@ refresh_fiber (BzApplication *self)
       bz_state_info_set_busy_progress_label (self->state, busy_progress_label);
       g_clear_pointer (&busy_step_label, g_free);
     }
-  g_clear_pointer (&self->last_installed_set, g_hash_table_unref);
-  self->last_installed_set = g_steal_pointer (&installed_set);
-  g_list_store_sort (self->groups, (GCompareDataFunc) cmp_group, NULL);
-  g_list_store_sort (self->installed_apps, (GCompareDataFunc) cmp_group, NULL);
+  g_ptr_array_sort_values_with_data (groups, (GCompareDataFunc) cmp_group, NULL);
+  g_ptr_array_sort_values_with_data (installed_apps, (GCompareDataFunc) cmp_group, NULL);
 
   busy_step_label = g_strdup_printf (_ ("Waiting for background indexing tasks to catch up...")),
   bz_state_info_set_busy_step_label (self->state, busy_step_label);
@@ -1583,13 +1683,78 @@ refresh_fiber (BzApplication *self)
     }
 
   g_debug ("Finished synchronizing with remotes, notifying UI...");
+
+  /* When revalidating a restored snapshot, groups
+   * which did not change keep their identity so
+   * the UI does not have to rebuild them
+   */
+  apply_groups_diff (self->groups, groups);
+  g_hash_table_remove_all (self->ids_to_groups);
+  n_groups = g_list_model_get_n_items (G_LIST_MODEL (self->groups));
+  for (guint i = 0; i < n_groups; i++)
+    {
+      g_autoptr (BzEntryGroup) group = NULL;
+
+      group = g_list_model_get_item (G_LIST_MODEL (self->groups), i);
+      g_hash_table_replace (self->ids_to_groups,
+                            g_strdup (bz_entry_group_get_id (group)),
+                            g_object_ref (group));
+    }
+
+  g_hash_table_remove_all (self->installed_apps_set);
+  for (guint i = 0; i < installed_apps->len; i++)
+    {
+      BzEntryGroup *group = NULL;
+      BzEntryGroup *kept  = NULL;
+
+      group = g_ptr_array_index (installed_apps, i);
+      kept  = g_hash_table_lookup (self->ids_to_groups, bz_entry_group_get_id (group));
+      if (kept != NULL && kept != group)
+        {
+          g_object_unref (group);
+          group                    = g_object_ref (kept);
+          installed_apps->pdata[i] = group;
+        }
+      g_hash_table_add (self->installed_apps_set, g_object_ref (group));
+    }
+  apply_groups_diff (self->installed_apps, installed_apps);
+
+  g_clear_pointer (&self->last_installed_set, g_hash_table_unref);
+  self->last_installed_set = g_steal_pointer (&installed_set);
+
+  /* The set above was taken before the remote sync. Installs and
+   * removals may have finished since (the UI stays interactive
+   * while revalidating a snapshot), so reconcile against the
+   * current state before anything is persisted */
+  installed_set = dex_await_boxed (
+      bz_backend_retrieve_install_ids (
+          BZ_BACKEND (self->flatpak), NULL),
+      &local_error);
+  if (installed_set != NULL)
+    sync_installed_set (self, installed_set);
+  else
+    {
+      g_warning ("Failed to re-enumerate installed entries: %s", local_error->message);
+      g_clear_error (&local_error);
+    }
+
   bz_state_info_set_online (self->state, TRUE);
-  bz_state_info_set_all_entry_groups (self->state, G_LIST_MODEL (self->groups));
-  bz_search_engine_set_model (self->search_engine, G_LIST_MODEL (self->groups));
-  bz_state_info_set_busy (self->state, FALSE);
+  if (!revalidating)
+    {
+      bz_state_info_set_all_entry_groups (self->state, G_LIST_MODEL (self->groups));
+      bz_search_engine_set_model (self->search_engine, G_LIST_MODEL (self->groups));
+      bz_state_info_set_busy (self->state, FALSE);
+    }
 
   gtk_filter_changed (GTK_FILTER (self->application_filter), GTK_FILTER_CHANGE_DIFFERENT);
-  bz_state_info_set_all_installed_entry_groups (self->state, G_LIST_MODEL (self->installed_apps));
+  if (!revalidating)
+    bz_state_info_set_all_installed_entry_groups (self->state, G_LIST_MODEL (self->installed_apps));
+
+  dex_future_disown (bz_catalog_snapshot_save (
+      G_LIST_MODEL (self->groups),
+      self->last_installed_set));
+  dex_future_disown (bz_entry_cache_manager_prune (self->cache, cached_checksums));
+  bz_mini_icon_store_prune (cached_checksums);
 
   busy_step_label = g_strdup_printf (
       _ ("Completed initialization in %0.2f seconds"),
@@ -1621,19 +1786,17 @@ watch_backend_notifs_fiber (BzApplication *self)
           g_autoptr (GError) local_error          = NULL;
           g_autoptr (BzBackendNotification) notif = NULL;
           g_autoptr (GHashTable) installed_set    = NULL;
-          g_autoptr (GPtrArray) diff_reads        = NULL;
-          GHashTableIter old_iter                 = { 0 };
-          GHashTableIter new_iter                 = { 0 };
-          g_autoptr (GPtrArray) diff_writes       = NULL;
 
           notif = dex_await_object (dex_channel_receive (channel), NULL);
           if (notif == NULL)
             break;
 
+          /* Don't drop what happened during a refresh; once it
+           * has published, the diff below picks the change up */
           if (self->refresh_task != NULL)
             {
-              g_debug ("Ignoring backend notification since we are currently refreshing");
-              continue;
+              g_debug ("Deferring backend notification until the current refresh completes");
+              dex_await (dex_ref (self->refresh_task), NULL);
             }
 
           bz_state_info_set_background_task_label (self->state, _ ("Synchronizing..."));
@@ -1649,104 +1812,112 @@ watch_backend_notifs_fiber (BzApplication *self)
               continue;
             }
 
-          diff_reads = g_ptr_array_new_with_free_func (dex_unref);
+          sync_installed_set (self, installed_set);
 
-          g_hash_table_iter_init (&old_iter, self->last_installed_set);
-          for (;;)
-            {
-              char *unique_id = NULL;
+          fiber_check_for_updates (self);
+          bz_state_info_set_background_task_label (self->state, NULL);
+        }
+    }
 
-              if (!g_hash_table_iter_next (
-                      &old_iter, (gpointer *) &unique_id, NULL))
-                break;
+  return NULL;
+}
 
-              if (!g_hash_table_contains (installed_set, unique_id))
-                g_ptr_array_add (
-                    diff_reads,
-                    bz_entry_cache_manager_get (self->cache, unique_id));
-            }
+/* Brings the installed state of entries and groups in line with
+ * @installed_set, only touching entries whose state changed since
+ * `last_installed_set`. Call from a fiber on the main thread */
+static void
+sync_installed_set (BzApplication *self,
+                    GHashTable    *installed_set)
+{
+  g_autoptr (GPtrArray) diff_reads  = NULL;
+  GHashTableIter old_iter           = { 0 };
+  GHashTableIter new_iter           = { 0 };
+  g_autoptr (GPtrArray) diff_writes = NULL;
 
-          g_hash_table_iter_init (&new_iter, installed_set);
-          for (;;)
-            {
-              char *unique_id = NULL;
+  diff_reads = g_ptr_array_new_with_free_func (dex_unref);
 
-              if (!g_hash_table_iter_next (
-                      &new_iter, (gpointer *) &unique_id, NULL))
-                break;
+  g_hash_table_iter_init (&old_iter, self->last_installed_set);
+  for (;;)
+    {
+      char *unique_id = NULL;
 
-              if (!g_hash_table_contains (self->last_installed_set, unique_id))
-                g_ptr_array_add (
-                    diff_reads,
-                    bz_entry_cache_manager_get (self->cache, unique_id));
-            }
+      if (!g_hash_table_iter_next (
+              &old_iter, (gpointer *) &unique_id, NULL))
+        break;
 
-          if (diff_reads->len > 0)
+      if (!g_hash_table_contains (installed_set, unique_id))
+        g_ptr_array_add (
+            diff_reads,
+            bz_entry_cache_manager_get (self->cache, unique_id));
+    }
+
+  g_hash_table_iter_init (&new_iter, installed_set);
+  for (;;)
+    {
+      char *unique_id = NULL;
+
+      if (!g_hash_table_iter_next (
+              &new_iter, (gpointer *) &unique_id, NULL))
+        break;
+
+      if (!g_hash_table_contains (self->last_installed_set, unique_id))
+        g_ptr_array_add (
+            diff_reads,
+            bz_entry_cache_manager_get (self->cache, unique_id));
+    }
+
+  if (diff_reads->len > 0)
+    {
+      dex_await (dex_future_allv (
+                     (DexFuture *const *) diff_reads->pdata,
+                     diff_reads->len),
+                 NULL);
+
+      diff_writes = g_ptr_array_new_with_free_func (dex_unref);
+      for (guint i = 0; i < diff_reads->len; i++)
+        {
+          DexFuture *future = NULL;
+
+          future = g_ptr_array_index (diff_reads, i);
+          if (dex_future_is_resolved (future))
             {
-              dex_await (dex_future_allv (
-                             (DexFuture *const *) diff_reads->pdata,
-                             diff_reads->len),
-                         NULL);
+              BzEntry      *entry     = NULL;
+              const char   *id        = NULL;
+              const char   *unique_id = NULL;
+              BzEntryGroup *group     = NULL;
+              gboolean      installed = FALSE;
+
+              entry = g_value_get_object (dex_future_get_value (future, NULL));
+              id    = bz_entry_get_id (entry);
+              group = g_hash_table_lookup (self->ids_to_groups, id);
+              if (group != NULL)
+                bz_entry_group_connect_living (group, entry);
 
-              diff_writes = g_ptr_array_new_with_free_func (dex_unref);
-              for (guint i = 0; i < diff_reads->len; i++)
-                {
-                  DexFuture *future = NULL;
+              unique_id = bz_entry_get_unique_id (entry);
+              installed = g_hash_table_contains (installed_set, unique_id);
+              bz_entry_set_installed (entry, installed);
 
-                  future = g_ptr_array_index (diff_reads, i);
-                  if (dex_future_is_resolved (future))
-                    {
-                      BzEntry      *entry     = NULL;
-                      const char   *id        = NULL;
-                      const char   *unique_id = NULL;
-                      BzEntryGroup *group     = NULL;
-                      gboolean      installed = FALSE;
-
-                      entry = g_value_get_object (dex_future_get_value (future, NULL));
-                      id    = bz_entry_get_id (entry);
-                      group = g_hash_table_lookup (self->ids_to_groups, id);
-                      if (group != NULL)
-                        bz_entry_group_connect_living (group, entry);
-
-                      unique_id = bz_entry_get_unique_id (entry);
-                      installed = g_hash_table_contains (installed_set, unique_id);
-                      bz_entry_set_installed (entry, installed);
-
-                      if (group != NULL)
-                        {
-                          gboolean found    = FALSE;
-                          guint    position = 0;
-
-                          found = g_list_store_find (self->installed_apps, group, &position);
-                          if (installed && !found)
-                            g_list_store_insert_sorted (
-                                self->installed_apps, group,
-                                (GCompareDataFunc) cmp_group, NULL);
-                          else if (!installed && found &&
-                                   bz_entry_group_get_removable (group) == 0)
-                            g_list_store_remove (self->installed_apps, position);
-                        }
-
-                      g_ptr_array_add (
-                          diff_writes,
-                          bz_entry_cache_manager_add (self->cache, entry));
-                    }
+              if (group != NULL)
+                {
+                  if (installed)
+                    add_installed_group (self, group);
+                  else if (bz_entry_group_get_removable (group) == 0)
+                    remove_installed_group (self, group);
                 }
 
-              dex_await (dex_future_allv (
-                             (DexFuture *const *) diff_writes->pdata,
-                             diff_writes->len),
-                         NULL);
+              g_ptr_array_add (
+                  diff_writes,
+                  bz_entry_cache_manager_add (self->cache, entry));
             }
-          g_clear_pointer (&self->last_installed_set, g_hash_table_unref);
-          self->last_installed_set = g_steal_pointer (&installed_set);
-
-          fiber_check_for_updates (self);
-          bz_state_info_set_background_task_label (self->state, NULL);
         }
-    }
 
-  return NULL;
+      dex_await (dex_future_allv (
+                     (DexFuture *const *) diff_writes->pdata,
+                     diff_writes->len),
+                 NULL);
+    }
+  g_clear_pointer (&self->last_installed_set, g_hash_table_unref);
+  self->last_installed_set = g_hash_table_ref (installed_set);
 }
 
 static DexFuture *
@@ -1830,6 +2001,7 @@ refresh (BzApplication *self)
   g_list_store_remove_all (self->groups);
   g_hash_table_remove_all (self->ids_to_groups);
   g_list_store_remove_all (self->installed_apps);
+  g_hash_table_remove_all (self->installed_apps_set);
 
   bz_state_info_set_busy (self->state, TRUE);
   bz_state_info_set_busy_progress (self->state, 0.0);
@@ -2011,3 +2183,186 @@ cmp_group (BzEntryGroup *a,
 
   return g_strcmp0 (title_a, title_b);
 }
+
+static void
+restore_snapshot (BzApplication     *self,
+                  BzCatalogSnapshot *snapshot)
+{
+  GListModel *groups                   = NULL;
+  guint       n_groups                 = 0;
+  GHashTable *installed                = NULL;
+  g_autoptr (GPtrArray) installed_apps = NULL;
+
+  groups    = bz_catalog_snapshot_get_groups (snapshot);
+  n_groups  = g_list_model_get_n_items (groups);
+  installed = bz_catalog_snapshot_get_installed_set (snapshot);
+
+  g_debug ("Restoring %d application groups from the last session", n_groups);
+
+  installed_apps = g_ptr_array_new_with_free_func (g_object_unref);
+
+  for (guint i = 0; i < n_groups; i++)
+    {
+      g_autoptr (BzEntryGroup) group = NULL;
+
+      group = g_list_model_get_item (groups, i);
+      g_list_store_append (self->groups, group);
+      g_hash_table_replace (self->ids_to_groups,
+                            g_strdup (bz_entry_group_get_id (group)),
+                            g_object_ref (group));
+      if (bz_entry_group_get_removable (group) > 0)
+        {
+          g_hash_table_add (self->installed_apps_set, g_object_ref (group));
+          g_ptr_array_add (installed_apps, g_object_ref (group));
+        }
+    }
+  g_list_store_splice (self->installed_apps, 0, 0, installed_apps->pdata, installed_apps->len);
+
+  g_clear_pointer (&self->last_installed_set, g_hash_table_unref);
+  self->last_installed_set = g_hash_table_ref (installed);
+
+  bz_state_info_set_online (self->state, TRUE);
+  bz_state_info_set_all_entry_groups (self->state, G_LIST_MODEL (self->groups));
+  bz_search_engine_set_model (self->search_engine, G_LIST_MODEL (self->groups));
+  bz_state_info_set_busy (self->state, FALSE);
+
+  gtk_filter_changed (GTK_FILTER (self->application_filter), GTK_FILTER_CHANGE_DIFFERENT);
+  bz_state_info_set_all_installed_entry_groups (self->state, G_LIST_MODEL (self->installed_apps));
+  bz_state_info_set_background_task_label (self->state, _ ("Synchronizing..."));
+}
+
+static gboolean
+groups_equal (BzEntryGroup *a,
+              BzEntryGroup *b)
+{
+  g_autoptr (GVariantBuilder) builder_a = NULL;
+  g_autoptr (GVariantBuilder) builder_b = NULL;
+  g_autoptr (GVariant) variant_a        = NULL;
+  g_autoptr (GVariant) variant_b        = NULL;
+
+  if (a == b)
+    return TRUE;
+
+  builder_a = g_variant_builder_new (G_VARIANT_TYPE_VARDICT);
+  builder_b = g_variant_builder_new (G_VARIANT_TYPE_VARDICT);
+  bz_serializable_serialize (BZ_SERIALIZABLE (a), builder_a);
+  bz_serializable_serialize (BZ_SERIALIZABLE (b), builder_b);
+  variant_a = g_variant_ref_sink (g_variant_builder_end (builder_a));
+  variant_b = g_variant_ref_sink (g_variant_builder_end (builder_b));
+
+  return g_variant_equal (variant_a, variant_b);
+}
+
+/* Both the store and the array must be sorted with
+ * cmp_group. The merged result keeps the old object
+ * wherever an equal group is found and is published
+ * with a single splice over the range that changed,
+ * so listeners only ever see one items-changed
+ */
+static void
+apply_groups_diff (GListStore *store,
+                   GPtrArray  *fresh)
+{
+  g_autoptr (GPtrArray) merged = NULL;
+  guint n_old                  = 0;
+  guint i                      = 0;
+  guint j                      = 0;
+  guint prefix                 = 0;
+  guint suffix                 = 0;
+
+  n_old = g_list_model_get_n_items (G_LIST_MODEL (store));
+  if (n_old == 0)
+    {
+      g_list_store_splice (store, 0, 0, fresh->pdata, fresh->len);
+      return;
+    }
+
+  merged = g_ptr_array_new_full (fresh->len, g_object_unref);
+  while (j < fresh->len)
+    {
+      g_autoptr (BzEntryGroup) old_group = NULL;
+      BzEntryGroup *new_group            = NULL;
+
+      new_group = g_ptr_array_index (fresh, j);
+      if (i < n_old)
+        old_group = g_list_model_get_item (G_LIST_MODEL (store), i);
+
+      if (old_group == NULL)
+        {
+          g_ptr_array_add (merged, g_object_ref (new_group));
+          j++;
+        }
+      else if (g_strcmp0 (bz_entry_group_get_id (old_group),
+                          bz_entry_group_get_id (new_group)) == 0)
+        {
+          if (groups_equal (old_group, new_group))
+            g_ptr_array_add (merged, g_object_ref (old_group));
+          else
+            g_ptr_array_add (merged, g_object_ref (new_group));
+          i++, j++;
+        }
+      else if (cmp_group (old_group, new_group, NULL) <= 0)
+        i++;
+      else
+        {
+          g_ptr_array_add (merged, g_object_ref (new_group));
+          j++;
+        }
+    }
+
+  while (prefix < n_old && prefix < merged->len)
+    {
+      g_autoptr (BzEntryGroup) old_group = NULL;
+
+      old_group = g_list_model_get_item (G_LIST_MODEL (store), prefix);
+      if (old_group != g_ptr_array_index (merged, prefix))
+        break;
+      prefix++;
+    }
+  while (suffix < n_old - prefix && suffix < merged->len - prefix)
+    {
+      g_autoptr (BzEntryGroup) old_group = NULL;
+
+      old_group = g_list_model_get_item (G_LIST_MODEL (store), n_old - suffix - 1);
+      if (old_group != g_ptr_array_index (merged, merged->len - suffix - 1))
+        break;
+      suffix++;
+    }
+
+  if (prefix + suffix == n_old && prefix + suffix == merged->len)
+    return;
+
+  g_list_store_splice (
+      store,
+      prefix,
+      n_old - prefix - suffix,
+      merged->pdata + prefix,
+      merged->len - prefix - suffix);
+}
+
+static void
+add_installed_group (BzApplication *self,
+                     BzEntryGroup  *group)
+{
+  if (g_hash_table_contains (self->installed_apps_set, group))
+    return;
+
+  g_hash_table_add (self->installed_apps_set, g_object_ref (group));
+  g_list_store_insert_sorted (self->installed_apps, group, (GCompareDataFunc) cmp_group, NULL);
+}
+
+static void
+remove_installed_group (BzApplication *self,
+                        BzEntryGroup  *group)
+{
+  guint position = 0;
+
+  if (!g_hash_table_remove (self->installed_apps_set, group))
+    return;
+
+  /* Only reached when the group really is in
+   * the list, so this search is not a hot path
+   */
+  if (g_list_store_find (self->installed_apps, group, &position))
+    g_list_store_remove (self->installed_apps, position);
+}
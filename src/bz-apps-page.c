@@ -30,6 +30,7 @@ struct _BzAppsPage
   GListModel *applications;
 
   /* Template widgets */
+  GtkScrolledWindow *scrolled_window;
 };
 
 G_DEFINE_FINAL_TYPE (BzAppsPage, bz_apps_page, ADW_TYPE_NAVIGATION_PAGE)
@@ -48,6 +49,7 @@ static GParamSpec *props[LAST_PROP] = { 0 };
 enum
 {
   SIGNAL_SELECT,
+  SIGNAL_NEAR_END,
 
   LAST_SIGNAL,
 };
@@ -57,6 +59,10 @@ static void
 tile_clicked (BzEntryGroup *group,
               GtkButton    *button);
 
+static void
+check_near_end (BzAppsPage    *self,
+                GtkAdjustment *adjustment);
+
 static void
 bz_apps_page_dispose (GObject *object)
 {
@@ -170,9 +176,23 @@ bz_apps_page_class_init (BzAppsPageClass *klass)
       G_TYPE_FROM_CLASS (klass),
       g_cclosure_marshal_VOID__OBJECTv);
 
+  /* Emitted while the end of the list is less than a
+   * screen away, so more can be loaded ahead of time
+   */
+  signals[SIGNAL_NEAR_END] =
+      g_signal_new (
+          "near-end",
+          G_OBJECT_CLASS_TYPE (klass),
+          G_SIGNAL_RUN_LAST,
+          0,
+          NULL, NULL,
+          g_cclosure_marshal_VOID__VOID,
+          G_TYPE_NONE, 0);
+
   g_type_ensure (BZ_TYPE_APP_TILE);
 
   gtk_widget_class_set_template_from_resource (widget_class, "/io/github/kolunmi/Bazaar/bz-apps-page.ui");
+  gtk_widget_class_bind_template_child (widget_class, BzAppsPage, scrolled_window);
   gtk_widget_class_bind_template_callback (widget_class, bind_widget_cb);
   gtk_widget_class_bind_template_callback (widget_class, unbind_widget_cb);
 }
@@ -180,7 +200,22 @@ bz_apps_page_class_init (BzAppsPageClass *klass)
 static void
 bz_apps_page_init (BzAppsPage *self)
 {
+  GtkAdjustment *adjustment = NULL;
+
   gtk_widget_init_template (GTK_WIDGET (self));
+
+  /* "changed" also covers the list growing
+   * without the user scrolling
+   */
+  adjustment = gtk_scrolled_window_get_vadjustment (self->scrolled_window);
+  g_signal_connect_object (
+      adjustment, "value-changed",
+      G_CALLBACK (check_near_end), self,
+      G_CONNECT_SWAPPED);
+  g_signal_connect_object (
+      adjustment, "changed",
+      G_CALLBACK (check_near_end), self,
+      G_CONNECT_SWAPPED);
 }
 
 AdwNavigationPage *
@@ -200,6 +235,18 @@ bz_apps_page_new (const char *title,
   return ADW_NAVIGATION_PAGE (apps_page);
 }
 
+/* Loading more may not add any rows when everything
+ * new is filtered out, in which case the adjustment
+ * never changes, so whoever loads can check again
+ */
+void
+bz_apps_page_check_near_end (BzAppsPage *self)
+{
+  g_return_if_fail (BZ_IS_APPS_PAGE (self));
+
+  check_near_end (self, gtk_scrolled_window_get_vadjustment (self->scrolled_window));
+}
+
 static void
 tile_clicked (BzEntryGroup *group,
               GtkButton    *button)
@@ -209,3 +256,19 @@ tile_clicked (BzEntryGroup *group,
   self = gtk_widget_get_ancestor (GTK_WIDGET (button), BZ_TYPE_APPS_PAGE);
   g_signal_emit (self, signals[SIGNAL_SELECT], 0, group);
 }
+
+static void
+check_near_end (BzAppsPage    *self,
+                GtkAdjustment *adjustment)
+{
+  double value     = 0.0;
+  double page_size = 0.0;
+  double upper     = 0.0;
+
+  value     = gtk_adjustment_get_value (adjustment);
+  page_size = gtk_adjustment_get_page_size (adjustment);
+  upper     = gtk_adjustment_get_upper (adjustment);
+
+  if (value + page_size * 2.0 >= upper)
+    g_signal_emit (self, signals[SIGNAL_NEAR_END], 0);
+}
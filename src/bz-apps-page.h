@@ -32,4 +32,7 @@ AdwNavigationPage *
 bz_apps_page_new (const char *title,
                   GListModel *applications);
 
+void
+bz_apps_page_check_near_end (BzAppsPage *self);
+
 G_END_DECLS
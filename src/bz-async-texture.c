@@ -25,6 +25,7 @@
 #define HTTP_TIMEOUT_SECONDS   5
 #define MAX_LOAD_RETRIES       3
 #define RETRY_INTERVAL_SECONDS 5
+#define MAX_RETAINED_TEXTURES  128
 
 #include "config.h"
 
@@ -34,28 +35,59 @@
 #include "bz-async-texture.h"
 #include "bz-download-worker.h"
 #include "bz-env.h"
+#include "bz-global-state.h"
+#include "bz-image-cache.h"
+#include "bz-image-scale.h"
 #include "bz-io.h"
 #include "bz-util.h"
 
+BZ_DEFINE_DATA (
+    load_ticket,
+    LoadTicket,
+    {
+      DexPromise *start;
+      guint       waiters[BZ_ASYNC_TEXTURE_N_PRIORITIES];
+      int         queued;
+      gboolean    started;
+      gboolean    dropped;
+      GList       link;
+    },
+    BZ_RELEASE_DATA (start, dex_unref));
+
 BZ_DEFINE_DATA (
     load,
     Load,
     {
-      GFile        *source;
-      char         *source_uri;
-      GFile        *cache_into;
-      char         *cache_into_path;
-      GCancellable *cancellable;
-      int           retries;
-      GWeakRef      self;
+      LoadTicketData *ticket;
+      GFile          *source;
+      char           *source_uri;
+      GFile          *cache_into;
+      char           *cache_into_path;
+      GCancellable   *cancellable;
+      int             retries;
+      int             size_hint;
+      GWeakRef        self;
     },
     BZ_RELEASE_DATA (source, g_object_unref);
     BZ_RELEASE_DATA (source_uri, g_free);
     BZ_RELEASE_DATA (cache_into, g_object_unref);
     BZ_RELEASE_DATA (cache_into_path, g_free);
     BZ_RELEASE_DATA (cancellable, g_object_unref);
+    BZ_RELEASE_DATA (ticket, load_ticket_data_unref);
     g_weak_ref_clear (&self->self);)
 
+/* A smaller rendition of the source, such as an
+ * appstream thumbnail, usable for small size hints
+ */
+typedef struct
+{
+  int    size;
+  GFile *source;
+  char  *source_uri;
+  GFile *cache_into;
+  char  *cache_into_path;
+} TextureVariant;
+
 struct _BzAsyncTexture
 {
   GObject parent_instance;
@@ -66,12 +98,35 @@ struct _BzAsyncTexture
   char    *cache_into_path;
   gboolean lazy;
 
+  /* Sorted by ascending size */
+  GPtrArray *variants;
+
   DexFuture    *task;
   GCancellable *cancellable;
 
   int        retries;
   DexFuture *retry_future;
 
+  /* Largest dimension in pixels consumers have asked
+   * for. 0 means nobody has asked yet, in which case the
+   * source is loaded as is; every consumer is expected to
+   * ask for what it displays, since this only ever grows
+   */
+  int size_hint;
+  int task_hint;
+  int loaded_hint;
+
+  /* How many consumers wait at each priority, the
+   * priority it was raised to by being drawn or
+   * awaited, the highest of the two, and the place
+   * held in the queue of the pending load
+   */
+  guint                  waiters[BZ_ASYNC_TEXTURE_N_PRIORITIES];
+  BzAsyncTexturePriority implicit_priority;
+  BzAsyncTexturePriority priority;
+  LoadTicketData        *ticket;
+  BzAsyncTexturePriority ticket_priority;
+
   GdkPaintable *paintable;
   GMutex        texture_mutex;
 };
@@ -99,6 +154,9 @@ static GParamSpec *props[LAST_PROP] = { 0 };
 static DexFuture *
 load_fiber_work (LoadData *data);
 
+static DexFuture *
+load_texture (LoadData *data);
+
 static DexFuture *
 load_finally (DexFuture *future,
               LoadData  *data);
@@ -106,6 +164,22 @@ load_finally (DexFuture *future,
 static void
 maybe_load (BzAsyncTexture *self);
 
+static TextureVariant *
+select_variant (BzAsyncTexture *self);
+
+static void
+texture_variant_free (TextureVariant *variant);
+
+static void
+raise_priority (BzAsyncTexture        *self,
+                BzAsyncTexturePriority priority);
+
+static void
+update_priority (BzAsyncTexture *self);
+
+static void
+detach_ticket (BzAsyncTexture *self);
+
 static DexFuture *
 retry_cb (DexFuture *future,
           LoadData  *data);
@@ -113,6 +187,78 @@ retry_cb (DexFuture *future,
 static gboolean
 idle_notify (BzAsyncTexture *self);
 
+/* Process-wide registry of decoded textures keyed by
+ * size hint and source uri. Consumers of the same uri
+ * and size share a single texture and a single in-flight
+ * load. Textures stay registered for as long as anyone
+ * holds them, and the most recently used ones are
+ * retained a little longer
+ */
+typedef struct
+{
+  char           *key;
+  GWeakRef        texture;
+  GdkTexture     *retained;
+  GList           link;
+  DexFuture      *inflight;
+  LoadTicketData *ticket;
+} SharedTexture;
+
+static GMutex      registry_mutex = { 0 };
+static GHashTable *registry       = NULL;
+static GQueue      registry_lru   = G_QUEUE_INIT;
+
+static char *
+registry_key (const char *uri,
+              int         size_hint);
+
+static GdkTexture *
+registry_dup_texture (const char *key);
+
+static DexFuture *
+registry_dup_load (LoadData        *data,
+                   LoadTicketData **ticket);
+
+static DexFuture *
+registry_load_finally (DexFuture *future,
+                       LoadData  *data);
+
+/* Loads wait in one queue per priority until one of
+ * the slots frees up. The most recent request of the
+ * highest priority goes first, which favors whatever
+ * just scrolled into view
+ */
+static GMutex queue_mutex                                  = { 0 };
+static GQueue queue_pending[BZ_ASYNC_TEXTURE_N_PRIORITIES] = { 0 };
+static guint  queue_running                                = 0;
+
+static void
+ticket_add_waiter (LoadTicketData        *ticket,
+                   BzAsyncTexturePriority priority);
+
+static void
+ticket_remove_waiter (LoadTicketData        *ticket,
+                      BzAsyncTexturePriority priority);
+
+static void
+ticket_update_locked (LoadTicketData *ticket);
+
+static void
+queue_dispatch_locked (void);
+
+static void
+queue_release_slot (void);
+
+static GdkTexture *
+downscale_texture (GdkTexture *texture,
+                   int         max_size);
+
+static gboolean
+revalidate_cached_file (LoadData   *data,
+                        const char *etag,
+                        const char *last_modified,
+                        GError    **error);
+
 static void
 bz_async_texture_dispose (GObject *object)
 {
@@ -121,6 +267,7 @@ bz_async_texture_dispose (GObject *object)
   if (self->cancellable != NULL)
     g_cancellable_cancel (self->cancellable);
   dex_clear (&self->task);
+  detach_ticket (self);
   g_clear_object (&self->cancellable);
   dex_clear (&self->retry_future);
 
@@ -128,6 +275,7 @@ bz_async_texture_dispose (GObject *object)
   g_clear_pointer (&self->source_uri, g_free);
   g_clear_object (&self->cache_into);
   g_clear_pointer (&self->cache_into_path, g_free);
+  g_clear_pointer (&self->variants, g_ptr_array_unref);
   g_clear_object (&self->paintable);
   g_mutex_clear (&self->texture_mutex);
 
@@ -212,8 +360,10 @@ bz_async_texture_class_init (BzAsyncTextureClass *klass)
 static void
 bz_async_texture_init (BzAsyncTexture *self)
 {
-  self->retries   = 0;
-  self->paintable = NULL;
+  self->retries           = 0;
+  self->paintable         = NULL;
+  self->implicit_priority = BZ_ASYNC_TEXTURE_PRIORITY_BACKGROUND;
+  self->priority          = BZ_ASYNC_TEXTURE_PRIORITY_BACKGROUND;
   g_mutex_init (&self->texture_mutex);
 }
 
@@ -227,6 +377,8 @@ paintable_snapshot (GdkPaintable *paintable,
   g_autoptr (GMutexLocker) locker = NULL;
 
   locker = g_mutex_locker_new (&self->texture_mutex);
+  /* Being drawn means it is on screen */
+  raise_priority (self, BZ_ASYNC_TEXTURE_PRIORITY_VISIBLE);
   maybe_load (self);
 
   if (self->paintable != NULL)
@@ -382,6 +534,78 @@ bz_async_texture_get_cache_into_path (BzAsyncTexture *self)
   return self->cache_into_path;
 }
 
+void
+bz_async_texture_add_variant (BzAsyncTexture *self,
+                              GFile          *source,
+                              GFile          *cache_into,
+                              int             size)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  TextureVariant *variant         = NULL;
+  guint           index           = 0;
+
+  g_return_if_fail (BZ_IS_ASYNC_TEXTURE (self));
+  g_return_if_fail (G_IS_FILE (source));
+  g_return_if_fail (cache_into == NULL || G_IS_FILE (cache_into));
+  g_return_if_fail (size > 0);
+
+  variant                  = g_new0 (TextureVariant, 1);
+  variant->size            = size;
+  variant->source          = g_object_ref (source);
+  variant->source_uri      = g_file_get_uri (source);
+  variant->cache_into      = cache_into != NULL ? g_object_ref (cache_into) : NULL;
+  variant->cache_into_path = cache_into != NULL ? g_file_get_path (cache_into) : NULL;
+
+  locker = g_mutex_locker_new (&self->texture_mutex);
+  if (self->variants == NULL)
+    self->variants = g_ptr_array_new_with_free_func (
+        (GDestroyNotify) texture_variant_free);
+
+  for (index = 0; index < self->variants->len; index++)
+    {
+      TextureVariant *other = g_ptr_array_index (self->variants, index);
+
+      if (other->size > size)
+        break;
+    }
+  g_ptr_array_insert (self->variants, index, variant);
+}
+
+guint
+bz_async_texture_get_n_variants (BzAsyncTexture *self)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  g_return_val_if_fail (BZ_IS_ASYNC_TEXTURE (self), 0);
+
+  locker = g_mutex_locker_new (&self->texture_mutex);
+  return self->variants != NULL ? self->variants->len : 0;
+}
+
+void
+bz_async_texture_get_variant (BzAsyncTexture *self,
+                              guint           index,
+                              int            *size,
+                              const char    **source_uri,
+                              const char    **cache_into_path)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  TextureVariant *variant         = NULL;
+
+  g_return_if_fail (BZ_IS_ASYNC_TEXTURE (self));
+
+  locker = g_mutex_locker_new (&self->texture_mutex);
+  g_return_if_fail (self->variants != NULL && index < self->variants->len);
+
+  variant = g_ptr_array_index (self->variants, index);
+  if (size != NULL)
+    *size = variant->size;
+  if (source_uri != NULL)
+    *source_uri = variant->source_uri;
+  if (cache_into_path != NULL)
+    *cache_into_path = variant->cache_into_path;
+}
+
 gboolean
 bz_async_texture_get_loaded (BzAsyncTexture *self)
 {
@@ -412,8 +636,18 @@ bz_async_texture_dup_future (BzAsyncTexture *self)
   g_return_val_if_fail (BZ_IS_ASYNC_TEXTURE (self), NULL);
 
   locker = g_mutex_locker_new (&self->texture_mutex);
+  /* Someone is waiting on this right now */
+  raise_priority (self, BZ_ASYNC_TEXTURE_PRIORITY_VISIBLE);
   maybe_load (self);
-  return dex_ref (self->task);
+  if (self->task != NULL)
+    return dex_ref (self->task);
+  else if (GDK_IS_TEXTURE (self->paintable))
+    return dex_future_new_for_object (self->paintable);
+  else
+    return dex_future_new_reject (
+        G_IO_ERROR,
+        G_IO_ERROR_FAILED,
+        "texture loading failed");
 }
 
 void
@@ -424,6 +658,10 @@ bz_async_texture_ensure (BzAsyncTexture *self)
   g_return_if_fail (BZ_IS_ASYNC_TEXTURE (self));
 
   locker = g_mutex_locker_new (&self->texture_mutex);
+  /* Only asks for the load to happen eventually,
+   * consumers say how urgently with waiters
+   */
+  raise_priority (self, BZ_ASYNC_TEXTURE_PRIORITY_BACKGROUND);
   maybe_load (self);
 }
 
@@ -434,6 +672,7 @@ bz_async_texture_cancel (BzAsyncTexture *self)
 
   if (self->cancellable != NULL)
     g_cancellable_cancel (self->cancellable);
+  detach_ticket (self);
   dex_clear (&self->task);
   g_clear_object (&self->cancellable);
   self->retries = G_MAXINT;
@@ -446,170 +685,385 @@ bz_async_texture_is_loading (BzAsyncTexture *self)
   return self->task != NULL && dex_future_is_pending (self->task);
 }
 
+void
+bz_async_texture_request_size (BzAsyncTexture *self,
+                               int             max_size)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  g_return_if_fail (BZ_IS_ASYNC_TEXTURE (self));
+
+  locker = g_mutex_locker_new (&self->texture_mutex);
+  /* The texture may be shared by several widgets,
+   * so it must satisfy the largest of them
+   */
+  if (max_size <= self->size_hint)
+    return;
+  self->size_hint = max_size;
+
+  if (!self->lazy ||
+      GDK_IS_TEXTURE (self->paintable) ||
+      (self->task != NULL && dex_future_is_pending (self->task)))
+    maybe_load (self);
+}
+
+int
+bz_async_texture_get_size_hint (BzAsyncTexture *self)
+{
+  g_return_val_if_fail (BZ_IS_ASYNC_TEXTURE (self), 0);
+  return self->size_hint;
+}
+
+void
+bz_async_texture_add_waiter (BzAsyncTexture        *self,
+                             BzAsyncTexturePriority priority)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  g_return_if_fail (BZ_IS_ASYNC_TEXTURE (self));
+  g_return_if_fail (priority > BZ_ASYNC_TEXTURE_PRIORITY_IDLE &&
+                    priority < BZ_ASYNC_TEXTURE_N_PRIORITIES);
+
+  locker = g_mutex_locker_new (&self->texture_mutex);
+  self->waiters[priority]++;
+  update_priority (self);
+}
+
+void
+bz_async_texture_remove_waiter (BzAsyncTexture        *self,
+                                BzAsyncTexturePriority priority)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  g_return_if_fail (BZ_IS_ASYNC_TEXTURE (self));
+  g_return_if_fail (priority > BZ_ASYNC_TEXTURE_PRIORITY_IDLE &&
+                    priority < BZ_ASYNC_TEXTURE_N_PRIORITIES);
+
+  locker = g_mutex_locker_new (&self->texture_mutex);
+  g_return_if_fail (self->waiters[priority] > 0);
+
+  self->waiters[priority]--;
+  /* Whatever drew or awaited this may have gone with
+   * the consumer, being drawn again raises it back
+   */
+  self->implicit_priority = BZ_ASYNC_TEXTURE_PRIORITY_IDLE;
+  update_priority (self);
+}
+
+BzAsyncTexturePriority
+bz_async_texture_get_priority (BzAsyncTexture *self)
+{
+  g_return_val_if_fail (BZ_IS_ASYNC_TEXTURE (self), BZ_ASYNC_TEXTURE_PRIORITY_IDLE);
+  return self->priority;
+}
+
 static void
 maybe_load (BzAsyncTexture *self)
 {
-  g_autoptr (LoadData) data    = NULL;
-  g_autoptr (DexFuture) future = NULL;
-
-  if (GDK_IS_TEXTURE (self->paintable) ||
-      (self->task != NULL && dex_future_is_pending (self->task)) ||
-      self->retries >= MAX_LOAD_RETRIES)
+  g_autofree char *key           = NULL;
+  g_autoptr (GdkTexture) texture = NULL;
+  g_autoptr (LoadData) data      = NULL;
+  g_autoptr (DexFuture) future   = NULL;
+  TextureVariant *variant        = NULL;
+  GFile          *source         = NULL;
+  const char     *source_uri     = NULL;
+  GFile          *cache_into     = NULL;
+  const char     *cache_path     = NULL;
+
+  if (self->retries >= MAX_LOAD_RETRIES)
+    return;
+  if (self->priority == BZ_ASYNC_TEXTURE_PRIORITY_IDLE)
+    return;
+  /* Already have a texture large enough, either
+   * the full resolution or the requested size
+   */
+  if (GDK_IS_TEXTURE (self->paintable) &&
+      (self->loaded_hint == 0 || self->loaded_hint >= self->size_hint))
+    return;
+  if (self->task != NULL && dex_future_is_pending (self->task) &&
+      self->task_hint == self->size_hint)
     return;
 
   if (self->cancellable != NULL)
     g_cancellable_cancel (self->cancellable);
+  detach_ticket (self);
   dex_clear (&self->task);
   g_clear_object (&self->cancellable);
 
   self->cancellable = g_cancellable_new ();
 
+  /* Don't fetch the full source when a smaller
+   * rendition would do, so growing size hints
+   * upgrade to larger ones as they come
+   */
+  variant = select_variant (self);
+  if (variant != NULL)
+    {
+      source     = variant->source;
+      source_uri = variant->source_uri;
+      cache_into = variant->cache_into;
+      cache_path = variant->cache_into_path;
+    }
+  else
+    {
+      source     = self->source;
+      source_uri = self->source_uri;
+      cache_into = self->cache_into;
+      cache_path = self->cache_into_path;
+    }
+
+  key     = registry_key (source_uri, self->size_hint);
+  texture = registry_dup_texture (key);
+  if (texture != NULL)
+    {
+      g_clear_object (&self->paintable);
+      self->paintable   = GDK_PAINTABLE (g_steal_pointer (&texture));
+      self->loaded_hint = self->size_hint;
+      self->task        = dex_future_new_for_object (self->paintable);
+
+      g_idle_add_full (
+          G_PRIORITY_DEFAULT_IDLE,
+          (GSourceFunc) idle_notify,
+          g_object_ref (self), g_object_unref);
+      return;
+    }
+
   data                  = load_data_new ();
-  data->source          = g_object_ref (self->source);
-  data->source_uri      = g_strdup (self->source_uri);
-  data->cache_into      = self->cache_into != NULL ? g_object_ref (self->cache_into) : NULL;
-  data->cache_into_path = self->cache_into_path != NULL ? g_strdup (self->cache_into_path) : NULL;
+  data->source          = g_object_ref (source);
+  data->source_uri      = g_strdup (source_uri);
+  data->cache_into      = cache_into != NULL ? g_object_ref (cache_into) : NULL;
+  data->cache_into_path = g_strdup (cache_path);
   data->cancellable     = g_object_ref (self->cancellable);
   data->retries         = self->retries;
+  data->size_hint       = self->size_hint;
   g_weak_ref_init (&data->self, self);
 
-  future = dex_scheduler_spawn (
-      bz_get_io_scheduler (),
-      bz_get_dex_stack_size (),
-      (DexFiberFunc) load_fiber_work,
-      load_data_ref (data), load_data_unref);
+  future = registry_dup_load (data, &self->ticket);
   future = dex_future_finally (
       future,
       (DexFutureCallback) load_finally,
       load_data_ref (data), load_data_unref);
-  self->task = g_steal_pointer (&future);
+  self->task      = g_steal_pointer (&future);
+  self->task_hint = self->size_hint;
+
+  self->ticket_priority = self->priority;
+  ticket_add_waiter (self->ticket, self->ticket_priority);
 }
 
-static DexFuture *
-load_fiber_work (LoadData *data)
+static TextureVariant *
+select_variant (BzAsyncTexture *self)
 {
-  static GMutex   queueing_mutex                       = { 0 };
-  static guint    ongoing_queued[MAX_CONCURRENT_LOADS] = { 0 };
-  static BzGuard *gates[MAX_CONCURRENT_LOADS]          = { 0 };
-  static GMutex   mutexes[MAX_CONCURRENT_LOADS]        = { 0 };
-
-  GFile        *source                  = data->source;
-  char         *source_uri              = data->source_uri;
-  GFile        *cache_into              = data->cache_into;
-  char         *cache_into_path         = data->cache_into_path;
-  GCancellable *cancellable             = data->cancellable;
-  gboolean      result                  = FALSE;
-  g_autoptr (GError) local_error        = NULL;
-  g_autoptr (GMutexLocker) locker       = NULL;
-  g_autoptr (BzGuard) slot_guard        = NULL;
-  guint    slot_queued                  = G_MAXUINT;
-  guint    slot_index                   = 0;
-  gboolean is_http                      = FALSE;
-  g_autoptr (GDateTime) now             = NULL;
-  g_autofree char *async_tex_data_path  = NULL;
-  g_autoptr (GFile) async_tex_data_file = NULL;
-  g_autoptr (GdkTexture) texture        = NULL;
-  g_autoptr (GlyFrame) frame            = NULL;
-
-  /* Rate limiting to reduce competition for resources */
-  locker = g_mutex_locker_new (&queueing_mutex);
-  for (guint i = 0; i < G_N_ELEMENTS (gates); i++)
-    {
-      if (ongoing_queued[i] < slot_queued)
+  /* A hint of zero asks for the full resolution */
+  if (self->variants == NULL || self->size_hint <= 0)
+    return NULL;
+
+  for (guint i = 0; i < self->variants->len; i++)
+    {
+      TextureVariant *variant = g_ptr_array_index (self->variants, i);
+
+      if (variant->size >= self->size_hint)
+        return variant;
+    }
+
+  return NULL;
+}
+
+static void
+texture_variant_free (TextureVariant *variant)
+{
+  g_clear_object (&variant->source);
+  g_clear_pointer (&variant->source_uri, g_free);
+  g_clear_object (&variant->cache_into);
+  g_clear_pointer (&variant->cache_into_path, g_free);
+  g_free (variant);
+}
+
+static void
+raise_priority (BzAsyncTexture        *self,
+                BzAsyncTexturePriority priority)
+{
+  if (priority <= self->implicit_priority)
+    return;
+
+  self->implicit_priority = priority;
+  update_priority (self);
+}
+
+static void
+update_priority (BzAsyncTexture *self)
+{
+  BzAsyncTexturePriority priority = BZ_ASYNC_TEXTURE_PRIORITY_IDLE;
+
+  priority = self->implicit_priority;
+  for (int i = BZ_ASYNC_TEXTURE_N_PRIORITIES - 1; i > (int) priority; i--)
+    {
+      if (self->waiters[i] > 0)
         {
-          slot_queued = ongoing_queued[i];
-          slot_index  = i;
+          priority = i;
+          break;
         }
     }
-  ongoing_queued[slot_index]++;
-  g_clear_pointer (&locker, g_mutex_locker_free);
 
-  BZ_BEGIN_GUARD_WITH_CONTEXT (&slot_guard,
-                               &mutexes[slot_index],
-                               &gates[slot_index]);
+  if (priority == self->priority)
+    return;
+  self->priority = priority;
+  if (self->ticket == NULL)
+    return;
 
-  locker = g_mutex_locker_new (&queueing_mutex);
-  ongoing_queued[slot_index]--;
-  g_clear_pointer (&locker, g_mutex_locker_free);
+  if (priority == BZ_ASYNC_TEXTURE_PRIORITY_IDLE)
+    {
+      gboolean started = FALSE;
 
-  is_http = g_str_has_prefix (source_uri, "http");
-  now     = g_date_time_new_now_utc ();
-  if (cache_into != NULL)
+      g_mutex_lock (&queue_mutex);
+      started = self->ticket->started;
+      g_mutex_unlock (&queue_mutex);
+
+      /* Nobody wants this anymore, so give up the place
+       * in the queue. A load that already started is
+       * left alone since it is probably almost done
+       */
+      if (!started)
+        {
+          if (self->cancellable != NULL)
+            g_cancellable_cancel (self->cancellable);
+          detach_ticket (self);
+          dex_clear (&self->task);
+          g_clear_object (&self->cancellable);
+        }
+    }
+  else if (priority != self->ticket_priority)
     {
-      async_tex_data_path = g_strdup_printf ("%s.bz-async-texture-data", cache_into_path);
-      async_tex_data_file = g_file_new_for_path (async_tex_data_path);
+      ticket_add_waiter (self->ticket, priority);
+      ticket_remove_waiter (self->ticket, self->ticket_priority);
+      self->ticket_priority = priority;
     }
+}
+
+static void
+detach_ticket (BzAsyncTexture *self)
+{
+  if (self->ticket == NULL)
+    return;
+
+  ticket_remove_waiter (self->ticket, self->ticket_priority);
+  g_clear_pointer (&self->ticket, load_ticket_data_unref);
+}
+
+static DexFuture *
+load_fiber_work (LoadData *data)
+{
+  g_autoptr (GError) local_error = NULL;
+  gboolean   result              = FALSE;
+  DexFuture *ret                 = NULL;
+
+  result = dex_await (dex_ref (data->ticket->start), &local_error);
+  if (!result)
+    return dex_future_new_for_error (g_steal_pointer (&local_error));
 
-  if (cache_into != NULL &&
-      g_file_query_exists (cache_into, NULL) &&
-      g_file_query_exists (async_tex_data_file, NULL))
+  ret = load_texture (data);
+  queue_release_slot ();
+
+  return ret;
+}
+
+static DexFuture *
+load_texture (LoadData *data)
+{
+  GFile        *source            = data->source;
+  char         *source_uri        = data->source_uri;
+  GFile        *cache_into        = data->cache_into;
+  char         *cache_into_path   = data->cache_into_path;
+  GCancellable *cancellable       = data->cancellable;
+  gboolean      result            = FALSE;
+  g_autoptr (GError) local_error  = NULL;
+  gboolean is_http                = FALSE;
+  g_autofree char *scaled_path    = NULL;
+  g_autoptr (GFile) scaled_file   = NULL;
+  g_autoptr (GdkTexture) texture  = NULL;
+  g_autoptr (GlyFrame) frame      = NULL;
+  gboolean downscaled             = FALSE;
+
+  is_http = g_str_has_prefix (source_uri, "http");
+
+  if (cache_into != NULL && data->size_hint > 0)
     {
-      g_autoptr (GBytes) bytes     = NULL;
-      g_autoptr (GVariant) variant = NULL;
-      GTimeSpan age_span           = 0;
-      g_autoptr (GlyLoader) loader = NULL;
-      g_autoptr (GlyImage) image   = NULL;
+      scaled_path = g_strdup_printf ("%s@%d.png", cache_into_path, data->size_hint);
+      scaled_file = g_file_new_for_path (scaled_path);
 
-      bytes = g_file_load_bytes (async_tex_data_file, NULL, NULL, &local_error);
-      if (bytes != NULL)
-        variant = g_variant_new_from_bytes (G_VARIANT_TYPE ("a{sv}"), bytes, FALSE);
-      if (variant != NULL)
+      if (bz_image_cache_lookup (scaled_path, CACHE_INVALID_AGE))
         {
-          gint64 birth_unix_stamp               = 0;
-          g_autoptr (GDateTime) birth_date_time = NULL;
+          g_autoptr (GlyLoader) loader = NULL;
+          g_autoptr (GlyImage) image   = NULL;
+
+          loader = gly_loader_new (scaled_file);
+          /* Written by us below */
+          gly_loader_set_sandbox_selector (loader, GLY_SANDBOX_SELECTOR_NOT_SANDBOXED);
 
-          if (g_variant_lookup (
-                  variant,
-                  "birth-unix-stamp", "x",
-                  &birth_unix_stamp))
+          image = gly_loader_load (loader, NULL);
+          if (image != NULL)
+            frame = gly_image_next_frame (image, NULL);
+
+          if (frame != NULL)
             {
-              birth_date_time = g_date_time_new_from_unix_utc (birth_unix_stamp);
-              age_span        = g_date_time_difference (now, birth_date_time);
+              texture = gly_gtk_frame_get_texture (frame);
+              if (texture != NULL)
+                return dex_future_new_for_object (texture);
             }
-          else
-            local_error = g_error_new (G_IO_ERROR, G_IO_ERROR_NOT_FOUND, "key \"birth-unix-stamp\" was not found");
+          g_clear_object (&frame);
+          bz_image_cache_forget (scaled_path);
         }
+    }
 
-      if (variant != NULL && age_span > 0)
+  if (cache_into != NULL)
+    {
+      BzImageCacheState state        = BZ_IMAGE_CACHE_MISS;
+      g_autofree char *etag          = NULL;
+      g_autofree char *last_modified = NULL;
+      g_autoptr (GlyLoader) loader   = NULL;
+      g_autoptr (GlyImage) image     = NULL;
+
+      state = bz_image_cache_query (
+          cache_into_path, CACHE_INVALID_AGE,
+          &etag, &last_modified);
+      if (state == BZ_IMAGE_CACHE_STALE)
         {
-          if (age_span < CACHE_INVALID_AGE)
+          /* Most images never change upstream, so ask
+           * the server before throwing this one away
+           */
+          if (is_http &&
+              (etag != NULL || last_modified != NULL) &&
+              revalidate_cached_file (data, etag, last_modified, &local_error))
+            state = BZ_IMAGE_CACHE_FRESH;
+          else
             {
-              loader = gly_loader_new (cache_into);
-              /* We assume we exported this file, so uhhh it is safe to
-                 not use sandboxing, since it is faster :-) */
-              gly_loader_set_sandbox_selector (loader, GLY_SANDBOX_SELECTOR_NOT_SANDBOXED);
-
-              image = gly_loader_load (loader, &local_error);
-              if (image != NULL)
-                frame = gly_image_next_frame (image, &local_error);
+              if (local_error != NULL)
+                g_debug ("Could not revalidate cached texture at %s, "
+                         "fetching from original source at %s instead: %s",
+                         cache_into_path, source_uri, local_error->message);
+              g_clear_pointer (&local_error, g_error_free);
+              bz_image_cache_forget (cache_into_path);
             }
-          else
-            g_debug ("Metadata file %s for cached texture at %s indicates this resource is too old (GTimeSpan: %zu), "
-                     "reaping and fetching from original source at %s instead",
-                     async_tex_data_path, cache_into_path, age_span, source_uri);
-        }
-      else
-        {
-          g_warning ("Couldn't load associated metadata file %s for cached texture at %s, "
-                     "reaping and fetching from original source at %s instead: %s",
-                     async_tex_data_path, cache_into_path, source_uri, local_error->message);
-          g_clear_pointer (&local_error, g_error_free);
         }
 
-      if (frame == NULL)
+      if (state == BZ_IMAGE_CACHE_FRESH)
         {
-          if (local_error != NULL)
-            g_warning ("An attempt to revive cached texture at %s has failed, "
-                       "reaping and fetching from original source at %s instead: %s",
-                       cache_into_path, source_uri, local_error->message);
-          g_clear_pointer (&local_error, g_error_free);
+          loader = gly_loader_new (cache_into);
+          /* We assume we exported this file, so uhhh it is safe to
+             not use sandboxing, since it is faster :-) */
+          gly_loader_set_sandbox_selector (loader, GLY_SANDBOX_SELECTOR_NOT_SANDBOXED);
 
-          if (!g_file_delete (cache_into, NULL, &local_error))
+          image = gly_loader_load (loader, &local_error);
+          if (image != NULL)
+            frame = gly_image_next_frame (image, &local_error);
+
+          if (frame == NULL)
             {
-              g_critical ("Couldn't reap cached texture at %s, this "
-                          "might lead to unexpected behavior: %s",
-                          cache_into_path, local_error->message);
+              g_warning ("An attempt to revive cached texture at %s has failed, "
+                         "reaping and fetching from original source at %s instead: %s",
+                         cache_into_path, source_uri,
+                         local_error != NULL ? local_error->message : "unknown error");
               g_clear_pointer (&local_error, g_error_free);
+              bz_image_cache_forget (cache_into_path);
             }
         }
     }
@@ -623,38 +1077,16 @@ load_fiber_work (LoadData *data)
       if (cache_into != NULL)
         {
           g_autoptr (GFile) parent = NULL;
-          gboolean reconstruct     = FALSE;
 
           parent = g_file_get_parent (cache_into);
-
-          if (g_file_query_exists (parent, NULL))
-            {
-              GFileType parent_type = G_FILE_TYPE_UNKNOWN;
-
-              parent_type = g_file_query_file_type (parent, G_FILE_QUERY_INFO_NONE, NULL);
-              if (parent_type != G_FILE_TYPE_DIRECTORY)
-                {
-                  reconstruct = TRUE;
-
-                  result = g_file_delete (parent, cancellable, &local_error);
-                  if (!result)
-                    return dex_future_new_for_error (g_steal_pointer (&local_error));
-                }
-            }
-          else
-            reconstruct = TRUE;
-
-          if (reconstruct)
+          result = g_file_make_directory_with_parents (
+              parent, cancellable, &local_error);
+          if (!result)
             {
-              result = g_file_make_directory_with_parents (
-                  parent, cancellable, &local_error);
-              if (!result)
-                {
-                  if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_EXISTS))
-                    g_clear_pointer (&local_error, g_error_free);
-                  else
-                    return dex_future_new_for_error (g_steal_pointer (&local_error));
-                }
+              if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+                g_clear_pointer (&local_error, g_error_free);
+              else
+                return dex_future_new_for_error (g_steal_pointer (&local_error));
             }
         }
 
@@ -676,17 +1108,36 @@ load_fiber_work (LoadData *data)
               g_io_stream_close (G_IO_STREAM (io), NULL, NULL);
             }
 
-          result = dex_await (
+          /* The worker decodes and scales the image as well, so
+           * only the final pixels ever reach this process
+           */
+          texture = dex_await_object (
               dex_future_first (
-                  bz_download_worker_invoke (
+                  bz_download_worker_invoke_decode (
                       bz_download_worker_get_default (),
-                      source, load_file),
+                      source, load_file, MAX (data->size_hint, 0)),
                   /* increase the timeout as more failures stack up */
                   dex_timeout_new_seconds ((data->retries + 1) * HTTP_TIMEOUT_SECONDS),
                   NULL),
               &local_error);
-          if (!result)
+          if (cache_into == NULL)
+            /* delete tmp file */
+            g_file_delete (load_file, NULL, NULL);
+          if (texture == NULL)
             return dex_future_new_for_error (g_steal_pointer (&local_error));
+
+          if (cache_into != NULL)
+            bz_image_cache_record_with_validators (
+                cache_into_path,
+                g_object_get_data (G_OBJECT (texture), BZ_DOWNLOAD_WORKER_ETAG_KEY),
+                g_object_get_data (G_OBJECT (texture), BZ_DOWNLOAD_WORKER_LAST_MODIFIED_KEY));
+
+          /* A texture exactly this size was most
+           * likely scaled down by the worker
+           */
+          downscaled = data->size_hint > 0 &&
+                       MAX (gdk_texture_get_width (texture),
+                            gdk_texture_get_height (texture)) == data->size_hint;
         }
       else
         {
@@ -703,74 +1154,70 @@ load_fiber_work (LoadData *data)
             }
           else
             load_file = g_object_ref (source);
-        }
 
-      loader = gly_loader_new (load_file);
+          loader = gly_loader_new (load_file);
 #ifdef SANDBOXED_LIBFLATPAK
-      gly_loader_set_sandbox_selector (loader, GLY_SANDBOX_SELECTOR_NOT_SANDBOXED);
+          gly_loader_set_sandbox_selector (loader, GLY_SANDBOX_SELECTOR_NOT_SANDBOXED);
 #endif
 
-      image = gly_loader_load (loader, &local_error);
-      if (is_http && cache_into == NULL)
-        /* delete tmp file */
-        g_file_delete (load_file, NULL, NULL);
-      if (image == NULL || local_error != NULL)
-        return dex_future_new_for_error (g_steal_pointer (&local_error));
-
-      frame = gly_image_next_frame (image, &local_error);
-      if (frame == NULL)
-        return dex_future_new_for_error (g_steal_pointer (&local_error));
-
-      if (async_tex_data_file != NULL)
-        {
-          g_autoptr (GVariantBuilder) builder  = NULL;
-          g_autoptr (GVariant) variant         = NULL;
-          g_autoptr (GBytes) bytes             = NULL;
-          g_autoptr (GFileOutputStream) output = NULL;
-
-          builder = g_variant_builder_new (G_VARIANT_TYPE ("a{sv}"));
-          g_variant_builder_add (
-              builder,
-              "{sv}",
-              "birth-unix-stamp",
-              g_variant_new_int64 (g_date_time_to_unix (now)));
-
-          variant = g_variant_builder_end (builder);
-          bytes   = g_variant_get_data_as_bytes (variant);
-
-          output = g_file_replace (
-              async_tex_data_file,
-              NULL,
-              FALSE,
-              G_FILE_CREATE_REPLACE_DESTINATION,
-              NULL,
-              &local_error);
-          if (output != NULL)
-            {
-              gssize bytes_written = 0;
+          image = gly_loader_load (loader, &local_error);
+          if (image == NULL || local_error != NULL)
+            return dex_future_new_for_error (g_steal_pointer (&local_error));
 
-              bytes_written = g_output_stream_write_bytes (G_OUTPUT_STREAM (output), bytes, NULL, &local_error);
-              if (bytes_written > 0)
-                g_output_stream_close (G_OUTPUT_STREAM (output), NULL, &local_error);
-            }
+          frame = gly_image_next_frame (image, &local_error);
+          if (frame == NULL)
+            return dex_future_new_for_error (g_steal_pointer (&local_error));
 
-          if (local_error != NULL)
-            g_critical ("Failed to write async-tex cache metadata to %s ;"
-                        "The image will be fully reloaded next time: %s",
-                        async_tex_data_path, local_error->message);
-          g_clear_pointer (&local_error, g_error_free);
+          if (cache_into != NULL)
+            bz_image_cache_record (cache_into_path);
         }
     }
 
-  bz_clear_guard (&slot_guard);
-
-  texture = gly_gtk_frame_get_texture (frame);
+  if (texture == NULL)
+    texture = gly_gtk_frame_get_texture (frame);
   if (texture == NULL)
     return dex_future_new_reject (
         G_IO_ERROR,
         G_IO_ERROR_FAILED,
         "texture loading failed");
 
+  if (data->size_hint > 0 &&
+      MAX (gdk_texture_get_width (texture),
+           gdk_texture_get_height (texture)) > data->size_hint)
+    {
+      g_autoptr (GdkTexture) scaled = NULL;
+
+      scaled = downscale_texture (texture, data->size_hint);
+      g_clear_object (&texture);
+      texture    = g_steal_pointer (&scaled);
+      downscaled = TRUE;
+    }
+
+  if (downscaled && scaled_file != NULL)
+    {
+      g_autoptr (GBytes) png_bytes = NULL;
+
+      png_bytes = gdk_texture_save_to_png_bytes (texture);
+      result    = g_file_replace_contents (
+          scaled_file,
+          g_bytes_get_data (png_bytes, NULL),
+          g_bytes_get_size (png_bytes),
+          NULL,
+          FALSE,
+          G_FILE_CREATE_REPLACE_DESTINATION,
+          NULL,
+          NULL,
+          &local_error);
+      if (result)
+        bz_image_cache_record (scaled_path);
+      else
+        {
+          g_warning ("Failed to cache scaled texture at %s: %s",
+                     scaled_path, local_error->message);
+          g_clear_pointer (&local_error, g_error_free);
+        }
+    }
+
   return dex_future_new_for_object (texture);
 }
 
@@ -790,12 +1237,28 @@ load_finally (DexFuture *future,
         "Object was discarded");
 
   locker = g_mutex_locker_new (&self->texture_mutex);
+  /* Superseded by a load for another size */
+  if (g_cancellable_is_cancelled (data->cancellable))
+    return dex_ref (future);
+  detach_ticket (self);
   dex_clear (&self->task);
 
   if (dex_future_is_resolved (future))
     {
+      GdkTexture *texture = NULL;
+
+      texture = g_value_get_object (dex_future_get_value (future, NULL));
       g_clear_object (&self->paintable);
-      self->paintable = g_value_dup_object (dex_future_get_value (future, NULL));
+      self->paintable = g_object_ref (GDK_PAINTABLE (texture));
+      /* A texture smaller than the hint was
+       * not scaled, so it is the full resolution
+       */
+      if (data->size_hint > 0 &&
+          MAX (gdk_texture_get_width (texture),
+               gdk_texture_get_height (texture)) >= data->size_hint)
+        self->loaded_hint = data->size_hint;
+      else
+        self->loaded_hint = 0;
 
       g_idle_add_full (
           G_PRIORITY_DEFAULT_IDLE,
@@ -812,12 +1275,12 @@ load_finally (DexFuture *future,
           if (self->retries == MAX_LOAD_RETRIES - 1)
             g_warning ("Loading %s failed: %s. Retrying in %d seconds. This will "
                        "be the last retry, after which this texture will remain invalid",
-                       self->source_uri,
+                       data->source_uri,
                        local_error->message,
                        RETRY_INTERVAL_SECONDS);
           else
             g_warning ("Loading %s failed: %s. Retrying in %d seconds. Retries left: %d",
-                       self->source_uri,
+                       data->source_uri,
                        local_error->message,
                        RETRY_INTERVAL_SECONDS,
                        MAX_LOAD_RETRIES - self->retries);
@@ -864,3 +1327,448 @@ idle_notify (BzAsyncTexture *self)
 
   return G_SOURCE_REMOVE;
 }
+
+static void
+shared_texture_free (SharedTexture *shared)
+{
+  if (shared->retained != NULL)
+    g_queue_unlink (&registry_lru, &shared->link);
+  g_clear_object (&shared->retained);
+  g_weak_ref_clear (&shared->texture);
+  dex_clear (&shared->inflight);
+  g_clear_pointer (&shared->ticket, load_ticket_data_unref);
+  g_free (shared->key);
+  g_free (shared);
+}
+
+static SharedTexture *
+registry_ensure_locked (const char *key)
+{
+  SharedTexture *shared = NULL;
+
+  if (registry == NULL)
+    registry = g_hash_table_new_full (
+        g_str_hash, g_str_equal,
+        NULL, (GDestroyNotify) shared_texture_free);
+
+  shared = g_hash_table_lookup (registry, key);
+  if (shared == NULL)
+    {
+      shared            = g_new0 (SharedTexture, 1);
+      shared->key       = g_strdup (key);
+      shared->link.data = shared;
+      g_weak_ref_init (&shared->texture, NULL);
+      g_hash_table_replace (registry, shared->key, shared);
+    }
+
+  return shared;
+}
+
+/* Returns the textures which fell out of the LRU, so they
+ * can be released after the registry lock is dropped
+ */
+static GPtrArray *
+registry_retain_locked (SharedTexture *shared,
+                        GdkTexture    *texture)
+{
+  GPtrArray *evicted = NULL;
+
+  if (shared->retained != NULL)
+    g_queue_unlink (&registry_lru, &shared->link);
+  else
+    shared->retained = g_object_ref (texture);
+  g_queue_push_head_link (&registry_lru, &shared->link);
+
+  evicted = g_ptr_array_new_with_free_func (g_object_unref);
+  while (registry_lru.length > MAX_RETAINED_TEXTURES)
+    {
+      GList         *link   = NULL;
+      SharedTexture *oldest = NULL;
+
+      link   = g_queue_pop_tail_link (&registry_lru);
+      oldest = link->data;
+      g_ptr_array_add (evicted, g_steal_pointer (&oldest->retained));
+    }
+
+  return evicted;
+}
+
+static void
+registry_sweep_locked (void)
+{
+  GHashTableIter iter = { 0 };
+
+  if (g_hash_table_size (registry) < MAX_RETAINED_TEXTURES * 4)
+    return;
+
+  g_hash_table_iter_init (&iter, registry);
+  for (;;)
+    {
+      SharedTexture *shared          = NULL;
+      g_autoptr (GdkTexture) texture = NULL;
+
+      if (!g_hash_table_iter_next (&iter, NULL, (gpointer *) &shared))
+        break;
+
+      if (shared->retained != NULL || shared->inflight != NULL)
+        continue;
+
+      texture = g_weak_ref_get (&shared->texture);
+      if (texture == NULL)
+        g_hash_table_iter_remove (&iter);
+    }
+}
+
+static char *
+registry_key (const char *uri,
+              int         size_hint)
+{
+  return g_strdup_printf ("%d:%s", size_hint, uri);
+}
+
+static GdkTexture *
+registry_dup_texture (const char *key)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  g_autoptr (GPtrArray) evicted   = NULL;
+  SharedTexture *shared           = NULL;
+  GdkTexture    *texture          = NULL;
+
+  locker = g_mutex_locker_new (&registry_mutex);
+  if (registry == NULL)
+    return NULL;
+
+  shared = g_hash_table_lookup (registry, key);
+  if (shared == NULL)
+    return NULL;
+
+  texture = g_weak_ref_get (&shared->texture);
+  if (texture != NULL)
+    evicted = registry_retain_locked (shared, texture);
+
+  g_clear_pointer (&locker, g_mutex_locker_free);
+  return texture;
+}
+
+static DexFuture *
+registry_dup_load (LoadData        *data,
+                   LoadTicketData **ticket)
+{
+  g_autofree char *key             = NULL;
+  g_autoptr (GMutexLocker) locker  = NULL;
+  SharedTexture *shared            = NULL;
+  gboolean       dropped           = FALSE;
+  g_autoptr (LoadData) shared_data = NULL;
+  g_autoptr (DexFuture) future     = NULL;
+
+  key    = registry_key (data->source_uri, data->size_hint);
+  locker = g_mutex_locker_new (&registry_mutex);
+  shared = registry_ensure_locked (key);
+  if (shared->inflight != NULL)
+    {
+      g_mutex_lock (&queue_mutex);
+      dropped = shared->ticket->dropped;
+      g_mutex_unlock (&queue_mutex);
+
+      /* A dropped load is about to fail, so
+       * it cannot be joined
+       */
+      if (!dropped)
+        {
+          *ticket = load_ticket_data_ref (shared->ticket);
+          return dex_ref (shared->inflight);
+        }
+      dex_clear (&shared->inflight);
+      g_clear_pointer (&shared->ticket, load_ticket_data_unref);
+    }
+
+  /* The load is shared, so one consumer
+   * cancelling must not affect the others
+   */
+  shared_data                  = load_data_new ();
+  shared_data->source          = g_object_ref (data->source);
+  shared_data->source_uri      = g_strdup (data->source_uri);
+  shared_data->cache_into      = data->cache_into != NULL ? g_object_ref (data->cache_into) : NULL;
+  shared_data->cache_into_path = g_strdup (data->cache_into_path);
+  shared_data->cancellable     = g_cancellable_new ();
+  shared_data->retries         = data->retries;
+  shared_data->size_hint       = data->size_hint;
+  g_weak_ref_init (&shared_data->self, NULL);
+
+  shared_data->ticket         = load_ticket_data_new ();
+  shared_data->ticket->start  = dex_promise_new ();
+  shared_data->ticket->queued = -1;
+
+  future = dex_scheduler_spawn (
+      bz_get_io_scheduler (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) load_fiber_work,
+      load_data_ref (shared_data), load_data_unref);
+  future = dex_future_finally (
+      future,
+      (DexFutureCallback) registry_load_finally,
+      load_data_ref (shared_data), load_data_unref);
+  shared->inflight = dex_ref (future);
+  shared->ticket   = load_ticket_data_ref (shared_data->ticket);
+
+  *ticket = load_ticket_data_ref (shared_data->ticket);
+  return g_steal_pointer (&future);
+}
+
+static DexFuture *
+registry_load_finally (DexFuture *future,
+                       LoadData  *data)
+{
+  g_autofree char *key            = NULL;
+  g_autoptr (GMutexLocker) locker = NULL;
+  g_autoptr (GPtrArray) evicted   = NULL;
+  SharedTexture *shared           = NULL;
+  GdkTexture    *texture          = NULL;
+
+  key    = registry_key (data->source_uri, data->size_hint);
+  locker = g_mutex_locker_new (&registry_mutex);
+  shared = registry_ensure_locked (key);
+  /* Might have been replaced after being dropped */
+  if (shared->ticket == data->ticket)
+    {
+      dex_clear (&shared->inflight);
+      g_clear_pointer (&shared->ticket, load_ticket_data_unref);
+    }
+
+  if (dex_future_is_resolved (future))
+    {
+      texture = g_value_get_object (dex_future_get_value (future, NULL));
+      g_weak_ref_set (&shared->texture, texture);
+      evicted = registry_retain_locked (shared, texture);
+    }
+  registry_sweep_locked ();
+
+  g_clear_pointer (&locker, g_mutex_locker_free);
+  return dex_ref (future);
+}
+
+static void
+ticket_add_waiter (LoadTicketData        *ticket,
+                   BzAsyncTexturePriority priority)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  locker = g_mutex_locker_new (&queue_mutex);
+  ticket->waiters[priority]++;
+  ticket_update_locked (ticket);
+}
+
+static void
+ticket_remove_waiter (LoadTicketData        *ticket,
+                      BzAsyncTexturePriority priority)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  locker = g_mutex_locker_new (&queue_mutex);
+  g_assert (ticket->waiters[priority] > 0);
+  ticket->waiters[priority]--;
+  ticket_update_locked (ticket);
+}
+
+/* Moves the ticket to the queue of the most urgent
+ * waiter, or drops it once nobody is waiting
+ */
+static void
+ticket_update_locked (LoadTicketData *ticket)
+{
+  int priority = BZ_ASYNC_TEXTURE_PRIORITY_IDLE;
+
+  if (ticket->started || ticket->dropped)
+    return;
+
+  for (int i = BZ_ASYNC_TEXTURE_N_PRIORITIES - 1; i > BZ_ASYNC_TEXTURE_PRIORITY_IDLE; i--)
+    {
+      if (ticket->waiters[i] > 0)
+        {
+          priority = i;
+          break;
+        }
+    }
+  if (priority == ticket->queued)
+    return;
+
+  if (ticket->queued >= 0)
+    {
+      g_queue_unlink (&queue_pending[ticket->queued], &ticket->link);
+      ticket->link.data = NULL;
+      load_ticket_data_unref (ticket);
+      ticket->queued = -1;
+    }
+
+  if (priority == BZ_ASYNC_TEXTURE_PRIORITY_IDLE)
+    {
+      ticket->dropped = TRUE;
+      dex_promise_reject (
+          ticket->start,
+          g_error_new (G_IO_ERROR,
+                       G_IO_ERROR_CANCELLED,
+                       "The load is no longer wanted"));
+      return;
+    }
+
+  ticket->link.data = load_ticket_data_ref (ticket);
+  ticket->queued    = priority;
+  g_queue_push_head_link (&queue_pending[priority], &ticket->link);
+
+  queue_dispatch_locked ();
+}
+
+static void
+queue_dispatch_locked (void)
+{
+  while (queue_running < MAX_CONCURRENT_LOADS)
+    {
+      LoadTicketData *ticket = NULL;
+
+      for (int i = BZ_ASYNC_TEXTURE_N_PRIORITIES - 1; i > BZ_ASYNC_TEXTURE_PRIORITY_IDLE; i--)
+        {
+          GList *link = NULL;
+
+          link = g_queue_pop_head_link (&queue_pending[i]);
+          if (link != NULL)
+            {
+              ticket = link->data;
+              break;
+            }
+        }
+      if (ticket == NULL)
+        break;
+
+      ticket->link.data = NULL;
+      ticket->queued    = -1;
+      ticket->started   = TRUE;
+      queue_running++;
+
+      dex_promise_resolve_boolean (ticket->start, TRUE);
+      load_ticket_data_unref (ticket);
+    }
+}
+
+static void
+queue_release_slot (void)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  locker = g_mutex_locker_new (&queue_mutex);
+  queue_running--;
+  queue_dispatch_locked ();
+}
+
+/* Cheap enough to run on the io scheduler */
+static GdkTexture *
+downscale_texture (GdkTexture *texture,
+                   int         max_size)
+{
+  int width                                   = 0;
+  int height                                  = 0;
+  int dst_width                               = 0;
+  int dst_height                              = 0;
+  g_autoptr (GdkTextureDownloader) downloader = NULL;
+  g_autoptr (GBytes) src_bytes                = NULL;
+  gsize   src_stride                          = 0;
+  gsize   dst_stride                          = 0;
+  guint8 *dst                                 = NULL;
+  g_autoptr (GBytes) dst_bytes                = NULL;
+
+  width  = gdk_texture_get_width (texture);
+  height = gdk_texture_get_height (texture);
+  bz_image_scale_fit (width, height, max_size, &dst_width, &dst_height);
+  if (dst_width == width && dst_height == height)
+    return g_object_ref (texture);
+
+  downloader = gdk_texture_downloader_new (texture);
+  gdk_texture_downloader_set_format (downloader, GDK_MEMORY_R8G8B8A8_PREMULTIPLIED);
+  src_bytes = gdk_texture_downloader_download_bytes (downloader, &src_stride);
+
+  dst_stride = (gsize) dst_width * 4;
+  dst        = g_malloc (dst_stride * dst_height);
+  bz_image_scale_rgba (
+      g_bytes_get_data (src_bytes, NULL),
+      width, height, src_stride,
+      dst, dst_width, dst_height, dst_stride);
+
+  dst_bytes = g_bytes_new_take (dst, dst_stride * dst_height);
+  return gdk_memory_texture_new (
+      dst_width, dst_height,
+      GDK_MEMORY_R8G8B8A8_PREMULTIPLIED,
+      dst_bytes, dst_stride);
+}
+
+static gboolean
+revalidate_cached_file (LoadData   *data,
+                        const char *etag,
+                        const char *last_modified,
+                        GError    **error)
+{
+  g_autoptr (SoupMessage) message  = NULL;
+  SoupMessageHeaders *headers      = NULL;
+  g_autoptr (GOutputStream) output = NULL;
+  gboolean result                  = FALSE;
+  guint    status                  = SOUP_STATUS_NONE;
+  g_autoptr (GBytes) bytes         = NULL;
+
+  message = soup_message_new (SOUP_METHOD_GET, data->source_uri);
+  if (message == NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "Invalid uri '%s'", data->source_uri);
+      return FALSE;
+    }
+
+  headers = soup_message_get_request_headers (message);
+  if (etag != NULL)
+    soup_message_headers_append (headers, "If-None-Match", etag);
+  if (last_modified != NULL)
+    soup_message_headers_append (headers, "If-Modified-Since", last_modified);
+
+  output = g_memory_output_stream_new_resizable ();
+  result = dex_await (
+      dex_future_first (
+          bz_send_with_global_http_session_then_splice_into (message, output),
+          dex_timeout_new_seconds (HTTP_TIMEOUT_SECONDS),
+          NULL),
+      error);
+  if (!result)
+    return FALSE;
+
+  status = soup_message_get_status (message);
+  if (status == SOUP_STATUS_NOT_MODIFIED)
+    {
+      bz_image_cache_refresh (data->cache_into_path);
+      return TRUE;
+    }
+  else if (!SOUP_STATUS_IS_SUCCESSFUL (status))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "HTTP request for '%s' failed with status %u",
+                   data->source_uri, status);
+      return FALSE;
+    }
+
+  /* The image changed, so we already have the new one */
+  bytes  = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (output));
+  result = g_file_replace_contents (
+      data->cache_into,
+      g_bytes_get_data (bytes, NULL),
+      g_bytes_get_size (bytes),
+      NULL,
+      FALSE,
+      G_FILE_CREATE_REPLACE_DESTINATION,
+      NULL,
+      data->cancellable,
+      error);
+  if (!result)
+    return FALSE;
+
+  headers = soup_message_get_response_headers (message);
+  bz_image_cache_record_with_validators (
+      data->cache_into_path,
+      soup_message_headers_get_one (headers, "ETag"),
+      soup_message_headers_get_one (headers, "Last-Modified"));
+  return TRUE;
+}
@@ -25,6 +25,16 @@
 
 G_BEGIN_DECLS
 
+typedef enum
+{
+  BZ_ASYNC_TEXTURE_PRIORITY_IDLE = 0,
+  BZ_ASYNC_TEXTURE_PRIORITY_BACKGROUND,
+  BZ_ASYNC_TEXTURE_PRIORITY_PREFETCH,
+  BZ_ASYNC_TEXTURE_PRIORITY_VISIBLE,
+
+  BZ_ASYNC_TEXTURE_N_PRIORITIES
+} BzAsyncTexturePriority;
+
 #define BZ_TYPE_ASYNC_TEXTURE (bz_async_texture_get_type ())
 G_DECLARE_FINAL_TYPE (BzAsyncTexture, bz_async_texture, BZ, ASYNC_TEXTURE, GObject)
 
@@ -48,6 +58,26 @@ bz_async_texture_get_cache_into (BzAsyncTexture *self);
 const char *
 bz_async_texture_get_cache_into_path (BzAsyncTexture *self);
 
+/* Registers a smaller rendition of the source whose
+ * largest dimension is @size. Size hints it satisfies
+ * are loaded from it instead of the full source
+ */
+void
+bz_async_texture_add_variant (BzAsyncTexture *self,
+                              GFile          *source,
+                              GFile          *cache_into,
+                              int             size);
+
+guint
+bz_async_texture_get_n_variants (BzAsyncTexture *self);
+
+void
+bz_async_texture_get_variant (BzAsyncTexture *self,
+                              guint           index,
+                              int            *size,
+                              const char    **source_uri,
+                              const char    **cache_into_path);
+
 gboolean
 bz_async_texture_get_loaded (BzAsyncTexture *self);
 
@@ -66,4 +96,27 @@ bz_async_texture_cancel (BzAsyncTexture *self);
 gboolean
 bz_async_texture_is_loading (BzAsyncTexture *self);
 
+void
+bz_async_texture_request_size (BzAsyncTexture *self,
+                               int             max_size);
+
+int
+bz_async_texture_get_size_hint (BzAsyncTexture *self);
+
+/* Consumers add a waiter at the priority they need
+ * the texture at while they hold it, and remove it
+ * once they let go. The load waits at the highest
+ * priority anyone is still waiting at
+ */
+void
+bz_async_texture_add_waiter (BzAsyncTexture        *self,
+                             BzAsyncTexturePriority priority);
+
+void
+bz_async_texture_remove_waiter (BzAsyncTexture        *self,
+                                BzAsyncTexturePriority priority);
+
+BzAsyncTexturePriority
+bz_async_texture_get_priority (BzAsyncTexture *self);
+
 G_END_DECLS
@@ -0,0 +1,362 @@
+/* bz-catalog-snapshot.c
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN  "BAZAAR::SNAPSHOT"
+#define BAZAAR_MODULE "catalog-snapshot"
+
+/* Bump this whenever the layout of the snapshot
+ * or of any serialized entry group changes
+ */
+#define SNAPSHOT_FORMAT_VERSION 1
+#define SNAPSHOT_FILENAME       "snapshot"
+
+#include "config.h"
+
+#include "bz-catalog-snapshot.h"
+#include "bz-entry-group.h"
+#include "bz-env.h"
+#include "bz-io.h"
+#include "bz-serializable.h"
+#include "bz-util.h"
+
+/* clang-format off */
+G_DEFINE_QUARK (bz-catalog-snapshot-error-quark, bz_catalog_snapshot_error);
+/* clang-format on */
+
+struct _BzCatalogSnapshot
+{
+  GObject parent_instance;
+
+  GListStore *groups;
+  GHashTable *installed_set;
+
+  /* Decoded off-thread, turned into groups on the main thread */
+  GVariant *pending_groups;
+};
+
+G_DEFINE_FINAL_TYPE (BzCatalogSnapshot, bz_catalog_snapshot, G_TYPE_OBJECT);
+
+BZ_DEFINE_DATA (
+    load,
+    Load,
+    {
+      BzApplicationMapFactory *factory;
+    },
+    BZ_RELEASE_DATA (factory, g_object_unref));
+static DexFuture *
+load_fiber (LoadData *data);
+static DexFuture *
+load_then (DexFuture *future,
+           LoadData  *data);
+
+BZ_DEFINE_DATA (
+    save,
+    Save,
+    {
+      GBytes *bytes;
+    },
+    BZ_RELEASE_DATA (bytes, g_bytes_unref));
+static DexFuture *
+save_fiber (SaveData *data);
+
+static void
+bz_catalog_snapshot_dispose (GObject *object)
+{
+  BzCatalogSnapshot *self = BZ_CATALOG_SNAPSHOT (object);
+
+  g_clear_object (&self->groups);
+  g_clear_pointer (&self->installed_set, g_hash_table_unref);
+  g_clear_pointer (&self->pending_groups, g_variant_unref);
+
+  G_OBJECT_CLASS (bz_catalog_snapshot_parent_class)->dispose (object);
+}
+
+static void
+bz_catalog_snapshot_class_init (BzCatalogSnapshotClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = bz_catalog_snapshot_dispose;
+}
+
+static void
+bz_catalog_snapshot_init (BzCatalogSnapshot *self)
+{
+  self->groups        = g_list_store_new (BZ_TYPE_ENTRY_GROUP);
+  self->installed_set = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+}
+
+GListModel *
+bz_catalog_snapshot_get_groups (BzCatalogSnapshot *self)
+{
+  g_return_val_if_fail (BZ_IS_CATALOG_SNAPSHOT (self), NULL);
+  return G_LIST_MODEL (self->groups);
+}
+
+GHashTable *
+bz_catalog_snapshot_get_installed_set (BzCatalogSnapshot *self)
+{
+  g_return_val_if_fail (BZ_IS_CATALOG_SNAPSHOT (self), NULL);
+  return self->installed_set;
+}
+
+/* Must be called from the main thread, since that
+ * is where the restored groups will be built
+ */
+DexFuture *
+bz_catalog_snapshot_load (BzApplicationMapFactory *factory)
+{
+  g_autoptr (LoadData) data    = NULL;
+  g_autoptr (DexFuture) future = NULL;
+
+  dex_return_error_if_fail (BZ_IS_APPLICATION_MAP_FACTORY (factory));
+
+  data          = load_data_new ();
+  data->factory = g_object_ref (factory);
+
+  future = dex_scheduler_spawn (
+      bz_get_io_scheduler (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) load_fiber,
+      load_data_ref (data), load_data_unref);
+  future = dex_future_then (
+      future, (DexFutureCallback) load_then,
+      load_data_ref (data), load_data_unref);
+  return g_steal_pointer (&future);
+}
+
+DexFuture *
+bz_catalog_snapshot_save (GListModel *groups,
+                          GHashTable *installed_set)
+{
+  g_autoptr (GVariantBuilder) builder        = NULL;
+  g_autoptr (GVariantBuilder) groups_builder = NULL;
+  g_autoptr (GVariantBuilder) ids_builder    = NULL;
+  guint          n_groups                    = 0;
+  GHashTableIter iter                        = { 0 };
+  g_autoptr (GVariant) variant               = NULL;
+  g_autoptr (SaveData) data                  = NULL;
+
+  dex_return_error_if_fail (G_IS_LIST_MODEL (groups));
+  dex_return_error_if_fail (installed_set != NULL);
+
+  /* Entry groups belong to the main thread, so
+   * serialize here and only hand off the bytes
+   */
+  groups_builder = g_variant_builder_new (G_VARIANT_TYPE ("aa{sv}"));
+  n_groups       = g_list_model_get_n_items (groups);
+  for (guint i = 0; i < n_groups; i++)
+    {
+      g_autoptr (BzEntryGroup) group            = NULL;
+      g_autoptr (GVariantBuilder) group_builder = NULL;
+
+      group         = g_list_model_get_item (groups, i);
+      group_builder = g_variant_builder_new (G_VARIANT_TYPE_VARDICT);
+      bz_serializable_serialize (BZ_SERIALIZABLE (group), group_builder);
+      g_variant_builder_add_value (groups_builder, g_variant_builder_end (group_builder));
+    }
+
+  ids_builder = g_variant_builder_new (G_VARIANT_TYPE ("as"));
+  g_hash_table_iter_init (&iter, installed_set);
+  for (;;)
+    {
+      const char *unique_id = NULL;
+
+      if (!g_hash_table_iter_next (&iter, (gpointer *) &unique_id, NULL))
+        break;
+      g_variant_builder_add (ids_builder, "s", unique_id);
+    }
+
+  builder = g_variant_builder_new (G_VARIANT_TYPE_VARDICT);
+  g_variant_builder_add (builder, "{sv}", "format-version", g_variant_new_uint32 (SNAPSHOT_FORMAT_VERSION));
+  g_variant_builder_add (builder, "{sv}", "bazaar-version", g_variant_new_string (PACKAGE_VERSION));
+  g_variant_builder_add (builder, "{sv}", "groups", g_variant_builder_end (groups_builder));
+  g_variant_builder_add (builder, "{sv}", "installed", g_variant_builder_end (ids_builder));
+  variant = g_variant_ref_sink (g_variant_builder_end (builder));
+
+  data        = save_data_new ();
+  data->bytes = g_variant_get_data_as_bytes (variant);
+
+  return dex_scheduler_spawn (
+      bz_get_io_scheduler (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) save_fiber,
+      save_data_ref (data), save_data_unref);
+}
+
+static DexFuture *
+load_fiber (LoadData *data)
+{
+  g_autoptr (GError) local_error         = NULL;
+  g_autofree char *module_dir            = NULL;
+  g_autoptr (GFile) file                 = NULL;
+  g_autoptr (GBytes) bytes               = NULL;
+  g_autoptr (GVariant) untrusted         = NULL;
+  g_autoptr (GVariant) variant           = NULL;
+  guint32     format_version             = 0;
+  const char *bazaar_version             = NULL;
+  g_autoptr (GVariant) groups            = NULL;
+  g_autoptr (GVariant) installed         = NULL;
+  g_autoptr (BzCatalogSnapshot) snapshot = NULL;
+  GVariantIter id_iter                   = { 0 };
+
+  module_dir = bz_dup_module_dir ();
+  file       = g_file_new_build_filename (module_dir, SNAPSHOT_FILENAME, NULL);
+
+  bytes = g_file_load_bytes (file, NULL, NULL, &local_error);
+  if (bytes == NULL)
+    return dex_future_new_reject (
+        BZ_CATALOG_SNAPSHOT_ERROR,
+        BZ_CATALOG_SNAPSHOT_ERROR_LOAD_FAILED,
+        "Failed to read catalog snapshot: %s",
+        local_error->message);
+
+  untrusted = g_variant_new_from_bytes (G_VARIANT_TYPE_VARDICT, bytes, FALSE);
+  variant   = g_variant_get_normal_form (untrusted);
+
+  if (!g_variant_lookup (variant, "format-version", "u", &format_version) ||
+      !g_variant_lookup (variant, "bazaar-version", "&s", &bazaar_version) ||
+      format_version != SNAPSHOT_FORMAT_VERSION ||
+      g_strcmp0 (bazaar_version, PACKAGE_VERSION) != 0)
+    {
+      bz_discard_module_dir ();
+      return dex_future_new_reject (
+          BZ_CATALOG_SNAPSHOT_ERROR,
+          BZ_CATALOG_SNAPSHOT_ERROR_INCOMPATIBLE,
+          "Catalog snapshot was written by an incompatible version of Bazaar");
+    }
+
+  groups    = g_variant_lookup_value (variant, "groups", G_VARIANT_TYPE ("aa{sv}"));
+  installed = g_variant_lookup_value (variant, "installed", G_VARIANT_TYPE ("as"));
+  if (groups == NULL || installed == NULL)
+    return dex_future_new_reject (
+        BZ_CATALOG_SNAPSHOT_ERROR,
+        BZ_CATALOG_SNAPSHOT_ERROR_LOAD_FAILED,
+        "Catalog snapshot is malformed");
+
+  snapshot                 = g_object_new (BZ_TYPE_CATALOG_SNAPSHOT, NULL);
+  snapshot->pending_groups = g_steal_pointer (&groups);
+
+  g_variant_iter_init (&id_iter, installed);
+  for (;;)
+    {
+      char *unique_id = NULL;
+
+      if (!g_variant_iter_next (&id_iter, "s", &unique_id))
+        break;
+      g_hash_table_add (snapshot->installed_set, unique_id);
+    }
+
+  return dex_future_new_for_object (snapshot);
+}
+
+static DexFuture *
+load_then (DexFuture *future,
+           LoadData  *data)
+{
+  BzCatalogSnapshot *snapshot    = NULL;
+  g_autoptr (GError) local_error = NULL;
+  GVariantIter group_iter        = { 0 };
+  g_autoptr (GPtrArray) restored = NULL;
+  g_autoptr (GVariant) groups    = NULL;
+
+  /* Entry groups belong to the main thread, so
+   * they are only built and deserialized here
+   */
+  snapshot = g_value_get_object (dex_future_get_value (future, NULL));
+  groups   = g_steal_pointer (&snapshot->pending_groups);
+  restored = g_ptr_array_new_with_free_func (g_object_unref);
+
+  g_variant_iter_init (&group_iter, groups);
+  for (;;)
+    {
+      g_autoptr (GVariant) group_variant = NULL;
+      g_autoptr (BzEntryGroup) group     = NULL;
+      gboolean result                    = FALSE;
+
+      group_variant = g_variant_iter_next_value (&group_iter);
+      if (group_variant == NULL)
+        break;
+
+      group  = bz_entry_group_new (data->factory);
+      result = bz_serializable_deserialize (BZ_SERIALIZABLE (group), group_variant, &local_error);
+      if (!result)
+        {
+          g_warning ("Skipping entry group in catalog snapshot: %s", local_error->message);
+          g_clear_pointer (&local_error, g_error_free);
+          continue;
+        }
+
+      g_ptr_array_add (restored, g_steal_pointer (&group));
+    }
+  g_list_store_splice (snapshot->groups, 0, 0, restored->pdata, restored->len);
+
+  return dex_ref (future);
+}
+
+static DexFuture *
+save_fiber (SaveData *data)
+{
+  g_autoptr (GError) local_error = NULL;
+  g_autofree char *module_dir    = NULL;
+  g_autoptr (GFile) parent_file  = NULL;
+  g_autoptr (GFile) file         = NULL;
+  gboolean result                = FALSE;
+
+  module_dir  = bz_dup_module_dir ();
+  parent_file = g_file_new_for_path (module_dir);
+  result      = g_file_make_directory_with_parents (parent_file, NULL, &local_error);
+  if (!result)
+    {
+      if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+        g_clear_pointer (&local_error, g_error_free);
+      else
+        return dex_future_new_reject (
+            BZ_CATALOG_SNAPSHOT_ERROR,
+            BZ_CATALOG_SNAPSHOT_ERROR_SAVE_FAILED,
+            "Failed to make parent directory '%s' for catalog snapshot: %s",
+            module_dir, local_error->message);
+    }
+
+  /* g_file_replace_contents writes to a temporary
+   * file first, so a crash never leaves a torn snapshot
+   */
+  file   = g_file_get_child (parent_file, SNAPSHOT_FILENAME);
+  result = g_file_replace_contents (
+      file,
+      g_bytes_get_data (data->bytes, NULL),
+      g_bytes_get_size (data->bytes),
+      NULL,
+      FALSE,
+      G_FILE_CREATE_REPLACE_DESTINATION,
+      NULL,
+      NULL,
+      &local_error);
+  if (!result)
+    return dex_future_new_reject (
+        BZ_CATALOG_SNAPSHOT_ERROR,
+        BZ_CATALOG_SNAPSHOT_ERROR_SAVE_FAILED,
+        "Failed to write catalog snapshot: %s",
+        local_error->message);
+
+  return dex_future_new_true ();
+}
+
+/* End of bz-catalog-snapshot.c */
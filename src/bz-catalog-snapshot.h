@@ -0,0 +1,57 @@
+/* bz-catalog-snapshot.h
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <libdex.h>
+
+#include "bz-application-map-factory.h"
+
+G_BEGIN_DECLS
+
+#define BZ_CATALOG_SNAPSHOT_ERROR (bz_catalog_snapshot_error_quark ())
+GQuark bz_catalog_snapshot_error_quark (void);
+
+typedef enum
+{
+  BZ_CATALOG_SNAPSHOT_ERROR_SAVE_FAILED = 0,
+  BZ_CATALOG_SNAPSHOT_ERROR_LOAD_FAILED,
+  BZ_CATALOG_SNAPSHOT_ERROR_INCOMPATIBLE,
+} BzCatalogSnapshotError;
+
+#define BZ_TYPE_CATALOG_SNAPSHOT (bz_catalog_snapshot_get_type ())
+G_DECLARE_FINAL_TYPE (BzCatalogSnapshot, bz_catalog_snapshot, BZ, CATALOG_SNAPSHOT, GObject)
+
+GListModel *
+bz_catalog_snapshot_get_groups (BzCatalogSnapshot *self);
+
+GHashTable *
+bz_catalog_snapshot_get_installed_set (BzCatalogSnapshot *self);
+
+DexFuture *
+bz_catalog_snapshot_load (BzApplicationMapFactory *factory);
+
+DexFuture *
+bz_catalog_snapshot_save (GListModel *groups,
+                          GHashTable *installed_set);
+
+G_END_DECLS
+
+/* End of bz-catalog-snapshot.h */
@@ -18,11 +18,15 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#include <glib/gi18n.h>
+
 #include "bz-decorated-screenshot.h"
+#include "bz-env.h"
 #include "bz-error.h"
+#include "bz-io.h"
 #include "bz-screenshot.h"
+#include "bz-util.h"
 #include "bz-window.h"
-#include <glib/gi18n.h>
 
 struct _BzDecoratedScreenshot
 {
@@ -31,6 +35,7 @@ struct _BzDecoratedScreenshot
   BzAsyncTexture *async_texture;
 
   GtkEventController *motion;
+  DexFuture          *copy_task;
 
   /* Template widgets */
   GtkWidget *buttons;
@@ -48,12 +53,28 @@ enum
 };
 static GParamSpec *props[LAST_PROP] = { 0 };
 
+BZ_DEFINE_DATA (
+    copy,
+    Copy,
+    {
+      GWeakRef self;
+      char    *path;
+    },
+    g_weak_ref_clear (&self->self);
+    BZ_RELEASE_DATA (path, g_free));
+static DexFuture *
+copy_fiber (CopyData *data);
+static DexFuture *
+copy_finally (DexFuture *future,
+              CopyData  *data);
+
 static void
 bz_decorated_screenshot_dispose (GObject *object)
 {
   BzDecoratedScreenshot *self = BZ_DECORATED_SCREENSHOT (object);
 
   g_clear_pointer (&self->async_texture, g_object_unref);
+  dex_clear (&self->copy_task);
 
   G_OBJECT_CLASS (bz_decorated_screenshot_parent_class)->dispose (object);
 }
@@ -121,25 +142,68 @@ open_externally_clicked (BzDecoratedScreenshot *self,
 }
 
 static void
-copy_clicked (BzDecoratedScreenshot *self,
-              GtkButton             *button)
+copy_texture (BzDecoratedScreenshot *self,
+              GdkTexture            *texture)
 {
-  g_autoptr (GdkTexture) texture = NULL;
-  GdkClipboard *clipboard;
-  BzWindow     *window = NULL;
-  AdwToast     *toast  = NULL;
-
-  texture = bz_async_texture_dup_texture (self->async_texture);
-  /* button shouldn't be clickable if not loaded */
-  g_assert (texture != NULL);
+  GdkClipboard *clipboard = NULL;
+  GtkRoot      *root      = NULL;
+  AdwToast     *toast     = NULL;
 
   clipboard = gdk_display_get_clipboard (gdk_display_get_default ());
   gdk_clipboard_set_texture (clipboard, texture);
 
-  window = BZ_WINDOW (gtk_widget_get_root (GTK_WIDGET (self)));
-  toast  = adw_toast_new (_ ("Copied!"));
+  root = gtk_widget_get_root (GTK_WIDGET (self));
+  if (!BZ_IS_WINDOW (root))
+    return;
+
+  toast = adw_toast_new (_ ("Copied!"));
   adw_toast_set_timeout (toast, 1);
-  bz_window_add_toast (window, toast);
+  bz_window_add_toast (BZ_WINDOW (root), toast);
+}
+
+static void
+copy_clicked (BzDecoratedScreenshot *self,
+              GtkButton             *button)
+{
+  g_autoptr (CopyData) data    = NULL;
+  g_autoptr (DexFuture) future = NULL;
+  const char *cache_path       = NULL;
+
+  if (self->copy_task != NULL &&
+      dex_future_get_status (self->copy_task) == DEX_FUTURE_STATUS_PENDING)
+    return;
+  dex_clear (&self->copy_task);
+
+  /* The displayed texture may have been scaled down, so prefer the
+   * original when we have it. Decoding it can take a while, so do it
+   * off the main thread and fill the clipboard when it is ready
+   */
+  cache_path = bz_async_texture_get_cache_into_path (self->async_texture);
+  if (cache_path == NULL)
+    {
+      g_autoptr (GdkTexture) texture = NULL;
+
+      texture = bz_async_texture_dup_texture (self->async_texture);
+      /* button shouldn't be clickable if not loaded */
+      g_assert (texture != NULL);
+
+      copy_texture (self, texture);
+      return;
+    }
+
+  data = copy_data_new ();
+  g_weak_ref_init (&data->self, self);
+  data->path = g_strdup (cache_path);
+
+  future = dex_scheduler_spawn (
+      bz_get_io_scheduler (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) copy_fiber,
+      copy_data_ref (data), copy_data_unref);
+  future = dex_future_finally (
+      future, (DexFutureCallback) copy_finally,
+      copy_data_ref (data), copy_data_unref);
+  self->copy_task = g_steal_pointer (&future);
 }
 
 static void
@@ -237,4 +301,49 @@ bz_decorated_screenshot_set_async_texture (BzDecoratedScreenshot *self,
   g_object_notify_by_pspec (G_OBJECT (self), props[PROP_ASYNC_TEXTURE]);
 }
 
+static DexFuture *
+copy_fiber (CopyData *data)
+{
+  g_autoptr (GError) local_error = NULL;
+  g_autoptr (GdkTexture) texture = NULL;
+
+  texture = gdk_texture_new_from_filename (data->path, &local_error);
+  if (texture == NULL)
+    return dex_future_new_for_error (g_steal_pointer (&local_error));
+
+  return dex_future_new_for_object (texture);
+}
+
+static DexFuture *
+copy_finally (DexFuture *future,
+              CopyData  *data)
+{
+  g_autoptr (BzDecoratedScreenshot) self = NULL;
+  g_autoptr (GError) local_error         = NULL;
+  g_autoptr (GdkTexture) texture         = NULL;
+  const GValue *value                    = NULL;
+
+  self = g_weak_ref_get (&data->self);
+  if (self == NULL)
+    return NULL;
+
+  value = dex_future_get_value (future, &local_error);
+  if (value != NULL)
+    texture = g_value_dup_object (value);
+  else
+    {
+      /* Usually only a thumbnail was fetched, so
+       * this is the expected case
+       */
+      g_debug ("Couldn't load %s for the clipboard, copying the displayed image instead: %s",
+               data->path, local_error->message);
+      if (self->async_texture != NULL)
+        texture = bz_async_texture_dup_texture (self->async_texture);
+    }
+
+  if (texture != NULL)
+    copy_texture (self, texture);
+  return NULL;
+}
+
 /* End of bz-decorated-screenshot.c */
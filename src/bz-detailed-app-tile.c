@@ -20,14 +20,23 @@
 
 #include <adwaita.h>
 
+#include "bz-async-texture.h"
 #include "bz-detailed-app-tile.h"
+#include "bz-flathub-stats.h"
 #include "bz-group-tile-css-watcher.h"
 
+/* Matches the pixel-size of the icon in bz-detailed-app-tile.blp */
+#define ICON_SIZE 96
+
 struct _BzDetailedAppTile
 {
   GtkButton parent_instance;
 
   BzEntryGroup *group;
+  /* The icon we added a waiter to, since the
+   * group can get one after we were bound
+   */
+  BzAsyncTexture *waited_icon;
 
   BzGroupTileCssWatcher *css;
 };
@@ -49,6 +58,11 @@ bz_detailed_app_tile_dispose (GObject *object)
 {
   BzDetailedAppTile *self = BZ_DETAILED_APP_TILE (object);
 
+  if (self->waited_icon != NULL)
+    bz_async_texture_remove_waiter (
+        self->waited_icon,
+        BZ_ASYNC_TEXTURE_PRIORITY_PREFETCH);
+  g_clear_object (&self->waited_icon);
   g_clear_pointer (&self->group, g_object_unref);
   g_clear_pointer (&self->css, g_object_unref);
 
@@ -158,9 +172,37 @@ bz_detailed_app_tile_set_group (BzDetailedAppTile *self,
 {
   g_return_if_fail (BZ_IS_DETAILED_APP_TILE (self));
 
+  /* Scrolled away, so a load which has not started
+   * yet can be dropped if nobody else waits on it
+   */
+  if (self->waited_icon != NULL)
+    bz_async_texture_remove_waiter (
+        self->waited_icon,
+        BZ_ASYNC_TEXTURE_PRIORITY_PREFETCH);
+  g_clear_object (&self->waited_icon);
   g_clear_pointer (&self->group, g_object_unref);
   if (group != NULL)
-    self->group = g_object_ref (group);
+    {
+      GdkPaintable *icon = NULL;
+
+      self->group = g_object_ref (group);
+
+      icon = bz_entry_group_get_icon_paintable (group);
+      if (BZ_IS_ASYNC_TEXTURE (icon))
+        {
+          self->waited_icon = g_object_ref (BZ_ASYNC_TEXTURE (icon));
+          bz_async_texture_add_waiter (
+              self->waited_icon,
+              BZ_ASYNC_TEXTURE_PRIORITY_PREFETCH);
+          bz_async_texture_request_size (
+              BZ_ASYNC_TEXTURE (icon),
+              ICON_SIZE * gtk_widget_get_scale_factor (GTK_WIDGET (self)));
+        }
+
+      /* So the app page can show its stats right away */
+      if (bz_entry_group_get_is_flathub (group))
+        bz_flathub_stats_prefetch (bz_entry_group_get_id (group));
+    }
 
   bz_group_tile_css_watcher_set_group (self->css, group);
 
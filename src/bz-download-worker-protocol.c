@@ -0,0 +1,131 @@
+/* bz-download-worker-protocol.c
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "BAZAAR::DL-WORKER-PROTOCOL"
+
+#define MAX_FRAME_SIZE (16 * 1024 * 1024)
+
+#include "config.h"
+
+#include <libdex.h>
+
+#include "bz-download-worker-protocol.h"
+
+static GBytes *
+read_exactly (GInputStream *stream,
+              gsize         count,
+              gboolean     *eof,
+              GError      **error);
+
+GBytes *
+bz_download_worker_frame_new (GVariant *variant)
+{
+  g_autoptr (GVariant) normal = NULL;
+  GByteArray *frame           = NULL;
+  guint32     size            = 0;
+
+  g_return_val_if_fail (variant != NULL, NULL);
+
+  normal = g_variant_get_normal_form (variant);
+  size   = GUINT32_TO_BE ((guint32) g_variant_get_size (normal));
+
+  frame = g_byte_array_sized_new (sizeof (size) + g_variant_get_size (normal));
+  g_byte_array_append (frame, (const guint8 *) &size, sizeof (size));
+  g_byte_array_append (frame, g_variant_get_data (normal), g_variant_get_size (normal));
+
+  return g_byte_array_free_to_bytes (frame);
+}
+
+/* Must be called from a fiber. Returns NULL without
+ * setting @error if the stream ended between frames
+ */
+GVariant *
+bz_download_worker_read_frame (GInputStream       *stream,
+                               const GVariantType *type,
+                               GError            **error)
+{
+  g_autoptr (GBytes) header = NULL;
+  g_autoptr (GBytes) body   = NULL;
+  gboolean eof              = FALSE;
+  guint32  size             = 0;
+
+  g_return_val_if_fail (G_IS_INPUT_STREAM (stream), NULL);
+  g_return_val_if_fail (type != NULL, NULL);
+
+  header = read_exactly (stream, sizeof (size), &eof, error);
+  if (header == NULL)
+    return NULL;
+
+  memcpy (&size, g_bytes_get_data (header, NULL), sizeof (size));
+  size = GUINT32_FROM_BE (size);
+  if (size > MAX_FRAME_SIZE)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Frame of %u bytes exceeds the maximum size", size);
+      return NULL;
+    }
+
+  body = read_exactly (stream, size, &eof, error);
+  if (body == NULL)
+    {
+      if (eof)
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                     "Stream ended in the middle of a frame");
+      return NULL;
+    }
+
+  return g_variant_ref_sink (g_variant_new_from_bytes (type, body, FALSE));
+}
+
+static GBytes *
+read_exactly (GInputStream *stream,
+              gsize         count,
+              gboolean     *eof,
+              GError      **error)
+{
+  g_autoptr (GByteArray) buffer = NULL;
+
+  buffer = g_byte_array_sized_new (count);
+  while (buffer->len < count)
+    {
+      g_autoptr (GBytes) bytes = NULL;
+      gsize         size       = 0;
+      gconstpointer data       = NULL;
+
+      bytes = dex_await_boxed (
+          dex_input_stream_read_bytes (
+              stream, count - buffer->len, G_PRIORITY_DEFAULT),
+          error);
+      if (bytes == NULL)
+        return NULL;
+
+      data = g_bytes_get_data (bytes, &size);
+      if (size == 0)
+        {
+          *eof = TRUE;
+          return NULL;
+        }
+      g_byte_array_append (buffer, data, size);
+    }
+
+  return g_byte_array_free_to_bytes (g_steal_pointer (&buffer));
+}
+
+/* End of bz-download-worker-protocol.c */
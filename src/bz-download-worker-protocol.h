@@ -0,0 +1,66 @@
+/* bz-download-worker-protocol.h
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Every message between Bazaar and the download worker
+ * subprocess is a serialized GVariant preceded by its
+ * size as a big endian 32 bit integer
+ */
+
+/* request id, source uri, destination path, report progress,
+ * size to decode the image into, 0 to decode at the original
+ * size, or -1 to only download it
+ */
+#define BZ_DOWNLOAD_WORKER_REQUEST_FORMAT "(ussbi)"
+/* request id, reply kind, payload */
+#define BZ_DOWNLOAD_WORKER_REPLY_FORMAT "(uyv)"
+
+/* Decoded pixels are passed as sealed memfds over a unix
+ * socket the worker inherits at this descriptor, one for
+ * each decoded reply and always ahead of it
+ */
+#define BZ_DOWNLOAD_WORKER_FD_SOCKET 3
+
+typedef enum
+{
+  /* (tt) bytes received, content length or 0 if unknown */
+  BZ_DOWNLOAD_WORKER_REPLY_PROGRESS = 'p',
+  /* (uuu) width, height, stride of premultiplied RGBA8 pixels */
+  BZ_DOWNLOAD_WORKER_REPLY_DECODED = 'd',
+  /* (bss) success, etag, last modified */
+  BZ_DOWNLOAD_WORKER_REPLY_FINISHED = 'f',
+} BzDownloadWorkerReplyKind;
+
+GBytes *
+bz_download_worker_frame_new (GVariant *variant);
+
+GVariant *
+bz_download_worker_read_frame (GInputStream       *stream,
+                               const GVariantType *type,
+                               GError            **error);
+
+G_END_DECLS
+
+/* End of bz-download-worker-protocol.h */
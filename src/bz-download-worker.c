@@ -18,8 +18,18 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#define _GNU_SOURCE
+
 #include "config.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gunixfdmessage.h>
+#include <gtk/gtk.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bz-download-worker-protocol.h"
 #include "bz-download-worker.h"
 #include "bz-env.h"
 #include "bz-util.h"
@@ -34,6 +44,21 @@ BZ_DEFINE_DATA (
     BZ_RELEASE_DATA (g, dex_unref);
     g_mutex_clear (&self->m);)
 
+BZ_DEFINE_DATA (
+    pending,
+    Pending,
+    {
+      DexPromise            *promise;
+      int                    max_size;
+      GdkTexture            *texture;
+      BzDownloadProgressFunc progress_func;
+      gpointer               progress_data;
+      GDestroyNotify         progress_destroy;
+    },
+    BZ_RELEASE_DATA (promise, dex_unref);
+    BZ_RELEASE_DATA (texture, g_object_unref);
+    BZ_RELEASE_DATA (progress_data, self->progress_destroy));
+
 struct _BzDownloadWorker
 {
   GObject parent_instance;
@@ -41,9 +66,11 @@ struct _BzDownloadWorker
   char *name;
 
   GSubprocess  *subprocess;
+  GSocket      *fd_socket;
   GHashTable   *waiting;
   MutexBoxData *mutex;
   DexFuture    *task;
+  guint32       next_id;
 };
 
 static void
@@ -70,27 +97,35 @@ BZ_DEFINE_DATA (
     MonitorWorker,
     {
       GSubprocess  *subprocess;
+      GSocket      *fd_socket;
       GHashTable   *waiting;
       MutexBoxData *mutex;
     },
     BZ_RELEASE_DATA (subprocess, g_object_unref);
+    BZ_RELEASE_DATA (fd_socket, g_object_unref);
     BZ_RELEASE_DATA (waiting, g_hash_table_unref);
     BZ_RELEASE_DATA (mutex, mutex_box_data_unref));
 static DexFuture *
 monitor_worker_fiber (MonitorWorkerData *data);
 
+static GdkTexture *
+receive_texture (GSocket  *fd_socket,
+                 GVariant *payload,
+                 GError  **error);
+
 BZ_DEFINE_DATA (
     invoke_worker,
     InvokeWorker,
     {
-      DexPromise   *promise;
+      guint32       id;
+      PendingData  *pending;
       GFile        *src;
       GFile        *dest;
       GSubprocess  *subprocess;
       GHashTable   *waiting;
       MutexBoxData *mutex;
     },
-    BZ_RELEASE_DATA (promise, dex_unref);
+    BZ_RELEASE_DATA (pending, pending_data_unref);
     BZ_RELEASE_DATA (src, g_object_unref);
     BZ_RELEASE_DATA (dest, g_object_unref);
     BZ_RELEASE_DATA (subprocess, g_object_unref);
@@ -99,16 +134,17 @@ BZ_DEFINE_DATA (
 static DexFuture *
 invoke_worker_fiber (InvokeWorkerData *data);
 
-static void
-plumb_data_input_stream_read_line_async (GDataInputStream   *stream,
-                                         GCancellable       *cancellable,
-                                         GAsyncReadyCallback callback,
-                                         gpointer            user_data);
+static guint
+count_pending (BzDownloadWorker *self);
 
-static char *
-plumb_data_input_stream_read_line_finish (GDataInputStream *stream,
-                                          GAsyncResult     *result,
-                                          gpointer          user_data);
+static DexFuture *
+invoke (BzDownloadWorker      *self,
+        GFile                 *src,
+        GFile                 *dest,
+        int                    max_size,
+        BzDownloadProgressFunc progress_func,
+        gpointer               user_data,
+        GDestroyNotify         destroy_data);
 
 static void
 bz_download_worker_dispose (GObject *object)
@@ -118,21 +154,20 @@ bz_download_worker_dispose (GObject *object)
 
   dex_clear (&self->task);
   g_clear_object (&self->subprocess);
+  g_clear_object (&self->fd_socket);
 
   g_hash_table_iter_init (&waiting_iter, self->waiting);
   for (;;)
     {
-      char       *dest_path = NULL;
-      DexPromise *promise   = NULL;
+      PendingData *pending = NULL;
 
       if (!g_hash_table_iter_next (
-              &waiting_iter,
-              (gpointer *) &dest_path,
-              (gpointer *) &promise))
+              &waiting_iter, NULL,
+              (gpointer *) &pending))
         break;
 
       dex_promise_reject (
-          promise,
+          pending->promise,
           g_error_new (G_IO_ERROR,
                        G_IO_ERROR_CANCELLED,
                        "The subprocess was terminated"));
@@ -207,7 +242,8 @@ bz_download_worker_init (BzDownloadWorker *self)
   g_mutex_init (&self->mutex->m);
 
   self->waiting = g_hash_table_new_full (
-      g_str_hash, g_str_equal, g_free, dex_unref);
+      g_direct_hash, g_direct_equal,
+      NULL, pending_data_unref);
 }
 
 static gboolean
@@ -215,19 +251,49 @@ bz_download_worker_initable_init (GInitable    *initable,
                                   GCancellable *cancellable,
                                   GError      **error)
 {
-  BzDownloadWorker *self             = BZ_DOWNLOAD_WORKER (initable);
-  g_autoptr (MonitorWorkerData) data = NULL;
+  BzDownloadWorker *self                   = BZ_DOWNLOAD_WORKER (initable);
+  g_autoptr (GSubprocessLauncher) launcher = NULL;
+  int fds[2]                               = { -1, -1 };
+  g_autoptr (MonitorWorkerData) data       = NULL;
+
+  /* Decoded images come back as file descriptors,
+   * which can't travel over the stdout pipe
+   */
+  if (socketpair (AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) != 0)
+    {
+      int errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Could not create a socket pair: %s", g_strerror (errsv));
+      return FALSE;
+    }
+
+  self->fd_socket = g_socket_new_from_fd (fds[0], error);
+  if (self->fd_socket == NULL)
+    {
+      close (fds[0]);
+      close (fds[1]);
+      return FALSE;
+    }
+  /* The worker always sends a descriptor before the
+   * frame announcing it, so we should never wait here
+   */
+  g_socket_set_blocking (self->fd_socket, FALSE);
 
-  self->subprocess = g_subprocess_new (
+  launcher = g_subprocess_launcher_new (
       G_SUBPROCESS_FLAGS_STDIN_PIPE |
-          G_SUBPROCESS_FLAGS_STDOUT_PIPE,
-      error,
+          G_SUBPROCESS_FLAGS_STDOUT_PIPE);
+  g_subprocess_launcher_take_fd (launcher, fds[1], BZ_DOWNLOAD_WORKER_FD_SOCKET);
+
+  self->subprocess = g_subprocess_launcher_spawn (
+      launcher, error,
       DL_WORKER_BIN_NAME, NULL);
   if (self->subprocess == NULL)
     return FALSE;
 
   data             = monitor_worker_data_new ();
   data->subprocess = g_object_ref (self->subprocess);
+  data->fd_socket  = g_object_ref (self->fd_socket);
   data->waiting    = g_hash_table_ref (self->waiting);
   data->mutex      = mutex_box_data_ref (self->mutex);
 
@@ -283,17 +349,72 @@ bz_download_worker_invoke (BzDownloadWorker *self,
                            GFile            *src,
                            GFile            *dest)
 {
-  g_autoptr (DexPromise) promise    = NULL;
-  g_autoptr (InvokeWorkerData) data = NULL;
+  return bz_download_worker_invoke_with_progress (
+      self, src, dest, NULL, NULL, NULL);
+}
+
+DexFuture *
+bz_download_worker_invoke_with_progress (BzDownloadWorker      *self,
+                                         GFile                 *src,
+                                         GFile                 *dest,
+                                         BzDownloadProgressFunc progress_func,
+                                         gpointer               user_data,
+                                         GDestroyNotify         destroy_data)
+{
+  dex_return_error_if_fail (BZ_IS_DOWNLOAD_WORKER (self));
+  dex_return_error_if_fail (G_IS_FILE (src));
+  dex_return_error_if_fail (G_IS_FILE (dest));
 
+  return invoke (
+      self, src, dest, -1,
+      progress_func, user_data, destroy_data);
+}
+
+DexFuture *
+bz_download_worker_invoke_decode (BzDownloadWorker *self,
+                                  GFile            *src,
+                                  GFile            *dest,
+                                  int               max_size)
+{
   dex_return_error_if_fail (BZ_IS_DOWNLOAD_WORKER (self));
   dex_return_error_if_fail (G_IS_FILE (src));
   dex_return_error_if_fail (G_IS_FILE (dest));
+  dex_return_error_if_fail (max_size >= 0);
 
-  promise = dex_promise_new ();
+  return invoke (
+      self, src, dest, max_size,
+      NULL, NULL, NULL);
+}
 
-  data             = invoke_worker_data_new ();
-  data->promise    = dex_ref (promise);
+static DexFuture *
+invoke (BzDownloadWorker      *self,
+        GFile                 *src,
+        GFile                 *dest,
+        int                    max_size,
+        BzDownloadProgressFunc progress_func,
+        gpointer               user_data,
+        GDestroyNotify         destroy_data)
+{
+  g_autoptr (GMutexLocker) locker   = NULL;
+  g_autoptr (PendingData) pending   = NULL;
+  g_autoptr (InvokeWorkerData) data = NULL;
+
+  pending                   = pending_data_new ();
+  pending->promise          = dex_promise_new ();
+  pending->max_size         = max_size;
+  pending->progress_func    = progress_func;
+  pending->progress_data    = user_data;
+  pending->progress_destroy = destroy_data;
+
+  locker = g_mutex_locker_new (&self->mutex->m);
+  data   = invoke_worker_data_new ();
+  /* Zero is never used so it can't be mistaken for a missing id */
+  if (++self->next_id == 0)
+    ++self->next_id;
+  data->id = self->next_id;
+  g_clear_pointer (&locker, g_mutex_locker_free);
+
+  data->pending    = pending_data_ref (pending);
   data->src        = g_object_ref (src);
   data->dest       = g_object_ref (dest);
   data->subprocess = g_object_ref (self->subprocess);
@@ -306,7 +427,7 @@ bz_download_worker_invoke (BzDownloadWorker *self,
       (DexFiberFunc) invoke_worker_fiber,
       invoke_worker_data_ref (data),
       invoke_worker_data_unref));
-  return DEX_FUTURE (g_steal_pointer (&promise));
+  return dex_ref (pending->promise);
 }
 
 BzDownloadWorker *
@@ -317,6 +438,7 @@ bz_download_worker_get_default (void)
   static guint      next          = 0;
   g_autoptr (GMutexLocker) locker = NULL;
   BzDownloadWorker *ret           = NULL;
+  guint             ret_pending   = 0;
 
   locker = g_mutex_locker_new (&mutex);
 
@@ -324,10 +446,7 @@ bz_download_worker_get_default (void)
     {
       workers = g_ptr_array_new_with_free_func (g_object_unref);
 
-      /* TODO: make number of workers controllable with envvar */
-#define N_WORKERS 5
-
-      for (guint i = 0; i < N_WORKERS; i++)
+      for (guint i = 0; i < bz_get_download_worker_count (); i++)
         {
           g_autoptr (GError) local_error      = NULL;
           g_autoptr (BzDownloadWorker) worker = NULL;
@@ -365,7 +484,22 @@ bz_download_worker_get_default (void)
         }
     }
 
-  ret  = g_ptr_array_index (workers, next);
+  /* Pick the least busy worker, starting the search at a
+   * different one each time so ties are spread around
+   */
+  for (guint i = 0; i < workers->len; i++)
+    {
+      BzDownloadWorker *worker = NULL;
+      guint             n      = 0;
+
+      worker = g_ptr_array_index (workers, (next + i) % workers->len);
+      n      = count_pending (worker);
+      if (ret == NULL || n < ret_pending)
+        {
+          ret         = worker;
+          ret_pending = n;
+        }
+    }
   next = (next + 1) % workers->len;
 
   return ret;
@@ -374,32 +508,31 @@ bz_download_worker_get_default (void)
 static DexFuture *
 monitor_worker_fiber (MonitorWorkerData *data)
 {
-  GSubprocess  *subprocess                       = data->subprocess;
-  GHashTable   *waiting                          = data->waiting;
-  MutexBoxData *mutex                            = data->mutex;
-  g_autoptr (GDataInputStream) subprocess_stdout = NULL;
+  GSubprocess  *subprocess                   = data->subprocess;
+  GSocket      *fd_socket                    = data->fd_socket;
+  GHashTable   *waiting                      = data->waiting;
+  MutexBoxData *mutex                        = data->mutex;
+  g_autoptr (GInputStream) subprocess_stdout = NULL;
 
-  subprocess_stdout = g_data_input_stream_new (
+  subprocess_stdout = g_buffered_input_stream_new (
       g_subprocess_get_stdout_pipe (subprocess));
 
   for (;;)
     {
-      g_autoptr (GError) local_error = NULL;
-      g_autoptr (BzGuard) guard      = NULL;
-      g_autofree char *line          = NULL;
-      g_autoptr (GVariant) variant   = NULL;
-      g_autofree char *dest_path     = NULL;
-      gboolean         success       = FALSE;
-      DexPromise      *promise       = NULL;
-
-      line = dex_await_string (
-          dex_async_pair_new (
-              subprocess_stdout,
-              &DEX_ASYNC_PAIR_INFO_STRING (
-                  plumb_data_input_stream_read_line_async,
-                  plumb_data_input_stream_read_line_finish)),
+      g_autoptr (GError) local_error  = NULL;
+      g_autoptr (BzGuard) guard       = NULL;
+      g_autoptr (GVariant) variant    = NULL;
+      g_autoptr (GVariant) payload    = NULL;
+      g_autoptr (PendingData) pending = NULL;
+      g_autoptr (GdkTexture) texture  = NULL;
+      guint32 id                      = 0;
+      guchar  kind                    = 0;
+
+      variant = bz_download_worker_read_frame (
+          subprocess_stdout,
+          G_VARIANT_TYPE (BZ_DOWNLOAD_WORKER_REPLY_FORMAT),
           &local_error);
-      if (line == NULL)
+      if (variant == NULL)
         {
           if (local_error != NULL)
             g_critical ("Could not read stdout from download worker subprocess: %s",
@@ -408,46 +541,202 @@ monitor_worker_fiber (MonitorWorkerData *data)
           /* give up on this subprocess and wait to be disposed */
           return NULL;
         }
+      g_variant_get (variant, BZ_DOWNLOAD_WORKER_REPLY_FORMAT, &id, &kind, &payload);
 
-      variant = g_variant_parse (G_VARIANT_TYPE ("(sb)"),
-                                 line, NULL, NULL, &local_error);
-      if (variant == NULL)
+      /* Always take the descriptor off the socket, even if
+       * nobody is waiting anymore, to stay in step with it
+       */
+      if (kind == BZ_DOWNLOAD_WORKER_REPLY_DECODED)
         {
-          g_critical ("Could not interpret stdout from download worker subprocess: %s",
-                      local_error->message);
-          continue;
+          texture = receive_texture (fd_socket, payload, &local_error);
+          if (texture == NULL)
+            g_warning ("Could not receive decoded image for request %u: %s",
+                       id, local_error->message);
         }
-      g_variant_get (variant, "(sb)", &dest_path, &success);
 
       BZ_BEGIN_GUARD_WITH_CONTEXT (&guard, &mutex->m, &mutex->g);
       {
-        promise = g_hash_table_lookup (waiting, dest_path);
-        if (promise != NULL)
-          {
-            if (success)
-              dex_promise_resolve_boolean (promise, TRUE);
-            else
-              dex_promise_reject (
-                  promise,
-                  g_error_new (G_IO_ERROR,
-                               G_IO_ERROR_UNKNOWN,
-                               "The subprocess reported an error downloading '%s'", dest_path));
-            promise = NULL;
-            g_hash_table_remove (waiting, dest_path);
-          }
+        g_autoptr (GMutexLocker) locker = NULL;
+
+        /* The guard lets go of the mutex once it is
+         * entered, but count_pending still reads the
+         * table from other threads
+         */
+        locker  = g_mutex_locker_new (&mutex->m);
+        pending = g_hash_table_lookup (waiting, GUINT_TO_POINTER (id));
+        if (pending != NULL)
+          pending = pending_data_ref (pending);
+        if (kind == BZ_DOWNLOAD_WORKER_REPLY_FINISHED)
+          g_hash_table_remove (waiting, GUINT_TO_POINTER (id));
       }
       bz_clear_guard (&guard);
+
+      if (pending == NULL)
+        continue;
+
+      if (kind == BZ_DOWNLOAD_WORKER_REPLY_PROGRESS &&
+          g_variant_is_of_type (payload, G_VARIANT_TYPE ("(tt)")))
+        {
+          guint64 received = 0;
+          guint64 total    = 0;
+
+          g_variant_get (payload, "(tt)", &received, &total);
+          if (pending->progress_func != NULL)
+            pending->progress_func (received, total, pending->progress_data);
+        }
+      else if (kind == BZ_DOWNLOAD_WORKER_REPLY_DECODED)
+        g_set_object (&pending->texture, texture);
+      else if (kind == BZ_DOWNLOAD_WORKER_REPLY_FINISHED &&
+               g_variant_is_of_type (payload, G_VARIANT_TYPE ("(bss)")))
+        {
+          gboolean         success       = FALSE;
+          g_autofree char *etag          = NULL;
+          g_autofree char *last_modified = NULL;
+
+          g_variant_get (payload, "(bss)", &success, &etag, &last_modified);
+          if (success && pending->max_size >= 0)
+            {
+              if (pending->texture != NULL)
+                {
+                  g_object_set_data_full (
+                      G_OBJECT (pending->texture), BZ_DOWNLOAD_WORKER_ETAG_KEY,
+                      g_steal_pointer (&etag), g_free);
+                  g_object_set_data_full (
+                      G_OBJECT (pending->texture), BZ_DOWNLOAD_WORKER_LAST_MODIFIED_KEY,
+                      g_steal_pointer (&last_modified), g_free);
+                  dex_promise_resolve_object (
+                      pending->promise,
+                      g_steal_pointer (&pending->texture));
+                }
+              else
+                dex_promise_reject (
+                    pending->promise,
+                    g_error_new (G_IO_ERROR,
+                                 G_IO_ERROR_INVALID_DATA,
+                                 "The subprocess could not decode the image of request %u", id));
+            }
+          else if (success)
+            {
+              g_auto (GValue) value    = G_VALUE_INIT;
+              const char *validators[] = { etag, last_modified, NULL };
+
+              g_value_init (&value, G_TYPE_STRV);
+              g_value_set_boxed (&value, validators);
+              dex_promise_resolve (pending->promise, &value);
+            }
+          else
+            dex_promise_reject (
+                pending->promise,
+                g_error_new (G_IO_ERROR,
+                             G_IO_ERROR_UNKNOWN,
+                             "The subprocess reported an error downloading request %u", id));
+        }
+      else
+        g_critical ("Download worker subprocess sent a malformed reply of kind '%c'", kind);
     }
 
   return NULL;
 }
 
+static GdkTexture *
+receive_texture (GSocket  *fd_socket,
+                 GVariant *payload,
+                 GError  **error)
+{
+  guchar                  byte       = 0;
+  GInputVector            vector     = { &byte, sizeof (byte) };
+  GSocketControlMessage **messages   = NULL;
+  int                     n_messages = 0;
+  gssize                  received   = 0;
+  int                     fd         = -1;
+  int                     seals      = 0;
+  guint32                 width      = 0;
+  guint32                 height     = 0;
+  guint32                 stride     = 0;
+  g_autoptr (GMappedFile) mapped     = NULL;
+  g_autoptr (GBytes) bytes           = NULL;
+
+  received = g_socket_receive_message (
+      fd_socket, NULL, &vector, 1,
+      &messages, &n_messages, NULL,
+      NULL, error);
+  for (int i = 0; i < n_messages; i++)
+    {
+      if (G_IS_UNIX_FD_MESSAGE (messages[i]))
+        {
+          g_autofree int *fds = NULL;
+          int             n   = 0;
+
+          fds = g_unix_fd_message_steal_fds (G_UNIX_FD_MESSAGE (messages[i]), &n);
+          for (int j = 0; j < n; j++)
+            {
+              if (fd < 0)
+                fd = fds[j];
+              else
+                close (fds[j]);
+            }
+        }
+      g_object_unref (messages[i]);
+    }
+  g_free (messages);
+
+  if (received < 0)
+    return NULL;
+  if (fd < 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "No descriptor accompanied the decoded reply");
+      return NULL;
+    }
+  if (!g_variant_is_of_type (payload, G_VARIANT_TYPE ("(uuu)")))
+    {
+      close (fd);
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Malformed decoded reply");
+      return NULL;
+    }
+  g_variant_get (payload, "(uuu)", &width, &height, &stride);
+
+  /* We map the pixels without copying them, so
+   * they had better not change or shrink on us
+   */
+  seals = fcntl (fd, F_GET_SEALS);
+  if (seals < 0 ||
+      (seals & (F_SEAL_SHRINK | F_SEAL_WRITE)) != (F_SEAL_SHRINK | F_SEAL_WRITE))
+    {
+      close (fd);
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_PERMISSION_DENIED,
+                   "The decoded image was not sealed");
+      return NULL;
+    }
+
+  mapped = g_mapped_file_new_from_fd (fd, FALSE, error);
+  close (fd);
+  if (mapped == NULL)
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  if (width == 0 || height == 0 ||
+      stride < (gsize) width * 4 ||
+      g_bytes_get_size (bytes) < (gsize) stride * height)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "The decoded image is smaller than advertised");
+      return NULL;
+    }
+
+  return gdk_memory_texture_new (
+      width, height,
+      GDK_MEMORY_R8G8B8A8_PREMULTIPLIED,
+      bytes, stride);
+}
+
 static DexFuture *
 invoke_worker_fiber (InvokeWorkerData *data)
 {
   g_autoptr (GError) local_error = NULL;
   g_autoptr (BzGuard) guard      = NULL;
-  DexPromise      *promise       = data->promise;
+  PendingData     *pending       = data->pending;
   GFile           *src           = data->src;
   GFile           *dest          = data->dest;
   GSubprocess     *subprocess    = data->subprocess;
@@ -455,43 +744,52 @@ invoke_worker_fiber (InvokeWorkerData *data)
   MutexBoxData    *mutex         = data->mutex;
   g_autofree char *src_uri       = NULL;
   g_autofree char *dest_path     = NULL;
-  DexPromise      *existing      = NULL;
   g_autoptr (GVariant) variant   = NULL;
-  g_autoptr (GString) output     = NULL;
+  g_autoptr (GBytes) frame       = NULL;
   GOutputStream *stdin_stream    = NULL;
-  gint64         bytes_written   = -1;
+  gsize          offset          = 0;
 
   src_uri   = g_file_get_uri (src);
   dest_path = g_file_get_path (dest);
 
+  variant = g_variant_ref_sink (g_variant_new (
+      BZ_DOWNLOAD_WORKER_REQUEST_FORMAT,
+      data->id, src_uri, dest_path,
+      pending->progress_func != NULL,
+      pending->max_size));
+  frame = bz_download_worker_frame_new (variant);
+
   BZ_BEGIN_GUARD_WITH_CONTEXT (&guard, &mutex->m, &mutex->g);
   {
-    existing = g_hash_table_lookup (waiting, dest_path);
-    if (existing != NULL)
+    /* Only hold the mutex for the table itself, never
+     * across the writes below which may have to wait
+     */
+    g_mutex_lock (&mutex->m);
+    g_hash_table_replace (waiting, GUINT_TO_POINTER (data->id), pending_data_ref (pending));
+    g_mutex_unlock (&mutex->m);
+
+    /* Requests are written whole while the guard is held,
+     * so frames from concurrent invocations never mix
+     */
+    stdin_stream = g_subprocess_get_stdin_pipe (subprocess);
+    while (offset < g_bytes_get_size (frame))
       {
-        dex_promise_reject (
-            existing,
-            g_error_new (G_IO_ERROR,
-                         G_IO_ERROR_CANCELLED,
-                         "The operation was replaced"));
-        existing = NULL;
-      }
-    g_hash_table_replace (waiting, g_strdup (dest_path), dex_ref (promise));
-
-    variant = g_variant_new ("(ss)", src_uri, dest_path);
-    output  = g_string_new (NULL);
-    output  = g_variant_print_string (variant, g_steal_pointer (&output), TRUE);
-    g_string_append_c (output, '\n');
-
-    stdin_stream  = g_subprocess_get_stdin_pipe (subprocess);
-    bytes_written = dex_await_int64 (
-        dex_output_stream_write (stdin_stream, output->str, output->len, G_PRIORITY_DEFAULT),
-        &local_error);
-
-    if (bytes_written < 0)
-      {
-        g_hash_table_remove (waiting, dest_path);
-        dex_promise_reject (promise, g_steal_pointer (&local_error));
+        g_autoptr (GBytes) remaining = NULL;
+        gint64 bytes_written         = 0;
+
+        remaining     = g_bytes_new_from_bytes (frame, offset, g_bytes_get_size (frame) - offset);
+        bytes_written = dex_await_int64 (
+            dex_output_stream_write_bytes (stdin_stream, remaining, G_PRIORITY_DEFAULT),
+            &local_error);
+        if (bytes_written < 0)
+          {
+            g_mutex_lock (&mutex->m);
+            g_hash_table_remove (waiting, GUINT_TO_POINTER (data->id));
+            g_mutex_unlock (&mutex->m);
+            dex_promise_reject (pending->promise, g_steal_pointer (&local_error));
+            break;
+          }
+        offset += bytes_written;
       }
   }
   bz_clear_guard (&guard);
@@ -499,30 +797,13 @@ invoke_worker_fiber (InvokeWorkerData *data)
   return NULL;
 }
 
-static void
-plumb_data_input_stream_read_line_async (GDataInputStream   *stream,
-                                         GCancellable       *cancellable,
-                                         GAsyncReadyCallback callback,
-                                         gpointer            user_data)
+static guint
+count_pending (BzDownloadWorker *self)
 {
-  g_data_input_stream_read_line_async (
-      stream,
-      G_PRIORITY_DEFAULT,
-      cancellable,
-      callback,
-      user_data);
-}
+  g_autoptr (GMutexLocker) locker = NULL;
 
-static char *
-plumb_data_input_stream_read_line_finish (GDataInputStream *stream,
-                                          GAsyncResult     *result,
-                                          gpointer          user_data)
-{
-  return g_data_input_stream_read_line_finish (
-      stream,
-      result,
-      NULL,
-      user_data);
+  locker = g_mutex_locker_new (&self->mutex->m);
+  return g_hash_table_size (self->waiting);
 }
 
 /* End of bz-download-worker.c */
@@ -24,6 +24,10 @@
 
 G_BEGIN_DECLS
 
+typedef void (*BzDownloadProgressFunc) (guint64  received,
+                                        guint64  total,
+                                        gpointer user_data);
+
 #define BZ_TYPE_DOWNLOAD_WORKER (bz_download_worker_get_type ())
 G_DECLARE_FINAL_TYPE (BzDownloadWorker, bz_download_worker, BZ, DOWNLOAD_WORKER, GObject)
 
@@ -38,11 +42,41 @@ void
 bz_download_worker_set_name (BzDownloadWorker *self,
                              const char       *name);
 
+/* Resolves to a %G_TYPE_STRV holding the ETag and
+ * Last-Modified headers of the response, each of
+ * which is an empty string if it was not sent
+ */
 DexFuture *
 bz_download_worker_invoke (BzDownloadWorker *self,
                            GFile            *src,
                            GFile            *dest);
 
+/* @progress_func is called on the main thread with the
+ * content length, or 0 if the server did not send one
+ */
+DexFuture *
+bz_download_worker_invoke_with_progress (BzDownloadWorker      *self,
+                                         GFile                 *src,
+                                         GFile                 *dest,
+                                         BzDownloadProgressFunc progress_func,
+                                         gpointer               user_data,
+                                         GDestroyNotify         destroy_data);
+
+#define BZ_DOWNLOAD_WORKER_ETAG_KEY          "bz-download-worker-etag"
+#define BZ_DOWNLOAD_WORKER_LAST_MODIFIED_KEY "bz-download-worker-last-modified"
+
+/* Downloads @src into @dest like bz_download_worker_invoke()
+ * and has the worker decode it too, scaled to fit @max_size
+ * or at its original size if @max_size is 0. Resolves to a
+ * #GdkTexture carrying the validators as object data under
+ * the keys above
+ */
+DexFuture *
+bz_download_worker_invoke_decode (BzDownloadWorker *self,
+                                  GFile            *src,
+                                  GFile            *dest,
+                                  int               max_size);
+
 BzDownloadWorker *
 bz_download_worker_get_default (void);
 
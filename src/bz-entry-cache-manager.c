@@ -144,6 +144,18 @@ BZ_DEFINE_DATA (
 static DexFuture *
 read_task_fiber (ReadTaskData *data);
 
+BZ_DEFINE_DATA (
+    prune_task,
+    PruneTask,
+    {
+      OngoingTaskData *task_data;
+      GHashTable      *keep_checksums;
+    },
+    BZ_RELEASE_DATA (task_data, ongoing_task_data_unref);
+    BZ_RELEASE_DATA (keep_checksums, g_hash_table_unref))
+static DexFuture *
+prune_task_fiber (PruneTaskData *data);
+
 static void
 bz_entry_cache_manager_dispose (GObject *object)
 {
@@ -320,6 +332,27 @@ bz_entry_cache_manager_get (BzEntryCacheManager *self,
   return g_steal_pointer (&future);
 }
 
+DexFuture *
+bz_entry_cache_manager_prune (BzEntryCacheManager *self,
+                              GHashTable          *keep_checksums)
+{
+  g_autoptr (PruneTaskData) data = NULL;
+
+  dex_return_error_if_fail (BZ_IS_ENTRY_CACHE_MANAGER (self));
+  dex_return_error_if_fail (keep_checksums != NULL);
+
+  data                 = prune_task_data_new ();
+  data->task_data      = ongoing_task_data_ref (self->task_data);
+  data->keep_checksums = g_hash_table_ref (keep_checksums);
+
+  return dex_scheduler_spawn (
+      self->scheduler,
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) prune_task_fiber,
+      prune_task_data_ref (data),
+      prune_task_data_unref);
+}
+
 static DexFuture *
 write_task_fiber (WriteTaskData *data)
 {
@@ -675,10 +708,74 @@ done:
     }
 }
 
+static DexFuture *
+prune_task_fiber (PruneTaskData *data)
+{
+  OngoingTaskData *task_data             = data->task_data;
+  GHashTable      *keep_checksums        = data->keep_checksums;
+  g_autoptr (GError) local_error         = NULL;
+  g_autoptr (BzGuard) guard              = NULL;
+  g_autofree char *main_cache            = NULL;
+  g_autoptr (GFile) main_cache_file      = NULL;
+  g_autoptr (GFileEnumerator) enumerator = NULL;
+  guint pruned                           = 0;
+
+  dex_await (dex_ref (task_data->init), NULL);
+
+  main_cache      = bz_dup_module_dir ();
+  main_cache_file = g_file_new_for_path (main_cache);
+
+  BZ_BEGIN_GUARD_WITH_CONTEXT (&guard, &task_data->writing_mutex, &task_data->writing_gate);
+
+  enumerator = g_file_enumerate_children (
+      main_cache_file,
+      G_FILE_ATTRIBUTE_STANDARD_NAME,
+      G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+      NULL,
+      &local_error);
+  if (enumerator == NULL)
+    {
+      if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        return dex_future_new_for_int (0);
+      return dex_future_new_reject (
+          BZ_ENTRY_CACHE_ERROR,
+          BZ_ENTRY_CACHE_ERROR_CACHE_FAILED,
+          "Failed to enumerate entry cache for pruning: %s",
+          local_error->message);
+    }
+
+  for (;;)
+    {
+      g_autoptr (GFileInfo) info = NULL;
+      const char *name           = NULL;
+      g_autoptr (GFile) child    = NULL;
+
+      info = g_file_enumerator_next_file (enumerator, NULL, NULL);
+      if (info == NULL)
+        break;
+
+      name = g_file_info_get_name (info);
+      if (g_hash_table_contains (keep_checksums, name) ||
+          g_hash_table_contains (task_data->writing_hash, name))
+        continue;
+
+      child = g_file_enumerator_get_child (enumerator, info);
+      if (g_file_delete (child, NULL, NULL))
+        pruned++;
+    }
+
+  g_debug ("Pruned %d stale entries from the entry cache", pruned);
+  return dex_future_new_for_int (pruned);
+}
+
 static DexFuture *
 watch_fiber (OngoingTaskData *task_data)
 {
-  bz_discard_module_dir ();
+  /* Entries stay on disk between sessions so the
+   * catalog snapshot can resolve them on startup;
+   * stale ones are removed with
+   * bz_entry_cache_manager_prune() after a refresh
+   */
   dex_promise_resolve_boolean (task_data->init, TRUE);
 
   for (;;)
@@ -56,6 +56,10 @@ DexFuture *
 bz_entry_cache_manager_get (BzEntryCacheManager *self,
                             const char          *unique_id);
 
+DexFuture *
+bz_entry_cache_manager_prune (BzEntryCacheManager *self,
+                              GHashTable          *keep_checksums);
+
 G_END_DECLS
 
 /* End of bz-entry-cache-manager.h */
@@ -24,6 +24,8 @@
 #include "bz-entry-group.h"
 #include "bz-async-texture.h"
 #include "bz-env.h"
+#include "bz-mini-icon-store.h"
+#include "bz-serializable.h"
 
 struct _BzEntryGroup
 {
@@ -57,7 +59,14 @@ struct _BzEntryGroup
   GWeakRef ui_entry;
 };
 
-G_DEFINE_FINAL_TYPE (BzEntryGroup, bz_entry_group, G_TYPE_OBJECT)
+static void
+serializable_iface_init (BzSerializableInterface *iface);
+
+G_DEFINE_FINAL_TYPE_WITH_CODE (
+    BzEntryGroup,
+    bz_entry_group,
+    G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (BZ_TYPE_SERIALIZABLE, serializable_iface_init))
 
 enum
 {
@@ -105,6 +114,9 @@ sync_props (BzEntryGroup *self,
 static DexFuture *
 dup_all_into_model_fiber (BzEntryGroup *self);
 
+static GdkPaintable *
+make_async_texture (GVariant *parse);
+
 static void
 bz_entry_group_dispose (GObject *object)
 {
@@ -380,6 +392,208 @@ bz_entry_group_class_init (BzEntryGroupClass *klass)
   g_object_class_install_properties (object_class, LAST_PROP, props);
 }
 
+static void
+bz_entry_group_real_serialize (BzSerializable  *serializable,
+                               GVariantBuilder *builder)
+{
+  BzEntryGroup *self                      = BZ_ENTRY_GROUP (serializable);
+  guint         n_items                   = 0;
+  g_autoptr (GVariantBuilder) sub_builder = NULL;
+
+  n_items     = g_list_model_get_n_items (G_LIST_MODEL (self->store));
+  sub_builder = g_variant_builder_new (G_VARIANT_TYPE ("as"));
+  for (guint i = 0; i < n_items; i++)
+    {
+      g_autoptr (GtkStringObject) string = NULL;
+
+      string = g_list_model_get_item (G_LIST_MODEL (self->store), i);
+      g_variant_builder_add (sub_builder, "s", gtk_string_object_get_string (string));
+    }
+  g_variant_builder_add (builder, "{sv}", "unique-ids", g_variant_builder_end (sub_builder));
+
+  if (self->id != NULL)
+    g_variant_builder_add (builder, "{sv}", "id", g_variant_new_string (self->id));
+  if (self->title != NULL)
+    g_variant_builder_add (builder, "{sv}", "title", g_variant_new_string (self->title));
+  if (self->developer != NULL)
+    g_variant_builder_add (builder, "{sv}", "developer", g_variant_new_string (self->developer));
+  if (self->description != NULL)
+    g_variant_builder_add (builder, "{sv}", "description", g_variant_new_string (self->description));
+  if (BZ_IS_ASYNC_TEXTURE (self->icon_paintable))
+    g_variant_builder_add (
+        builder, "{sv}", "icon-paintable",
+        g_variant_new ("(sms)",
+                       bz_async_texture_get_source_uri (BZ_ASYNC_TEXTURE (self->icon_paintable)),
+                       bz_async_texture_get_cache_into_path (BZ_ASYNC_TEXTURE (self->icon_paintable))));
+  if (self->mini_icon != NULL)
+    {
+      g_autoptr (GVariant) serialized = NULL;
+
+      serialized = bz_mini_icon_store_serialize (self->mini_icon);
+      if (serialized != NULL)
+        g_variant_builder_add (builder, "{sv}", "mini-icon", serialized);
+    }
+  g_variant_builder_add (builder, "{sv}", "is-floss", g_variant_new_boolean (self->is_floss));
+  if (self->light_accent_color != NULL)
+    g_variant_builder_add (builder, "{sv}", "light-accent-color", g_variant_new_string (self->light_accent_color));
+  if (self->dark_accent_color != NULL)
+    g_variant_builder_add (builder, "{sv}", "dark-accent-color", g_variant_new_string (self->dark_accent_color));
+  g_variant_builder_add (builder, "{sv}", "is-flathub", g_variant_new_boolean (self->is_flathub));
+  if (self->search_tokens != NULL && self->search_tokens->len > 0)
+    {
+      g_autoptr (GVariantBuilder) tokens_builder = NULL;
+
+      tokens_builder = g_variant_builder_new (G_VARIANT_TYPE ("as"));
+      for (guint i = 0; i < self->search_tokens->len; i++)
+        g_variant_builder_add (tokens_builder, "s", g_ptr_array_index (self->search_tokens, i));
+      g_variant_builder_add (builder, "{sv}", "search-tokens", g_variant_builder_end (tokens_builder));
+    }
+  if (self->remote_repos_string != NULL)
+    g_variant_builder_add (builder, "{sv}", "remote-repos-string", g_variant_new_string (self->remote_repos_string));
+  g_variant_builder_add (builder, "{sv}", "max-usefulness", g_variant_new_int32 (self->max_usefulness));
+  g_variant_builder_add (
+      builder, "{sv}", "counts",
+      g_variant_new ("(iiiiii)",
+                     self->installable,
+                     self->updatable,
+                     self->removable,
+                     self->installable_available,
+                     self->updatable_available,
+                     self->removable_available));
+}
+
+static gboolean
+bz_entry_group_real_deserialize (BzSerializable *serializable,
+                                 GVariant       *import,
+                                 GError        **error)
+{
+  BzEntryGroup *self            = BZ_ENTRY_GROUP (serializable);
+  g_autoptr (GVariantIter) iter = NULL;
+
+  iter = g_variant_iter_new (import);
+  for (;;)
+    {
+      g_autofree char *key       = NULL;
+      g_autoptr (GVariant) value = NULL;
+
+      if (!g_variant_iter_next (iter, "{sv}", &key, &value))
+        break;
+
+      if (g_strcmp0 (key, "unique-ids") == 0)
+        {
+          g_autoptr (GVariantIter) id_iter = NULL;
+
+          g_list_store_remove_all (self->store);
+          id_iter = g_variant_iter_new (value);
+          for (;;)
+            {
+              g_autofree char *unique_id         = NULL;
+              g_autoptr (GtkStringObject) string = NULL;
+
+              if (!g_variant_iter_next (id_iter, "s", &unique_id))
+                break;
+              string = gtk_string_object_new (unique_id);
+              g_list_store_append (self->store, string);
+            }
+        }
+      else if (g_strcmp0 (key, "id") == 0)
+        {
+          g_clear_pointer (&self->id, g_free);
+          self->id = g_variant_dup_string (value, NULL);
+        }
+      else if (g_strcmp0 (key, "title") == 0)
+        {
+          g_clear_pointer (&self->title, g_free);
+          self->title = g_variant_dup_string (value, NULL);
+        }
+      else if (g_strcmp0 (key, "developer") == 0)
+        {
+          g_clear_pointer (&self->developer, g_free);
+          self->developer = g_variant_dup_string (value, NULL);
+        }
+      else if (g_strcmp0 (key, "description") == 0)
+        {
+          g_clear_pointer (&self->description, g_free);
+          self->description = g_variant_dup_string (value, NULL);
+        }
+      else if (g_strcmp0 (key, "icon-paintable") == 0)
+        {
+          g_clear_object (&self->icon_paintable);
+          self->icon_paintable = make_async_texture (value);
+        }
+      else if (g_strcmp0 (key, "mini-icon") == 0)
+        {
+          g_clear_object (&self->mini_icon);
+          self->mini_icon = bz_mini_icon_store_deserialize (value);
+        }
+      else if (g_strcmp0 (key, "is-floss") == 0)
+        self->is_floss = g_variant_get_boolean (value);
+      else if (g_strcmp0 (key, "light-accent-color") == 0)
+        {
+          g_clear_pointer (&self->light_accent_color, g_free);
+          self->light_accent_color = g_variant_dup_string (value, NULL);
+        }
+      else if (g_strcmp0 (key, "dark-accent-color") == 0)
+        {
+          g_clear_pointer (&self->dark_accent_color, g_free);
+          self->dark_accent_color = g_variant_dup_string (value, NULL);
+        }
+      else if (g_strcmp0 (key, "is-flathub") == 0)
+        self->is_flathub = g_variant_get_boolean (value);
+      else if (g_strcmp0 (key, "search-tokens") == 0)
+        {
+          g_autoptr (GPtrArray) search_tokens = NULL;
+          g_autoptr (GVariantIter) token_iter = NULL;
+
+          search_tokens = g_ptr_array_new_with_free_func (g_free);
+          token_iter    = g_variant_iter_new (value);
+          for (;;)
+            {
+              g_autofree char *token = NULL;
+
+              if (!g_variant_iter_next (token_iter, "s", &token))
+                break;
+              g_ptr_array_add (search_tokens, g_steal_pointer (&token));
+            }
+
+          g_clear_pointer (&self->search_tokens, g_ptr_array_unref);
+          self->search_tokens = g_steal_pointer (&search_tokens);
+        }
+      else if (g_strcmp0 (key, "remote-repos-string") == 0)
+        {
+          g_clear_pointer (&self->remote_repos_string, g_free);
+          self->remote_repos_string = g_variant_dup_string (value, NULL);
+        }
+      else if (g_strcmp0 (key, "max-usefulness") == 0)
+        self->max_usefulness = g_variant_get_int32 (value);
+      else if (g_strcmp0 (key, "counts") == 0)
+        g_variant_get (value, "(iiiiii)",
+                       &self->installable,
+                       &self->updatable,
+                       &self->removable,
+                       &self->installable_available,
+                       &self->updatable_available,
+                       &self->removable_available);
+    }
+
+  if (self->id == NULL ||
+      g_list_model_get_n_items (G_LIST_MODEL (self->store)) == 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Serialized entry group is missing an id or entries");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+serializable_iface_init (BzSerializableInterface *iface)
+{
+  iface->serialize   = bz_entry_group_real_serialize;
+  iface->deserialize = bz_entry_group_real_deserialize;
+}
+
 static void
 bz_entry_group_init (BzEntryGroup *self)
 {
@@ -951,3 +1165,21 @@ dup_all_into_model_fiber (BzEntryGroup *self)
 
   return dex_future_new_for_object (store);
 }
+
+static GdkPaintable *
+make_async_texture (GVariant *parse)
+{
+  g_autofree char *source            = NULL;
+  g_autofree char *cache_into        = NULL;
+  g_autoptr (GFile) source_file      = NULL;
+  g_autoptr (GFile) cache_into_file  = NULL;
+  g_autoptr (BzAsyncTexture) texture = NULL;
+
+  g_variant_get (parse, "(sms)", &source, &cache_into);
+  source_file = g_file_new_for_uri (source);
+  if (cache_into != NULL)
+    cache_into_file = g_file_new_for_path (cache_into);
+
+  texture = bz_async_texture_new_lazy (source_file, cache_into_file);
+  return GDK_PAINTABLE (g_steal_pointer (&texture));
+}
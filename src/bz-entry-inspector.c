@@ -20,6 +20,7 @@
 
 #include <json-glib/json-glib.h>
 
+#include "bz-async-texture.h"
 #include "bz-entry-inspector.h"
 #include "bz-entry.h"
 #include "bz-serializable.h"
@@ -183,7 +184,19 @@ bz_entry_inspector_set_result (BzEntryInspector *self,
 
   g_clear_pointer (&self->result, g_object_unref);
   if (result != NULL)
-    self->result = g_object_ref (result);
+    {
+      BzEntry *entry = NULL;
+
+      self->result = g_object_ref (result);
+
+      /* Largest of the icon previews */
+      entry = bz_result_get_object (result);
+      if (entry != NULL &&
+          BZ_IS_ASYNC_TEXTURE (bz_entry_get_icon_paintable (entry)))
+        bz_async_texture_request_size (
+            BZ_ASYNC_TEXTURE (bz_entry_get_icon_paintable (entry)),
+            128 * gtk_widget_get_scale_factor (GTK_WIDGET (self)));
+    }
 
   g_object_notify_by_pspec (G_OBJECT (self), props[PROP_RESULT]);
 }
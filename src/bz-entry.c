@@ -30,9 +30,10 @@
 #include "bz-data-point.h"
 #include "bz-entry.h"
 #include "bz-env.h"
-#include "bz-global-state.h"
+#include "bz-flathub-stats.h"
 #include "bz-io.h"
 #include "bz-issue.h"
+#include "bz-mini-icon-store.h"
 #include "bz-release.h"
 #include "bz-serializable.h"
 #include "bz-url.h"
@@ -91,6 +92,11 @@ typedef struct
 
   GHashTable *flathub_prop_queries;
   DexFuture  *mini_icon_future;
+
+  /* Guards the fields published by `load_deferred`, which
+   * the entry cache may serialize from another thread */
+  GMutex     heavy_mutex;
+  DexFuture *deferred_future;
 } BzEntryPrivate;
 
 G_DEFINE_ABSTRACT_TYPE_WITH_PRIVATE (BzEntry, bz_entry, G_TYPE_OBJECT);
@@ -163,6 +169,9 @@ static void
 query_flathub (BzEntry *self,
                int      prop);
 
+static void
+load_deferred (BzEntry *self);
+
 static void
 download_stats_per_day_foreach (JsonObject  *object,
                                 const gchar *member_name,
@@ -203,10 +212,6 @@ load_mini_icon_fiber (LoadMiniIconData *data);
 static DexFuture *
 load_mini_icon_notify (LoadMiniIconData *data);
 
-static GIcon *
-load_mini_icon_sync (const char *unique_id_checksum,
-                     const char *path);
-
 static void
 clear_entry (BzEntry *self);
 
@@ -220,6 +225,17 @@ bz_entry_dispose (GObject *object)
   G_OBJECT_CLASS (bz_entry_parent_class)->dispose (object);
 }
 
+static void
+bz_entry_finalize (GObject *object)
+{
+  BzEntry        *self = BZ_ENTRY (object);
+  BzEntryPrivate *priv = bz_entry_get_instance_private (self);
+
+  g_mutex_clear (&priv->heavy_mutex);
+
+  G_OBJECT_CLASS (bz_entry_parent_class)->finalize (object);
+}
+
 static void
 bz_entry_get_property (GObject    *object,
                        guint       prop_id,
@@ -262,6 +278,7 @@ bz_entry_get_property (GObject    *object,
       g_value_set_string (value, priv->description);
       break;
     case PROP_LONG_DESCRIPTION:
+      load_deferred (self);
       g_value_set_string (value, priv->long_description);
       break;
     case PROP_REMOTE_REPO_NAME:
@@ -305,9 +322,11 @@ bz_entry_get_property (GObject    *object,
       g_value_set_string (value, priv->developer_id);
       break;
     case PROP_SCREENSHOT_PAINTABLES:
+      load_deferred (self);
       g_value_set_object (value, priv->screenshot_paintables);
       break;
     case PROP_SHARE_URLS:
+      load_deferred (self);
       g_value_set_object (value, priv->share_urls);
       break;
     case PROP_DONATION_URL:
@@ -326,6 +345,7 @@ bz_entry_get_property (GObject    *object,
       g_value_set_string (value, priv->ratings_summary);
       break;
     case PROP_VERSION_HISTORY:
+      load_deferred (self);
       g_value_set_object (value, priv->version_history);
       break;
     case PROP_LIGHT_ACCENT_COLOR:
@@ -404,8 +424,14 @@ bz_entry_set_property (GObject      *object,
       priv->description = g_value_dup_string (value);
       break;
     case PROP_LONG_DESCRIPTION:
-      g_clear_pointer (&priv->long_description, g_free);
-      priv->long_description = g_value_dup_string (value);
+      {
+        g_autofree char *old = NULL;
+
+        g_mutex_lock (&priv->heavy_mutex);
+        old                    = g_steal_pointer (&priv->long_description);
+        priv->long_description = g_value_dup_string (value);
+        g_mutex_unlock (&priv->heavy_mutex);
+      }
       break;
     case PROP_REMOTE_REPO_NAME:
       g_clear_pointer (&priv->remote_repo_name, g_free);
@@ -460,12 +486,24 @@ bz_entry_set_property (GObject      *object,
       priv->developer_id = g_value_dup_string (value);
       break;
     case PROP_SCREENSHOT_PAINTABLES:
-      g_clear_object (&priv->screenshot_paintables);
-      priv->screenshot_paintables = g_value_dup_object (value);
+      {
+        g_autoptr (GListModel) old = NULL;
+
+        g_mutex_lock (&priv->heavy_mutex);
+        old                         = g_steal_pointer (&priv->screenshot_paintables);
+        priv->screenshot_paintables = g_value_dup_object (value);
+        g_mutex_unlock (&priv->heavy_mutex);
+      }
       break;
     case PROP_SHARE_URLS:
-      g_clear_object (&priv->share_urls);
-      priv->share_urls = g_value_dup_object (value);
+      {
+        g_autoptr (GListModel) old = NULL;
+
+        g_mutex_lock (&priv->heavy_mutex);
+        old              = g_steal_pointer (&priv->share_urls);
+        priv->share_urls = g_value_dup_object (value);
+        g_mutex_unlock (&priv->heavy_mutex);
+      }
       break;
     case PROP_DONATION_URL:
       g_clear_pointer (&priv->donation_url, g_free);
@@ -487,8 +525,14 @@ bz_entry_set_property (GObject      *object,
       priv->ratings_summary = g_value_dup_string (value);
       break;
     case PROP_VERSION_HISTORY:
-      g_clear_object (&priv->version_history);
-      priv->version_history = g_value_dup_object (value);
+      {
+        g_autoptr (GListModel) old = NULL;
+
+        g_mutex_lock (&priv->heavy_mutex);
+        old                   = g_steal_pointer (&priv->version_history);
+        priv->version_history = g_value_dup_object (value);
+        g_mutex_unlock (&priv->heavy_mutex);
+      }
       break;
     case PROP_LIGHT_ACCENT_COLOR:
       g_clear_pointer (&priv->light_accent_color, g_free);
@@ -558,6 +602,7 @@ bz_entry_class_init (BzEntryClass *klass)
   object_class->set_property = bz_entry_set_property;
   object_class->get_property = bz_entry_get_property;
   object_class->dispose      = bz_entry_dispose;
+  object_class->finalize     = bz_entry_finalize;
 
   props[PROP_HOLDING] =
       g_param_spec_boolean (
@@ -817,14 +862,28 @@ bz_entry_init (BzEntry *self)
   BzEntryPrivate *priv = bz_entry_get_instance_private (self);
 
   priv->hold = 0;
+  g_mutex_init (&priv->heavy_mutex);
 }
 
 static void
 bz_entry_real_serialize (BzSerializable  *serializable,
                          GVariantBuilder *builder)
 {
-  BzEntry        *self = BZ_ENTRY (serializable);
-  BzEntryPrivate *priv = bz_entry_get_instance_private (self);
+  BzEntry        *self                         = BZ_ENTRY (serializable);
+  BzEntryPrivate *priv                         = bz_entry_get_instance_private (self);
+  g_autofree char *long_description            = NULL;
+  g_autoptr (GListModel) screenshot_paintables = NULL;
+  g_autoptr (GListModel) share_urls            = NULL;
+  g_autoptr (GListModel) version_history       = NULL;
+
+  /* The cache manager serializes live entries off the main
+   * thread while deferred fields may be landing on it */
+  g_mutex_lock (&priv->heavy_mutex);
+  long_description      = g_strdup (priv->long_description);
+  screenshot_paintables = priv->screenshot_paintables != NULL ? g_object_ref (priv->screenshot_paintables) : NULL;
+  share_urls            = priv->share_urls != NULL ? g_object_ref (priv->share_urls) : NULL;
+  version_history       = priv->version_history != NULL ? g_object_ref (priv->version_history) : NULL;
+  g_mutex_unlock (&priv->heavy_mutex);
 
   g_variant_builder_add (builder, "{sv}", "installed", g_variant_new_boolean (priv->installed));
   g_variant_builder_add (builder, "{sv}", "kinds", g_variant_new_uint32 (priv->kinds));
@@ -861,8 +920,8 @@ bz_entry_real_serialize (BzSerializable  *serializable,
     g_variant_builder_add (builder, "{sv}", "eol", g_variant_new_string (priv->eol));
   if (priv->description != NULL)
     g_variant_builder_add (builder, "{sv}", "description", g_variant_new_string (priv->description));
-  if (priv->long_description != NULL)
-    g_variant_builder_add (builder, "{sv}", "long-description", g_variant_new_string (priv->long_description));
+  if (long_description != NULL)
+    g_variant_builder_add (builder, "{sv}", "long-description", g_variant_new_string (long_description));
   if (priv->remote_repo_name != NULL)
     g_variant_builder_add (builder, "{sv}", "remote-repo-name", g_variant_new_string (priv->remote_repo_name));
   if (priv->url != NULL)
@@ -875,8 +934,9 @@ bz_entry_real_serialize (BzSerializable  *serializable,
     {
       g_autoptr (GVariant) serialized = NULL;
 
-      serialized = g_icon_serialize (priv->mini_icon);
-      g_variant_builder_add (builder, "{sv}", "mini-icon", serialized);
+      serialized = bz_mini_icon_store_serialize (priv->mini_icon);
+      if (serialized != NULL)
+        g_variant_builder_add (builder, "{sv}", "mini-icon", serialized);
     }
   if (priv->remote_repo_icon != NULL)
     maybe_save_paintable (priv, "remote-repo-icon", priv->remote_repo_icon, builder);
@@ -905,11 +965,11 @@ bz_entry_real_serialize (BzSerializable  *serializable,
     g_variant_builder_add (builder, "{sv}", "developer", g_variant_new_string (priv->developer));
   if (priv->developer_id != NULL)
     g_variant_builder_add (builder, "{sv}", "developer-id", g_variant_new_string (priv->developer_id));
-  if (priv->screenshot_paintables != NULL)
+  if (screenshot_paintables != NULL)
     {
       guint n_items = 0;
 
-      n_items = g_list_model_get_n_items (priv->screenshot_paintables);
+      n_items = g_list_model_get_n_items (screenshot_paintables);
       if (n_items > 0)
         {
           g_autoptr (GVariantBuilder) sub_builder = NULL;
@@ -920,7 +980,7 @@ bz_entry_real_serialize (BzSerializable  *serializable,
               g_autoptr (GdkPaintable) paintable = NULL;
               g_autofree char *key               = NULL;
 
-              paintable = g_list_model_get_item (priv->screenshot_paintables, i);
+              paintable = g_list_model_get_item (screenshot_paintables, i);
               key       = g_strdup_printf ("screenshot_%d.png", i);
 
               maybe_save_paintable (priv, key, paintable, sub_builder);
@@ -929,11 +989,11 @@ bz_entry_real_serialize (BzSerializable  *serializable,
           g_variant_builder_add (builder, "{sv}", "screenshot-paintables", g_variant_builder_end (sub_builder));
         }
     }
-  if (priv->share_urls != NULL)
+  if (share_urls != NULL)
     {
       guint n_items = 0;
 
-      n_items = g_list_model_get_n_items (priv->share_urls);
+      n_items = g_list_model_get_n_items (share_urls);
       if (n_items > 0)
         {
           g_autoptr (GVariantBuilder) sub_builder = NULL;
@@ -945,7 +1005,7 @@ bz_entry_real_serialize (BzSerializable  *serializable,
               const char *name      = NULL;
               const char *url_str   = NULL;
 
-              url     = g_list_model_get_item (priv->share_urls, i);
+              url     = g_list_model_get_item (share_urls, i);
               name    = bz_url_get_name (url);
               url_str = bz_url_get_url (url);
               g_variant_builder_add (sub_builder, "(ss)", name, url_str);
@@ -957,11 +1017,11 @@ bz_entry_real_serialize (BzSerializable  *serializable,
     g_variant_builder_add (builder, "{sv}", "donation-url", g_variant_new_string (priv->donation_url));
   if (priv->forge_url != NULL)
     g_variant_builder_add (builder, "{sv}", "forge-url", g_variant_new_string (priv->forge_url));
-  if (priv->version_history != NULL)
+  if (version_history != NULL)
     {
       guint n_items = 0;
 
-      n_items = g_list_model_get_n_items (priv->version_history);
+      n_items = g_list_model_get_n_items (version_history);
       if (n_items > 0)
         {
           g_autoptr (GVariantBuilder) sub_builder = NULL;
@@ -978,7 +1038,7 @@ bz_entry_real_serialize (BzSerializable  *serializable,
               const char *version                        = NULL;
               const char *description                    = NULL;
 
-              release     = g_list_model_get_item (priv->version_history, i);
+              release     = g_list_model_get_item (version_history, i);
               issues      = bz_release_get_issues (release);
               timestamp   = bz_release_get_timestamp (release);
               url         = bz_release_get_url (release);
@@ -1134,7 +1194,7 @@ bz_entry_real_deserialize (BzSerializable *serializable,
       else if (g_strcmp0 (key, "icon-paintable") == 0)
         priv->icon_paintable = make_async_texture (value);
       else if (g_strcmp0 (key, "mini-icon") == 0)
-        priv->mini_icon = g_icon_deserialize (value);
+        priv->mini_icon = bz_mini_icon_store_deserialize (value);
       else if (g_strcmp0 (key, "remote-repo-icon") == 0)
         priv->remote_repo_icon = make_async_texture (value);
       else if (g_strcmp0 (key, "search-tokens") == 0)
@@ -1516,6 +1576,7 @@ bz_entry_get_long_description (BzEntry *self)
   g_return_val_if_fail (BZ_IS_ENTRY (self), NULL);
   priv = bz_entry_get_instance_private (self);
 
+  load_deferred (self);
   return priv->long_description;
 }
 
@@ -1560,6 +1621,7 @@ bz_entry_get_screenshot_paintables (BzEntry *self)
   g_return_val_if_fail (BZ_IS_ENTRY (self), NULL);
   priv = bz_entry_get_instance_private (self);
 
+  load_deferred (self);
   return priv->screenshot_paintables;
 }
 
@@ -1593,6 +1655,7 @@ bz_entry_get_share_urls (BzEntry *self)
   g_return_val_if_fail (BZ_IS_ENTRY (self), NULL);
   priv = bz_entry_get_instance_private (self);
 
+  load_deferred (self);
   return priv->share_urls;
 }
 
@@ -1700,7 +1763,7 @@ GIcon *
 bz_load_mini_icon_sync (const char *unique_id_checksum,
                         const char *path)
 {
-  return load_mini_icon_sync (unique_id_checksum, path);
+  return bz_mini_icon_store_ensure (unique_id_checksum, path);
 }
 
 gint
@@ -1798,24 +1861,24 @@ query_flathub_fiber (QueryFlathubData *data)
   int   prop                     = data->prop;
   char *id                       = data->id;
   g_autoptr (GError) local_error = NULL;
-  g_autofree char *request       = NULL;
+  BzFlathubStatsKind kind        = 0;
   g_autoptr (JsonNode) node      = NULL;
 
   switch (prop)
     {
     case PROP_VERIFIED:
-      request = g_strdup_printf ("/verification/%s/status", id);
+      kind = BZ_FLATHUB_STATS_VERIFICATION;
       break;
     case PROP_DOWNLOAD_STATS:
     case PROP_DOWNLOAD_STATS_PER_COUNTRY:
-      request = g_strdup_printf ("/stats/%s?all=false&days=175", id);
+      kind = BZ_FLATHUB_STATS_DOWNLOADS;
       break;
     default:
       g_assert_not_reached ();
       return NULL;
     }
 
-  node = dex_await_boxed (bz_query_flathub_v2_json (request), &local_error);
+  node = dex_await_boxed (bz_flathub_stats_query (id, kind), &local_error);
   if (node == NULL)
     {
       if (!g_error_matches (local_error, DEX_ERROR, DEX_ERROR_FIBER_CANCELLED))
@@ -1959,6 +2022,7 @@ maybe_save_paintable (BzEntryPrivate  *priv,
   g_autoptr (GdkTexture) texture = NULL;
   g_autoptr (GFile) save_file    = NULL;
   gboolean result                = FALSE;
+  guint    n_variants            = 0;
 
   if (!BZ_IS_ASYNC_TEXTURE (paintable))
     {
@@ -1968,8 +2032,14 @@ maybe_save_paintable (BzEntryPrivate  *priv,
 
   source_uri      = bz_async_texture_get_source_uri (BZ_ASYNC_TEXTURE (paintable));
   cache_into_path = bz_async_texture_get_cache_into_path (BZ_ASYNC_TEXTURE (paintable));
+  n_variants      = bz_async_texture_get_n_variants (BZ_ASYNC_TEXTURE (paintable));
   if (cache_into_path == NULL)
     goto done;
+  /* The loaded texture may be a thumbnail, which
+   * must not end up in the full size cache
+   */
+  if (n_variants > 0)
+    goto done;
 
   if (bz_async_texture_get_loaded (BZ_ASYNC_TEXTURE (paintable)))
     texture = bz_async_texture_dup_texture (BZ_ASYNC_TEXTURE (paintable));
@@ -2036,7 +2106,30 @@ maybe_save_paintable (BzEntryPrivate  *priv,
     }
 
 done:
-  g_variant_builder_add (builder, "{sv}", key, g_variant_new ("(sms)", source_uri, cache_into_path));
+  if (n_variants > 0)
+    {
+      g_autoptr (GVariantBuilder) variants_builder = NULL;
+
+      variants_builder = g_variant_builder_new (G_VARIANT_TYPE ("a(isms)"));
+      for (guint i = 0; i < n_variants; i++)
+        {
+          int         variant_size       = 0;
+          const char *variant_uri        = NULL;
+          const char *variant_cache_path = NULL;
+
+          bz_async_texture_get_variant (
+              BZ_ASYNC_TEXTURE (paintable), i,
+              &variant_size, &variant_uri, &variant_cache_path);
+          g_variant_builder_add (
+              variants_builder, "(isms)",
+              variant_size, variant_uri, variant_cache_path);
+        }
+      g_variant_builder_add (
+          builder, "{sv}", key,
+          g_variant_new ("(smsa(isms))", source_uri, cache_into_path, variants_builder));
+    }
+  else
+    g_variant_builder_add (builder, "{sv}", key, g_variant_new ("(sms)", source_uri, cache_into_path));
   return TRUE;
 }
 
@@ -2048,13 +2141,38 @@ make_async_texture (GVariant *parse)
   g_autoptr (GFile) source_file      = NULL;
   g_autoptr (GFile) cache_into_file  = NULL;
   g_autoptr (BzAsyncTexture) texture = NULL;
+  g_autoptr (GVariantIter) variants  = NULL;
 
-  g_variant_get (parse, "(sms)", &source, &cache_into);
+  if (g_variant_is_of_type (parse, G_VARIANT_TYPE ("(smsa(isms))")))
+    g_variant_get (parse, "(smsa(isms))", &source, &cache_into, &variants);
+  else
+    g_variant_get (parse, "(sms)", &source, &cache_into);
   source_file = g_file_new_for_uri (source);
   if (cache_into != NULL)
     cache_into_file = g_file_new_for_path (cache_into);
 
   texture = bz_async_texture_new_lazy (source_file, cache_into_file);
+
+  if (variants != NULL)
+    {
+      int         variant_size       = 0;
+      const char *variant_uri        = NULL;
+      const char *variant_cache_path = NULL;
+
+      while (g_variant_iter_next (variants, "(i&sm&s)",
+                                  &variant_size, &variant_uri, &variant_cache_path))
+        {
+          g_autoptr (GFile) variant_file  = NULL;
+          g_autoptr (GFile) variant_cache = NULL;
+
+          variant_file = g_file_new_for_uri (variant_uri);
+          if (variant_cache_path != NULL)
+            variant_cache = g_file_new_for_path (variant_cache_path);
+          if (variant_size > 0)
+            bz_async_texture_add_variant (texture, variant_file, variant_cache, variant_size);
+        }
+    }
+
   return GDK_PAINTABLE (g_steal_pointer (&texture));
 }
 
@@ -2094,7 +2212,7 @@ load_mini_icon_fiber (LoadMiniIconData *data)
   BzEntry *self = data->self;
   char    *path = data->path;
 
-  data->result = load_mini_icon_sync (
+  data->result = bz_mini_icon_store_ensure (
       bz_entry_get_unique_id_checksum (BZ_ENTRY (self)),
       path);
   return dex_scheduler_spawn (
@@ -2105,60 +2223,6 @@ load_mini_icon_fiber (LoadMiniIconData *data)
       load_mini_icon_data_unref);
 }
 
-static GIcon *
-load_mini_icon_sync (const char *unique_id_checksum,
-                     const char *path)
-{
-  g_autofree char *main_cache            = NULL;
-  g_autoptr (GString) mini_icon_basename = NULL;
-  g_autofree char *mini_icon_path        = NULL;
-  g_autoptr (GBytes) bytes               = NULL;
-  cairo_surface_t *surface_in            = NULL;
-  int              width                 = 0;
-  int              height                = 0;
-  cairo_surface_t *surface_out           = NULL;
-  cairo_t         *cairo                 = NULL;
-  g_autoptr (GFile) parent_file          = NULL;
-  g_autoptr (GFile) mini_icon_file       = NULL;
-  g_autoptr (GIcon) mini_icon            = NULL;
-
-  main_cache         = bz_dup_module_dir ();
-  mini_icon_basename = g_string_new (unique_id_checksum);
-  g_string_append (mini_icon_basename, "-24x24.png");
-  mini_icon_path = g_build_filename (main_cache, mini_icon_basename->str, NULL);
-
-  if (g_file_test (mini_icon_path, G_FILE_TEST_EXISTS))
-    /* Assume the icon left behind by last writer */
-    goto done;
-
-  surface_in = cairo_image_surface_create_from_png (path);
-  width      = cairo_image_surface_get_width (surface_in);
-  height     = cairo_image_surface_get_height (surface_in);
-
-  /* 24x24 for the gnome-shell search provider */
-  surface_out = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 24, 24);
-  cairo       = cairo_create (surface_out);
-
-  cairo_scale (cairo, 24.0 / (double) width, 24.0 / (double) height);
-  cairo_set_source_surface (cairo, surface_in, 0, 0);
-  cairo_paint (cairo);
-  cairo_restore (cairo);
-
-  parent_file = g_file_new_for_path (main_cache);
-  g_file_make_directory_with_parents (parent_file, NULL, NULL);
-
-  cairo_surface_flush (surface_out);
-  cairo_surface_write_to_png (surface_out, mini_icon_path);
-  cairo_destroy (cairo);
-  cairo_surface_destroy (surface_in);
-  cairo_surface_destroy (surface_out);
-
-done:
-  mini_icon_file = g_file_new_for_path (mini_icon_path);
-  mini_icon      = g_file_icon_new (mini_icon_file);
-  return g_steal_pointer (&mini_icon);
-}
-
 static DexFuture *
 load_mini_icon_notify (LoadMiniIconData *data)
 {
@@ -2178,6 +2242,15 @@ clear_entry (BzEntry *self)
   BzEntryPrivate *priv = bz_entry_get_instance_private (self);
 
   dex_clear (&priv->mini_icon_future);
+  dex_clear (&priv->deferred_future);
+
+  g_mutex_lock (&priv->heavy_mutex);
+  g_clear_pointer (&priv->long_description, g_free);
+  g_clear_object (&priv->screenshot_paintables);
+  g_clear_object (&priv->share_urls);
+  g_clear_object (&priv->version_history);
+  g_mutex_unlock (&priv->heavy_mutex);
+
   g_clear_pointer (&priv->flathub_prop_queries, g_hash_table_unref);
   g_clear_object (&priv->addons);
   g_clear_pointer (&priv->id, g_free);
@@ -2186,7 +2259,6 @@ clear_entry (BzEntry *self)
   g_clear_pointer (&priv->title, g_free);
   g_clear_pointer (&priv->eol, g_free);
   g_clear_pointer (&priv->description, g_free);
-  g_clear_pointer (&priv->long_description, g_free);
   g_clear_pointer (&priv->remote_repo_name, g_free);
   g_clear_pointer (&priv->url, g_free);
   g_clear_object (&priv->icon_paintable);
@@ -2198,14 +2270,26 @@ clear_entry (BzEntry *self)
   g_clear_pointer (&priv->project_group, g_free);
   g_clear_pointer (&priv->developer, g_free);
   g_clear_pointer (&priv->developer_id, g_free);
-  g_clear_object (&priv->screenshot_paintables);
-  g_clear_object (&priv->share_urls);
   g_clear_pointer (&priv->donation_url, g_free);
   g_clear_pointer (&priv->forge_url, g_free);
   g_clear_object (&priv->reviews);
   g_clear_pointer (&priv->ratings_summary, g_free);
-  g_clear_object (&priv->version_history);
   g_clear_pointer (&priv->light_accent_color, g_free);
   g_clear_pointer (&priv->dark_accent_color, g_free);
   g_clear_object (&priv->download_stats);
 }
+
+static void
+load_deferred (BzEntry *self)
+{
+  BzEntryPrivate *priv  = bz_entry_get_instance_private (self);
+  BzEntryClass   *klass = BZ_ENTRY_GET_CLASS (self);
+
+  /* Never parse here, this is reached from
+   * property reads on the UI thread */
+  if (klass->load_deferred == NULL ||
+      priv->deferred_future != NULL)
+    return;
+
+  priv->deferred_future = klass->load_deferred (self);
+}
@@ -41,6 +41,14 @@ G_DECLARE_DERIVABLE_TYPE (BzEntry, bz_entry, BZ, ENTRY, GObject)
 struct _BzEntryClass
 {
   GObjectClass parent_class;
+
+  /* Called on the main thread the first time the long
+   * description, screenshots, share urls or version history
+   * are asked for, so subclasses can postpone building them.
+   * Those read as NULL until the returned future has set
+   * them, which notifies as usual
+   */
+  DexFuture *(*load_deferred) (BzEntry *self);
 };
 
 void
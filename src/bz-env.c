@@ -63,3 +63,42 @@ bz_get_dex_stack_size (void)
 
   return stack_size;
 }
+
+guint
+bz_get_download_worker_count (void)
+{
+  static gsize worker_count = 0;
+
+  if (g_once_init_enter (&worker_count))
+    {
+      const char *envvar = NULL;
+      guint32     value  = 5;
+
+      envvar = g_getenv ("BAZAAR_DL_WORKERS");
+      if (envvar != NULL)
+        {
+          g_autoptr (GError) local_error = NULL;
+          g_autoptr (GVariant) variant   = NULL;
+
+          variant = g_variant_parse (
+              G_VARIANT_TYPE_UINT32, envvar,
+              NULL, NULL, &local_error);
+          if (variant != NULL)
+            {
+              guint32 parse_result = 0;
+
+              parse_result = g_variant_get_uint32 (variant);
+              if (parse_result == 0)
+                g_critical ("BAZAAR_DL_WORKERS must be greater than 0");
+              else
+                value = parse_result;
+            }
+          else
+            g_critical ("BAZAAR_DL_WORKERS is invalid: %s", local_error->message);
+        }
+
+      g_once_init_leave (&worker_count, value);
+    }
+
+  return worker_count;
+}
@@ -27,4 +27,7 @@ G_BEGIN_DECLS
 gsize
 bz_get_dex_stack_size (void);
 
+guint
+bz_get_download_worker_count (void);
+
 G_END_DECLS
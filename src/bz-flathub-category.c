@@ -197,6 +197,13 @@ bz_flathub_category_dup_applications (BzFlathubCategory *self)
     return NULL;
 }
 
+GListModel *
+bz_flathub_category_get_app_ids (BzFlathubCategory *self)
+{
+  g_return_val_if_fail (BZ_IS_FLATHUB_CATEGORY (self), NULL);
+  return self->applications;
+}
+
 void
 bz_flathub_category_set_map_factory (BzFlathubCategory       *self,
                                      BzApplicationMapFactory *map_factory)
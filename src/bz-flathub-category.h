@@ -41,6 +41,10 @@ bz_flathub_category_get_name (BzFlathubCategory *self);
 GListModel *
 bz_flathub_category_dup_applications (BzFlathubCategory *self);
 
+/* The app ids the applications are mapped from */
+GListModel *
+bz_flathub_category_get_app_ids (BzFlathubCategory *self);
+
 void
 bz_flathub_category_set_map_factory (BzFlathubCategory       *self,
                                      BzApplicationMapFactory *map_factory);
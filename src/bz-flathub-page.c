@@ -26,9 +26,11 @@
 #include "bz-dynamic-list-view.h"
 #include "bz-entry-group.h"
 #include "bz-flathub-category.h"
+#include "bz-flathub-paged-list.h"
 #include "bz-inhibited-scrollable.h"
 #include "bz-patterned-background.h"
 #include "bz-section-view.h"
+#include "bz-util.h"
 #include "bz-window.h"
 #include <glib/gi18n.h>
 
@@ -71,9 +73,34 @@ category_clicked (BzFlathubCategory *category,
                   GtkButton         *button);
 
 static void
-show_more_clicked (const char *title,
-                   GListModel *model,
-                   GtkButton  *button);
+show_more_clicked (const char         *title,
+                   GListModel         *model,
+                   BzFlathubPagedList *pager,
+                   GtkButton          *button);
+
+static void
+push_apps_page (GtkWidget          *self,
+                const char         *title,
+                GListModel         *model,
+                BzFlathubPagedList *pager);
+
+BZ_DEFINE_DATA (
+    load_more,
+    LoadMore,
+    {
+      GWeakRef pager;
+      GWeakRef page;
+    },
+    g_weak_ref_clear (&self->pager);
+    g_weak_ref_clear (&self->page));
+
+static void
+load_more (BzFlathubPagedList *pager,
+           BzAppsPage         *page);
+
+static DexFuture *
+load_more_then (DexFuture    *future,
+                LoadMoreData *data);
 
 static void
 apps_page_select_cb (BzFlathubPage *self,
@@ -173,7 +200,10 @@ show_more_trending_clicked_cb (BzFlathubPage *self,
   g_autoptr (GListModel) model = NULL;
 
   model = bz_flathub_state_dup_trending (self->state);
-  show_more_clicked (_ ("Trending"), model, button);
+  show_more_clicked (
+      _ ("Trending"), model,
+      bz_flathub_state_get_trending_pager (self->state),
+      button);
 }
 
 static void
@@ -183,7 +213,10 @@ show_more_recently_updated_clicked_cb (BzFlathubPage *self,
   g_autoptr (GListModel) model = NULL;
 
   model = bz_flathub_state_dup_recently_updated (self->state);
-  show_more_clicked (_ ("Recently Updated"), model, button);
+  show_more_clicked (
+      _ ("Recently Updated"), model,
+      bz_flathub_state_get_recently_updated_pager (self->state),
+      button);
 }
 
 static void
@@ -193,7 +226,10 @@ show_more_recently_added_clicked_cb (BzFlathubPage *self,
   g_autoptr (GListModel) model = NULL;
 
   model = bz_flathub_state_dup_recently_added (self->state);
-  show_more_clicked (_ ("Recently Added"), model, button);
+  show_more_clicked (
+      _ ("Recently Added"), model,
+      bz_flathub_state_get_recently_added_pager (self->state),
+      button);
 }
 
 static void
@@ -203,7 +239,10 @@ show_more_popular_clicked_cb (BzFlathubPage *self,
   g_autoptr (GListModel) model = NULL;
 
   model = bz_flathub_state_dup_popular (self->state);
-  show_more_clicked (_ ("Popular"), model, button);
+  show_more_clicked (
+      _ ("Popular"), model,
+      bz_flathub_state_get_popular_pager (self->state),
+      button);
 }
 
 static void
@@ -312,51 +351,47 @@ static void
 category_clicked (BzFlathubCategory *category,
                   GtkButton         *button)
 {
-  GtkWidget         *self      = NULL;
-  GtkWidget         *window    = NULL;
-  GtkWidget         *nav_view  = NULL;
-  AdwNavigationPage *apps_page = NULL;
+  GtkWidget  *self             = NULL;
+  GListModel *app_ids          = NULL;
   g_autoptr (GListModel) model = NULL;
-  const char *title            = NULL;
 
   self = gtk_widget_get_ancestor (GTK_WIDGET (button), BZ_TYPE_FLATHUB_PAGE);
   g_assert (self != NULL);
 
-  window = GTK_WIDGET (gtk_widget_get_root (GTK_WIDGET (self)));
+  app_ids = bz_flathub_category_get_app_ids (category);
+  model   = bz_flathub_category_dup_applications (category);
 
-  nav_view = gtk_widget_get_ancestor (GTK_WIDGET (self), ADW_TYPE_NAVIGATION_VIEW);
-  g_assert (nav_view != NULL);
-
-  title = bz_flathub_category_get_display_name (category);
-  model = bz_flathub_category_dup_applications (category);
-
-  apps_page = bz_apps_page_new (title, model);
+  push_apps_page (
+      self,
+      bz_flathub_category_get_display_name (category),
+      model,
+      BZ_IS_FLATHUB_PAGED_LIST (app_ids) ? BZ_FLATHUB_PAGED_LIST (app_ids) : NULL);
+}
 
-  g_signal_connect_swapped (
-      apps_page, "select",
-      G_CALLBACK (apps_page_select_cb), self);
-  g_signal_connect_swapped (
-      apps_page, "hiding",
-      G_CALLBACK (apps_page_hiding_cb), self);
+static void
+show_more_clicked (const char         *title,
+                   GListModel         *model,
+                   BzFlathubPagedList *pager,
+                   GtkButton          *button)
+{
+  GtkWidget *self = NULL;
 
-  adw_navigation_view_push (ADW_NAVIGATION_VIEW (nav_view), apps_page);
+  self = gtk_widget_get_ancestor (GTK_WIDGET (button), BZ_TYPE_FLATHUB_PAGE);
+  g_assert (self != NULL);
 
-  bz_window_set_app_list_view_mode (BZ_WINDOW (window), TRUE);
+  push_apps_page (self, title, model, pager);
 }
 
 static void
-show_more_clicked (const char *title,
-                   GListModel *model,
-                   GtkButton  *button)
+push_apps_page (GtkWidget          *self,
+                const char         *title,
+                GListModel         *model,
+                BzFlathubPagedList *pager)
 {
-  GtkWidget         *self      = NULL;
   GtkWidget         *window    = NULL;
   GtkWidget         *nav_view  = NULL;
   AdwNavigationPage *apps_page = NULL;
 
-  self = gtk_widget_get_ancestor (GTK_WIDGET (button), BZ_TYPE_FLATHUB_PAGE);
-  g_assert (self != NULL);
-
   window = GTK_WIDGET (gtk_widget_get_root (GTK_WIDGET (self)));
 
   nav_view = gtk_widget_get_ancestor (GTK_WIDGET (self), ADW_TYPE_NAVIGATION_VIEW);
@@ -370,12 +405,63 @@ show_more_clicked (const char *title,
   g_signal_connect_swapped (
       apps_page, "hiding",
       G_CALLBACK (apps_page_hiding_cb), self);
+  if (pager != NULL)
+    g_signal_connect_object (
+        apps_page, "near-end",
+        G_CALLBACK (load_more), pager,
+        G_CONNECT_SWAPPED);
 
   adw_navigation_view_push (ADW_NAVIGATION_VIEW (nav_view), apps_page);
 
   bz_window_set_app_list_view_mode (BZ_WINDOW (window), TRUE);
 }
 
+static void
+load_more (BzFlathubPagedList *pager,
+           BzAppsPage         *page)
+{
+  g_autoptr (LoadMoreData) data = NULL;
+  DexFuture *future             = NULL;
+
+  /* Only the call which starts a load checks again
+   * afterwards, so scrolling while it is in flight
+   * doesn't pile up more checks
+   */
+  if (bz_flathub_paged_list_get_loading (pager))
+    return;
+
+  data = load_more_data_new ();
+  g_weak_ref_init (&data->pager, pager);
+  g_weak_ref_init (&data->page, page);
+
+  future = bz_flathub_paged_list_load_more (pager);
+  future = dex_future_then (
+      future, (DexFutureCallback) load_more_then,
+      load_more_data_ref (data), load_more_data_unref);
+  dex_future_disown (future);
+}
+
+static DexFuture *
+load_more_then (DexFuture    *future,
+                LoadMoreData *data)
+{
+  g_autoptr (BzFlathubPagedList) pager = NULL;
+  g_autoptr (BzAppsPage) page          = NULL;
+
+  pager = g_weak_ref_get (&data->pager);
+  page  = g_weak_ref_get (&data->page);
+  if (pager == NULL || page == NULL)
+    return NULL;
+
+  /* The page may not have grown if none of the new
+   * apps are shown, so see if we need to keep going
+   */
+  if (!bz_flathub_paged_list_get_complete (pager))
+    bz_apps_page_check_near_end (page);
+
+  return NULL;
+}
+
 static void
 apps_page_select_cb (BzFlathubPage *self,
                      BzEntryGroup  *group,
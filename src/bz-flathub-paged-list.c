@@ -0,0 +1,418 @@
+/* bz-flathub-paged-list.c
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "BAZAAR::FLATHUB"
+
+#define MAX_PAGE_FAILURES 4
+#define RETRY_DELAY_USEC  (2 * G_USEC_PER_SEC)
+
+#include "bz-flathub-paged-list.h"
+#include "bz-global-state.h"
+#include "bz-util.h"
+
+struct _BzFlathubPagedList
+{
+  GObject parent_instance;
+
+  char          *request;
+  guint          page_size;
+  GtkStringList *app_ids;
+  /* Pages can shift while we walk them, so the
+   * same app may come back on the next one
+   */
+  GHashTable *seen;
+  guint       next_page;
+  gboolean    complete;
+  DexFuture  *loading;
+  /* Consecutive failures of the next page, so a
+   * flaky one is retried with a growing delay and
+   * eventually given up on instead of on every scroll
+   */
+  guint   failures;
+  gint64  retry_after;
+  GError *error;
+};
+
+static void list_model_iface_init (GListModelInterface *iface);
+G_DEFINE_FINAL_TYPE_WITH_CODE (
+    BzFlathubPagedList,
+    bz_flathub_paged_list,
+    G_TYPE_OBJECT,
+    G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, list_model_iface_init));
+
+enum
+{
+  PROP_0,
+
+  PROP_REQUEST,
+  PROP_PAGE_SIZE,
+  PROP_LOADING,
+  PROP_COMPLETE,
+
+  LAST_PROP
+};
+static GParamSpec *props[LAST_PROP] = { 0 };
+
+BZ_DEFINE_DATA (
+    page,
+    Page,
+    {
+      GWeakRef self;
+      guint    page;
+    },
+    g_weak_ref_clear (&self->self));
+
+static DexFuture *
+page_then (DexFuture *future,
+           PageData  *data);
+
+static DexFuture *
+page_finally (DexFuture *future,
+              PageData  *data);
+
+static void
+items_changed (BzFlathubPagedList *self,
+               guint               position,
+               guint               removed,
+               guint               added,
+               GListModel         *model);
+
+static void
+bz_flathub_paged_list_dispose (GObject *object)
+{
+  BzFlathubPagedList *self = BZ_FLATHUB_PAGED_LIST (object);
+
+  dex_clear (&self->loading);
+
+  if (self->app_ids != NULL)
+    g_signal_handlers_disconnect_by_func (self->app_ids, items_changed, self);
+  g_clear_pointer (&self->app_ids, g_object_unref);
+  g_clear_pointer (&self->seen, g_hash_table_unref);
+  g_clear_pointer (&self->request, g_free);
+  g_clear_error (&self->error);
+
+  G_OBJECT_CLASS (bz_flathub_paged_list_parent_class)->dispose (object);
+}
+
+static void
+bz_flathub_paged_list_get_property (GObject    *object,
+                                    guint       prop_id,
+                                    GValue     *value,
+                                    GParamSpec *pspec)
+{
+  BzFlathubPagedList *self = BZ_FLATHUB_PAGED_LIST (object);
+
+  switch (prop_id)
+    {
+    case PROP_REQUEST:
+      g_value_set_string (value, bz_flathub_paged_list_get_request (self));
+      break;
+    case PROP_PAGE_SIZE:
+      g_value_set_uint (value, bz_flathub_paged_list_get_page_size (self));
+      break;
+    case PROP_LOADING:
+      g_value_set_boolean (value, bz_flathub_paged_list_get_loading (self));
+      break;
+    case PROP_COMPLETE:
+      g_value_set_boolean (value, bz_flathub_paged_list_get_complete (self));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+bz_flathub_paged_list_set_property (GObject      *object,
+                                    guint         prop_id,
+                                    const GValue *value,
+                                    GParamSpec   *pspec)
+{
+  BzFlathubPagedList *self = BZ_FLATHUB_PAGED_LIST (object);
+
+  switch (prop_id)
+    {
+    case PROP_REQUEST:
+      g_clear_pointer (&self->request, g_free);
+      self->request = g_value_dup_string (value);
+      break;
+    case PROP_PAGE_SIZE:
+      self->page_size = g_value_get_uint (value);
+      break;
+    case PROP_LOADING:
+    case PROP_COMPLETE:
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+bz_flathub_paged_list_class_init (BzFlathubPagedListClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->set_property = bz_flathub_paged_list_set_property;
+  object_class->get_property = bz_flathub_paged_list_get_property;
+  object_class->dispose      = bz_flathub_paged_list_dispose;
+
+  props[PROP_REQUEST] =
+      g_param_spec_string (
+          "request",
+          NULL, NULL, NULL,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  props[PROP_PAGE_SIZE] =
+      g_param_spec_uint (
+          "page-size",
+          NULL, NULL,
+          1, G_MAXUINT, 48,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  props[PROP_LOADING] =
+      g_param_spec_boolean (
+          "loading",
+          NULL, NULL, FALSE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY);
+
+  props[PROP_COMPLETE] =
+      g_param_spec_boolean (
+          "complete",
+          NULL, NULL, FALSE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY);
+
+  g_object_class_install_properties (object_class, LAST_PROP, props);
+}
+
+static GType
+list_model_get_item_type (GListModel *list)
+{
+  return GTK_TYPE_STRING_OBJECT;
+}
+
+static guint
+list_model_get_n_items (GListModel *list)
+{
+  BzFlathubPagedList *self = BZ_FLATHUB_PAGED_LIST (list);
+  return g_list_model_get_n_items (G_LIST_MODEL (self->app_ids));
+}
+
+static gpointer
+list_model_get_item (GListModel *list,
+                     guint       position)
+{
+  BzFlathubPagedList *self = BZ_FLATHUB_PAGED_LIST (list);
+  return g_list_model_get_item (G_LIST_MODEL (self->app_ids), position);
+}
+
+static void
+list_model_iface_init (GListModelInterface *iface)
+{
+  iface->get_item_type = list_model_get_item_type;
+  iface->get_n_items   = list_model_get_n_items;
+  iface->get_item      = list_model_get_item;
+}
+
+static void
+bz_flathub_paged_list_init (BzFlathubPagedList *self)
+{
+  self->app_ids   = gtk_string_list_new (NULL);
+  self->seen      = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  self->next_page = 1;
+
+  g_signal_connect_swapped (
+      self->app_ids, "items-changed",
+      G_CALLBACK (items_changed), self);
+}
+
+BzFlathubPagedList *
+bz_flathub_paged_list_new (const char *request,
+                           guint       page_size)
+{
+  g_return_val_if_fail (request != NULL, NULL);
+  g_return_val_if_fail (page_size > 0, NULL);
+
+  return g_object_new (
+      BZ_TYPE_FLATHUB_PAGED_LIST,
+      "request", request,
+      "page-size", page_size,
+      NULL);
+}
+
+const char *
+bz_flathub_paged_list_get_request (BzFlathubPagedList *self)
+{
+  g_return_val_if_fail (BZ_IS_FLATHUB_PAGED_LIST (self), NULL);
+  return self->request;
+}
+
+guint
+bz_flathub_paged_list_get_page_size (BzFlathubPagedList *self)
+{
+  g_return_val_if_fail (BZ_IS_FLATHUB_PAGED_LIST (self), 0);
+  return self->page_size;
+}
+
+gboolean
+bz_flathub_paged_list_get_loading (BzFlathubPagedList *self)
+{
+  g_return_val_if_fail (BZ_IS_FLATHUB_PAGED_LIST (self), FALSE);
+  return self->loading != NULL;
+}
+
+gboolean
+bz_flathub_paged_list_get_complete (BzFlathubPagedList *self)
+{
+  g_return_val_if_fail (BZ_IS_FLATHUB_PAGED_LIST (self), FALSE);
+  return self->complete;
+}
+
+DexFuture *
+bz_flathub_paged_list_load_more (BzFlathubPagedList *self)
+{
+  g_autoptr (PageData) data    = NULL;
+  g_autofree char *request     = NULL;
+  g_autoptr (DexFuture) future = NULL;
+
+  dex_return_error_if_fail (BZ_IS_FLATHUB_PAGED_LIST (self));
+
+  if (self->loading != NULL)
+    return dex_ref (self->loading);
+  if (self->complete)
+    return dex_future_new_true ();
+  if (self->error != NULL &&
+      (self->failures >= MAX_PAGE_FAILURES ||
+       g_get_monotonic_time () < self->retry_after))
+    return dex_future_new_for_error (g_error_copy (self->error));
+
+  data = page_data_new ();
+  g_weak_ref_init (&data->self, self);
+  data->page = self->next_page;
+
+  /* Flathub counts pages from 1 */
+  request = g_strdup_printf (
+      "%s%cpage=%u&per_page=%u",
+      self->request,
+      strchr (self->request, '?') != NULL ? '&' : '?',
+      data->page, self->page_size);
+
+  future = bz_query_flathub_v2_strings (request, "hits", "app_id");
+  future = dex_future_then (
+      future,
+      (DexFutureCallback) page_then,
+      page_data_ref (data), page_data_unref);
+  future = dex_future_finally (
+      future,
+      (DexFutureCallback) page_finally,
+      page_data_ref (data), page_data_unref);
+
+  self->loading = dex_ref (future);
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_LOADING]);
+
+  return g_steal_pointer (&future);
+}
+
+static DexFuture *
+page_then (DexFuture *future,
+           PageData  *data)
+{
+  g_autoptr (BzFlathubPagedList) self = NULL;
+  GPtrArray *app_ids                  = NULL;
+  g_autoptr (GPtrArray) fresh         = NULL;
+
+  self = g_weak_ref_get (&data->self);
+  if (self == NULL)
+    return NULL;
+
+  app_ids = g_value_get_boxed (dex_future_get_value (future, NULL));
+
+  fresh = g_ptr_array_new_full (app_ids->len + 1, NULL);
+  for (guint i = 0; i < app_ids->len; i++)
+    {
+      const char *app_id = g_ptr_array_index (app_ids, i);
+
+      if (g_hash_table_add (self->seen, g_strdup (app_id)))
+        g_ptr_array_add (fresh, (gpointer) app_id);
+    }
+  g_ptr_array_add (fresh, NULL);
+
+  gtk_string_list_splice (
+      self->app_ids,
+      g_list_model_get_n_items (G_LIST_MODEL (self->app_ids)),
+      0, (const char *const *) fresh->pdata);
+
+  self->next_page = data->page + 1;
+  self->failures  = 0;
+  g_clear_error (&self->error);
+  /* A short page is the last one */
+  if (app_ids->len < self->page_size)
+    {
+      self->complete = TRUE;
+      g_object_notify_by_pspec (G_OBJECT (self), props[PROP_COMPLETE]);
+    }
+
+  return NULL;
+}
+
+static DexFuture *
+page_finally (DexFuture *future,
+              PageData  *data)
+{
+  g_autoptr (BzFlathubPagedList) self = NULL;
+  g_autoptr (GError) local_error      = NULL;
+
+  self = g_weak_ref_get (&data->self);
+  if (self != NULL)
+    {
+      dex_clear (&self->loading);
+      g_object_notify_by_pspec (G_OBJECT (self), props[PROP_LOADING]);
+    }
+
+  if (dex_future_get_value (future, &local_error) ||
+      g_error_matches (local_error, DEX_ERROR, DEX_ERROR_FIBER_CANCELLED))
+    return dex_ref (future);
+
+  if (self != NULL)
+    {
+      self->failures++;
+      self->retry_after = g_get_monotonic_time () + ((gint64) RETRY_DELAY_USEC << (self->failures - 1));
+      g_clear_error (&self->error);
+      self->error = g_error_copy (local_error);
+
+      if (self->failures >= MAX_PAGE_FAILURES)
+        g_warning ("Could not load page %u of flathub collection, giving up after %u attempts: %s",
+                   data->page, self->failures, local_error->message);
+      else
+        g_debug ("Could not load page %u of flathub collection, will retry: %s",
+                 data->page, local_error->message);
+    }
+
+  return dex_ref (future);
+}
+
+static void
+items_changed (BzFlathubPagedList *self,
+               guint               position,
+               guint               removed,
+               guint               added,
+               GListModel         *model)
+{
+  g_list_model_items_changed (G_LIST_MODEL (self), position, removed, added);
+}
+
+/* End of bz-flathub-paged-list.c */
@@ -0,0 +1,60 @@
+/* bz-flathub-paged-list.h
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gtk/gtk.h>
+#include <libdex.h>
+
+G_BEGIN_DECLS
+
+#define BZ_TYPE_FLATHUB_PAGED_LIST (bz_flathub_paged_list_get_type ())
+G_DECLARE_FINAL_TYPE (BzFlathubPagedList, bz_flathub_paged_list, BZ, FLATHUB_PAGED_LIST, GObject)
+
+/* A list of the app ids of a flathub collection, such
+ * as "/collection/popular", which fetches @page_size
+ * hits at a time as it is asked for more
+ */
+BzFlathubPagedList *
+bz_flathub_paged_list_new (const char *request,
+                           guint       page_size);
+
+const char *
+bz_flathub_paged_list_get_request (BzFlathubPagedList *self);
+
+guint
+bz_flathub_paged_list_get_page_size (BzFlathubPagedList *self);
+
+gboolean
+bz_flathub_paged_list_get_loading (BzFlathubPagedList *self);
+
+gboolean
+bz_flathub_paged_list_get_complete (BzFlathubPagedList *self);
+
+/* Fetches the next page unless one is already on
+ * its way or the collection has run out. Resolves
+ * once the page has been appended
+ */
+DexFuture *
+bz_flathub_paged_list_load_more (BzFlathubPagedList *self);
+
+G_END_DECLS
+
+/* End of bz-flathub-paged-list.h */
@@ -19,17 +19,22 @@
  */
 
 #define G_LOG_DOMAIN "BAZAAR::FLATHUB"
-#define COLLECTION_FETCH_SIZE 192
-#define CATEGORY_FETCH_SIZE 96
+
+/* Enough to fill the front page sections with room
+ * to spare for apps the filter hides
+ */
+#define DEFAULT_PAGE_SIZE 48
 
 #include <json-glib/json-glib.h>
 #include <libdex.h>
 
 #include "bz-env.h"
 #include "bz-flathub-category.h"
+#include "bz-flathub-paged-list.h"
 #include "bz-flathub-state.h"
 #include "bz-global-state.h"
 #include "bz-io.h"
+#include "bz-util.h"
 
 struct _BzFlathubState
 {
@@ -37,15 +42,22 @@ struct _BzFlathubState
 
   char                    *for_day;
   BzApplicationMapFactory *map_factory;
+  guint                    page_size;
   char                    *app_of_the_day;
   GtkStringList           *apps_of_the_week;
   GListStore              *categories;
-  GtkStringList           *recently_updated;
-  GtkStringList           *recently_added;
-  GtkStringList           *popular;
-  GtkStringList           *trending;
+  BzFlathubPagedList      *recently_updated;
+  BzFlathubPagedList      *recently_added;
+  BzFlathubPagedList      *popular;
+  BzFlathubPagedList      *trending;
+
+  /* Request index of each published category,
+   * parallel to the categories store
+   */
+  GArray *category_indices;
 
   DexFuture *initializing;
+  guint      generation;
 };
 
 G_DEFINE_FINAL_TYPE (BzFlathubState, bz_flathub_state, G_TYPE_OBJECT);
@@ -58,6 +70,7 @@ enum
 
   PROP_FOR_DAY,
   PROP_MAP_FACTORY,
+  PROP_PAGE_SIZE,
   PROP_APP_OF_THE_DAY,
   PROP_APP_OF_THE_DAY_GROUP,
   PROP_APPS_OF_THE_WEEK,
@@ -72,12 +85,79 @@ enum
 };
 static GParamSpec *props[LAST_PROP] = { 0 };
 
+typedef enum
+{
+  SECTION_APP_OF_THE_DAY,
+  SECTION_APPS_OF_THE_WEEK,
+  SECTION_CATEGORIES,
+  SECTION_CATEGORY,
+} SectionKind;
+
+/* One request to flathub. Results are extracted into plain
+ * data on the io scheduler, then published on the main
+ * thread as soon as they land, independently of the rest
+ */
+BZ_DEFINE_DATA (
+    section,
+    Section,
+    {
+      GWeakRef            self;
+      guint               generation;
+      SectionKind         kind;
+      char               *request;
+      char               *category;
+      guint               category_index;
+      char               *app_of_the_day;
+      GPtrArray          *app_ids;
+      GPtrArray          *category_names;
+      /* Only set for categories */
+      BzFlathubPagedList *pager;
+    },
+    g_weak_ref_clear (&self->self);
+    BZ_RELEASE_DATA (request, g_free);
+    BZ_RELEASE_DATA (category, g_free);
+    BZ_RELEASE_DATA (app_of_the_day, g_free);
+    BZ_RELEASE_DATA (app_ids, g_ptr_array_unref);
+    BZ_RELEASE_DATA (category_names, g_ptr_array_unref);
+    BZ_RELEASE_DATA (pager, g_object_unref));
 static DexFuture *
-initialize_fiber (BzFlathubState *self);
+section_fiber (SectionData *data);
+static DexFuture *
+section_then (DexFuture   *future,
+              SectionData *data);
+static DexFuture *
+section_catch (DexFuture   *future,
+               SectionData *data);
+
 static DexFuture *
 initialize_finally (DexFuture      *future,
                     BzFlathubState *self);
 
+static DexFuture *
+load_section (BzFlathubState *self,
+              SectionKind     kind,
+              char           *request);
+
+static DexFuture *
+load_category (BzFlathubState *self,
+               const char     *name,
+               guint           index);
+
+static DexFuture *
+load_first_page (BzFlathubPagedList *pager);
+
+static DexFuture *
+first_page_catch (DexFuture *future,
+                  gpointer   user_data);
+
+static void
+publish_category (BzFlathubState *self,
+                  SectionData    *data);
+
+static void
+splice_app_ids (GtkStringList *list,
+                GPtrArray     *app_ids);
+
 static void
 bz_flathub_state_dispose (GObject *object)
 {
@@ -86,6 +166,7 @@ bz_flathub_state_dispose (GObject *object)
   dex_clear (&self->initializing);
 
   g_clear_pointer (&self->for_day, g_free);
+  g_clear_pointer (&self->category_indices, g_array_unref);
   g_clear_pointer (&self->map_factory, g_object_unref);
   g_clear_pointer (&self->app_of_the_day, g_free);
   g_clear_pointer (&self->apps_of_the_week, g_object_unref);
@@ -114,6 +195,9 @@ bz_flathub_state_get_property (GObject    *object,
     case PROP_MAP_FACTORY:
       g_value_set_object (value, bz_flathub_state_get_map_factory (self));
       break;
+    case PROP_PAGE_SIZE:
+      g_value_set_uint (value, bz_flathub_state_get_page_size (self));
+      break;
     case PROP_APP_OF_THE_DAY:
       g_value_set_string (value, bz_flathub_state_get_app_of_the_day (self));
       break;
@@ -162,6 +246,9 @@ bz_flathub_state_set_property (GObject      *object,
     case PROP_MAP_FACTORY:
       bz_flathub_state_set_map_factory (self, g_value_get_object (value));
       break;
+    case PROP_PAGE_SIZE:
+      bz_flathub_state_set_page_size (self, g_value_get_uint (value));
+      break;
     case PROP_APP_OF_THE_DAY:
     case PROP_APP_OF_THE_DAY_GROUP:
     case PROP_APPS_OF_THE_WEEK:
@@ -198,6 +285,13 @@ bz_flathub_state_class_init (BzFlathubStateClass *klass)
           BZ_TYPE_APPLICATION_MAP_FACTORY,
           G_PARAM_READABLE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY);
 
+  props[PROP_PAGE_SIZE] =
+      g_param_spec_uint (
+          "page-size",
+          NULL, NULL,
+          1, G_MAXUINT, DEFAULT_PAGE_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | G_PARAM_EXPLICIT_NOTIFY);
+
   props[PROP_APP_OF_THE_DAY] =
       g_param_spec_string (
           "app-of-the-day",
@@ -266,6 +360,7 @@ bz_flathub_state_class_init (BzFlathubStateClass *klass)
 static void
 bz_flathub_state_init (BzFlathubState *self)
 {
+  self->page_size = DEFAULT_PAGE_SIZE;
 }
 
 BzFlathubState *
@@ -281,6 +376,13 @@ bz_flathub_state_get_for_day (BzFlathubState *self)
   return self->for_day;
 }
 
+guint
+bz_flathub_state_get_page_size (BzFlathubState *self)
+{
+  g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), 0);
+  return self->page_size;
+}
+
 BzApplicationMapFactory *
 bz_flathub_state_get_map_factory (BzFlathubState *self)
 {
@@ -292,8 +394,6 @@ const char *
 bz_flathub_state_get_app_of_the_day (BzFlathubState *self)
 {
   g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), NULL);
-  if (self->initializing != NULL)
-    return NULL;
   return self->app_of_the_day;
 }
 
@@ -303,7 +403,7 @@ bz_flathub_state_dup_app_of_the_day_group (BzFlathubState *self)
   g_autoptr (GtkStringObject) string = NULL;
 
   g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), NULL);
-  if (self->initializing != NULL)
+  if (self->app_of_the_day == NULL)
     return NULL;
   g_return_val_if_fail (self->map_factory != NULL, NULL);
 
@@ -315,8 +415,6 @@ GListModel *
 bz_flathub_state_dup_apps_of_the_week (BzFlathubState *self)
 {
   g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), NULL);
-  if (self->initializing != NULL)
-    return NULL;
 
   if (self->apps_of_the_week != NULL)
     {
@@ -336,8 +434,6 @@ bz_flathub_state_dup_apps_of_the_day_week (BzFlathubState *self)
   g_autoptr (GtkStringList) combined_list = NULL;
 
   g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), NULL);
-  if (self->initializing != NULL)
-    return NULL;
 
   combined_list = gtk_string_list_new (NULL);
 
@@ -364,8 +460,6 @@ GListModel *
 bz_flathub_state_get_categories (BzFlathubState *self)
 {
   g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), NULL);
-  if (self->initializing != NULL)
-    return NULL;
   return G_LIST_MODEL (self->categories);
 }
 
@@ -373,8 +467,6 @@ GListModel *
 bz_flathub_state_dup_recently_updated (BzFlathubState *self)
 {
   g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), NULL);
-  if (self->initializing != NULL)
-    return NULL;
 
   if (self->recently_updated != NULL)
     {
@@ -392,8 +484,6 @@ GListModel *
 bz_flathub_state_dup_recently_added (BzFlathubState *self)
 {
   g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), NULL);
-  if (self->initializing != NULL)
-    return NULL;
 
   if (self->recently_added != NULL)
     {
@@ -411,8 +501,6 @@ GListModel *
 bz_flathub_state_dup_popular (BzFlathubState *self)
 {
   g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), NULL);
-  if (self->initializing != NULL)
-    return NULL;
 
   if (self->popular != NULL)
     {
@@ -430,8 +518,6 @@ GListModel *
 bz_flathub_state_dup_trending (BzFlathubState *self)
 {
   g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), NULL);
-  if (self->initializing != NULL)
-    return NULL;
 
   if (self->trending != NULL)
     {
@@ -445,6 +531,34 @@ bz_flathub_state_dup_trending (BzFlathubState *self)
     return NULL;
 }
 
+BzFlathubPagedList *
+bz_flathub_state_get_recently_updated_pager (BzFlathubState *self)
+{
+  g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), NULL);
+  return self->recently_updated;
+}
+
+BzFlathubPagedList *
+bz_flathub_state_get_recently_added_pager (BzFlathubState *self)
+{
+  g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), NULL);
+  return self->recently_added;
+}
+
+BzFlathubPagedList *
+bz_flathub_state_get_popular_pager (BzFlathubState *self)
+{
+  g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), NULL);
+  return self->popular;
+}
+
+BzFlathubPagedList *
+bz_flathub_state_get_trending_pager (BzFlathubState *self)
+{
+  g_return_val_if_fail (BZ_IS_FLATHUB_STATE (self), NULL);
+  return self->trending;
+}
+
 void
 bz_flathub_state_set_for_day (BzFlathubState *self,
                               const char     *for_day)
@@ -452,8 +566,13 @@ bz_flathub_state_set_for_day (BzFlathubState *self,
   g_return_if_fail (BZ_IS_FLATHUB_STATE (self));
 
   dex_clear (&self->initializing);
+  /* Sections still in flight check this
+   * before publishing anything
+   */
+  self->generation++;
 
   g_clear_pointer (&self->for_day, g_free);
+  g_clear_pointer (&self->category_indices, g_array_unref);
   g_clear_pointer (&self->app_of_the_day, g_free);
   g_clear_pointer (&self->apps_of_the_week, g_object_unref);
   g_clear_pointer (&self->categories, g_object_unref);
@@ -462,16 +581,6 @@ bz_flathub_state_set_for_day (BzFlathubState *self,
   g_clear_pointer (&self->popular, g_object_unref);
   g_clear_pointer (&self->trending, g_object_unref);
 
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APP_OF_THE_DAY]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APP_OF_THE_DAY_GROUP]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APPS_OF_THE_WEEK]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APPS_OF_THE_DAY_WEEK]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_CATEGORIES]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_RECENTLY_UPDATED]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_RECENTLY_ADDED]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_POPULAR]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_TRENDING]);
-
   if (for_day != NULL)
     {
       g_autoptr (DexFuture) future = NULL;
@@ -479,16 +588,27 @@ bz_flathub_state_set_for_day (BzFlathubState *self,
       self->for_day          = g_strdup (for_day);
       self->apps_of_the_week = gtk_string_list_new (NULL);
       self->categories       = g_list_store_new (BZ_TYPE_FLATHUB_CATEGORY);
-      self->recently_updated = gtk_string_list_new (NULL);
-      self->recently_added   = gtk_string_list_new (NULL);
-      self->popular          = gtk_string_list_new (NULL);
-      self->trending         = gtk_string_list_new (NULL);
-
-      future = dex_scheduler_spawn (
-          bz_get_io_scheduler (),
-          bz_get_dex_stack_size (),
-          (DexFiberFunc) initialize_fiber,
-          self, NULL);
+      self->category_indices = g_array_new (FALSE, FALSE, sizeof (guint));
+      self->recently_updated = bz_flathub_paged_list_new ("/collection/recently-updated", self->page_size);
+      self->recently_added   = bz_flathub_paged_list_new ("/collection/recently-added", self->page_size);
+      self->popular          = bz_flathub_paged_list_new ("/collection/popular", self->page_size);
+      self->trending         = bz_flathub_paged_list_new ("/collection/trending", self->page_size);
+
+      /* Only the first page of each collection is
+       * fetched here, the rest as they are scrolled to
+       */
+      future = dex_future_all (
+          load_section (self, SECTION_APP_OF_THE_DAY,
+                        g_strdup_printf ("/app-picks/app-of-the-day/%s", for_day)),
+          load_section (self, SECTION_APPS_OF_THE_WEEK,
+                        g_strdup_printf ("/app-picks/apps-of-the-week/%s", for_day)),
+          load_section (self, SECTION_CATEGORIES,
+                        g_strdup ("/collection/category")),
+          load_first_page (self->recently_updated),
+          load_first_page (self->recently_added),
+          load_first_page (self->popular),
+          load_first_page (self->trending),
+          NULL);
       future = dex_future_finally (
           future,
           (DexFutureCallback) initialize_finally,
@@ -496,6 +616,19 @@ bz_flathub_state_set_for_day (BzFlathubState *self,
       self->initializing = g_steal_pointer (&future);
     }
 
+  /* The new models start out empty and
+   * fill in as their sections land
+   */
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APP_OF_THE_DAY]);
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APP_OF_THE_DAY_GROUP]);
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APPS_OF_THE_WEEK]);
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APPS_OF_THE_DAY_WEEK]);
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_CATEGORIES]);
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_RECENTLY_UPDATED]);
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_RECENTLY_ADDED]);
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_POPULAR]);
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_TRENDING]);
+
   g_object_notify_by_pspec (G_OBJECT (self), props[PROP_FOR_DAY]);
 }
 
@@ -514,6 +647,21 @@ bz_flathub_state_update_to_today (BzFlathubState *self)
   bz_flathub_state_set_for_day (self, for_day);
 }
 
+void
+bz_flathub_state_set_page_size (BzFlathubState *self,
+                                guint           page_size)
+{
+  g_return_if_fail (BZ_IS_FLATHUB_STATE (self));
+  g_return_if_fail (page_size > 0);
+
+  if (page_size == self->page_size)
+    return;
+
+  /* Takes effect with the next sync */
+  self->page_size = page_size;
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_PAGE_SIZE]);
+}
+
 void
 bz_flathub_state_set_map_factory (BzFlathubState          *self,
                                   BzApplicationMapFactory *map_factory)
@@ -529,260 +677,252 @@ bz_flathub_state_set_map_factory (BzFlathubState          *self,
 }
 
 static DexFuture *
-initialize_fiber (BzFlathubState *self)
+load_section (BzFlathubState *self,
+              SectionKind     kind,
+              char           *request)
 {
-  const char *for_day            = self->for_day;
-  g_autoptr (GError) local_error = NULL;
-  g_autoptr (GHashTable) futures = NULL;
-  g_autoptr (GHashTable) nodes   = NULL;
-
-  futures = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, dex_unref);
-  nodes   = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) json_node_unref);
-
-#define ADD_REQUEST(key, ...)                  \
-  G_STMT_START                                 \
-  {                                            \
-    g_autofree char *_request     = NULL;      \
-    g_autoptr (DexFuture) _future = NULL;      \
-                                               \
-    _request = g_strdup_printf (__VA_ARGS__);  \
-    _future  = bz_query_flathub_v2_json_take ( \
-        g_steal_pointer (&_request));         \
-    g_hash_table_replace (                     \
-        futures,                               \
-        g_strdup (key),                        \
-        g_steal_pointer (&_future));           \
-  }                                            \
-  G_STMT_END
-
-
-  ADD_REQUEST ("/app-picks/app-of-the-day",     "/app-picks/app-of-the-day/%s",                     for_day);
-  ADD_REQUEST ("/app-picks/apps-of-the-week",   "/app-picks/apps-of-the-week/%s",                   for_day);
-  ADD_REQUEST ("/collection/category",          "/collection/category");
-  ADD_REQUEST ("/collection/recently-updated",  "/collection/recently-updated?page=0&per_page=%d",  COLLECTION_FETCH_SIZE);
-  ADD_REQUEST ("/collection/recently-added",    "/collection/recently-added?page=0&per_page=%d",    COLLECTION_FETCH_SIZE);
-  ADD_REQUEST ("/collection/popular",           "/collection/popular?page=0&per_page=%d",           COLLECTION_FETCH_SIZE);
-  ADD_REQUEST ("/collection/trending",          "/collection/trending?page=0&per_page=%d",          COLLECTION_FETCH_SIZE);
-
-  while (g_hash_table_size (futures) > 0)
-    {
-      GHashTableIter   iter        = { 0 };
-      g_autofree char *request     = NULL;
-      g_autoptr (DexFuture) future = NULL;
-      g_autoptr (JsonNode) node    = NULL;
-
-      g_hash_table_iter_init (&iter, futures);
-      g_hash_table_iter_next (&iter, (gpointer *) &request, (gpointer *) &future);
-      g_hash_table_iter_steal (&iter);
-
-      node = dex_await_boxed (g_steal_pointer (&future), &local_error);
-      if (node == NULL)
-        {
-          g_critical ("Failed to complete request '%s' from flathub: %s", request, local_error->message);
-          return dex_future_new_for_error (g_steal_pointer (&local_error));
-        }
-      g_hash_table_replace (nodes, g_steal_pointer (&request), g_steal_pointer (&node));
-    }
+  g_autoptr (SectionData) data = NULL;
+  g_autoptr (DexFuture) future = NULL;
+
+  data = section_data_new ();
+  g_weak_ref_init (&data->self, self);
+  data->generation = self->generation;
+  data->kind       = kind;
+  data->request    = request;
+
+  future = dex_scheduler_spawn (
+      bz_get_io_scheduler (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) section_fiber,
+      section_data_ref (data), section_data_unref);
+  future = dex_future_then (
+      future,
+      (DexFutureCallback) section_then,
+      section_data_ref (data), section_data_unref);
+  /* A failed section is skipped rather than
+   * holding back the rest of the page
+   */
+  future = dex_future_catch (
+      future,
+      (DexFutureCallback) section_catch,
+      section_data_ref (data), section_data_unref);
+  return g_steal_pointer (&future);
+}
 
-  if (g_hash_table_contains (nodes, "/app-picks/app-of-the-day"))
-    {
-      JsonObject *object = NULL;
+static DexFuture *
+load_category (BzFlathubState *self,
+               const char     *name,
+               guint           index)
+{
+  g_autoptr (SectionData) data = NULL;
+  g_autoptr (DexFuture) future = NULL;
+
+  data = section_data_new ();
+  g_weak_ref_init (&data->self, self);
+  data->generation     = self->generation;
+  data->kind           = SECTION_CATEGORY;
+  data->request        = g_strdup_printf ("/collection/category/%s", name);
+  data->category       = g_strdup (name);
+  data->category_index = index;
+  data->pager          = bz_flathub_paged_list_new (data->request, self->page_size);
+
+  /* The category is only published once its
+   * first page is in
+   */
+  future = bz_flathub_paged_list_load_more (data->pager);
+  future = dex_future_then (
+      future,
+      (DexFutureCallback) section_then,
+      section_data_ref (data), section_data_unref);
+  future = dex_future_catch (
+      future,
+      (DexFutureCallback) section_catch,
+      section_data_ref (data), section_data_unref);
+  return g_steal_pointer (&future);
+}
 
-      object               = json_node_get_object (g_hash_table_lookup (nodes, "/app-picks/app-of-the-day"));
-      self->app_of_the_day = g_strdup (json_object_get_string_member (object, "app_id"));
-    }
-  if (g_hash_table_contains (nodes, "/app-picks/apps-of-the-week"))
-    {
-      JsonObject *object = NULL;
-      JsonArray  *array  = NULL;
-      guint       length = 0;
+static DexFuture *
+load_first_page (BzFlathubPagedList *pager)
+{
+  return dex_future_catch (
+      bz_flathub_paged_list_load_more (pager),
+      first_page_catch,
+      NULL, NULL);
+}
 
-      object = json_node_get_object (g_hash_table_lookup (nodes, "/app-picks/apps-of-the-week"));
-      array  = json_object_get_array_member (object, "apps");
-      length = json_array_get_length (array);
+static DexFuture *
+first_page_catch (DexFuture *future,
+                  gpointer   user_data)
+{
+  /* The list has already warned, and stays
+   * empty until it is asked for more
+   */
+  return dex_future_new_true ();
+}
 
-      for (guint i = 0; i < length; i++)
-        {
-          JsonObject *element = NULL;
+static DexFuture *
+section_fiber (SectionData *data)
+{
+  g_autoptr (GError) local_error = NULL;
+  g_autoptr (JsonNode) node      = NULL;
+  JsonObject *object             = NULL;
 
-          element = json_array_get_object_element (array, i);
-          gtk_string_list_append (
-              self->apps_of_the_week,
-              json_object_get_string_member (element, "app_id"));
-        }
+  /* Listings only ever need the app ids, so
+   * those are picked out without a full parse
+   */
+  switch (data->kind)
+    {
+    case SECTION_APPS_OF_THE_WEEK:
+      data->app_ids = dex_await_boxed (
+          bz_query_flathub_v2_strings (data->request, "apps", "app_id"),
+          &local_error);
+      break;
+    default:
+      node = dex_await_boxed (bz_query_flathub_v2_json (data->request), &local_error);
+      break;
     }
-  if (g_hash_table_contains (nodes, "/collection/category"))
+  if (local_error != NULL)
+    return dex_future_new_for_error (g_steal_pointer (&local_error));
+
+  switch (data->kind)
     {
-      JsonArray *array  = NULL;
-      guint      length = 0;
+    case SECTION_APP_OF_THE_DAY:
+      object               = json_node_get_object (node);
+      data->app_of_the_day = g_strdup (json_object_get_string_member (object, "app_id"));
+      break;
+    case SECTION_CATEGORIES:
+      {
+        JsonArray *array  = NULL;
+        guint      length = 0;
+
+        array                = json_node_get_array (node);
+        length               = json_array_get_length (array);
+        data->category_names = g_ptr_array_new_full (length, g_free);
+        for (guint i = 0; i < length; i++)
+          g_ptr_array_add (data->category_names, g_strdup (json_array_get_string_element (array, i)));
+      }
+      break;
+    default:
+      break;
+    }
 
-      array  = json_node_get_array (g_hash_table_lookup (nodes, "/collection/category"));
-      length = json_array_get_length (array);
+  return dex_future_new_true ();
+}
 
-      for (guint i = 0; i < length; i++)
-        {
-          const char *category = NULL;
+static DexFuture *
+section_then (DexFuture   *future,
+              SectionData *data)
+{
+  g_autoptr (BzFlathubState) self = NULL;
 
-          category = json_array_get_string_element (array, i);
-          ADD_REQUEST (category, "/collection/category/%s?page=0&per_page=%d", category, CATEGORY_FETCH_SIZE);
-        }
+  self = g_weak_ref_get (&data->self);
+  if (self == NULL || self->generation != data->generation)
+    return NULL;
 
-      while (g_hash_table_size (futures) > 0)
-        {
-          GHashTableIter   iter                  = { 0 };
-          g_autofree char *name                  = NULL;
-          g_autoptr (DexFuture) future           = NULL;
-          g_autoptr (JsonNode) node              = NULL;
-          g_autoptr (BzFlathubCategory) category = NULL;
-          g_autoptr (GtkStringList) store        = NULL;
-          JsonArray *category_array              = NULL;
-          guint      category_length             = 0;
-
-          g_hash_table_iter_init (&iter, futures);
-          g_hash_table_iter_next (&iter, (gpointer *) &name, (gpointer *) &future);
-          g_hash_table_iter_steal (&iter);
-
-          node = dex_await_boxed (g_steal_pointer (&future), &local_error);
-          if (node == NULL)
-            {
-              g_critical ("Failed to retrieve category '%s' from flathub: %s", name, local_error->message);
-              return dex_future_new_for_error (g_steal_pointer (&local_error));
-            }
-
-          category = bz_flathub_category_new ();
-          store    = gtk_string_list_new (NULL);
-          bz_flathub_category_set_name (category, name);
-          bz_flathub_category_set_applications (category, G_LIST_MODEL (store));
-
-          category_array  = json_object_get_array_member (json_node_get_object (node), "hits");
-          category_length = json_array_get_length (category_array);
-
-          for (guint i = 0; i < category_length; i++)
-            {
-              JsonObject *element = NULL;
-
-              element = json_array_get_object_element (category_array, i);
-              gtk_string_list_append (
-                  store,
-                  json_object_get_string_member (element, "app_id"));
-            }
-
-          g_list_store_append (self->categories, category);
-        }
-    }
-  if (g_hash_table_contains (nodes, "/collection/recently-updated"))
+  switch (data->kind)
     {
-      JsonObject *object = NULL;
-      JsonArray  *array  = NULL;
-      guint       length = 0;
-
-      object = json_node_get_object (g_hash_table_lookup (nodes, "/collection/recently-updated"));
-      array  = json_object_get_array_member (object, "hits");
-      length = json_array_get_length (array);
-
-      for (guint i = 0; i < length; i++)
-        {
-          JsonObject *element = NULL;
-
-          element = json_array_get_object_element (array, i);
-          gtk_string_list_append (
-              self->recently_updated,
-              json_object_get_string_member (element, "app_id"));
-        }
+    case SECTION_APP_OF_THE_DAY:
+      self->app_of_the_day = g_steal_pointer (&data->app_of_the_day);
+      g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APP_OF_THE_DAY]);
+      g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APP_OF_THE_DAY_GROUP]);
+      g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APPS_OF_THE_DAY_WEEK]);
+      break;
+    case SECTION_APPS_OF_THE_WEEK:
+      splice_app_ids (self->apps_of_the_week, data->app_ids);
+      g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APPS_OF_THE_WEEK]);
+      g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APPS_OF_THE_DAY_WEEK]);
+      break;
+    case SECTION_CATEGORIES:
+      {
+        g_autoptr (GPtrArray) futures = NULL;
+
+        /* Category pages only need the names, so they
+         * go out right away and each lands on its own
+         */
+        futures = g_ptr_array_new_with_free_func (dex_unref);
+        for (guint i = 0; i < data->category_names->len; i++)
+          {
+            const char *name             = NULL;
+            g_autoptr (DexFuture) loaded = NULL;
+
+            name   = g_ptr_array_index (data->category_names, i);
+            loaded = load_category (self, name, i);
+            g_ptr_array_add (futures, g_steal_pointer (&loaded));
+          }
+
+        if (futures->len > 0)
+          return dex_future_allv ((DexFuture *const *) futures->pdata, futures->len);
+      }
+      break;
+    case SECTION_CATEGORY:
+      publish_category (self, data);
+      break;
+    default:
+      g_assert_not_reached ();
     }
-  if (g_hash_table_contains (nodes, "/collection/recently-added"))
-    {
-      JsonObject *object = NULL;
-      JsonArray  *array  = NULL;
-      guint       length = 0;
 
-      object = json_node_get_object (g_hash_table_lookup (nodes, "/collection/recently-added"));
-      array  = json_object_get_array_member (object, "hits");
-      length = json_array_get_length (array);
-
-      for (guint i = 0; i < length; i++)
-        {
-          JsonObject *element = NULL;
+  return NULL;
+}
 
-          element = json_array_get_object_element (array, i);
-          gtk_string_list_append (
-              self->recently_added,
-              json_object_get_string_member (element, "app_id"));
-        }
-    }
-  if (g_hash_table_contains (nodes, "/collection/popular"))
-    {
-      JsonObject *object = NULL;
-      JsonArray  *array  = NULL;
-      guint       length = 0;
+static DexFuture *
+section_catch (DexFuture   *future,
+               SectionData *data)
+{
+  g_autoptr (GError) local_error = NULL;
 
-      object = json_node_get_object (g_hash_table_lookup (nodes, "/collection/popular"));
-      array  = json_object_get_array_member (object, "hits");
-      length = json_array_get_length (array);
+  dex_future_get_value (future, &local_error);
+  /* Paged lists warn about their own failures */
+  if (data->pager == NULL &&
+      !g_error_matches (local_error, DEX_ERROR, DEX_ERROR_FIBER_CANCELLED))
+    g_warning ("Skipping flathub request '%s': %s", data->request, local_error->message);
 
-      for (guint i = 0; i < length; i++)
-        {
-          JsonObject *element = NULL;
+  return dex_future_new_true ();
+}
 
-          element = json_array_get_object_element (array, i);
-          gtk_string_list_append (
-              self->popular,
-              json_object_get_string_member (element, "app_id"));
-        }
-    }
-  if (g_hash_table_contains (nodes, "/collection/trending"))
-    {
-      JsonObject *object = NULL;
-      JsonArray  *array  = NULL;
-      guint       length = 0;
+static void
+publish_category (BzFlathubState *self,
+                  SectionData    *data)
+{
+  g_autoptr (BzFlathubCategory) category = NULL;
+  guint position                         = 0;
 
-      object = json_node_get_object (g_hash_table_lookup (nodes, "/collection/trending"));
-      array  = json_object_get_array_member (object, "hits");
-      length = json_array_get_length (array);
+  category = bz_flathub_category_new ();
+  bz_flathub_category_set_name (category, data->category);
+  bz_flathub_category_set_applications (category, G_LIST_MODEL (data->pager));
+  g_object_bind_property (self, "map-factory", category, "map-factory", G_BINDING_SYNC_CREATE);
 
-      for (guint i = 0; i < length; i++)
-        {
-          JsonObject *element = NULL;
+  /* Keep flathub's order however the pages arrive */
+  while (position < self->category_indices->len &&
+         g_array_index (self->category_indices, guint, position) < data->category_index)
+    position++;
 
-          element = json_array_get_object_element (array, i);
-          gtk_string_list_append (
-              self->trending,
-              json_object_get_string_member (element, "app_id"));
-        }
-    }
-
-  return dex_future_new_true ();
+  g_array_insert_val (self->category_indices, position, data->category_index);
+  g_list_store_insert (self->categories, position, category);
 }
 
 static DexFuture *
 initialize_finally (DexFuture      *future,
                     BzFlathubState *self)
 {
-  guint n_categories = 0;
-
-  n_categories = g_list_model_get_n_items (G_LIST_MODEL (self->categories));
-  for (guint i = 0; i < n_categories; i++)
-    {
-      g_autoptr (BzFlathubCategory) category = NULL;
-
-      category = g_list_model_get_item (G_LIST_MODEL (self->categories), i);
-      g_object_bind_property (self, "map-factory", category, "map-factory", G_BINDING_SYNC_CREATE);
-    }
-
   self->initializing = NULL;
-  g_debug ("Done syncing flathub state; notifying property listeners...");
-
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APP_OF_THE_DAY]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APP_OF_THE_DAY_GROUP]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APPS_OF_THE_WEEK]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_APPS_OF_THE_DAY_WEEK]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_CATEGORIES]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_RECENTLY_UPDATED]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_RECENTLY_ADDED]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_POPULAR]);
-  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_TRENDING]);
+  g_debug ("Done syncing flathub state");
 
   return NULL;
 }
 
+static void
+splice_app_ids (GtkStringList *list,
+                GPtrArray     *app_ids)
+{
+  if (app_ids == NULL)
+    return;
+
+  /* Terminate for gtk_string_list_splice */
+  g_ptr_array_add (app_ids, NULL);
+  gtk_string_list_splice (
+      list, 0, 0,
+      (const char *const *) app_ids->pdata);
+  g_ptr_array_remove_index (app_ids, app_ids->len - 1);
+}
+
 /* End of bz-flathub-state.c */
@@ -24,6 +24,7 @@
 
 #include "bz-application-map-factory.h"
 #include "bz-entry-group.h"
+#include "bz-flathub-paged-list.h"
 
 G_BEGIN_DECLS
 
@@ -47,6 +48,16 @@ bz_flathub_state_get_for_day (BzFlathubState *self);
 BzApplicationMapFactory *
 bz_flathub_state_get_map_factory (BzFlathubState *self);
 
+guint
+bz_flathub_state_get_page_size (BzFlathubState *self);
+
+/* How many apps to fetch at a time for collections
+ * and categories, applied at the next sync
+ */
+void
+bz_flathub_state_set_page_size (BzFlathubState *self,
+                                guint           page_size);
+
 const char *
 bz_flathub_state_get_app_of_the_day (BzFlathubState *self);
 
@@ -71,6 +82,18 @@ bz_flathub_state_dup_popular (BzFlathubState *self);
 GListModel *
 bz_flathub_state_dup_trending (BzFlathubState *self);
 
+BzFlathubPagedList *
+bz_flathub_state_get_recently_updated_pager (BzFlathubState *self);
+
+BzFlathubPagedList *
+bz_flathub_state_get_recently_added_pager (BzFlathubState *self);
+
+BzFlathubPagedList *
+bz_flathub_state_get_popular_pager (BzFlathubState *self);
+
+BzFlathubPagedList *
+bz_flathub_state_get_trending_pager (BzFlathubState *self);
+
 void
 bz_flathub_state_update_to_today (BzFlathubState *self);
 
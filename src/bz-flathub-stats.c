@@ -0,0 +1,223 @@
+/* bz-flathub-stats.c
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "BAZAAR::FLATHUB-STATS"
+
+/* Replies are cheap to keep, but stats do move */
+#define MEMORY_TTL (G_TIME_SPAN_MINUTE * 30)
+/* Roughly a few screens of tiles worth of apps */
+#define MAX_MEMORY_RECORDS 256
+
+#define PREFETCH_DELAY_MSEC 250
+#define PREFETCH_BATCH_SIZE 4
+#define MAX_PREFETCH_QUEUED 32
+
+#include "config.h"
+
+#include "bz-flathub-stats.h"
+#include "bz-global-state.h"
+
+typedef struct
+{
+  /* borrowed from the key in cache_records */
+  const char *key;
+  DexFuture  *future;
+  gint64      birth;
+  /* data points back at the record */
+  GList link;
+} CacheRecord;
+
+static GMutex      cache_mutex   = { 0 };
+static GHashTable *cache_records = NULL;
+/* Ordered from least to most recently asked for */
+static GQueue      cache_lru     = G_QUEUE_INIT;
+
+/* Only touched from the main thread. The queue owns
+ * its strings, the set just points at them
+ */
+static GQueue      prefetch_queue     = G_QUEUE_INIT;
+static GHashTable *prefetch_queued    = NULL;
+static guint       prefetch_source    = 0;
+static guint       prefetch_in_flight = 0;
+
+static void
+cache_record_free (CacheRecord *record);
+
+static gboolean
+prefetch_timeout (gpointer user_data);
+
+static void
+pump_prefetch (void);
+
+static DexFuture *
+prefetch_finally (DexFuture *future,
+                  gpointer   user_data);
+
+DexFuture *
+bz_flathub_stats_query (const char        *app_id,
+                        BzFlathubStatsKind kind)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  g_autofree char *key            = NULL;
+  g_autofree char *request        = NULL;
+  CacheRecord     *record         = NULL;
+  gint64           now            = 0;
+
+  dex_return_error_if_fail (app_id != NULL);
+
+  key = g_strdup_printf ("%d:%s", kind, app_id);
+  now = g_get_monotonic_time ();
+
+  locker = g_mutex_locker_new (&cache_mutex);
+  if (cache_records == NULL)
+    cache_records = g_hash_table_new_full (
+        g_str_hash, g_str_equal,
+        g_free, (GDestroyNotify) cache_record_free);
+
+  /* Failed and expired replies are simply
+   * replaced by a new request
+   */
+  record = g_hash_table_lookup (cache_records, key);
+  if (record != NULL &&
+      (dex_future_is_pending (record->future) ||
+       (dex_future_is_resolved (record->future) &&
+        now - record->birth < MEMORY_TTL)))
+    {
+      g_queue_unlink (&cache_lru, &record->link);
+      g_queue_push_tail_link (&cache_lru, &record->link);
+      return dex_ref (record->future);
+    }
+
+  switch (kind)
+    {
+    case BZ_FLATHUB_STATS_VERIFICATION:
+      request = g_strdup_printf ("/verification/%s/status", app_id);
+      break;
+    case BZ_FLATHUB_STATS_DOWNLOADS:
+      request = g_strdup_printf ("/stats/%s?all=false&days=175", app_id);
+      break;
+    default:
+      g_assert_not_reached ();
+      return NULL;
+    }
+
+  record            = g_new0 (CacheRecord, 1);
+  record->key       = key;
+  record->future    = bz_query_flathub_v2_json (request);
+  record->birth     = now;
+  record->link.data = record;
+  g_hash_table_replace (cache_records, g_steal_pointer (&key), record);
+  g_queue_push_tail_link (&cache_lru, &record->link);
+
+  /* Every app ever bound to a tile passes through
+   * here, so forget the ones not asked for lately.
+   * Anyone still waiting holds their own reference
+   */
+  while (g_queue_get_length (&cache_lru) > MAX_MEMORY_RECORDS)
+    {
+      CacheRecord *cold = g_queue_peek_head (&cache_lru);
+
+      /* also drops the record from the queue */
+      g_hash_table_remove (cache_records, cold->key);
+    }
+
+  return dex_ref (record->future);
+}
+
+void
+bz_flathub_stats_prefetch (const char *app_id)
+{
+  g_return_if_fail (app_id != NULL);
+
+  if (prefetch_queued == NULL)
+    prefetch_queued = g_hash_table_new (g_str_hash, g_str_equal);
+  if (g_hash_table_contains (prefetch_queued, app_id))
+    return;
+
+  g_queue_push_head (&prefetch_queue, g_strdup (app_id));
+  g_hash_table_add (prefetch_queued, g_queue_peek_head (&prefetch_queue));
+
+  /* Tiles scrolled past long ago are not worth it */
+  while (g_queue_get_length (&prefetch_queue) > MAX_PREFETCH_QUEUED)
+    {
+      g_autofree char *dropped = NULL;
+
+      dropped = g_queue_pop_tail (&prefetch_queue);
+      g_hash_table_remove (prefetch_queued, dropped);
+    }
+
+  /* Let flings settle before anything goes out */
+  if (prefetch_source == 0)
+    prefetch_source = g_timeout_add (PREFETCH_DELAY_MSEC, prefetch_timeout, NULL);
+}
+
+static void
+cache_record_free (CacheRecord *record)
+{
+  g_queue_unlink (&cache_lru, &record->link);
+  dex_clear (&record->future);
+  g_free (record);
+}
+
+static gboolean
+prefetch_timeout (gpointer user_data)
+{
+  prefetch_source = 0;
+  pump_prefetch ();
+  return G_SOURCE_REMOVE;
+}
+
+static void
+pump_prefetch (void)
+{
+  while (prefetch_in_flight < PREFETCH_BATCH_SIZE)
+    {
+      g_autofree char *app_id      = NULL;
+      g_autoptr (DexFuture) future = NULL;
+
+      app_id = g_queue_pop_head (&prefetch_queue);
+      if (app_id == NULL)
+        break;
+      g_hash_table_remove (prefetch_queued, app_id);
+
+      future = dex_future_all (
+          bz_flathub_stats_query (app_id, BZ_FLATHUB_STATS_VERIFICATION),
+          bz_flathub_stats_query (app_id, BZ_FLATHUB_STATS_DOWNLOADS),
+          NULL);
+      future = dex_future_finally (
+          future,
+          (DexFutureCallback) prefetch_finally,
+          NULL, NULL);
+
+      prefetch_in_flight++;
+      dex_future_disown (g_steal_pointer (&future));
+    }
+}
+
+static DexFuture *
+prefetch_finally (DexFuture *future,
+                  gpointer   user_data)
+{
+  prefetch_in_flight--;
+  pump_prefetch ();
+  return NULL;
+}
+
+/* End of bz-flathub-stats.c */
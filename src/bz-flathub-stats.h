@@ -0,0 +1,52 @@
+/* bz-flathub-stats.h
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <libdex.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  BZ_FLATHUB_STATS_VERIFICATION = 0,
+  BZ_FLATHUB_STATS_DOWNLOADS,
+} BzFlathubStatsKind;
+
+/* Resolves to the flathub reply for @app_id as an immutable
+ * #JsonNode. Replies are shared by every entry of the app
+ * and kept in memory for a while; the http cache keeps
+ * them on disk across restarts
+ */
+DexFuture *
+bz_flathub_stats_query (const char        *app_id,
+                        BzFlathubStatsKind kind);
+
+/* Queues @app_id to be fetched in the background, for tiles
+ * which just came into view. Only the most recent requests
+ * are kept, and they are served newest first. Must be
+ * called from the main thread
+ */
+void
+bz_flathub_stats_prefetch (const char *app_id);
+
+G_END_DECLS
+
+/* End of bz-flathub-stats.h */
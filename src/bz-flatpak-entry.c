@@ -21,18 +21,25 @@
 #define G_LOG_DOMAIN  "BAZAAR::FLATPAK-ENTRY"
 #define BAZAAR_MODULE "entry"
 
+/* Largest size the app icon is displayed at, in
+ * device pixels
+ */
+#define ICON_TARGET_SIZE 128
+
 #include "config.h"
 
 #include <glib/gi18n.h>
 #include <xmlb.h>
 
 #include "bz-async-texture.h"
+#include "bz-env.h"
 #include "bz-flatpak-private.h"
 #include "bz-io.h"
 #include "bz-issue.h"
 #include "bz-release.h"
 #include "bz-serializable.h"
 #include "bz-url.h"
+#include "bz-util.h"
 
 enum
 {
@@ -57,6 +64,14 @@ struct _BzFlatpakEntry
   char    *runtime_name;
   char    *addon_extension_of_ref;
 
+  /* The raw appstream component, kept around
+   * until the heavy fields are first needed.
+   * Guarded by `mutex` since the entry cache
+   * serializes it off the main thread
+   */
+  GMutex mutex;
+  char  *deferred_xml;
+
   FlatpakRef *ref;
 };
 
@@ -97,6 +112,62 @@ append_markup_escaped (GString    *string,
 static void
 clear_entry (BzFlatpakEntry *self);
 
+static inline gboolean
+size_fits_better (int candidate,
+                  int current,
+                  int target);
+
+BZ_DEFINE_DATA (
+    heavy_fields,
+    HeavyFields,
+    {
+      char       *long_description;
+      GListStore *screenshot_paintables;
+      GListStore *share_urls;
+      GListStore *version_history;
+    },
+    BZ_RELEASE_DATA (long_description, g_free);
+    BZ_RELEASE_DATA (screenshot_paintables, g_object_unref);
+    BZ_RELEASE_DATA (share_urls, g_object_unref);
+    BZ_RELEASE_DATA (version_history, g_object_unref));
+
+BZ_DEFINE_DATA (
+    load_deferred,
+    LoadDeferred,
+    {
+      BzFlatpakEntry  *self;
+      char            *xml;
+      char            *id;
+      char            *unique_id;
+      char            *unique_id_checksum;
+      char            *remote_name;
+      gboolean         is_application;
+      HeavyFieldsData *result;
+    },
+    BZ_RELEASE_DATA (self, g_object_unref);
+    BZ_RELEASE_DATA (xml, g_free);
+    BZ_RELEASE_DATA (id, g_free);
+    BZ_RELEASE_DATA (unique_id, g_free);
+    BZ_RELEASE_DATA (unique_id_checksum, g_free);
+    BZ_RELEASE_DATA (remote_name, g_free);
+    BZ_RELEASE_DATA (result, heavy_fields_data_unref));
+static DexFuture *
+load_deferred_fiber (LoadDeferredData *data);
+static DexFuture *
+load_deferred_notify (LoadDeferredData *data);
+
+static HeavyFieldsData *
+build_heavy_fields (const char  *id,
+                    const char  *unique_id_checksum,
+                    const char  *remote_name,
+                    gboolean     is_application,
+                    AsComponent *component,
+                    GError     **error);
+
+static void
+apply_heavy_fields (BzFlatpakEntry  *self,
+                    HeavyFieldsData *fields);
+
 static void
 bz_flatpak_entry_dispose (GObject *object)
 {
@@ -108,6 +179,16 @@ bz_flatpak_entry_dispose (GObject *object)
   G_OBJECT_CLASS (bz_flatpak_entry_parent_class)->dispose (object);
 }
 
+static void
+bz_flatpak_entry_finalize (GObject *object)
+{
+  BzFlatpakEntry *self = BZ_FLATPAK_ENTRY (object);
+
+  g_mutex_clear (&self->mutex);
+
+  G_OBJECT_CLASS (bz_flatpak_entry_parent_class)->finalize (object);
+}
+
 static void
 bz_flatpak_entry_get_property (GObject    *object,
                                guint       prop_id,
@@ -167,14 +248,47 @@ bz_flatpak_entry_set_property (GObject      *object,
     }
 }
 
+static DexFuture *
+bz_flatpak_entry_real_load_deferred (BzEntry *entry)
+{
+  BzFlatpakEntry *self              = BZ_FLATPAK_ENTRY (entry);
+  g_autoptr (LoadDeferredData) data = NULL;
+
+  data = load_deferred_data_new ();
+
+  g_mutex_lock (&self->mutex);
+  data->xml = g_strdup (self->deferred_xml);
+  g_mutex_unlock (&self->mutex);
+  if (data->xml == NULL)
+    return dex_future_new_true ();
+
+  data->self               = g_object_ref (self);
+  data->id                 = g_strdup (bz_entry_get_id (entry));
+  data->unique_id          = g_strdup (bz_entry_get_unique_id (entry));
+  data->unique_id_checksum = g_strdup (bz_entry_get_unique_id_checksum (entry));
+  data->remote_name        = g_strdup (bz_entry_get_remote_repo_name (entry));
+  data->is_application     = bz_entry_is_of_kinds (entry, BZ_ENTRY_KIND_APPLICATION);
+
+  return dex_scheduler_spawn (
+      bz_get_io_scheduler (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) load_deferred_fiber,
+      load_deferred_data_ref (data),
+      load_deferred_data_unref);
+}
+
 static void
 bz_flatpak_entry_class_init (BzFlatpakEntryClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  BzEntryClass *entry_class  = BZ_ENTRY_CLASS (klass);
 
   object_class->set_property = bz_flatpak_entry_set_property;
   object_class->get_property = bz_flatpak_entry_get_property;
   object_class->dispose      = bz_flatpak_entry_dispose;
+  object_class->finalize     = bz_flatpak_entry_finalize;
+
+  entry_class->load_deferred = bz_flatpak_entry_real_load_deferred;
 
   props[PROP_INSTANCE] =
       g_param_spec_object (
@@ -232,6 +346,7 @@ bz_flatpak_entry_class_init (BzFlatpakEntryClass *klass)
 static void
 bz_flatpak_entry_init (BzFlatpakEntry *self)
 {
+  g_mutex_init (&self->mutex);
 }
 
 static void
@@ -253,6 +368,10 @@ bz_flatpak_entry_real_serialize (BzSerializable  *serializable,
     g_variant_builder_add (builder, "{sv}", "runtime-name", g_variant_new_string (self->runtime_name));
   if (self->addon_extension_of_ref != NULL)
     g_variant_builder_add (builder, "{sv}", "addon-extension-of-ref", g_variant_new_string (self->addon_extension_of_ref));
+  g_mutex_lock (&self->mutex);
+  if (self->deferred_xml != NULL)
+    g_variant_builder_add (builder, "{sv}", "deferred-xml", g_variant_new_string (self->deferred_xml));
+  g_mutex_unlock (&self->mutex);
 
   bz_entry_serialize (BZ_ENTRY (self), builder);
 }
@@ -290,6 +409,13 @@ bz_flatpak_entry_real_deserialize (BzSerializable *serializable,
         self->runtime_name = g_variant_dup_string (value, NULL);
       else if (g_strcmp0 (key, "addon-extension-of-ref") == 0)
         self->addon_extension_of_ref = g_variant_dup_string (value, NULL);
+      else if (g_strcmp0 (key, "deferred-xml") == 0)
+        {
+          g_mutex_lock (&self->mutex);
+          g_clear_pointer (&self->deferred_xml, g_free);
+          self->deferred_xml = g_variant_dup_string (value, NULL);
+          g_mutex_unlock (&self->mutex);
+        }
     }
 
   return bz_entry_deserialize (BZ_ENTRY (self), import, error);
@@ -308,6 +434,7 @@ bz_flatpak_entry_new_for_ref (BzFlatpakInstance *instance,
                               FlatpakRemote     *remote,
                               FlatpakRef        *ref,
                               AsComponent       *component,
+                              const char        *component_xml,
                               const char        *appstream_dir,
                               GdkPaintable      *remote_icon,
                               GError           **error)
@@ -331,21 +458,17 @@ bz_flatpak_entry_new_for_ref (BzFlatpakInstance *instance,
   const char      *project_group               = NULL;
   const char      *developer                   = NULL;
   const char      *developer_id                = NULL;
-  g_autofree char *long_description            = NULL;
   const char      *remote_name                 = NULL;
   const char      *project_url                 = NULL;
   g_autoptr (GPtrArray) as_search_tokens       = NULL;
   g_autoptr (GPtrArray) search_tokens          = NULL;
   g_autoptr (GdkPaintable) icon_paintable      = NULL;
   g_autoptr (GIcon) mini_icon                  = NULL;
-  g_autoptr (GListStore) screenshot_paintables = NULL;
-  g_autoptr (GListStore) share_urls            = NULL;
-  g_autofree char *donation_url                = NULL;
-  g_autofree char *forge_url                   = NULL;
+  const char      *donation_url                = NULL;
+  const char      *forge_url                   = NULL;
   g_autoptr (GListStore) native_reviews        = NULL;
   double           average_rating              = 0.0;
   g_autofree char *ratings_summary             = NULL;
-  g_autoptr (GListStore) version_history       = NULL;
   const char *accent_color_light               = NULL;
   const char *accent_color_dark                = NULL;
 
@@ -433,13 +556,9 @@ bz_flatpak_entry_new_for_ref (BzFlatpakInstance *instance,
 
   if (component != NULL)
     {
-      const char    *long_description_raw = NULL;
-      AsDeveloper   *developer_obj        = NULL;
-      GPtrArray     *screenshots          = NULL;
-      AsReleaseList *releases             = NULL;
-      GPtrArray     *releases_arr         = NULL;
-      GPtrArray     *icons                = NULL;
-      AsBranding    *branding             = NULL;
+      AsDeveloper *developer_obj = NULL;
+      GPtrArray   *icons         = NULL;
+      AsBranding  *branding      = NULL;
 
       title = as_component_get_name (component);
       if (title == NULL)
@@ -452,6 +571,8 @@ bz_flatpak_entry_new_for_ref (BzFlatpakInstance *instance,
       project_group    = as_component_get_project_group (component);
       project_url      = as_component_get_url (component, AS_URL_KIND_HOMEPAGE);
       as_search_tokens = as_component_get_search_tokens (component);
+      donation_url     = as_component_get_url (component, AS_URL_KIND_DONATION);
+      forge_url        = as_component_get_url (component, AS_URL_KIND_VCS_BROWSER);
 
       developer_obj = as_component_get_developer (component);
       if (developer_obj != NULL)
@@ -460,246 +581,80 @@ bz_flatpak_entry_new_for_ref (BzFlatpakInstance *instance,
           developer_id = as_developer_get_id (developer_obj);
         }
 
-      long_description_raw = as_component_get_description (component);
-      long_description     = parse_appstream_to_markdown (long_description_raw, error);
-      if (long_description_raw != NULL && long_description == NULL)
-        return NULL;
-
-      screenshots = as_component_get_screenshots_all (component);
-      if (screenshots != NULL)
-        {
-          screenshot_paintables = g_list_store_new (BZ_TYPE_ASYNC_TEXTURE);
-
-          for (guint i = 0; i < screenshots->len; i++)
-            {
-              AsScreenshot *screenshot = NULL;
-              GPtrArray    *images     = NULL;
-
-              screenshot = g_ptr_array_index (screenshots, i);
-              images     = as_screenshot_get_images_all (screenshot);
-
-              for (guint j = 0; j < images->len; j++)
-                {
-                  AsImage    *image_obj = NULL;
-                  const char *url       = NULL;
-
-                  image_obj = g_ptr_array_index (images, j);
-                  url       = as_image_get_url (image_obj);
-
-                  if (url != NULL)
-                    {
-                      g_autoptr (GFile) screenshot_file  = NULL;
-                      g_autofree char *cache_basename    = NULL;
-                      g_autoptr (GFile) cache_file       = NULL;
-                      g_autoptr (BzAsyncTexture) texture = NULL;
-
-                      screenshot_file = g_file_new_for_uri (url);
-                      cache_basename  = g_strdup_printf ("screenshot_%d.png", i);
-                      cache_file      = g_file_new_build_filename (
-                          module_dir, unique_id_checksum, cache_basename, NULL);
-
-                      texture = bz_async_texture_new_lazy (screenshot_file, cache_file);
-                      g_list_store_append (screenshot_paintables, texture);
-                      break;
-                    }
-                }
-            }
-        }
-
-      share_urls = g_list_store_new (BZ_TYPE_URL);
-      if (kinds & BZ_ENTRY_KIND_APPLICATION &&
-          g_strcmp0 (remote_name, "flathub") == 0)
-        {
-          g_autofree char *flathub_url = NULL;
-          g_autoptr (BzUrl) url        = NULL;
-
-          flathub_url = g_strdup_printf ("https://flathub.org/apps/%s", id);
-
-          url = bz_url_new ();
-          bz_url_set_name (url, C_ ("Project URL Type", "Flathub Page"));
-          bz_url_set_url (url, flathub_url);
-
-          g_list_store_append (share_urls, url);
-        }
-
-      for (int e = AS_URL_KIND_UNKNOWN + 1; e < AS_URL_KIND_LAST; e++)
-        {
-          const char *url = NULL;
-
-          url = as_component_get_url (component, e);
-          if (url != NULL)
-            {
-              const char *enum_string     = NULL;
-              g_autoptr (BzUrl) share_url = NULL;
-
-              switch (e)
-                {
-                case AS_URL_KIND_HOMEPAGE:
-                  enum_string = C_ ("Project URL Type", "Homepage");
-                  break;
-                case AS_URL_KIND_BUGTRACKER:
-                  enum_string = C_ ("Project URL Type", "Issue Tracker");
-                  break;
-                case AS_URL_KIND_FAQ:
-                  enum_string = C_ ("Project URL Type", "FAQ");
-                  break;
-                case AS_URL_KIND_HELP:
-                  enum_string = C_ ("Project URL Type", "Help");
-                  break;
-                case AS_URL_KIND_DONATION:
-                  enum_string = C_ ("Project URL Type", "Donate");
-                  g_clear_pointer (&donation_url, g_free);
-                  donation_url = g_strdup (url);
-                  break;
-                case AS_URL_KIND_TRANSLATE:
-                  enum_string = C_ ("Project URL Type", "Translate");
-                  break;
-                case AS_URL_KIND_CONTACT:
-                  enum_string = C_ ("Project URL Type", "Contact");
-                  break;
-                case AS_URL_KIND_VCS_BROWSER:
-                  enum_string = C_ ("Project URL Type", "Source Code");
-                  g_clear_pointer (&forge_url, g_free);
-                  forge_url = g_strdup (url);
-                  break;
-                case AS_URL_KIND_CONTRIBUTE:
-                  enum_string = C_ ("Project URL Type", "Contribute");
-                  break;
-                default:
-                  break;
-                }
-
-              share_url = g_object_new (
-                  BZ_TYPE_URL,
-                  "name", enum_string,
-                  "url", url,
-                  NULL);
-              g_list_store_append (share_urls, share_url);
-            }
-        }
-      if (g_list_model_get_n_items (G_LIST_MODEL (share_urls)) == 0)
-        g_clear_object (&share_urls);
-
-      releases = as_component_load_releases (component, TRUE, error);
-      if (releases == NULL)
-        return NULL;
-      releases_arr = as_release_list_get_entries (releases);
-      if (releases_arr != NULL)
-        {
-          version_history = g_list_store_new (BZ_TYPE_RELEASE);
-
-          for (guint i = 0; i < releases_arr->len; i++)
-            {
-              AsRelease       *as_release              = NULL;
-              GPtrArray       *as_issues               = NULL;
-              const char      *release_description_raw = NULL;
-              g_autofree char *release_description     = NULL;
-              g_autoptr (GListStore) issues            = NULL;
-              g_autoptr (BzRelease) release            = NULL;
-
-              as_release = g_ptr_array_index (releases_arr, i);
-              as_issues  = as_release_get_issues (as_release);
-
-              release_description_raw = as_release_get_description (as_release);
-              release_description     = parse_appstream_to_markdown (release_description_raw, NULL);
-
-              if (as_issues != NULL && as_issues->len > 0)
-                {
-                  issues = g_list_store_new (BZ_TYPE_ISSUE);
-
-                  for (guint j = 0; j < as_issues->len; j++)
-                    {
-                      AsIssue *as_issue         = NULL;
-                      g_autoptr (BzIssue) issue = NULL;
-
-                      as_issue = g_ptr_array_index (as_issues, j);
-
-                      issue = g_object_new (
-                          BZ_TYPE_ISSUE,
-                          "id", as_issue_get_id (as_issue),
-                          "url", as_issue_get_url (as_issue),
-                          NULL);
-                      g_list_store_append (issues, issue);
-                    }
-                }
-
-              release = g_object_new (
-                  BZ_TYPE_RELEASE,
-                  "description", release_description,
-                  "issues", issues,
-                  "timestamp", as_release_get_timestamp (as_release),
-                  "url", as_release_get_url (as_release, AS_RELEASE_URL_KIND_DETAILS),
-                  "version", as_release_get_version (as_release),
-                  NULL);
-              g_list_store_append (version_history, release);
-            }
-        }
-
       icons = as_component_get_icons (component);
       if (icons != NULL)
         {
           g_autofree char *select          = NULL;
           gboolean         select_is_local = FALSE;
-          int              select_width    = 0;
-          int              select_height   = 0;
+          int              select_size     = 0;
 
+          /* Cached local icons always win over remote ones,
+           * then the smallest icon covering the display size
+           */
           for (guint i = 0; i < icons->len; i++)
             {
               AsIcon  *icon     = NULL;
               int      width    = 0;
               int      height   = 0;
+              int      scale    = 0;
+              int      size     = 0;
               gboolean is_local = FALSE;
 
               icon     = g_ptr_array_index (icons, i);
               width    = as_icon_get_width (icon);
               height   = as_icon_get_height (icon);
+              scale    = MAX (as_icon_get_scale (icon), 1);
+              size     = MAX (width, height) * scale;
               is_local = as_icon_get_kind (icon) != AS_ICON_KIND_REMOTE;
 
-              if (select == NULL ||
-                  (is_local && !select_is_local) ||
-                  (width > select_width && height > select_height))
+              if (select_is_local && !is_local)
+                continue;
+              if (select != NULL &&
+                  is_local == select_is_local &&
+                  !size_fits_better (size, select_size, ICON_TARGET_SIZE))
+                continue;
+
+              if (is_local)
                 {
-                  if (is_local)
-                    {
-                      const char      *filename   = NULL;
-                      g_autofree char *resolution = NULL;
-                      g_autofree char *path       = NULL;
-
-                      filename = as_icon_get_filename (icon);
-                      if (filename == NULL)
-                        continue;
-
-                      resolution = g_strdup_printf ("%dx%d", width, height);
-                      path       = g_build_filename (
-                          appstream_dir,
-                          "icons",
-                          "flatpak",
-                          resolution,
-                          filename,
-                          NULL);
-                      if (!g_file_test (path, G_FILE_TEST_EXISTS))
-                        continue;
-
-                      g_clear_pointer (&select, g_free);
-                      select          = g_steal_pointer (&path);
-                      select_is_local = TRUE;
-                      select_width    = width;
-                      select_height   = height;
-                    }
+                  const char      *filename   = NULL;
+                  g_autofree char *resolution = NULL;
+                  g_autofree char *path       = NULL;
+
+                  filename = as_icon_get_filename (icon);
+                  if (filename == NULL)
+                    continue;
+
+                  if (scale > 1)
+                    resolution = g_strdup_printf ("%dx%d@%d", width, height, scale);
                   else
-                    {
-                      const char *url = NULL;
-
-                      url = as_icon_get_url (icon);
-                      if (url == NULL)
-                        continue;
-
-                      g_clear_pointer (&select, g_free);
-                      select          = g_strdup (url);
-                      select_is_local = FALSE;
-                      select_width    = width;
-                      select_height   = height;
-                    }
+                    resolution = g_strdup_printf ("%dx%d", width, height);
+                  path = g_build_filename (
+                      appstream_dir,
+                      "icons",
+                      "flatpak",
+                      resolution,
+                      filename,
+                      NULL);
+                  if (!g_file_test (path, G_FILE_TEST_EXISTS))
+                    continue;
+
+                  g_clear_pointer (&select, g_free);
+                  select          = g_steal_pointer (&path);
+                  select_is_local = TRUE;
+                  select_size     = size;
+                }
+              else
+                {
+                  const char *url = NULL;
+
+                  url = as_icon_get_url (icon);
+                  if (url == NULL)
+                    continue;
+
+                  g_clear_pointer (&select, g_free);
+                  select          = g_strdup (url);
+                  select_is_local = FALSE;
+                  select_size     = size;
                 }
             }
 
@@ -793,7 +748,6 @@ bz_flatpak_entry_new_for_ref (BzFlatpakInstance *instance,
       "title", title,
       "eol", eol,
       "description", description,
-      "long-description", long_description,
       "remote-repo-name", remote_name,
       "url", project_url,
       "size", download_size,
@@ -807,18 +761,35 @@ bz_flatpak_entry_new_for_ref (BzFlatpakInstance *instance,
       "developer-id", developer_id,
       "icon-paintable", icon_paintable,
       "mini-icon", mini_icon,
-      "screenshot-paintables", screenshot_paintables,
-      "share-urls", share_urls,
       "donation-url", donation_url,
       "forge-url", forge_url,
       "reviews", native_reviews,
       "average-rating", average_rating,
       "ratings-summary", ratings_summary,
-      "version-history", version_history,
       "light-accent-color", accent_color_light,
       "dark-accent-color", accent_color_dark,
       NULL);
 
+  /* Only a small fraction of entries is ever
+   * opened, so postpone the expensive parts
+   */
+  if (component_xml != NULL)
+    self->deferred_xml = g_strdup (component_xml);
+  else if (component != NULL)
+    {
+      g_autoptr (HeavyFieldsData) fields = NULL;
+
+      fields = build_heavy_fields (
+          bz_entry_get_id (BZ_ENTRY (self)),
+          bz_entry_get_unique_id_checksum (BZ_ENTRY (self)),
+          bz_entry_get_remote_repo_name (BZ_ENTRY (self)),
+          bz_entry_is_of_kinds (BZ_ENTRY (self), BZ_ENTRY_KIND_APPLICATION),
+          component, error);
+      if (fields == NULL)
+        return NULL;
+      apply_heavy_fields (self, fields);
+    }
+
   return g_steal_pointer (&self);
 }
 
@@ -1101,6 +1072,327 @@ append_markup_escaped (GString    *string,
   g_string_append (string, escaped);
 }
 
+static inline gboolean
+size_fits_better (int candidate,
+                  int current,
+                  int target)
+{
+  /* Unknown sizes (zero) lose to known ones */
+  if (current <= 0)
+    return candidate > 0;
+  if (candidate >= target && current >= target)
+    return candidate < current;
+  if (candidate >= target || current >= target)
+    return candidate >= target;
+  return candidate > current;
+}
+
+/* Only touches @component and what is passed in,
+ * so this is safe to run off the main thread */
+static HeavyFieldsData *
+build_heavy_fields (const char  *id,
+                    const char  *unique_id_checksum,
+                    const char  *remote_name,
+                    gboolean     is_application,
+                    AsComponent *component,
+                    GError     **error)
+{
+  g_autofree char *module_dir                  = NULL;
+  const char      *long_description_raw        = NULL;
+  g_autofree char *long_description            = NULL;
+  GPtrArray       *screenshots                 = NULL;
+  g_autoptr (GListStore) screenshot_paintables = NULL;
+  g_autoptr (GListStore) share_urls            = NULL;
+  AsReleaseList *releases                      = NULL;
+  GPtrArray     *releases_arr                  = NULL;
+  g_autoptr (GListStore) version_history       = NULL;
+  g_autoptr (HeavyFieldsData) fields           = NULL;
+
+  module_dir = bz_dup_module_dir ();
+
+  long_description_raw = as_component_get_description (component);
+  long_description     = parse_appstream_to_markdown (long_description_raw, error);
+  if (long_description_raw != NULL && long_description == NULL)
+    return NULL;
+
+  screenshots = as_component_get_screenshots_all (component);
+  if (screenshots != NULL)
+    {
+      screenshot_paintables = g_list_store_new (BZ_TYPE_ASYNC_TEXTURE);
+
+      for (guint i = 0; i < screenshots->len; i++)
+        {
+          AsScreenshot *screenshot           = NULL;
+          GPtrArray    *images               = NULL;
+          AsImage      *source_image         = NULL;
+          g_autoptr (GFile) screenshot_file  = NULL;
+          g_autofree char *cache_basename    = NULL;
+          g_autoptr (GFile) cache_file       = NULL;
+          g_autoptr (BzAsyncTexture) texture = NULL;
+
+          screenshot = g_ptr_array_index (screenshots, i);
+          images     = as_screenshot_get_images_all (screenshot);
+
+          /* The source image is only fetched for sizes no
+           * thumbnail covers, like the fullscreen viewer
+           */
+          for (guint j = 0; j < images->len; j++)
+            {
+              AsImage *image_obj = g_ptr_array_index (images, j);
+
+              if (as_image_get_url (image_obj) == NULL)
+                continue;
+              if (as_image_get_kind (image_obj) == AS_IMAGE_KIND_SOURCE)
+                {
+                  source_image = image_obj;
+                  break;
+                }
+              if (source_image == NULL)
+                source_image = image_obj;
+            }
+          if (source_image == NULL)
+            continue;
+
+          screenshot_file = g_file_new_for_uri (as_image_get_url (source_image));
+          cache_basename  = g_strdup_printf ("screenshot_%d.png", i);
+          cache_file      = g_file_new_build_filename (
+              module_dir, unique_id_checksum, cache_basename, NULL);
+          texture = bz_async_texture_new_lazy (screenshot_file, cache_file);
+
+          for (guint j = 0; j < images->len; j++)
+            {
+              AsImage         *image_obj          = NULL;
+              const char      *url                = NULL;
+              int              size               = 0;
+              g_autoptr (GFile) thumbnail_file    = NULL;
+              g_autofree char *thumbnail_basename = NULL;
+              g_autoptr (GFile) thumbnail_cache   = NULL;
+
+              image_obj = g_ptr_array_index (images, j);
+              url       = as_image_get_url (image_obj);
+              size      = MAX (as_image_get_width (image_obj),
+                               as_image_get_height (image_obj));
+              if (image_obj == source_image ||
+                  url == NULL ||
+                  size <= 0 ||
+                  as_image_get_kind (image_obj) != AS_IMAGE_KIND_THUMBNAIL)
+                continue;
+
+              thumbnail_file     = g_file_new_for_uri (url);
+              thumbnail_basename = g_strdup_printf ("screenshot_%d-%dpx.png", i, size);
+              thumbnail_cache    = g_file_new_build_filename (
+                  module_dir, unique_id_checksum, thumbnail_basename, NULL);
+              bz_async_texture_add_variant (texture, thumbnail_file, thumbnail_cache, size);
+            }
+
+          g_list_store_append (screenshot_paintables, texture);
+        }
+    }
+
+  share_urls = g_list_store_new (BZ_TYPE_URL);
+  if (is_application &&
+      g_strcmp0 (remote_name, "flathub") == 0)
+    {
+      g_autofree char *flathub_url = NULL;
+      g_autoptr (BzUrl) url        = NULL;
+
+      flathub_url = g_strdup_printf ("https://flathub.org/apps/%s", id);
+
+      url = bz_url_new ();
+      bz_url_set_name (url, C_ ("Project URL Type", "Flathub Page"));
+      bz_url_set_url (url, flathub_url);
+
+      g_list_store_append (share_urls, url);
+    }
+
+  for (int e = AS_URL_KIND_UNKNOWN + 1; e < AS_URL_KIND_LAST; e++)
+    {
+      const char *url = NULL;
+
+      url = as_component_get_url (component, e);
+      if (url != NULL)
+        {
+          const char *enum_string     = NULL;
+          g_autoptr (BzUrl) share_url = NULL;
+
+          switch (e)
+            {
+            case AS_URL_KIND_HOMEPAGE:
+              enum_string = C_ ("Project URL Type", "Homepage");
+              break;
+            case AS_URL_KIND_BUGTRACKER:
+              enum_string = C_ ("Project URL Type", "Issue Tracker");
+              break;
+            case AS_URL_KIND_FAQ:
+              enum_string = C_ ("Project URL Type", "FAQ");
+              break;
+            case AS_URL_KIND_HELP:
+              enum_string = C_ ("Project URL Type", "Help");
+              break;
+            case AS_URL_KIND_DONATION:
+              enum_string = C_ ("Project URL Type", "Donate");
+              break;
+            case AS_URL_KIND_TRANSLATE:
+              enum_string = C_ ("Project URL Type", "Translate");
+              break;
+            case AS_URL_KIND_CONTACT:
+              enum_string = C_ ("Project URL Type", "Contact");
+              break;
+            case AS_URL_KIND_VCS_BROWSER:
+              enum_string = C_ ("Project URL Type", "Source Code");
+              break;
+            case AS_URL_KIND_CONTRIBUTE:
+              enum_string = C_ ("Project URL Type", "Contribute");
+              break;
+            default:
+              break;
+            }
+
+          share_url = g_object_new (
+              BZ_TYPE_URL,
+              "name", enum_string,
+              "url", url,
+              NULL);
+          g_list_store_append (share_urls, share_url);
+        }
+    }
+  if (g_list_model_get_n_items (G_LIST_MODEL (share_urls)) == 0)
+    g_clear_object (&share_urls);
+
+  releases = as_component_load_releases (component, TRUE, error);
+  if (releases == NULL)
+    return NULL;
+  releases_arr = as_release_list_get_entries (releases);
+  if (releases_arr != NULL)
+    {
+      version_history = g_list_store_new (BZ_TYPE_RELEASE);
+
+      for (guint i = 0; i < releases_arr->len; i++)
+        {
+          AsRelease       *as_release              = NULL;
+          GPtrArray       *as_issues               = NULL;
+          const char      *release_description_raw = NULL;
+          g_autofree char *release_description     = NULL;
+          g_autoptr (GListStore) issues            = NULL;
+          g_autoptr (BzRelease) release            = NULL;
+
+          as_release = g_ptr_array_index (releases_arr, i);
+          as_issues  = as_release_get_issues (as_release);
+
+          release_description_raw = as_release_get_description (as_release);
+          release_description     = parse_appstream_to_markdown (release_description_raw, NULL);
+
+          if (as_issues != NULL && as_issues->len > 0)
+            {
+              issues = g_list_store_new (BZ_TYPE_ISSUE);
+
+              for (guint j = 0; j < as_issues->len; j++)
+                {
+                  AsIssue *as_issue         = NULL;
+                  g_autoptr (BzIssue) issue = NULL;
+
+                  as_issue = g_ptr_array_index (as_issues, j);
+
+                  issue = g_object_new (
+                      BZ_TYPE_ISSUE,
+                      "id", as_issue_get_id (as_issue),
+                      "url", as_issue_get_url (as_issue),
+                      NULL);
+                  g_list_store_append (issues, issue);
+                }
+            }
+
+          release = g_object_new (
+              BZ_TYPE_RELEASE,
+              "description", release_description,
+              "issues", issues,
+              "timestamp", as_release_get_timestamp (as_release),
+              "url", as_release_get_url (as_release, AS_RELEASE_URL_KIND_DETAILS),
+              "version", as_release_get_version (as_release),
+              NULL);
+          g_list_store_append (version_history, release);
+        }
+    }
+
+  fields                        = heavy_fields_data_new ();
+  fields->long_description      = g_steal_pointer (&long_description);
+  fields->screenshot_paintables = g_steal_pointer (&screenshot_paintables);
+  fields->share_urls            = g_steal_pointer (&share_urls);
+  fields->version_history       = g_steal_pointer (&version_history);
+
+  return g_steal_pointer (&fields);
+}
+
+static void
+apply_heavy_fields (BzFlatpakEntry  *self,
+                    HeavyFieldsData *fields)
+{
+  g_object_set (
+      self,
+      "long-description", fields->long_description,
+      "screenshot-paintables", fields->screenshot_paintables,
+      "share-urls", fields->share_urls,
+      "version-history", fields->version_history,
+      NULL);
+
+  /* Only drop the xml once the fields are in place, so a
+   * concurrent serialize always sees one or the other */
+  g_mutex_lock (&self->mutex);
+  g_clear_pointer (&self->deferred_xml, g_free);
+  g_mutex_unlock (&self->mutex);
+}
+
+static DexFuture *
+load_deferred_fiber (LoadDeferredData *data)
+{
+  g_autoptr (GError) local_error  = NULL;
+  g_autoptr (AsMetadata) metadata = NULL;
+  gboolean     result             = FALSE;
+  AsComponent *component          = NULL;
+
+  metadata = as_metadata_new ();
+  result   = as_metadata_parse_data (
+      metadata, data->xml, -1, AS_FORMAT_KIND_XML, &local_error);
+  if (!result)
+    {
+      g_warning ("Failed to parse deferred appstream data for %s: %s",
+                 data->unique_id, local_error->message);
+      return dex_future_new_for_error (g_steal_pointer (&local_error));
+    }
+
+  component = as_metadata_get_component (metadata);
+  if (component == NULL)
+    return dex_future_new_true ();
+
+  data->result = build_heavy_fields (
+      data->id,
+      data->unique_id_checksum,
+      data->remote_name,
+      data->is_application,
+      component,
+      &local_error);
+  if (data->result == NULL)
+    {
+      g_warning ("Failed to load appstream data for %s: %s",
+                 data->unique_id, local_error->message);
+      return dex_future_new_for_error (g_steal_pointer (&local_error));
+    }
+
+  return dex_scheduler_spawn (
+      dex_scheduler_get_default (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) load_deferred_notify,
+      load_deferred_data_ref (data),
+      load_deferred_data_unref);
+}
+
+static DexFuture *
+load_deferred_notify (LoadDeferredData *data)
+{
+  apply_heavy_fields (data->self, data->result);
+  return dex_future_new_true ();
+}
+
 static void
 clear_entry (BzFlatpakEntry *self)
 {
@@ -1110,4 +1402,8 @@ clear_entry (BzFlatpakEntry *self)
   g_clear_pointer (&self->application_command, g_free);
   g_clear_pointer (&self->runtime_name, g_free);
   g_clear_pointer (&self->addon_extension_of_ref, g_free);
+
+  g_mutex_lock (&self->mutex);
+  g_clear_pointer (&self->deferred_xml, g_free);
+  g_mutex_unlock (&self->mutex);
 }
@@ -21,6 +21,15 @@
 #define G_LOG_DOMAIN  "BAZAAR::FLATPAK"
 #define BAZAAR_MODULE "flatpak"
 
+/* Lives outside of the module dir since that
+ * is discarded every time an instance is made
+ */
+#define REMOTE_SYNC_CACHE_DIR "remote-sync"
+
+/* Cap on how often progress is forwarded to the
+ * transaction channel, roughly a display refresh */
+#define PROGRESS_INTERVAL_USEC (G_USEC_PER_SEC / 30)
+
 #include <xmlb.h>
 
 #include "bz-backend-notification.h"
@@ -55,6 +64,8 @@ struct _BzFlatpakInstance
 
   GPtrArray *notif_channels;
   GMutex     notif_mutex;
+
+  guint remote_sync_window;
 };
 
 static void
@@ -168,7 +179,14 @@ BZ_DEFINE_DATA (
       GPtrArray         *send_futures;
       GHashTable        *ref_to_entry_hash;
       GHashTable        *op_to_progress_hash;
+      int                progress_sum;
       guint              unidentified_op_cnt;
+      GHashTable        *pending_progress;
+      gint64             last_progress_flush;
+      DexFuture         *progress_send;
+      GHashTable        *errored;
+      GHashTable        *scheduled;
+      GHashTable        *finished;
     },
     g_mutex_clear (&self->mutex);
     BZ_RELEASE_DATA (cancellable, g_object_unref);
@@ -178,22 +196,58 @@ BZ_DEFINE_DATA (
     BZ_RELEASE_DATA (channel, dex_unref);
     BZ_RELEASE_DATA (send_futures, g_ptr_array_unref);
     BZ_RELEASE_DATA (ref_to_entry_hash, g_hash_table_unref);
-    BZ_RELEASE_DATA (op_to_progress_hash, g_hash_table_unref));
+    BZ_RELEASE_DATA (op_to_progress_hash, g_hash_table_unref);
+    BZ_RELEASE_DATA (pending_progress, g_hash_table_unref);
+    BZ_RELEASE_DATA (progress_send, dex_unref);
+    BZ_RELEASE_DATA (errored, g_hash_table_unref);
+    BZ_RELEASE_DATA (scheduled, g_hash_table_unref);
+    BZ_RELEASE_DATA (finished, g_hash_table_unref));
 static DexFuture *
 transaction_fiber (TransactionData *data);
 
+/* Everything scheduled for one installation */
 BZ_DEFINE_DATA (
     transaction_job,
     TransactionJob,
     {
       TransactionData    *parent;
       FlatpakTransaction *transaction;
+      GPtrArray          *entries;
     },
     BZ_RELEASE_DATA (parent, transaction_data_unref);
-    BZ_RELEASE_DATA (transaction, g_object_unref));
+    BZ_RELEASE_DATA (transaction, g_object_unref);
+    BZ_RELEASE_DATA (entries, g_ptr_array_unref));
 static DexFuture *
 transaction_job_fiber (TransactionJobData *data);
 
+typedef enum
+{
+  PLAN_INSTALL,
+  PLAN_UPDATE,
+  PLAN_REMOVAL,
+} PlanKind;
+
+static void
+plan_ops (TransactionData     *data,
+          GPtrArray           *entries,
+          PlanKind             kind,
+          TransactionJobData **user_job,
+          TransactionJobData **system_job);
+
+static void
+fail_entry (TransactionData *data,
+            BzFlatpakEntry  *entry,
+            GError          *error);
+
+static void
+set_op_progress (TransactionData *data,
+                 gpointer         op,
+                 int              progress);
+
+static void
+flush_progress (TransactionData *data,
+                gboolean         force);
+
 static void
 transaction_new_operation (FlatpakTransaction          *object,
                            FlatpakTransactionOperation *operation,
@@ -247,6 +301,15 @@ cmp_rref (FlatpakRemoteRef *a,
           FlatpakRemoteRef *b,
           GHashTable       *hash);
 
+static gboolean
+remote_sync_is_fresh (FlatpakInstallation *installation,
+                      FlatpakRemote       *remote,
+                      guint                window);
+
+static void
+record_remote_sync (FlatpakInstallation *installation,
+                    FlatpakRemote       *remote);
+
 static void
 bz_flatpak_instance_dispose (GObject *object)
 {
@@ -448,6 +511,10 @@ bz_flatpak_instance_schedule_transaction (BzBackend    *backend,
   data->send_futures        = g_ptr_array_new_with_free_func (dex_unref);
   data->ref_to_entry_hash   = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
   data->op_to_progress_hash = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
+  data->pending_progress    = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, g_object_unref);
+  data->errored             = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, (GDestroyNotify) g_error_free);
+  data->scheduled           = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
+  data->finished            = g_hash_table_new_full (g_direct_hash, g_direct_equal, g_object_unref, NULL);
 
   return dex_scheduler_spawn (
       self->scheduler,
@@ -536,6 +603,21 @@ bz_flatpak_instance_ensure_has_flathub (BzFlatpakInstance *self,
       ensure_flathub_data_ref (data), ensure_flathub_data_unref);
 }
 
+guint
+bz_flatpak_instance_get_remote_sync_window (BzFlatpakInstance *self)
+{
+  g_return_val_if_fail (BZ_IS_FLATPAK_INSTANCE (self), 0);
+  return g_atomic_int_get (&self->remote_sync_window);
+}
+
+void
+bz_flatpak_instance_set_remote_sync_window (BzFlatpakInstance *self,
+                                            guint              seconds)
+{
+  g_return_if_fail (BZ_IS_FLATPAK_INSTANCE (self));
+  g_atomic_int_set (&self->remote_sync_window, seconds);
+}
+
 static DexFuture *
 init_fiber (InitData *data)
 {
@@ -830,6 +912,7 @@ load_local_ref_fiber (LoadLocalRefData *data)
       NULL,
       NULL,
       NULL,
+      NULL,
       &local_error);
   if (entry == NULL)
     return dex_future_new_reject (
@@ -1047,41 +1130,53 @@ retrieve_refs_for_remote_fiber (RetrieveRefsForRemoteData *data)
   g_autoptr (AsMetadata) metadata         = NULL;
   AsComponentBox *components              = NULL;
   g_autoptr (GHashTable) component_hash   = NULL;
+  g_autoptr (GHashTable) xml_hash         = NULL;
   // g_autofree char *remote_icon_name       = NULL;
   g_autoptr (GdkPaintable) remote_icon = NULL;
   g_autoptr (GPtrArray) refs           = NULL;
 
   remote_name = flatpak_remote_get_name (remote);
 
-  result = flatpak_installation_update_remote_sync (
-      installation,
-      remote_name,
-      cancellable,
-      &local_error);
-  if (!result)
-    return dex_future_new_reject (
-        BZ_FLATPAK_ERROR,
-        BZ_FLATPAK_ERROR_REMOTE_SYNCHRONIZATION_FAILURE,
-        "Failed to synchronize remote '%s': %s",
-        remote_name,
-        local_error->message);
+  if (remote_sync_is_fresh (
+          installation, remote,
+          bz_flatpak_instance_get_remote_sync_window (instance)))
+    g_debug ("Remote '%s' was synchronized recently and its local "
+             "appstream data is unchanged, skipping synchronization",
+             remote_name);
+  else
+    {
+      result = flatpak_installation_update_remote_sync (
+          installation,
+          remote_name,
+          cancellable,
+          &local_error);
+      if (!result)
+        return dex_future_new_reject (
+            BZ_FLATPAK_ERROR,
+            BZ_FLATPAK_ERROR_REMOTE_SYNCHRONIZATION_FAILURE,
+            "Failed to synchronize remote '%s': %s",
+            remote_name,
+            local_error->message);
 
-  result = flatpak_installation_update_appstream_full_sync (
-      installation,
-      remote_name,
-      NULL,
-      (FlatpakProgressCallback) gather_refs_update_progress,
-      data,
-      NULL,
-      cancellable,
-      &local_error);
-  if (!result)
-    return dex_future_new_reject (
-        BZ_FLATPAK_ERROR,
-        BZ_FLATPAK_ERROR_REMOTE_SYNCHRONIZATION_FAILURE,
-        "Failed to synchronize appstream data for remote '%s': %s",
-        remote_name,
-        local_error->message);
+      result = flatpak_installation_update_appstream_full_sync (
+          installation,
+          remote_name,
+          NULL,
+          (FlatpakProgressCallback) gather_refs_update_progress,
+          data,
+          NULL,
+          cancellable,
+          &local_error);
+      if (!result)
+        return dex_future_new_reject (
+            BZ_FLATPAK_ERROR,
+            BZ_FLATPAK_ERROR_REMOTE_SYNCHRONIZATION_FAILURE,
+            "Failed to synchronize appstream data for remote '%s': %s",
+            remote_name,
+            local_error->message);
+
+      record_remote_sync (installation, remote);
+    }
 
   appstream_dir = flatpak_remote_get_appstream_dir (remote, NULL);
   if (appstream_dir == NULL)
@@ -1150,11 +1245,13 @@ retrieve_refs_for_remote_fiber (RetrieveRefsForRemoteData *data)
   root     = xb_silo_get_root (silo);
   children = xb_node_get_children (root);
   metadata = as_metadata_new ();
+  xml_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 
   for (guint i = 0; i < children->len; i++)
     {
       XbNode          *component_node = NULL;
       g_autofree char *component_xml  = NULL;
+      const char      *component_id   = NULL;
 
       component_node = g_ptr_array_index (children, i);
 
@@ -1182,6 +1279,13 @@ retrieve_refs_for_remote_fiber (RetrieveRefsForRemoteData *data)
             appstream_xml_path,
             remote_name,
             local_error->message);
+
+      /* Entries keep the plain xml around to build
+       * their heavy fields once they are first shown
+       */
+      component_id = xb_node_query_text (component_node, "id", NULL);
+      if (component_id != NULL && !g_hash_table_contains (xml_hash, component_id))
+        g_hash_table_replace (xml_hash, g_strdup (component_id), g_steal_pointer (&component_xml));
     }
 
   components     = as_metadata_get_components (metadata);
@@ -1299,18 +1403,21 @@ retrieve_refs_for_remote_fiber (RetrieveRefsForRemoteData *data)
       FlatpakRemoteRef *rref               = NULL;
       const char       *name               = NULL;
       AsComponent      *component          = NULL;
+      const char       *component_xml      = NULL;
       g_autoptr (BzFlatpakEntry) entry     = NULL;
       g_autoptr (DexFuture) channel_future = NULL;
 
-      rref      = g_ptr_array_index (refs, i);
-      name      = flatpak_ref_get_name (FLATPAK_REF (rref));
-      component = g_hash_table_lookup (component_hash, name);
+      rref          = g_ptr_array_index (refs, i);
+      name          = flatpak_ref_get_name (FLATPAK_REF (rref));
+      component     = g_hash_table_lookup (component_hash, name);
+      component_xml = g_hash_table_lookup (xml_hash, name);
       if (component == NULL)
         {
           g_autofree char *desktop_id = NULL;
 
-          desktop_id = g_strdup_printf ("%s.desktop", name);
-          component  = g_hash_table_lookup (component_hash, desktop_id);
+          desktop_id    = g_strdup_printf ("%s.desktop", name);
+          component     = g_hash_table_lookup (component_hash, desktop_id);
+          component_xml = g_hash_table_lookup (xml_hash, desktop_id);
         }
 
       entry = bz_flatpak_entry_new_for_ref (
@@ -1319,6 +1426,7 @@ retrieve_refs_for_remote_fiber (RetrieveRefsForRemoteData *data)
           remote,
           FLATPAK_REF (rref),
           component,
+          component_xml,
           appstream_dir_path,
           remote_icon,
           NULL);
@@ -1466,298 +1574,272 @@ retrieve_updates_fiber (GatherRefsData *data)
 static DexFuture *
 transaction_fiber (TransactionData *data)
 {
-  GCancellable      *cancellable     = data->cancellable;
-  BzFlatpakInstance *instance        = data->instance;
-  GPtrArray         *installations   = data->installs;
-  GPtrArray         *updates         = data->updates;
-  GPtrArray         *removals        = data->removals;
-  DexChannel        *channel         = data->channel;
-  g_autoptr (GError) local_error     = NULL;
-  gboolean result                    = FALSE;
-  g_autoptr (GPtrArray) transactions = NULL;
-  g_autoptr (GPtrArray) entries      = NULL;
-  g_autoptr (GPtrArray) jobs         = NULL;
-  g_autoptr (GHashTable) errored     = NULL;
-
-  transactions = g_ptr_array_new_with_free_func (g_object_unref);
-  entries      = g_ptr_array_new_with_free_func (g_object_unref);
-
-  if (installations != NULL)
-    {
-      for (guint i = 0; i < installations->len; i++)
-        {
-          BzFlatpakEntry  *entry                     = NULL;
-          FlatpakRef      *ref                       = NULL;
-          gboolean         is_user                   = FALSE;
-          g_autofree char *ref_fmt                   = NULL;
-          g_autoptr (FlatpakTransaction) transaction = NULL;
+  BzFlatpakInstance *instance                = data->instance;
+  DexChannel        *channel                 = data->channel;
+  g_autoptr (TransactionJobData) user_job    = NULL;
+  g_autoptr (TransactionJobData) system_job  = NULL;
+  g_autoptr (GPtrArray) jobs                 = NULL;
+  g_autoptr (GHashTable) errored             = NULL;
+
+  /* Fold everything for an installation into one
+   * transaction, so runtimes shared between entries
+   * are resolved and pulled once and only a single
+   * transaction contends for each repo lock
+   */
+  plan_ops (data, data->installs, PLAN_INSTALL, &user_job, &system_job);
+  plan_ops (data, data->updates, PLAN_UPDATE, &user_job, &system_job);
+  plan_ops (data, data->removals, PLAN_REMOVAL, &user_job, &system_job);
 
-          entry   = g_ptr_array_index (installations, i);
-          ref     = bz_flatpak_entry_get_ref (entry);
-          is_user = bz_flatpak_entry_is_user (BZ_FLATPAK_ENTRY (entry));
-          ref_fmt = flatpak_ref_format_ref (ref);
+  jobs = g_ptr_array_new_with_free_func (dex_unref);
+  if (user_job != NULL)
+    g_ptr_array_add (
+        jobs,
+        dex_scheduler_spawn (
+            instance->scheduler,
+            bz_get_dex_stack_size (),
+            (DexFiberFunc) transaction_job_fiber,
+            transaction_job_data_ref (user_job),
+            transaction_job_data_unref));
+  if (system_job != NULL)
+    g_ptr_array_add (
+        jobs,
+        dex_scheduler_spawn (
+            instance->scheduler,
+            bz_get_dex_stack_size (),
+            (DexFiberFunc) transaction_job_fiber,
+            transaction_job_data_ref (system_job),
+            transaction_job_data_unref));
+
+  /* Failures were already attributed to their
+   * entries by the jobs themselves
+   */
+  if (jobs->len > 0)
+    dex_await (dex_future_allv (
+                   (DexFuture *const *) jobs->pdata,
+                   jobs->len),
+               NULL);
 
-          if ((is_user && instance->user == NULL) ||
-              (!is_user && instance->system == NULL))
-            {
-              dex_channel_close_send (channel);
-              return dex_future_new_reject (
-                  BZ_FLATPAK_ERROR,
-                  BZ_FLATPAK_ERROR_TRANSACTION_FAILURE,
-                  "Failed to append the update of %s to transaction "
-                  "because its installation couldn't be found",
-                  ref_fmt);
-            }
+  g_mutex_lock (&data->mutex);
+  flush_progress (data, TRUE);
+  g_mutex_unlock (&data->mutex);
+  /* Settled sends are pruned as progress is
+   * flushed, so there may be none left
+   */
+  if (data->send_futures->len > 0)
+    dex_await (dex_future_allv (
+                   (DexFuture *const *) data->send_futures->pdata,
+                   data->send_futures->len),
+               NULL);
 
-          transaction = flatpak_transaction_new_for_installation (
-              is_user
-                  ? instance->user
-                  : instance->system,
-              cancellable, &local_error);
-          if (transaction == NULL)
-            {
-              dex_channel_close_send (channel);
-              return dex_future_new_reject (
-                  BZ_FLATPAK_ERROR,
-                  BZ_FLATPAK_ERROR_TRANSACTION_FAILURE,
-                  "Failed to initialize potential transaction for system installation: %s",
-                  local_error->message);
-            }
+  g_mutex_lock (&data->mutex);
+  errored = g_steal_pointer (&data->errored);
+  g_mutex_unlock (&data->mutex);
 
-          result = flatpak_transaction_add_install (
-              transaction,
-              bz_entry_get_remote_repo_name (BZ_ENTRY (entry)),
-              ref_fmt,
-              NULL,
-              &local_error);
-          if (!result)
-            {
-              dex_channel_close_send (channel);
-              return dex_future_new_reject (
-                  BZ_FLATPAK_ERROR,
-                  BZ_FLATPAK_ERROR_TRANSACTION_FAILURE,
-                  "Failed to append the installation of %s to transaction: %s",
-                  ref_fmt,
-                  local_error->message);
-            }
+  dex_channel_close_send (channel);
+  return dex_future_new_take_boxed (G_TYPE_HASH_TABLE, g_steal_pointer (&errored));
+}
 
-          g_ptr_array_add (transactions, g_steal_pointer (&transaction));
-          g_ptr_array_add (entries, g_object_ref (entry));
-          g_hash_table_replace (data->ref_to_entry_hash,
-                                g_steal_pointer (&ref_fmt),
-                                g_object_ref (entry));
-        }
-    }
+static DexFuture *
+transaction_job_fiber (TransactionJobData *data)
+{
+  TransactionData    *parent      = data->parent;
+  FlatpakTransaction *transaction = data->transaction;
+  GCancellable       *cancellable = parent->cancellable;
+  g_autoptr (GError) local_error  = NULL;
+  gboolean result                 = FALSE;
+
+  /* Every op of this installation may have failed
+   * to be appended
+   */
+  if (flatpak_transaction_is_empty (transaction))
+    return dex_future_new_true ();
 
-  if (updates != NULL)
+  g_signal_connect (transaction, "new-operation", G_CALLBACK (transaction_new_operation), parent);
+  g_signal_connect (transaction, "operation-done", G_CALLBACK (transaction_operation_done), parent);
+  g_signal_connect (transaction, "operation-error", G_CALLBACK (transaction_operation_error), parent);
+  g_signal_connect (transaction, "ready", G_CALLBACK (transaction_ready), parent);
+
+  result = flatpak_transaction_run (transaction, cancellable, &local_error);
+  if (!result)
     {
-      for (guint i = 0; i < updates->len; i++)
+      gboolean resolved = FALSE;
+
+      /* Entries whose ops never got to run share the fate of
+       * the whole transaction. Once resolved, entries without
+       * an op (an update with nothing to do) are left alone
+       */
+      g_mutex_lock (&parent->mutex);
+      for (guint i = 0; i < data->entries->len && !resolved; i++)
+        resolved = g_hash_table_contains (
+            parent->scheduled, g_ptr_array_index (data->entries, i));
+
+      for (guint i = 0; i < data->entries->len; i++)
         {
-          BzFlatpakEntry  *entry                     = NULL;
-          FlatpakRef      *ref                       = NULL;
-          gboolean         is_user                   = FALSE;
-          g_autofree char *ref_fmt                   = NULL;
-          g_autoptr (FlatpakTransaction) transaction = NULL;
-
-          entry   = g_ptr_array_index (updates, i);
-          ref     = bz_flatpak_entry_get_ref (entry);
-          is_user = bz_flatpak_entry_is_user (BZ_FLATPAK_ENTRY (entry));
-          ref_fmt = flatpak_ref_format_ref (ref);
+          BzFlatpakEntry *entry = g_ptr_array_index (data->entries, i);
+
+          if (resolved && !g_hash_table_contains (parent->scheduled, entry))
+            continue;
+          if (!g_hash_table_contains (parent->finished, entry))
+            fail_entry (
+                parent, entry,
+                g_error_new (
+                    BZ_FLATPAK_ERROR,
+                    BZ_FLATPAK_ERROR_TRANSACTION_FAILURE,
+                    "Failed to run flatpak transaction: %s",
+                    local_error->message));
+        }
+      g_mutex_unlock (&parent->mutex);
 
-          if ((is_user && instance->user == NULL) ||
-              (!is_user && instance->system == NULL))
-            {
-              dex_channel_close_send (channel);
-              return dex_future_new_reject (
-                  BZ_FLATPAK_ERROR,
-                  BZ_FLATPAK_ERROR_TRANSACTION_FAILURE,
-                  "Failed to append the update of %s to transaction "
-                  "because its installation couldn't be found",
-                  ref_fmt);
-            }
+      return dex_future_new_reject (
+          BZ_FLATPAK_ERROR,
+          BZ_FLATPAK_ERROR_TRANSACTION_FAILURE,
+          "Failed to run flatpak transaction: %s",
+          local_error->message);
+    }
 
-          transaction = flatpak_transaction_new_for_installation (
-              is_user
-                  ? instance->user
-                  : instance->system,
-              cancellable, &local_error);
-          if (transaction == NULL)
-            {
-              dex_channel_close_send (channel);
-              return dex_future_new_reject (
-                  BZ_FLATPAK_ERROR,
-                  BZ_FLATPAK_ERROR_TRANSACTION_FAILURE,
-                  "Failed to initialize potential transaction for system installation: %s",
-                  local_error->message);
-            }
+  return dex_future_new_true ();
+}
 
-          result = flatpak_transaction_add_update (
-              transaction,
-              ref_fmt,
-              NULL,
-              NULL,
-              &local_error);
-          if (!result)
-            {
-              dex_channel_close_send (channel);
-              return dex_future_new_reject (
-                  BZ_FLATPAK_ERROR,
-                  BZ_FLATPAK_ERROR_TRANSACTION_FAILURE,
-                  "Failed to append the update of %s to transaction: %s",
-                  ref_fmt,
-                  local_error->message);
-            }
+static void
+plan_ops (TransactionData     *data,
+          GPtrArray           *entries,
+          PlanKind             kind,
+          TransactionJobData **user_job,
+          TransactionJobData **system_job)
+{
+  static const char *const verbs[] = {
+    [PLAN_INSTALL] = "installation",
+    [PLAN_UPDATE]  = "update",
+    [PLAN_REMOVAL] = "removal",
+  };
 
-          g_ptr_array_add (transactions, g_steal_pointer (&transaction));
-          g_ptr_array_add (entries, g_object_ref (entry));
-          g_hash_table_replace (data->ref_to_entry_hash,
-                                g_steal_pointer (&ref_fmt),
-                                g_object_ref (entry));
-        }
-    }
+  if (entries == NULL)
+    return;
 
-  if (removals != NULL)
+  for (guint i = 0; i < entries->len; i++)
     {
-      for (guint i = 0; i < removals->len; i++)
+      BzFlatpakEntry      *entry         = NULL;
+      FlatpakRef          *ref           = NULL;
+      gboolean             is_user       = FALSE;
+      g_autofree char     *ref_fmt       = NULL;
+      FlatpakInstallation *installation  = NULL;
+      TransactionJobData **job           = NULL;
+      g_autoptr (GError) local_error     = NULL;
+      gboolean             result        = FALSE;
+
+      entry        = g_ptr_array_index (entries, i);
+      ref          = bz_flatpak_entry_get_ref (entry);
+      is_user      = bz_flatpak_entry_is_user (entry);
+      ref_fmt      = flatpak_ref_format_ref (ref);
+      installation = is_user ? data->instance->user : data->instance->system;
+      job          = is_user ? user_job : system_job;
+
+      if (installation == NULL)
         {
-          BzFlatpakEntry  *entry                     = NULL;
-          FlatpakRef      *ref                       = NULL;
-          gboolean         is_user                   = FALSE;
-          g_autofree char *ref_fmt                   = NULL;
-          g_autoptr (FlatpakTransaction) transaction = NULL;
-
-          entry   = g_ptr_array_index (removals, i);
-          ref     = bz_flatpak_entry_get_ref (entry);
-          is_user = bz_flatpak_entry_is_user (BZ_FLATPAK_ENTRY (entry));
-          ref_fmt = flatpak_ref_format_ref (ref);
-
-          if ((is_user && instance->user == NULL) ||
-              (!is_user && instance->system == NULL))
-            {
-              dex_channel_close_send (channel);
-              return dex_future_new_reject (
+          g_mutex_lock (&data->mutex);
+          fail_entry (
+              data, entry,
+              g_error_new (
                   BZ_FLATPAK_ERROR,
                   BZ_FLATPAK_ERROR_TRANSACTION_FAILURE,
-                  "Failed to append the removal of %s to transaction "
+                  "Failed to append the %s of %s to transaction "
                   "because its installation couldn't be found",
-                  ref_fmt);
-            }
+                  verbs[kind], ref_fmt));
+          g_mutex_unlock (&data->mutex);
+          continue;
+        }
+
+      if (*job == NULL)
+        {
+          g_autoptr (FlatpakTransaction) transaction = NULL;
 
           transaction = flatpak_transaction_new_for_installation (
-              is_user
-                  ? instance->user
-                  : instance->system,
-              cancellable, &local_error);
+              installation, data->cancellable, &local_error);
           if (transaction == NULL)
             {
-              dex_channel_close_send (channel);
-              return dex_future_new_reject (
-                  BZ_FLATPAK_ERROR,
-                  BZ_FLATPAK_ERROR_TRANSACTION_FAILURE,
-                  "Failed to initialize potential transaction for system installation: %s",
-                  local_error->message);
+              g_mutex_lock (&data->mutex);
+              fail_entry (
+                  data, entry,
+                  g_error_new (
+                      BZ_FLATPAK_ERROR,
+                      BZ_FLATPAK_ERROR_TRANSACTION_FAILURE,
+                      "Failed to initialize potential transaction for %s installation: %s",
+                      is_user ? "user" : "system",
+                      local_error->message));
+              g_mutex_unlock (&data->mutex);
+              continue;
             }
 
+          *job                = transaction_job_data_new ();
+          (*job)->parent      = transaction_data_ref (data);
+          (*job)->transaction = g_steal_pointer (&transaction);
+          (*job)->entries     = g_ptr_array_new_with_free_func (g_object_unref);
+        }
+
+      switch (kind)
+        {
+        case PLAN_INSTALL:
+          result = flatpak_transaction_add_install (
+              (*job)->transaction,
+              bz_entry_get_remote_repo_name (BZ_ENTRY (entry)),
+              ref_fmt,
+              NULL,
+              &local_error);
+          break;
+        case PLAN_UPDATE:
+          result = flatpak_transaction_add_update (
+              (*job)->transaction,
+              ref_fmt,
+              NULL,
+              NULL,
+              &local_error);
+          break;
+        case PLAN_REMOVAL:
           result = flatpak_transaction_add_uninstall (
-              transaction,
+              (*job)->transaction,
               ref_fmt,
               &local_error);
-          if (!result)
-            {
-              dex_channel_close_send (channel);
-              return dex_future_new_reject (
+          break;
+        default:
+          g_assert_not_reached ();
+        }
+
+      if (!result)
+        {
+          g_mutex_lock (&data->mutex);
+          fail_entry (
+              data, entry,
+              g_error_new (
                   BZ_FLATPAK_ERROR,
                   BZ_FLATPAK_ERROR_TRANSACTION_FAILURE,
-                  "Failed to append the removal of %s to transaction: %s",
-                  ref_fmt,
-                  local_error->message);
-            }
-
-          g_ptr_array_add (transactions, g_steal_pointer (&transaction));
-          g_ptr_array_add (entries, g_object_ref (entry));
-          g_hash_table_replace (data->ref_to_entry_hash,
-                                g_steal_pointer (&ref_fmt),
-                                g_object_ref (entry));
+                  "Failed to append the %s of %s to transaction: %s",
+                  verbs[kind], ref_fmt, local_error->message));
+          g_mutex_unlock (&data->mutex);
+          continue;
         }
-    }
-
-  jobs = g_ptr_array_new_with_free_func (dex_unref);
-  for (guint i = 0; i < transactions->len; i++)
-    {
-      FlatpakTransaction *transaction         = NULL;
-      g_autoptr (TransactionJobData) job_data = NULL;
-
-      transaction = g_ptr_array_index (transactions, i);
-
-      job_data              = transaction_job_data_new ();
-      job_data->parent      = transaction_data_ref (data);
-      job_data->transaction = g_object_ref (transaction);
-
-      g_ptr_array_add (
-          jobs,
-          dex_scheduler_spawn (
-              instance->scheduler,
-              bz_get_dex_stack_size (),
-              (DexFiberFunc) transaction_job_fiber,
-              transaction_job_data_ref (job_data),
-              transaction_job_data_unref));
-    }
 
-  dex_await (dex_future_all_racev (
-                 (DexFuture *const *) jobs->pdata,
-                 jobs->len),
-             NULL);
-  dex_await (dex_future_allv (
-                 (DexFuture *const *) data->send_futures->pdata,
-                 data->send_futures->len),
-             NULL);
-
-  errored = g_hash_table_new_full (
-      g_direct_hash, g_direct_equal,
-      g_object_unref, (GDestroyNotify) g_error_free);
-  for (guint i = 0; i < jobs->len; i++)
-    {
-      DexFuture *job   = NULL;
-      BzEntry   *entry = NULL;
-
-      job   = g_ptr_array_index (jobs, i);
-      entry = g_ptr_array_index (entries, i);
-
-      dex_future_get_value (job, &local_error);
-      if (local_error != NULL)
-        g_hash_table_replace (
-            errored,
-            g_object_ref (entry),
-            g_steal_pointer (&local_error));
+      g_ptr_array_add ((*job)->entries, g_object_ref (entry));
+      g_hash_table_replace (data->ref_to_entry_hash,
+                            g_steal_pointer (&ref_fmt),
+                            g_object_ref (entry));
     }
-
-  dex_channel_close_send (channel);
-  return dex_future_new_take_boxed (G_TYPE_HASH_TABLE, g_steal_pointer (&errored));
 }
 
-static DexFuture *
-transaction_job_fiber (TransactionJobData *data)
+/* Takes @error. The first failure of an entry is
+ * the one reported. Call with the mutex held
+ */
+static void
+fail_entry (TransactionData *data,
+            BzFlatpakEntry  *entry,
+            GError          *error)
 {
-  TransactionData    *parent      = data->parent;
-  FlatpakTransaction *transaction = data->transaction;
-  GCancellable       *cancellable = parent->cancellable;
-  g_autoptr (GError) local_error  = NULL;
-  gboolean result                 = FALSE;
-
-  g_signal_connect (transaction, "new-operation", G_CALLBACK (transaction_new_operation), parent);
-  g_signal_connect (transaction, "operation-done", G_CALLBACK (transaction_operation_done), parent);
-  g_signal_connect (transaction, "operation-error", G_CALLBACK (transaction_operation_error), parent);
-  g_signal_connect (transaction, "ready", G_CALLBACK (transaction_ready), parent);
-
-  result = flatpak_transaction_run (transaction, cancellable, &local_error);
-  if (!result)
-    return dex_future_new_reject (
-        BZ_FLATPAK_ERROR,
-        BZ_FLATPAK_ERROR_TRANSACTION_FAILURE,
-        "Failed to run flatpak transaction on user installation: %s",
-        local_error->message);
+  if (g_hash_table_contains (data->errored, entry))
+    {
+      g_error_free (error);
+      return;
+    }
 
-  return dex_future_new_true ();
+  g_hash_table_replace (data->errored, g_object_ref (entry), error);
 }
 
 static void
@@ -1793,6 +1875,7 @@ transaction_new_operation (FlatpakTransaction          *transaction,
           data->channel,
           dex_future_new_for_object (payload)));
   data->unidentified_op_cnt--;
+  set_op_progress (data, payload, 0);
   g_mutex_unlock (&data->mutex);
 
   g_object_set_data_full (
@@ -1821,6 +1904,7 @@ transaction_operation_done (FlatpakTransaction          *object,
                             TransactionData             *data)
 {
   FlatpakTransactionOperationType kind              = FLATPAK_TRANSACTION_OPERATION_LAST_TYPE;
+  BzFlatpakEntry *entry                             = NULL;
   g_autoptr (BzBackendTransactionOpPayload) payload = NULL;
 
   kind = flatpak_transaction_operation_get_operation_type (operation);
@@ -1838,13 +1922,24 @@ transaction_operation_done (FlatpakTransaction          *object,
       g_mutex_unlock (&data->instance->mute_mutex);
     }
 
+  payload = g_object_steal_data (G_OBJECT (operation), "payload");
+
   g_mutex_lock (&data->mutex);
-  g_hash_table_replace (
-      data->op_to_progress_hash,
-      g_object_ref (operation),
-      GINT_TO_POINTER (100));
+  if (payload != NULL)
+    set_op_progress (data, payload, 100);
+  /* Whatever was coalesced must land before the op
+   * is reported done */
+  flush_progress (data, TRUE);
+
+  /* Only the op for the entry itself counts,
+   * not the runtimes it pulled in
+   */
+  entry = g_hash_table_lookup (
+      data->ref_to_entry_hash,
+      flatpak_transaction_operation_get_ref (operation));
+  if (entry != NULL)
+    g_hash_table_add (data->finished, g_object_ref (entry));
 
-  payload = g_object_steal_data (G_OBJECT (operation), "payload");
   if (payload != NULL)
     g_ptr_array_add (
         data->send_futures,
@@ -1862,20 +1957,26 @@ transaction_operation_error (FlatpakTransaction          *object,
                              gint                         details,
                              TransactionData             *data)
 {
+  BzFlatpakEntry *entry                             = NULL;
   g_autoptr (BzBackendTransactionOpPayload) payload = NULL;
 
   /* `FLATPAK_TRANSACTION_ERROR_DETAILS_NON_FATAL` is the only
      possible value of `details` */
 
-  g_critical ("Transaction failed to complete: %s", error->message);
+  g_warning ("Transaction operation failed: %s", error->message);
+
+  payload = g_object_steal_data (G_OBJECT (operation), "payload");
 
   g_mutex_lock (&data->mutex);
-  g_hash_table_replace (
-      data->op_to_progress_hash,
-      g_object_ref (operation),
-      GINT_TO_POINTER (100));
+  if (payload != NULL)
+    set_op_progress (data, payload, 100);
+  flush_progress (data, TRUE);
+
+  /* A failed runtime lands on an entry that needed it */
+  entry = find_entry_from_operation (data, operation, NULL);
+  if (entry != NULL)
+    fail_entry (data, entry, g_error_copy (error));
 
-  payload = g_object_steal_data (G_OBJECT (operation), "payload");
   if (payload != NULL)
     {
       g_object_set_data_full (
@@ -1890,8 +1991,11 @@ transaction_operation_error (FlatpakTransaction          *object,
 
   g_mutex_unlock (&data->mutex);
 
-  /* Don't recover for now */
-  return FALSE;
+  /* The other entries sharing the transaction should
+   * not fail along with this one. Ops depending on
+   * the failed one are skipped by flatpak itself
+   */
+  return TRUE;
 }
 
 gboolean
@@ -1904,6 +2008,16 @@ transaction_ready (FlatpakTransaction *object,
 
   g_mutex_lock (&data->mutex);
   data->unidentified_op_cnt += g_list_length (operations);
+  for (GList *l = operations; l != NULL; l = l->next)
+    {
+      BzFlatpakEntry *entry = NULL;
+
+      entry = g_hash_table_lookup (
+          data->ref_to_entry_hash,
+          flatpak_transaction_operation_get_ref (l->data));
+      if (entry != NULL)
+        g_hash_table_add (data->scheduled, g_object_ref (entry));
+    }
   g_mutex_unlock (&data->mutex);
 
   return TRUE;
@@ -1966,39 +2080,13 @@ transaction_progress_changed (FlatpakTransactionProgress *progress,
 {
   TransactionData *parent                                   = data->parent;
   g_autoptr (BzBackendTransactionOpProgressPayload) payload = NULL;
-  int            int_progress                               = 0;
-  double         double_progress                            = 0.0;
-  GHashTableIter iter                                       = { 0 };
-  int            progress_sum                               = 0;
-  guint          n_ops                                      = 0;
-  double         total_progress                             = 0.0;
-
-  g_mutex_lock (&parent->mutex);
+  int int_progress                                          = 0;
 
-  int_progress    = flatpak_transaction_progress_get_progress (progress);
-  double_progress = (double) flatpak_transaction_progress_get_progress (progress) / 100.0;
-
-  g_hash_table_replace (
-      parent->op_to_progress_hash,
-      g_object_ref (data->op),
-      GINT_TO_POINTER (int_progress));
-
-  g_hash_table_iter_init (&iter, parent->op_to_progress_hash);
-  for (;;)
-    {
-      gpointer key = NULL;
-      gpointer val = NULL;
-
-      if (!g_hash_table_iter_next (&iter, &key, &val))
-        break;
-
-      progress_sum += GPOINTER_TO_INT (val);
-      n_ops++;
-    }
-  total_progress = MIN ((double) progress_sum /
-                            (double) ((n_ops + parent->unidentified_op_cnt) * 100),
-                        1.0);
+  int_progress = flatpak_transaction_progress_get_progress (progress);
 
+  /* libflatpak ticks far more often than anyone can
+   * look at, so only keep the latest snapshot per op
+   * and let `flush_progress` decide when to send */
   payload = bz_backend_transaction_op_progress_payload_new ();
   bz_backend_transaction_op_progress_payload_set_op (
       payload, data->op);
@@ -2007,23 +2095,103 @@ transaction_progress_changed (FlatpakTransactionProgress *progress,
   bz_backend_transaction_op_progress_payload_set_is_estimating (
       payload, flatpak_transaction_progress_get_is_estimating (progress));
   bz_backend_transaction_op_progress_payload_set_progress (
-      payload, double_progress);
-  bz_backend_transaction_op_progress_payload_set_total_progress (
-      payload, total_progress);
+      payload, (double) int_progress / 100.0);
   bz_backend_transaction_op_progress_payload_set_bytes_transferred (
       payload, flatpak_transaction_progress_get_bytes_transferred (progress));
   bz_backend_transaction_op_progress_payload_set_start_time (
       payload, flatpak_transaction_progress_get_start_time (progress));
 
-  g_ptr_array_add (
-      data->parent->send_futures,
-      dex_channel_send (
-          data->parent->channel,
-          dex_future_new_for_object (payload)));
-
+  g_mutex_lock (&parent->mutex);
+  set_op_progress (parent, data->op, int_progress);
+  g_hash_table_replace (
+      parent->pending_progress,
+      g_object_ref (data->op),
+      g_steal_pointer (&payload));
+  flush_progress (parent, FALSE);
   g_mutex_unlock (&parent->mutex);
 }
 
+/* Keeps `progress_sum` in step with `op_to_progress_hash`
+ * so the total never needs a rescan. Call with the mutex
+ * held */
+static void
+set_op_progress (TransactionData *data,
+                 gpointer         op,
+                 int              progress)
+{
+  gpointer old = NULL;
+
+  if (g_hash_table_lookup_extended (data->op_to_progress_hash, op, NULL, &old))
+    data->progress_sum -= GPOINTER_TO_INT (old);
+  data->progress_sum += progress;
+
+  g_hash_table_replace (
+      data->op_to_progress_hash,
+      g_object_ref (op),
+      GINT_TO_POINTER (progress));
+}
+
+/* Sends the coalesced snapshots, at most once per
+ * `PROGRESS_INTERVAL_USEC` and only once the receiver has
+ * taken the previous batch. Nothing blocks here; while the
+ * channel is backed up snapshots simply keep replacing each
+ * other. Call with the mutex held */
+static void
+flush_progress (TransactionData *data,
+                gboolean         force)
+{
+  gint64         now            = 0;
+  guint          n_ops          = 0;
+  double         total_progress = 0.0;
+  GHashTableIter iter           = { 0 };
+
+  if (data->channel == NULL ||
+      g_hash_table_size (data->pending_progress) == 0)
+    return;
+
+  now = g_get_monotonic_time ();
+  if (!force &&
+      (now - data->last_progress_flush < PROGRESS_INTERVAL_USEC ||
+       (data->progress_send != NULL &&
+        dex_future_get_status (data->progress_send) == DEX_FUTURE_STATUS_PENDING)))
+    return;
+
+  n_ops = g_hash_table_size (data->op_to_progress_hash) + data->unidentified_op_cnt;
+  if (n_ops > 0)
+    total_progress = MIN ((double) data->progress_sum / (double) (n_ops * 100), 1.0);
+
+  g_hash_table_iter_init (&iter, data->pending_progress);
+  for (;;)
+    {
+      gpointer val = NULL;
+
+      if (!g_hash_table_iter_next (&iter, NULL, &val))
+        break;
+
+      bz_backend_transaction_op_progress_payload_set_total_progress (
+          val, total_progress);
+
+      dex_clear (&data->progress_send);
+      data->progress_send = dex_channel_send (
+          data->channel,
+          dex_future_new_for_object (val));
+      g_ptr_array_add (data->send_futures, dex_ref (data->progress_send));
+    }
+  g_hash_table_remove_all (data->pending_progress);
+  data->last_progress_flush = now;
+
+  /* Only sends still in flight need awaiting at the end */
+  for (guint i = 0; i < data->send_futures->len;)
+    {
+      DexFuture *future = g_ptr_array_index (data->send_futures, i);
+
+      if (dex_future_get_status (future) != DEX_FUTURE_STATUS_PENDING)
+        g_ptr_array_remove_index_fast (data->send_futures, i);
+      else
+        i++;
+    }
+}
+
 static void
 installation_event (BzFlatpakInstance *self,
                     GFile             *file,
@@ -2120,3 +2288,148 @@ cmp_rref (FlatpakRemoteRef *a,
 
   return 0;
 }
+
+static char *
+dup_remote_sync_record_path (FlatpakInstallation *installation,
+                             FlatpakRemote       *remote)
+{
+  g_autofree char *cache_dir = NULL;
+  g_autofree char *basename  = NULL;
+
+  cache_dir = bz_dup_cache_dir (REMOTE_SYNC_CACHE_DIR);
+  basename  = g_strdup_printf (
+      "%s-%s",
+      flatpak_installation_get_is_user (installation) ? "user" : "system",
+      flatpak_remote_get_name (remote));
+
+  return g_build_filename (cache_dir, basename, NULL);
+}
+
+/* Returns a (mstt) variant of the remote url and the
+ * modification time and size of the appstream bundle,
+ * or NULL if the bundle has not been downloaded yet
+ */
+static GVariant *
+fingerprint_remote (FlatpakRemote *remote)
+{
+  g_autoptr (GFile) appstream_dir = NULL;
+  g_autoptr (GFile) appstream_xml = NULL;
+  g_autoptr (GFileInfo) info      = NULL;
+  g_autofree char *url            = NULL;
+  guint64          mtime_usec     = 0;
+
+  appstream_dir = flatpak_remote_get_appstream_dir (remote, NULL);
+  if (appstream_dir == NULL)
+    return NULL;
+
+  appstream_xml = g_file_get_child (appstream_dir, "appstream.xml.gz");
+  info          = g_file_query_info (
+      appstream_xml,
+      G_FILE_ATTRIBUTE_STANDARD_SIZE
+      "," G_FILE_ATTRIBUTE_TIME_MODIFIED
+      "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+      G_FILE_QUERY_INFO_NONE,
+      NULL, NULL);
+  if (info == NULL)
+    return NULL;
+
+  url        = flatpak_remote_get_url (remote);
+  mtime_usec = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC +
+               g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+
+  return g_variant_ref_sink (g_variant_new (
+      "(mstt)", url, mtime_usec,
+      (guint64) g_file_info_get_size (info)));
+}
+
+static gboolean
+remote_sync_is_fresh (FlatpakInstallation *installation,
+                      FlatpakRemote       *remote,
+                      guint                window)
+{
+  g_autofree char *path          = NULL;
+  g_autoptr (GFile) file         = NULL;
+  g_autoptr (GBytes) bytes       = NULL;
+  g_autoptr (GVariant) untrusted = NULL;
+  g_autoptr (GVariant) record    = NULL;
+  gint64 synced                  = 0;
+  g_autoptr (GVariant) recorded  = NULL;
+  g_autoptr (GVariant) current   = NULL;
+  gint64 now                     = 0;
+
+  if (window == 0)
+    return FALSE;
+
+  path  = dup_remote_sync_record_path (installation, remote);
+  file  = g_file_new_for_path (path);
+  bytes = g_file_load_bytes (file, NULL, NULL, NULL);
+  if (bytes == NULL)
+    return FALSE;
+
+  untrusted = g_variant_new_from_bytes (G_VARIANT_TYPE ("(x(mstt))"), bytes, FALSE);
+  record    = g_variant_get_normal_form (untrusted);
+  g_variant_get (record, "(x@(mstt))", &synced, &recorded);
+
+  now = g_get_real_time () / G_USEC_PER_SEC;
+  if (synced > now || now - synced >= (gint64) window)
+    return FALSE;
+
+  /* The summary and appstream bundle are only trusted if
+   * they are exactly what we left behind last time
+   */
+  current = fingerprint_remote (remote);
+  return current != NULL && g_variant_equal (current, recorded);
+}
+
+static void
+record_remote_sync (FlatpakInstallation *installation,
+                    FlatpakRemote       *remote)
+{
+  g_autoptr (GError) local_error = NULL;
+  g_autoptr (GVariant) current   = NULL;
+  g_autoptr (GVariant) record    = NULL;
+  g_autofree char *path          = NULL;
+  g_autoptr (GFile) file         = NULL;
+  g_autoptr (GFile) parent_file  = NULL;
+  gboolean result                = FALSE;
+
+  current = fingerprint_remote (remote);
+  if (current == NULL)
+    return;
+
+  record = g_variant_ref_sink (g_variant_new (
+      "(x@(mstt))",
+      g_get_real_time () / G_USEC_PER_SEC,
+      current));
+
+  path        = dup_remote_sync_record_path (installation, remote);
+  file        = g_file_new_for_path (path);
+  parent_file = g_file_get_parent (file);
+
+  result = g_file_make_directory_with_parents (parent_file, NULL, &local_error);
+  if (!result)
+    {
+      if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+        g_clear_pointer (&local_error, g_error_free);
+      else
+        {
+          g_warning ("Failed to record synchronization of remote '%s': %s",
+                     flatpak_remote_get_name (remote), local_error->message);
+          return;
+        }
+    }
+
+  result = g_file_replace_contents (
+      file,
+      g_variant_get_data (record),
+      g_variant_get_size (record),
+      NULL,
+      FALSE,
+      G_FILE_CREATE_REPLACE_DESTINATION,
+      NULL,
+      NULL,
+      &local_error);
+  if (!result)
+    g_warning ("Failed to record synchronization of remote '%s': %s",
+               flatpak_remote_get_name (remote), local_error->message);
+}
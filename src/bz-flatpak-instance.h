@@ -52,4 +52,11 @@ DexFuture *
 bz_flatpak_instance_ensure_has_flathub (BzFlatpakInstance *self,
                                         GCancellable      *cancellable);
 
+guint
+bz_flatpak_instance_get_remote_sync_window (BzFlatpakInstance *self);
+
+void
+bz_flatpak_instance_set_remote_sync_window (BzFlatpakInstance *self,
+                                            guint              seconds);
+
 G_END_DECLS
@@ -48,6 +48,7 @@ bz_flatpak_entry_new_for_ref (BzFlatpakInstance *instance,
                               FlatpakRemote     *remote,
                               FlatpakRef        *ref,
                               AsComponent       *component,
+                              const char        *component_xml,
                               const char        *appstream_dir,
                               GdkPaintable      *remote_icon,
                               GError           **error);
@@ -20,10 +20,14 @@
 
 #define G_LOG_DOMAIN "BAZAAR::FULL-VIEW-WIDGET"
 
+/* Matches the pixel-size of the app icon in the template */
+#define ICON_SIZE 128
+
 #include <glib/gi18n.h>
 #include <json-glib/json-glib.h>
 
 #include "bz-addons-dialog.h"
+#include "bz-async-texture.h"
 #include "bz-decorated-screenshot.h"
 #include "bz-dynamic-list-view.h"
 #include "bz-env.h"
@@ -53,6 +57,10 @@ struct _BzFullView
   guint      debounce_timeout;
   DexFuture *loading_forge_stars;
 
+  /* Version history may land after the entry does */
+  BzEntry *releases_entry;
+  gulong   releases_handler;
+
   /* Template widgets */
   AdwViewStack *stack;
   GtkWidget    *forge_stars;
@@ -111,6 +119,8 @@ bz_full_view_dispose (GObject *object)
 
   dex_clear (&self->loading_forge_stars);
   g_clear_handle_id (&self->debounce_timeout, g_source_remove);
+  g_clear_signal_handler (&self->releases_handler, self->releases_entry);
+  g_clear_object (&self->releases_entry);
 
   G_OBJECT_CLASS (bz_full_view_parent_class)->dispose (object);
 }
@@ -580,6 +590,15 @@ populate_releases_box (BzFullView *self)
   if (entry == NULL)
     return;
 
+  if (entry != self->releases_entry)
+    {
+      g_clear_signal_handler (&self->releases_handler, self->releases_entry);
+      g_set_object (&self->releases_entry, entry);
+      self->releases_handler = g_signal_connect_swapped (
+          entry, "notify::version-history",
+          G_CALLBACK (populate_releases_box), self);
+    }
+
   g_object_get (entry, "version-history", &version_history, NULL);
   if (version_history == NULL)
     return;
@@ -827,6 +846,7 @@ bz_full_view_set_entry_group (BzFullView   *self,
   if (group != NULL)
     {
       g_autoptr (DexFuture) future = NULL;
+      GdkPaintable *icon           = NULL;
 
       self->group            = g_object_ref (group);
       self->ui_entry         = bz_entry_group_dup_ui_entry (group);
@@ -836,6 +856,14 @@ bz_full_view_set_entry_group (BzFullView   *self,
       future            = bz_entry_group_dup_all_into_model (group);
       self->group_model = bz_result_new (future);
 
+      /* The icon is shared with the tiles, which ask
+       * for less, so ask for what is shown here too */
+      icon = bz_entry_group_get_icon_paintable (group);
+      if (BZ_IS_ASYNC_TEXTURE (icon))
+        bz_async_texture_request_size (
+            BZ_ASYNC_TEXTURE (icon),
+            ICON_SIZE * gtk_widget_get_scale_factor (GTK_WIDGET (self)));
+
       adw_view_stack_set_visible_child_name (self->stack, "content");
     }
   else
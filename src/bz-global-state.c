@@ -24,8 +24,56 @@
 
 #include "bz-env.h"
 #include "bz-global-state.h"
+#include "bz-http-cache.h"
+#include "bz-io.h"
+#include "bz-json-scan.h"
+#include "bz-network-metrics.h"
 #include "bz-util.h"
 
+/* Used when neither the endpoint nor the
+ * response says how long to keep a reply
+ */
+#define DEFAULT_TTL G_TIME_SPAN_HOUR
+
+#define MAX_REQUESTS_PER_HOST   6
+#define MAX_RETRIES             3
+#define BASE_BACKOFF            (G_TIME_SPAN_SECOND / 2)
+#define MAX_BACKOFF             (G_TIME_SPAN_SECOND * 30)
+#define MAX_RETRY_AFTER_SECONDS 60
+
+enum
+{
+  PRIORITY_CLASS_HIGH = 0,
+  PRIORITY_CLASS_NORMAL,
+  PRIORITY_CLASS_LOW,
+
+  N_PRIORITY_CLASSES
+};
+
+/* Only ever touched from fibers on the default
+ * scheduler, so needs no locking
+ */
+typedef struct
+{
+  guint  active;
+  GQueue waiting[N_PRIORITY_CLASSES];
+} HostState;
+
+static const struct
+{
+  const char *prefix;
+  GTimeSpan   ttl;
+} flathub_ttls[] = {
+  /* Listings move as apps are published */
+  { "/collection/recently-updated", G_TIME_SPAN_MINUTE * 15 },
+  { "/collection/recently-added", G_TIME_SPAN_MINUTE * 15 },
+  { "/collection/category/", G_TIME_SPAN_HOUR },
+  { "/collection/", G_TIME_SPAN_HOUR },
+  /* Stats are only aggregated daily */
+  { "/stats/", G_TIME_SPAN_DAY },
+  { "/verification/", G_TIME_SPAN_DAY },
+};
+
 BZ_DEFINE_DATA (
     http_request,
     HttpRequest,
@@ -40,13 +88,86 @@ static DexFuture *
 http_send_fiber (HttpRequestData *data);
 
 static void
-http_send_and_splice_finish (GObject      *object,
-                             GAsyncResult *result,
-                             gpointer      user_data);
+http_splice_finish (GObject      *object,
+                    GAsyncResult *result,
+                    gpointer      user_data);
+
+static void
+http_send_finish (GObject      *object,
+                  GAsyncResult *result,
+                  gpointer      user_data);
+
+static void
+finish_record (BzNetworkRecord *record,
+               SoupMessage     *message,
+               gint64           begin,
+               const GError    *error);
+
+static HostState *
+host_state_for (SoupMessage *message);
+
+static gboolean
+acquire_slot (HostState *host,
+              int        priority_class,
+              GError   **error);
+
+static void
+release_slot (HostState *host);
+
+static int
+priority_class_for (SoupMessage *message);
+
+static gboolean
+error_is_transient (const GError *error);
 
+static gboolean
+status_is_transient (guint status);
+
+static GTimeSpan
+backoff_delay (guint               attempt,
+               SoupMessageHeaders *headers);
+
+BZ_DEFINE_DATA (
+    query_json,
+    QueryJson,
+    {
+      char     *uri;
+      GTimeSpan ttl;
+    },
+    BZ_RELEASE_DATA (uri, g_free));
+static DexFuture *
+query_json_fiber (QueryJsonData *data);
+
+static DexFuture *
+query_json (const char *uri,
+            GTimeSpan   ttl);
+
+static DexFuture *
+query_json_finally (DexFuture *future,
+                    char      *uri);
+
+BZ_DEFINE_DATA (
+    query_strings,
+    QueryStrings,
+    {
+      char     *uri;
+      GTimeSpan ttl;
+      char     *array_member;
+      char     *field;
+    },
+    BZ_RELEASE_DATA (uri, g_free);
+    BZ_RELEASE_DATA (array_member, g_free);
+    BZ_RELEASE_DATA (field, g_free));
 static DexFuture *
-query_json_source_then (DexFuture     *future,
-                        GOutputStream *output_stream);
+query_strings_fiber (QueryStringsData *data);
+
+static char *
+flathub_uri (const char *request,
+             GTimeSpan  *ttl);
+
+/* Requests for the same uri share one future */
+static GRecMutex   inflight_mutex = { 0 };
+static GHashTable *inflight       = NULL;
 
 static DexFuture *
 send (SoupMessage   *message,
@@ -72,38 +193,20 @@ bz_send_with_global_http_session_then_splice_into (SoupMessage   *message,
 DexFuture *
 bz_https_query_json (const char *uri)
 {
-  g_autoptr (GError) local_error   = NULL;
-  g_autoptr (SoupMessage) message  = NULL;
-  SoupMessageHeaders *headers      = NULL;
-  g_autoptr (GOutputStream) output = NULL;
-  g_autoptr (DexFuture) future     = NULL;
-
   dex_return_error_if_fail (uri != NULL);
-
-  message = soup_message_new (SOUP_METHOD_GET, uri);
-  headers = soup_message_get_request_headers (message);
-  /* Needed for github for some reason */
-  soup_message_headers_append (headers, "User-Agent", "Bazaar");
-
-  output = g_memory_output_stream_new_resizable ();
-
-  future = send (message, output, TRUE);
-  future = dex_future_then (
-      future,
-      (DexFutureCallback) query_json_source_then,
-      g_object_ref (output), g_object_unref);
-  return g_steal_pointer (&future);
+  return query_json (uri, DEFAULT_TTL);
 }
 
 DexFuture *
 bz_query_flathub_v2_json (const char *request)
 {
   g_autofree char *uri = NULL;
+  GTimeSpan        ttl = 0;
 
   dex_return_error_if_fail (request != NULL);
 
-  uri = g_strdup_printf ("https://flathub.org/api/v2%s", request);
-  return bz_https_query_json (uri);
+  uri = flathub_uri (request, &ttl);
+  return query_json (uri, ttl);
 }
 
 DexFuture *
@@ -119,55 +222,211 @@ bz_query_flathub_v2_json_take (char *request)
   return future;
 }
 
+DexFuture *
+bz_query_flathub_v2_strings (const char *request,
+                             const char *array_member,
+                             const char *field)
+{
+  g_autoptr (QueryStringsData) data = NULL;
+
+  dex_return_error_if_fail (request != NULL);
+  dex_return_error_if_fail (array_member != NULL);
+  dex_return_error_if_fail (field != NULL);
+
+  data               = query_strings_data_new ();
+  data->uri          = flathub_uri (request, &data->ttl);
+  data->array_member = g_strdup (array_member);
+  data->field        = g_strdup (field);
+
+  return dex_scheduler_spawn (
+      bz_get_io_scheduler (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) query_strings_fiber,
+      query_strings_data_ref (data), query_strings_data_unref);
+}
+
 static DexFuture *
 http_send_fiber (HttpRequestData *data)
 {
-  static SoupSession      *session      = NULL;
-  SoupMessage             *message      = data->message;
-  GOutputStream           *splice_into  = data->splice_into;
-  gboolean                 close_output = data->close_output;
-  GOutputStreamSpliceFlags splice_flags = G_OUTPUT_STREAM_SPLICE_NONE;
-  g_autoptr (DexPromise) promise        = NULL;
+  static SoupSession      *session        = NULL;
+  SoupMessage             *message        = data->message;
+  GOutputStream           *splice_into    = data->splice_into;
+  gboolean                 close_output   = data->close_output;
+  g_autoptr (GError) local_error          = NULL;
+  HostState               *host           = NULL;
+  int                      priority_class = 0;
+  gboolean                 idempotent     = FALSE;
+  g_autoptr (GInputStream) input          = NULL;
+  GOutputStreamSpliceFlags splice_flags   = G_OUTPUT_STREAM_SPLICE_NONE;
+  g_autoptr (DexPromise) promise          = NULL;
+  gssize bytes_written                    = 0;
+  g_autoptr (BzNetworkRecord) record      = NULL;
+  gint64 begin                            = 0;
 
   if (g_once_init_enter_pointer (&session))
     g_once_init_leave_pointer (&session, soup_session_new ());
 
+  host           = host_state_for (message);
+  priority_class = priority_class_for (message);
+  idempotent     = g_strcmp0 (soup_message_get_method (message), SOUP_METHOD_GET) == 0 ||
+                   g_strcmp0 (soup_message_get_method (message), SOUP_METHOD_HEAD) == 0;
+
+  record = bz_network_record_new (soup_message_get_method (message), soup_message_get_uri (message));
+  begin  = g_get_monotonic_time ();
+
+  for (guint attempt = 0;; attempt++)
+    {
+      GTimeSpan delay   = 0;
+      gint64    queued  = 0;
+      gint64    sent_at = 0;
+
+      queued = g_get_monotonic_time ();
+      if (!acquire_slot (host, priority_class, &local_error))
+        {
+          finish_record (g_steal_pointer (&record), message, begin, local_error);
+          return dex_future_new_for_error (g_steal_pointer (&local_error));
+        }
+      sent_at = g_get_monotonic_time ();
+      record->queue_wait += sent_at - queued;
+      record->attempts++;
+
+      promise = dex_promise_new_cancellable ();
+      soup_session_send_async (
+          session,
+          message,
+          G_PRIORITY_DEFAULT_IDLE,
+          dex_promise_get_cancellable (promise),
+          http_send_finish,
+          dex_ref (promise));
+      input = dex_await_object (DEX_FUTURE (g_steal_pointer (&promise)), &local_error);
+      /* The reply headers are in by now */
+      record->time_to_first_byte = g_get_monotonic_time () - sent_at;
+
+      if (input == NULL)
+        {
+          release_slot (host);
+          if (!idempotent ||
+              attempt >= MAX_RETRIES ||
+              !error_is_transient (local_error))
+            {
+              finish_record (g_steal_pointer (&record), message, begin, local_error);
+              return dex_future_new_for_error (g_steal_pointer (&local_error));
+            }
+
+          delay = backoff_delay (attempt, NULL);
+          g_debug ("Retrying %s in %" G_GINT64_FORMAT "ms after error: %s",
+                   g_uri_get_host (soup_message_get_uri (message)),
+                   delay / 1000, local_error->message);
+          g_clear_pointer (&local_error, g_error_free);
+        }
+      else
+        {
+          guint status = 0;
+
+          status = soup_message_get_status (message);
+          /* Keep the slot while the body is read */
+          if (!idempotent ||
+              attempt >= MAX_RETRIES ||
+              !status_is_transient (status))
+            break;
+
+          release_slot (host);
+          g_input_stream_close (input, NULL, NULL);
+          g_clear_object (&input);
+
+          delay = backoff_delay (attempt, soup_message_get_response_headers (message));
+          g_debug ("Retrying %s in %" G_GINT64_FORMAT "ms after status %u",
+                   g_uri_get_host (soup_message_get_uri (message)),
+                   delay / 1000, status);
+        }
+
+      if (!dex_await (dex_timeout_new_usec (delay), &local_error) &&
+          !g_error_matches (local_error, DEX_ERROR, DEX_ERROR_TIMED_OUT))
+        {
+          finish_record (g_steal_pointer (&record), message, begin, local_error);
+          return dex_future_new_for_error (g_steal_pointer (&local_error));
+        }
+      g_clear_pointer (&local_error, g_error_free);
+    }
+
+  /* Streams handed back to the caller are read
+   * outside of the per-host limit
+   */
+  if (splice_into == NULL)
+    {
+      release_slot (host);
+      finish_record (g_steal_pointer (&record), message, begin, NULL);
+      return dex_future_new_take_object (g_steal_pointer (&input));
+    }
+
   splice_flags = G_OUTPUT_STREAM_SPLICE_CLOSE_SOURCE;
   if (close_output)
     splice_flags |= G_OUTPUT_STREAM_SPLICE_CLOSE_TARGET;
 
   promise = dex_promise_new_cancellable ();
-  soup_session_send_and_splice_async (
-      session,
-      message,
+  g_output_stream_splice_async (
       splice_into,
+      input,
       splice_flags,
       G_PRIORITY_DEFAULT_IDLE,
       dex_promise_get_cancellable (promise),
-      http_send_and_splice_finish,
+      http_splice_finish,
       dex_ref (promise));
+  bytes_written = dex_await_int64 (DEX_FUTURE (g_steal_pointer (&promise)), &local_error);
+  release_slot (host);
 
-  return DEX_FUTURE (g_steal_pointer (&promise));
+  if (local_error == NULL)
+    record->bytes = bytes_written;
+  finish_record (g_steal_pointer (&record), message, begin, local_error);
+
+  if (local_error != NULL)
+    return dex_future_new_for_error (g_steal_pointer (&local_error));
+  return dex_future_new_for_uint64 (bytes_written);
 }
 
 static void
-http_send_and_splice_finish (GObject      *object,
-                             GAsyncResult *result,
-                             gpointer      user_data)
+http_send_finish (GObject      *object,
+                  GAsyncResult *result,
+                  gpointer      user_data)
 {
   DexPromise *promise            = user_data;
   g_autoptr (GError) local_error = NULL;
-  gssize bytes_written           = 0;
+  g_autoptr (GInputStream) input = NULL;
 
   g_assert (SOUP_IS_SESSION (object));
   g_assert (G_IS_ASYNC_RESULT (result));
   g_assert (DEX_IS_PROMISE (promise));
 
-  bytes_written = soup_session_send_and_splice_finish (SOUP_SESSION (object), result, &local_error);
+  input = soup_session_send_finish (SOUP_SESSION (object), result, &local_error);
+  if (input != NULL)
+    dex_promise_resolve_object (promise, g_steal_pointer (&input));
+  else
+    {
+      g_debug ("Could not send http request: %s", local_error->message);
+      dex_promise_reject (promise, g_steal_pointer (&local_error));
+    }
+
+  dex_unref (promise);
+}
+
+static void
+http_splice_finish (GObject      *object,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+  DexPromise *promise            = user_data;
+  g_autoptr (GError) local_error = NULL;
+  gssize bytes_written           = 0;
+
+  g_assert (G_IS_OUTPUT_STREAM (object));
+  g_assert (G_IS_ASYNC_RESULT (result));
+  g_assert (DEX_IS_PROMISE (promise));
+
+  bytes_written = g_output_stream_splice_finish (G_OUTPUT_STREAM (object), result, &local_error);
   if (bytes_written >= 0)
     {
       g_debug ("Spliced %zu bytes from http reply into output stream", bytes_written);
-      dex_promise_resolve_uint64 (promise, bytes_written);
+      dex_promise_resolve_int64 (promise, bytes_written);
     }
   else
     {
@@ -178,9 +437,211 @@ http_send_and_splice_finish (GObject      *object,
   dex_unref (promise);
 }
 
+static void
+finish_record (BzNetworkRecord *record,
+               SoupMessage     *message,
+               gint64           begin,
+               const GError    *error)
+{
+  record->total  = g_get_monotonic_time () - begin;
+  record->status = soup_message_get_status (message);
+  if (bz_network_metrics_is_cache_lookup (message))
+    record->cache = record->status == SOUP_STATUS_NOT_MODIFIED
+                        ? BZ_NETWORK_CACHE_REVALIDATED
+                        : BZ_NETWORK_CACHE_MISS;
+  if (error != NULL)
+    record->error = g_strdup (error->message);
+
+  bz_network_metrics_take (record);
+}
+
+static HostState *
+host_state_for (SoupMessage *message)
+{
+  static GHashTable *hosts = NULL;
+  const char        *host  = NULL;
+  HostState         *state = NULL;
+
+  if (hosts == NULL)
+    hosts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  host = g_uri_get_host (soup_message_get_uri (message));
+  if (host == NULL)
+    host = "";
+
+  state = g_hash_table_lookup (hosts, host);
+  if (state == NULL)
+    {
+      state = g_new0 (HostState, 1);
+      for (guint i = 0; i < N_PRIORITY_CLASSES; i++)
+        g_queue_init (&state->waiting[i]);
+      g_hash_table_replace (hosts, g_strdup (host), state);
+    }
+
+  return state;
+}
+
+static gboolean
+acquire_slot (HostState *host,
+              int        priority_class,
+              GError   **error)
+{
+  g_autoptr (DexPromise) promise = NULL;
+
+  if (host->active < MAX_REQUESTS_PER_HOST)
+    {
+      host->active++;
+      return TRUE;
+    }
+
+  /* release_slot hands its slot straight to us */
+  promise = dex_promise_new ();
+  g_queue_push_tail (&host->waiting[priority_class], dex_ref (promise));
+  if (dex_await (dex_ref (promise), error))
+    return TRUE;
+
+  if (g_queue_remove (&host->waiting[priority_class], promise))
+    dex_unref (promise);
+  else
+    /* Granted right as we were cancelled */
+    release_slot (host);
+  return FALSE;
+}
+
+static void
+release_slot (HostState *host)
+{
+  for (guint i = 0; i < N_PRIORITY_CLASSES; i++)
+    {
+      DexPromise *promise = NULL;
+
+      promise = g_queue_pop_head (&host->waiting[i]);
+      if (promise != NULL)
+        {
+          dex_promise_resolve_boolean (promise, TRUE);
+          dex_unref (promise);
+          return;
+        }
+    }
+
+  host->active--;
+}
+
+static int
+priority_class_for (SoupMessage *message)
+{
+  switch (soup_message_get_priority (message))
+    {
+    case SOUP_MESSAGE_PRIORITY_VERY_HIGH:
+    case SOUP_MESSAGE_PRIORITY_HIGH:
+      return PRIORITY_CLASS_HIGH;
+    case SOUP_MESSAGE_PRIORITY_LOW:
+    case SOUP_MESSAGE_PRIORITY_VERY_LOW:
+      return PRIORITY_CLASS_LOW;
+    case SOUP_MESSAGE_PRIORITY_NORMAL:
+    default:
+      return PRIORITY_CLASS_NORMAL;
+    }
+}
+
+static gboolean
+error_is_transient (const GError *error)
+{
+  return g_error_matches (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT) ||
+         g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CONNECTION_CLOSED) ||
+         g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CONNECTION_REFUSED) ||
+         g_error_matches (error, G_IO_ERROR, G_IO_ERROR_BROKEN_PIPE) ||
+         g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NETWORK_UNREACHABLE) ||
+         g_error_matches (error, G_IO_ERROR, G_IO_ERROR_HOST_UNREACHABLE) ||
+         g_error_matches (error, G_RESOLVER_ERROR, G_RESOLVER_ERROR_TEMPORARY_FAILURE);
+}
+
+static gboolean
+status_is_transient (guint status)
+{
+  return status == 429 /* Too Many Requests */ ||
+         status == SOUP_STATUS_BAD_GATEWAY ||
+         status == SOUP_STATUS_SERVICE_UNAVAILABLE ||
+         status == SOUP_STATUS_GATEWAY_TIMEOUT;
+}
+
+static GTimeSpan
+backoff_delay (guint               attempt,
+               SoupMessageHeaders *headers)
+{
+  const char *retry_after = NULL;
+  guint64     seconds     = 0;
+  GTimeSpan   delay       = 0;
+
+  /* Only the delta-seconds form is understood,
+   * dates fall back to our own backoff
+   */
+  if (headers != NULL)
+    retry_after = soup_message_headers_get_one (headers, "Retry-After");
+  if (retry_after != NULL &&
+      g_ascii_string_to_unsigned (retry_after, 10, 0, MAX_RETRY_AFTER_SECONDS, &seconds, NULL))
+    return (GTimeSpan) seconds * G_TIME_SPAN_SECOND;
+
+  /* Jitter keeps many entries from retrying in lockstep */
+  delay = MIN (BASE_BACKOFF << attempt, MAX_BACKOFF);
+  return (GTimeSpan) g_random_double_range (delay / 2, delay);
+}
+
+static DexFuture *
+query_json (const char *uri,
+            GTimeSpan   ttl)
+{
+  g_autoptr (GRecMutexLocker) locker = NULL;
+  DexFuture *existing                = NULL;
+  g_autoptr (QueryJsonData) data     = NULL;
+  g_autoptr (DexFuture) future       = NULL;
+
+  locker = g_rec_mutex_locker_new (&inflight_mutex);
+  if (inflight == NULL)
+    inflight = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, dex_unref);
+
+  existing = g_hash_table_lookup (inflight, uri);
+  if (existing != NULL)
+    return dex_ref (existing);
+
+  data      = query_json_data_new ();
+  data->uri = g_strdup (uri);
+  data->ttl = ttl;
+
+  /* Parse away from the main thread, the nodes
+   * come out immutable so they can be shared
+   */
+  future = dex_scheduler_spawn (
+      bz_get_io_scheduler (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) query_json_fiber,
+      query_json_data_ref (data), query_json_data_unref);
+  future = dex_future_finally (
+      future,
+      (DexFutureCallback) query_json_finally,
+      g_strdup (uri), g_free);
+
+  /* The callback may have already run on this thread */
+  if (dex_future_is_pending (future))
+    g_hash_table_replace (inflight, g_strdup (uri), dex_ref (future));
+
+  return g_steal_pointer (&future);
+}
+
+static DexFuture *
+query_json_finally (DexFuture *future,
+                    char      *uri)
+{
+  g_autoptr (GRecMutexLocker) locker = NULL;
+
+  locker = g_rec_mutex_locker_new (&inflight_mutex);
+  g_hash_table_remove (inflight, uri);
+
+  return dex_ref (future);
+}
+
 static DexFuture *
-query_json_source_then (DexFuture     *future,
-                        GOutputStream *output_stream)
+query_json_fiber (QueryJsonData *data)
 {
   g_autoptr (GError) local_error = NULL;
   g_autoptr (GBytes) bytes       = NULL;
@@ -190,8 +651,9 @@ query_json_source_then (DexFuture     *future,
   gboolean  result               = FALSE;
   JsonNode *node                 = NULL;
 
-  bytes = g_memory_output_stream_steal_as_bytes (
-      G_MEMORY_OUTPUT_STREAM (output_stream));
+  bytes = dex_await_boxed (bz_http_cache_fetch (data->uri, data->ttl), &local_error);
+  if (bytes == NULL)
+    return dex_future_new_for_error (g_steal_pointer (&local_error));
   bytes_data = g_bytes_get_data (bytes, &bytes_size);
 
   parser = json_parser_new_immutable ();
@@ -203,6 +665,50 @@ query_json_source_then (DexFuture     *future,
   return dex_future_new_take_boxed (JSON_TYPE_NODE, json_node_ref (node));
 }
 
+static DexFuture *
+query_strings_fiber (QueryStringsData *data)
+{
+  g_autoptr (GError) local_error = NULL;
+  g_autoptr (GBytes) bytes       = NULL;
+  gsize         bytes_size       = 0;
+  gconstpointer bytes_data       = NULL;
+  g_autoptr (GPtrArray) strings  = NULL;
+
+  bytes = dex_await_boxed (bz_http_cache_fetch (data->uri, data->ttl), &local_error);
+  if (bytes == NULL)
+    return dex_future_new_for_error (g_steal_pointer (&local_error));
+  bytes_data = g_bytes_get_data (bytes, &bytes_size);
+
+  /* Listings can run to thousands of entries of which
+   * we keep a single field, so skip building the tree
+   */
+  strings = bz_json_scan_strings (
+      bytes_data, bytes_size,
+      data->array_member, data->field,
+      &local_error);
+  if (strings == NULL)
+    return dex_future_new_for_error (g_steal_pointer (&local_error));
+
+  return dex_future_new_take_boxed (G_TYPE_PTR_ARRAY, g_steal_pointer (&strings));
+}
+
+static char *
+flathub_uri (const char *request,
+             GTimeSpan  *ttl)
+{
+  *ttl = DEFAULT_TTL;
+  for (guint i = 0; i < G_N_ELEMENTS (flathub_ttls); i++)
+    {
+      if (g_str_has_prefix (request, flathub_ttls[i].prefix))
+        {
+          *ttl = flathub_ttls[i].ttl;
+          break;
+        }
+    }
+
+  return g_strdup_printf ("https://flathub.org/api/v2%s", request);
+}
+
 static DexFuture *
 send (SoupMessage   *message,
       GOutputStream *splice_into,
@@ -25,6 +25,9 @@
 
 G_BEGIN_DECLS
 
+/* Resolves to the response body as a #GInputStream,
+ * whatever the status of the response turns out to be
+ */
 DexFuture *
 bz_send_with_global_http_session (SoupMessage *message);
 
@@ -41,4 +44,13 @@ bz_query_flathub_v2_json (const char *request);
 DexFuture *
 bz_query_flathub_v2_json_take (char *request);
 
+/* Resolves to a #GPtrArray holding the @field string of
+ * each object in the top level @array_member of the reply,
+ * without parsing the rest of it into a tree
+ */
+DexFuture *
+bz_query_flathub_v2_strings (const char *request,
+                             const char *array_member,
+                             const char *field);
+
 G_END_DECLS
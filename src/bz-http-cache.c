@@ -0,0 +1,612 @@
+/* bz-http-cache.c
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN  "BAZAAR::HTTP-CACHE"
+#define BAZAAR_MODULE "http-cache"
+
+/* Bump this whenever the layout of a stored
+ * response changes
+ */
+#define ENTRY_VERSION 2
+#define ENTRY_FORMAT  "(uxbmsmsay)"
+
+/* How far past its expiry a stored body may still be
+ * served while revalidating in the background. Older
+ * bodies are only used if the network fails
+ */
+#define MAX_STALE_AGE (G_TIME_SPAN_DAY * 7)
+
+/* Bounds on the store, applied once per run. Entries are
+ * rewritten whenever they are refreshed, so ones that
+ * haven't been in a while are no longer being asked for
+ */
+#define PRUNE_AGE    (G_TIME_SPAN_DAY * 30)
+#define PRUNE_BUDGET (64 * 1024 * 1024)
+
+#include "config.h"
+
+#include <libsoup/soup.h>
+
+#include "bz-env.h"
+#include "bz-global-state.h"
+#include "bz-http-cache.h"
+#include "bz-io.h"
+#include "bz-network-metrics.h"
+#include "bz-util.h"
+
+BZ_DEFINE_DATA (
+    entry,
+    Entry,
+    {
+      gint64   expires_at;
+      gboolean no_cache;
+      char    *etag;
+      char   *last_modified;
+      GBytes *body;
+    },
+    BZ_RELEASE_DATA (etag, g_free);
+    BZ_RELEASE_DATA (last_modified, g_free);
+    BZ_RELEASE_DATA (body, g_bytes_unref));
+
+BZ_DEFINE_DATA (
+    fetch,
+    Fetch,
+    {
+      char      *uri;
+      char      *path;
+      GTimeSpan  ttl;
+      EntryData *entry;
+      gboolean   background;
+    },
+    BZ_RELEASE_DATA (uri, g_free);
+    BZ_RELEASE_DATA (path, g_free);
+    BZ_RELEASE_DATA (entry, entry_data_unref));
+static DexFuture *
+fetch_fiber (FetchData *data);
+
+static DexFuture *
+revalidate_fiber (FetchData *data);
+
+/* Paths of entries being revalidated in the background,
+ * so repeated lookups don't pile up identical requests
+ */
+static GMutex      revalidating_mutex = { 0 };
+static GHashTable *revalidating       = NULL;
+
+static GBytes *
+refresh (FetchData *data,
+         GError   **error);
+
+static gboolean
+compute_expiry (SoupMessageHeaders *headers,
+                GTimeSpan           ttl,
+                gint64              now,
+                gint64             *expires_at,
+                gboolean           *no_cache);
+
+static EntryData *
+load_entry (const char *path);
+
+static void
+store_entry (const char *path,
+             EntryData  *entry);
+
+static gboolean
+claim_revalidation (const char *path);
+
+static void
+record_served (FetchData           *data,
+               EntryData           *entry,
+               BzNetworkCacheStatus cache,
+               gint64               begin);
+
+static void
+release_revalidation (const char *path);
+
+static DexFuture *
+prune_fiber (gpointer data);
+
+typedef struct
+{
+  GFile  *file;
+  guint64 mtime;
+  goffset size;
+} PruneCandidate;
+
+static void
+prune_candidate_free (PruneCandidate *candidate);
+
+DexFuture *
+bz_http_cache_fetch (const char *uri,
+                     GTimeSpan   ttl)
+{
+  static gsize pruned          = 0;
+  g_autoptr (FetchData) data  = NULL;
+  g_autofree char *module_dir = NULL;
+  g_autofree char *checksum   = NULL;
+
+  dex_return_error_if_fail (uri != NULL);
+
+  if (g_once_init_enter (&pruned))
+    {
+      dex_future_disown (dex_scheduler_spawn (
+          bz_get_io_scheduler (),
+          bz_get_dex_stack_size (),
+          (DexFiberFunc) prune_fiber,
+          NULL, NULL));
+      g_once_init_leave (&pruned, 1);
+    }
+
+  module_dir = bz_dup_module_dir ();
+  checksum   = g_compute_checksum_for_string (G_CHECKSUM_SHA256, uri, -1);
+
+  data       = fetch_data_new ();
+  data->uri  = g_strdup (uri);
+  data->path = g_build_filename (module_dir, checksum, NULL);
+  data->ttl  = ttl;
+
+  return dex_scheduler_spawn (
+      bz_get_io_scheduler (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) fetch_fiber,
+      fetch_data_ref (data), fetch_data_unref);
+}
+
+static DexFuture *
+fetch_fiber (FetchData *data)
+{
+  g_autoptr (GError) local_error = NULL;
+  gint64 begin                   = 0;
+  g_autoptr (EntryData) entry    = NULL;
+  gint64 now                     = 0;
+  g_autoptr (GBytes) body        = NULL;
+
+  begin = g_get_monotonic_time ();
+  entry = load_entry (data->path);
+  now   = g_get_real_time ();
+
+  /* no-cache bodies may be stored, but every use
+   * has to be confirmed with the server first
+   */
+  if (entry != NULL && entry->no_cache)
+    {
+      data->entry = g_steal_pointer (&entry);
+      body        = refresh (data, &local_error);
+      if (body == NULL)
+        return dex_future_new_for_error (g_steal_pointer (&local_error));
+      return dex_future_new_take_boxed (G_TYPE_BYTES, g_steal_pointer (&body));
+    }
+
+  if (entry != NULL && now < entry->expires_at)
+    {
+      record_served (data, entry, BZ_NETWORK_CACHE_HIT, begin);
+      return dex_future_new_take_boxed (G_TYPE_BYTES, g_bytes_ref (entry->body));
+    }
+
+  if (entry != NULL && now - entry->expires_at < MAX_STALE_AGE)
+    {
+      if (claim_revalidation (data->path))
+        {
+          g_autoptr (FetchData) revalidate = NULL;
+
+          revalidate             = fetch_data_new ();
+          revalidate->uri        = g_strdup (data->uri);
+          revalidate->path       = g_strdup (data->path);
+          revalidate->ttl        = data->ttl;
+          revalidate->entry      = entry_data_ref (entry);
+          revalidate->background = TRUE;
+
+          dex_future_disown (dex_scheduler_spawn (
+              bz_get_io_scheduler (),
+              bz_get_dex_stack_size (),
+              (DexFiberFunc) revalidate_fiber,
+              fetch_data_ref (revalidate), fetch_data_unref));
+        }
+
+      record_served (data, entry, BZ_NETWORK_CACHE_STALE, begin);
+      return dex_future_new_take_boxed (G_TYPE_BYTES, g_bytes_ref (entry->body));
+    }
+
+  data->entry = g_steal_pointer (&entry);
+  body        = refresh (data, &local_error);
+  if (body == NULL)
+    {
+      if (data->entry == NULL)
+        return dex_future_new_for_error (g_steal_pointer (&local_error));
+
+      g_warning ("Could not refresh %s, serving an expired copy: %s",
+                 data->uri, local_error->message);
+      body = g_bytes_ref (data->entry->body);
+    }
+
+  return dex_future_new_take_boxed (G_TYPE_BYTES, g_steal_pointer (&body));
+}
+
+static DexFuture *
+revalidate_fiber (FetchData *data)
+{
+  g_autoptr (GError) local_error = NULL;
+  g_autoptr (GBytes) body        = NULL;
+
+  body = refresh (data, &local_error);
+  if (body == NULL)
+    g_debug ("Could not revalidate %s: %s", data->uri, local_error->message);
+
+  release_revalidation (data->path);
+  return dex_future_new_true ();
+}
+
+static GBytes *
+refresh (FetchData *data,
+         GError   **error)
+{
+  EntryData          *entry            = data->entry;
+  g_autoptr (SoupMessage) message      = NULL;
+  SoupMessageHeaders *request_headers  = NULL;
+  SoupMessageHeaders *response_headers = NULL;
+  g_autoptr (GOutputStream) output     = NULL;
+  gboolean    result                   = FALSE;
+  guint       status                   = 0;
+  gint64      expires_at               = 0;
+  gboolean    no_cache                 = FALSE;
+  const char *etag                     = NULL;
+  const char *last_modified            = NULL;
+  g_autoptr (GBytes) body              = NULL;
+  g_autoptr (EntryData) updated        = NULL;
+
+  message = soup_message_new (SOUP_METHOD_GET, data->uri);
+  if (message == NULL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "Invalid uri '%s'", data->uri);
+      return NULL;
+    }
+
+  bz_network_metrics_mark_cache_lookup (message);
+
+  /* Let requests someone is waiting on go first */
+  if (data->background)
+    soup_message_set_priority (message, SOUP_MESSAGE_PRIORITY_LOW);
+
+  request_headers = soup_message_get_request_headers (message);
+  /* Needed for github for some reason */
+  soup_message_headers_append (request_headers, "User-Agent", "Bazaar");
+  if (entry != NULL && entry->etag != NULL)
+    soup_message_headers_append (request_headers, "If-None-Match", entry->etag);
+  if (entry != NULL && entry->last_modified != NULL)
+    soup_message_headers_append (request_headers, "If-Modified-Since", entry->last_modified);
+
+  output = g_memory_output_stream_new_resizable ();
+  result = dex_await (
+      bz_send_with_global_http_session_then_splice_into (message, output),
+      error);
+  if (!result)
+    return NULL;
+
+  status           = soup_message_get_status (message);
+  response_headers = soup_message_get_response_headers (message);
+
+  if (status == SOUP_STATUS_NOT_MODIFIED && entry != NULL)
+    body = g_bytes_ref (entry->body);
+  else
+    {
+      if (status != SOUP_STATUS_OK)
+        {
+          /* Error pages are never stored or handed to
+           * callers, who would parse them as data
+           */
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                       "HTTP request for '%s' failed with status %u",
+                       data->uri, status);
+          return NULL;
+        }
+      body = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (output));
+    }
+
+  if (!compute_expiry (response_headers, data->ttl, g_get_real_time (), &expires_at, &no_cache))
+    return g_steal_pointer (&body);
+
+  etag          = soup_message_headers_get_one (response_headers, "ETag");
+  last_modified = soup_message_headers_get_one (response_headers, "Last-Modified");
+
+  updated             = entry_data_new ();
+  updated->expires_at = expires_at;
+  updated->no_cache   = no_cache;
+  updated->body       = g_bytes_ref (body);
+  /* A 304 may omit validators that still apply */
+  if (etag != NULL)
+    updated->etag = g_strdup (etag);
+  else if (status == SOUP_STATUS_NOT_MODIFIED)
+    updated->etag = g_strdup (entry->etag);
+  if (last_modified != NULL)
+    updated->last_modified = g_strdup (last_modified);
+  else if (status == SOUP_STATUS_NOT_MODIFIED)
+    updated->last_modified = g_strdup (entry->last_modified);
+
+  store_entry (data->path, updated);
+  return g_steal_pointer (&body);
+}
+
+static gboolean
+compute_expiry (SoupMessageHeaders *headers,
+                GTimeSpan           ttl,
+                gint64              now,
+                gint64             *expires_at,
+                gboolean           *no_cache)
+{
+  const char *cache_control = NULL;
+  const char *age_header    = NULL;
+  guint64     age           = 0;
+
+  cache_control = soup_message_headers_get_list (headers, "Cache-Control");
+  if (cache_control != NULL)
+    {
+      g_autoptr (GHashTable) params = NULL;
+      const char *max_age           = NULL;
+      guint64     seconds           = 0;
+
+      params = soup_header_parse_param_list (cache_control);
+      if (g_hash_table_contains (params, "no-store"))
+        return FALSE;
+      if (g_hash_table_contains (params, "no-cache"))
+        {
+          *expires_at = now;
+          *no_cache   = TRUE;
+          return TRUE;
+        }
+
+      max_age = g_hash_table_lookup (params, "max-age");
+      if (max_age != NULL &&
+          g_ascii_string_to_unsigned (max_age, 10, 0, G_MAXINT32, &seconds, NULL))
+        {
+          age_header = soup_message_headers_get_one (headers, "Age");
+          if (age_header != NULL &&
+              g_ascii_string_to_unsigned (age_header, 10, 0, G_MAXINT32, &age, NULL))
+            seconds = age < seconds ? seconds - age : 0;
+
+          *expires_at = now + (gint64) seconds * G_TIME_SPAN_SECOND;
+          return TRUE;
+        }
+    }
+
+  *expires_at = now + ttl;
+  return TRUE;
+}
+
+static EntryData *
+load_entry (const char *path)
+{
+  g_autoptr (GError) local_error = NULL;
+  g_autoptr (GMappedFile) mapped = NULL;
+  g_autoptr (GBytes) bytes       = NULL;
+  g_autoptr (GVariant) variant   = NULL;
+  guint32 version                = 0;
+  g_autoptr (GVariant) body      = NULL;
+  g_autoptr (EntryData) entry    = NULL;
+
+  mapped = g_mapped_file_new (path, FALSE, &local_error);
+  if (mapped == NULL)
+    {
+      if (!g_error_matches (local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_debug ("Could not read cached response at %s: %s", path, local_error->message);
+      return NULL;
+    }
+
+  bytes   = g_mapped_file_get_bytes (mapped);
+  variant = g_variant_new_from_bytes (G_VARIANT_TYPE (ENTRY_FORMAT), bytes, FALSE);
+
+  g_variant_get_child (variant, 0, "u", &version);
+  if (version != ENTRY_VERSION)
+    return NULL;
+
+  entry = entry_data_new ();
+  g_variant_get (variant, "(uxbmsmsay)", NULL, &entry->expires_at, &entry->no_cache,
+                 &entry->etag, &entry->last_modified, NULL);
+
+  /* The body stays a slice of the mapping */
+  body        = g_variant_get_child_value (variant, 5);
+  entry->body = g_variant_get_data_as_bytes (body);
+
+  return g_steal_pointer (&entry);
+}
+
+static void
+store_entry (const char *path,
+             EntryData  *entry)
+{
+  g_autoptr (GError) local_error = NULL;
+  g_autofree char *module_dir    = NULL;
+  g_autoptr (GVariant) variant   = NULL;
+  gboolean result                = FALSE;
+
+  module_dir = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (module_dir, 0755) != 0)
+    {
+      g_warning ("Could not make http cache directory %s", module_dir);
+      return;
+    }
+
+  variant = g_variant_ref_sink (g_variant_new (
+      ENTRY_FORMAT,
+      ENTRY_VERSION,
+      entry->expires_at,
+      entry->no_cache,
+      entry->etag,
+      entry->last_modified,
+      g_variant_new_from_bytes (G_VARIANT_TYPE_BYTESTRING, entry->body, TRUE)));
+
+  /* g_file_set_contents renames a temporary file
+   * into place, so readers never see a torn entry
+   */
+  result = g_file_set_contents (
+      path,
+      g_variant_get_data (variant),
+      g_variant_get_size (variant),
+      &local_error);
+  if (!result)
+    g_warning ("Could not store cached response at %s: %s", path, local_error->message);
+}
+
+static gboolean
+claim_revalidation (const char *path)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  locker = g_mutex_locker_new (&revalidating_mutex);
+  if (revalidating == NULL)
+    revalidating = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  return g_hash_table_add (revalidating, g_strdup (path));
+}
+
+static void
+release_revalidation (const char *path)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  locker = g_mutex_locker_new (&revalidating_mutex);
+  g_hash_table_remove (revalidating, path);
+}
+
+static gint
+cmp_mtime (gconstpointer a,
+           gconstpointer b)
+{
+  const PruneCandidate *candidate_a = *(const PruneCandidate **) a;
+  const PruneCandidate *candidate_b = *(const PruneCandidate **) b;
+
+  if (candidate_a->mtime < candidate_b->mtime)
+    return -1;
+  else if (candidate_a->mtime > candidate_b->mtime)
+    return 1;
+  else
+    return 0;
+}
+
+/* Drops entries nobody refreshed in a while, then the
+ * oldest of the rest until the store fits its budget
+ */
+static DexFuture *
+prune_fiber (gpointer data)
+{
+  g_autofree char *module_dir            = NULL;
+  g_autoptr (GFile) dir                  = NULL;
+  g_autoptr (GFileEnumerator) enumerator = NULL;
+  g_autoptr (GPtrArray) kept             = NULL;
+  guint64 cutoff                         = 0;
+  guint64 total                          = 0;
+  guint   n_removed                      = 0;
+
+  module_dir = bz_dup_module_dir ();
+  dir        = g_file_new_for_path (module_dir);
+  enumerator = g_file_enumerate_children (
+      dir,
+      G_FILE_ATTRIBUTE_STANDARD_NAME
+      "," G_FILE_ATTRIBUTE_STANDARD_TYPE
+      "," G_FILE_ATTRIBUTE_STANDARD_SIZE
+      "," G_FILE_ATTRIBUTE_TIME_MODIFIED,
+      G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+      NULL, NULL);
+  if (enumerator == NULL)
+    return dex_future_new_true ();
+
+  cutoff = (g_get_real_time () - PRUNE_AGE) / G_USEC_PER_SEC;
+  kept   = g_ptr_array_new_with_free_func ((GDestroyNotify) prune_candidate_free);
+
+  for (;;)
+    {
+      g_autoptr (GFileInfo) info = NULL;
+      PruneCandidate *candidate  = NULL;
+
+      info = g_file_enumerator_next_file (enumerator, NULL, NULL);
+      if (info == NULL)
+        break;
+      if (g_file_info_get_file_type (info) != G_FILE_TYPE_REGULAR)
+        continue;
+
+      candidate        = g_new0 (PruneCandidate, 1);
+      candidate->file  = g_file_enumerator_get_child (enumerator, info);
+      candidate->mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+      candidate->size  = g_file_info_get_size (info);
+
+      if (candidate->mtime < cutoff)
+        {
+          if (g_file_delete (candidate->file, NULL, NULL))
+            n_removed++;
+          prune_candidate_free (candidate);
+          continue;
+        }
+
+      total += candidate->size;
+      g_ptr_array_add (kept, candidate);
+    }
+
+  if (total > PRUNE_BUDGET)
+    {
+      g_ptr_array_sort (kept, cmp_mtime);
+      for (guint i = 0; i < kept->len && total > PRUNE_BUDGET; i++)
+        {
+          PruneCandidate *candidate = g_ptr_array_index (kept, i);
+
+          if (g_file_delete (candidate->file, NULL, NULL))
+            n_removed++;
+          total -= candidate->size;
+        }
+    }
+
+  if (n_removed > 0)
+    g_debug ("Pruned %u cached responses, %" G_GUINT64_FORMAT " bytes remain",
+             n_removed, total);
+
+  return dex_future_new_true ();
+}
+
+static void
+prune_candidate_free (PruneCandidate *candidate)
+{
+  g_clear_object (&candidate->file);
+  g_free (candidate);
+}
+
+/* Entries served without touching the network still
+ * show up among the recorded requests
+ */
+static void
+record_served (FetchData           *data,
+               EntryData           *entry,
+               BzNetworkCacheStatus cache,
+               gint64               begin)
+{
+  g_autoptr (GUri) uri               = NULL;
+  g_autoptr (BzNetworkRecord) record = NULL;
+
+  uri = g_uri_parse (data->uri, G_URI_FLAGS_NONE, NULL);
+  if (uri == NULL)
+    return;
+
+  record        = bz_network_record_new (SOUP_METHOD_GET, uri);
+  record->total = g_get_monotonic_time () - begin;
+  record->bytes = g_bytes_get_size (entry->body);
+  record->cache = cache;
+
+  bz_network_metrics_take (g_steal_pointer (&record));
+}
+
+/* End of bz-http-cache.c */
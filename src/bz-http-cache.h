@@ -0,0 +1,39 @@
+/* bz-http-cache.h
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <libdex.h>
+
+G_BEGIN_DECLS
+
+/* Resolves to the body of @uri as #GBytes. Responses are
+ * kept on disk and served from there while fresh; stale
+ * ones are served immediately and revalidated in the
+ * background. @ttl applies when the response carries no
+ * Cache-Control max-age of its own
+ */
+DexFuture *
+bz_http_cache_fetch (const char *uri,
+                     GTimeSpan   ttl);
+
+G_END_DECLS
+
+/* End of bz-http-cache.h */
@@ -0,0 +1,626 @@
+/* bz-image-cache.c
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN  "BAZAAR::IMAGE-CACHE"
+#define BAZAAR_MODULE "image-cache"
+
+#define INDEX_FILENAME      "index"
+#define INDEX_VERSION       2
+#define SAVE_DELAY_SECONDS  5
+#define DEFAULT_BUDGET_SIZE (512 * 1024 * 1024)
+#define LEGACY_DATA_SUFFIX  ".bz-async-texture-data"
+#define LEGACY_MODULE       "entry"
+
+#include "config.h"
+
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include "bz-env.h"
+#include "bz-image-cache.h"
+#include "bz-io.h"
+
+/* Tracks every image written to disk by Bazaar in a
+ * single index file, so the total size can be bounded
+ * without a metadata file next to each image
+ */
+
+typedef struct
+{
+  /* borrowed from the key in index_records */
+  const char *path;
+  GList      *link;
+  guint64     size;
+  gint64      birth;
+  gint64      last_access;
+  char       *etag;
+  char       *last_modified;
+} CacheRecord;
+
+static GMutex      index_mutex    = { 0 };
+static GHashTable *index_records  = NULL;
+/* Ordered from least to most recently accessed */
+static GQueue      index_lru      = G_QUEUE_INIT;
+static guint64     index_total    = 0;
+static guint64     index_budget   = DEFAULT_BUDGET_SIZE;
+static gboolean    save_scheduled = FALSE;
+
+static void
+cache_record_free (CacheRecord *record);
+
+static CacheRecord *
+insert_record_locked (const char *path);
+
+static void
+touch_record_locked (CacheRecord *record);
+
+static void
+ensure_index_locked (void);
+
+static GPtrArray *
+enforce_budget_locked (const char *keep);
+
+static void
+schedule_save_locked (void);
+
+static DexFuture *
+save_fiber (gpointer data);
+
+static DexFuture *
+sweep_legacy_fiber (gpointer data);
+
+static void
+sweep_legacy_dir (GFile  *dir,
+                  guint64 before);
+
+static void
+remove_files (GPtrArray *paths);
+
+void
+bz_image_cache_set_budget (guint64 bytes)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  g_autoptr (GPtrArray) evicted   = NULL;
+
+  locker       = g_mutex_locker_new (&index_mutex);
+  index_budget = bytes;
+
+  /* Avoid reading the index from disk here, a
+   * lazy load will apply the new budget later
+   */
+  if (index_records == NULL)
+    return;
+
+  evicted = enforce_budget_locked (NULL);
+  if (evicted->len > 0)
+    schedule_save_locked ();
+  g_clear_pointer (&locker, g_mutex_locker_free);
+
+  remove_files (evicted);
+}
+
+guint64
+bz_image_cache_get_budget (void)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  locker = g_mutex_locker_new (&index_mutex);
+  return index_budget;
+}
+
+gboolean
+bz_image_cache_lookup (const char *path,
+                       GTimeSpan   max_age)
+{
+  BzImageCacheState state = BZ_IMAGE_CACHE_MISS;
+
+  state = bz_image_cache_query (path, max_age, NULL, NULL);
+  if (state == BZ_IMAGE_CACHE_STALE)
+    bz_image_cache_forget (path);
+
+  return state == BZ_IMAGE_CACHE_FRESH;
+}
+
+BzImageCacheState
+bz_image_cache_query (const char *path,
+                      GTimeSpan   max_age,
+                      char      **etag,
+                      char      **last_modified)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  CacheRecord *record             = NULL;
+  gint64       now                = 0;
+
+  g_return_val_if_fail (path != NULL, BZ_IMAGE_CACHE_MISS);
+
+  locker = g_mutex_locker_new (&index_mutex);
+  ensure_index_locked ();
+
+  record = g_hash_table_lookup (index_records, path);
+  if (record == NULL)
+    return BZ_IMAGE_CACHE_MISS;
+
+  if (!g_file_test (path, G_FILE_TEST_IS_REGULAR))
+    {
+      index_total -= record->size;
+      g_hash_table_remove (index_records, path);
+      schedule_save_locked ();
+      return BZ_IMAGE_CACHE_MISS;
+    }
+
+  if (etag != NULL)
+    *etag = g_strdup (record->etag);
+  if (last_modified != NULL)
+    *last_modified = g_strdup (record->last_modified);
+
+  now = g_get_real_time ();
+  if (max_age > 0 && now - record->birth > max_age)
+    return BZ_IMAGE_CACHE_STALE;
+
+  record->last_access = now;
+  touch_record_locked (record);
+  schedule_save_locked ();
+  return BZ_IMAGE_CACHE_FRESH;
+}
+
+void
+bz_image_cache_refresh (const char *path)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  CacheRecord *record             = NULL;
+
+  g_return_if_fail (path != NULL);
+
+  locker = g_mutex_locker_new (&index_mutex);
+  ensure_index_locked ();
+
+  record = g_hash_table_lookup (index_records, path);
+  if (record == NULL)
+    return;
+
+  record->birth       = g_get_real_time ();
+  record->last_access = record->birth;
+  touch_record_locked (record);
+  schedule_save_locked ();
+}
+
+void
+bz_image_cache_record (const char *path)
+{
+  bz_image_cache_record_with_validators (path, NULL, NULL);
+}
+
+void
+bz_image_cache_record_with_validators (const char *path,
+                                       const char *etag,
+                                       const char *last_modified)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  g_autoptr (GFile) file          = NULL;
+  g_autoptr (GFileInfo) info      = NULL;
+  g_autoptr (GPtrArray) evicted   = NULL;
+  CacheRecord *record             = NULL;
+  gint64       now                = 0;
+
+  g_return_if_fail (path != NULL);
+
+  file = g_file_new_for_path (path);
+  info = g_file_query_info (
+      file, G_FILE_ATTRIBUTE_STANDARD_SIZE,
+      G_FILE_QUERY_INFO_NONE, NULL, NULL);
+  if (info == NULL)
+    return;
+
+  locker = g_mutex_locker_new (&index_mutex);
+  ensure_index_locked ();
+
+  now    = g_get_real_time ();
+  record = g_hash_table_lookup (index_records, path);
+  if (record != NULL)
+    {
+      index_total -= record->size;
+      touch_record_locked (record);
+    }
+  else
+    record = insert_record_locked (path);
+  record->size        = g_file_info_get_size (info);
+  record->birth       = now;
+  record->last_access = now;
+  g_clear_pointer (&record->etag, g_free);
+  g_clear_pointer (&record->last_modified, g_free);
+  if (etag != NULL && *etag != '\0')
+    record->etag = g_strdup (etag);
+  if (last_modified != NULL && *last_modified != '\0')
+    record->last_modified = g_strdup (last_modified);
+  index_total += record->size;
+
+  evicted = enforce_budget_locked (path);
+  schedule_save_locked ();
+  g_clear_pointer (&locker, g_mutex_locker_free);
+
+  remove_files (evicted);
+}
+
+void
+bz_image_cache_forget (const char *path)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  CacheRecord *record             = NULL;
+
+  g_return_if_fail (path != NULL);
+
+  locker = g_mutex_locker_new (&index_mutex);
+  ensure_index_locked ();
+
+  record = g_hash_table_lookup (index_records, path);
+  if (record != NULL)
+    {
+      index_total -= record->size;
+      g_hash_table_remove (index_records, path);
+      schedule_save_locked ();
+    }
+  g_clear_pointer (&locker, g_mutex_locker_free);
+
+  g_unlink (path);
+}
+
+static void
+cache_record_free (CacheRecord *record)
+{
+  /* Records are only freed by index_records,
+   * so this keeps the queue in sync with it
+   */
+  if (record->link != NULL)
+    g_queue_delete_link (&index_lru, record->link);
+  g_free (record->etag);
+  g_free (record->last_modified);
+  g_free (record);
+}
+
+static CacheRecord *
+insert_record_locked (const char *path)
+{
+  CacheRecord *record = NULL;
+  char        *key    = NULL;
+
+  key          = g_strdup (path);
+  record       = g_new0 (CacheRecord, 1);
+  record->path = key;
+  g_hash_table_replace (index_records, key, record);
+
+  g_queue_push_tail (&index_lru, record);
+  record->link = index_lru.tail;
+
+  return record;
+}
+
+static void
+touch_record_locked (CacheRecord *record)
+{
+  g_queue_unlink (&index_lru, record->link);
+  g_queue_push_tail_link (&index_lru, record->link);
+}
+
+static gint
+cmp_last_access (gconstpointer a,
+                 gconstpointer b,
+                 gpointer      user_data)
+{
+  const CacheRecord *record_a = a;
+  const CacheRecord *record_b = b;
+
+  if (record_a->last_access < record_b->last_access)
+    return -1;
+  else if (record_a->last_access > record_b->last_access)
+    return 1;
+  else
+    return 0;
+}
+
+static void
+ensure_index_locked (void)
+{
+  g_autoptr (GError) local_error = NULL;
+  g_autofree char *module_dir    = NULL;
+  g_autofree char *index_path    = NULL;
+  g_autofree char *contents      = NULL;
+  gsize            length        = 0;
+  g_autoptr (GBytes) bytes       = NULL;
+  g_autoptr (GVariant) variant   = NULL;
+  guint32       version          = 0;
+  GVariantIter *iter             = NULL;
+  const char   *path             = NULL;
+  guint64       size             = 0;
+  gint64        birth            = 0;
+  gint64        last_access      = 0;
+  const char   *etag             = NULL;
+  const char   *last_modified    = NULL;
+
+  if (index_records != NULL)
+    return;
+  index_records = g_hash_table_new_full (
+      g_str_hash, g_str_equal,
+      g_free, (GDestroyNotify) cache_record_free);
+  index_total   = 0;
+
+  module_dir = bz_dup_module_dir ();
+  index_path = g_build_filename (module_dir, INDEX_FILENAME, NULL);
+  if (!g_file_get_contents (index_path, &contents, &length, &local_error))
+    {
+      if (g_error_matches (local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        /* Images cached before there was an index
+         * are unknown to it, so nothing would ever
+         * clean them up otherwise
+         */
+        dex_future_disown (dex_scheduler_spawn (
+            bz_get_io_scheduler (),
+            bz_get_dex_stack_size (),
+            (DexFiberFunc) sweep_legacy_fiber,
+            NULL, NULL));
+      else
+        g_warning ("Failed to read image cache index at %s: %s",
+                   index_path, local_error->message);
+      return;
+    }
+
+  bytes   = g_bytes_new_take (g_steal_pointer (&contents), length);
+  variant = g_variant_new_from_bytes (G_VARIANT_TYPE ("(ua{s(txxss)})"), bytes, FALSE);
+  g_variant_get (variant, "(ua{s(txxss)})", &version, &iter);
+  if (version != INDEX_VERSION)
+    {
+      g_debug ("Discarding image cache index with version %u", version);
+      g_variant_iter_free (iter);
+      return;
+    }
+
+  while (g_variant_iter_next (
+      iter, "{&s(txx&s&s)}",
+      &path, &size, &birth, &last_access, &etag, &last_modified))
+    {
+      CacheRecord *record = NULL;
+
+      record              = insert_record_locked (path);
+      record->size        = size;
+      record->birth       = birth;
+      record->last_access = last_access;
+      if (*etag != '\0')
+        record->etag = g_strdup (etag);
+      if (*last_modified != '\0')
+        record->last_modified = g_strdup (last_modified);
+      index_total += size;
+    }
+  g_variant_iter_free (iter);
+
+  /* The index isn't stored in any particular order,
+   * so this is the only time the queue is sorted
+   */
+  g_queue_sort (&index_lru, cmp_last_access, NULL);
+
+  g_debug ("Loaded image cache index with %u images totaling %" G_GUINT64_FORMAT " bytes",
+           g_hash_table_size (index_records), index_total);
+}
+
+/* Returns the paths which should be removed from
+ * disk once the index lock has been released
+ */
+static GPtrArray *
+enforce_budget_locked (const char *keep)
+{
+  g_autoptr (GPtrArray) evicted = NULL;
+  GList *link                   = NULL;
+
+  evicted = g_ptr_array_new_with_free_func (g_free);
+  if (index_total <= index_budget)
+    return g_steal_pointer (&evicted);
+
+  /* Pop from the cold end until we fit */
+  link = index_lru.head;
+  while (link != NULL && index_total > index_budget)
+    {
+      CacheRecord *record = link->data;
+
+      link = link->next;
+      if (keep != NULL && g_strcmp0 (record->path, keep) == 0)
+        continue;
+
+      index_total -= record->size;
+      g_ptr_array_add (evicted, g_strdup (record->path));
+      /* also drops the record from the queue */
+      g_hash_table_remove (index_records, record->path);
+    }
+
+  g_debug ("Evicted %u images from the image cache, now at %" G_GUINT64_FORMAT " bytes",
+           evicted->len, index_total);
+  return g_steal_pointer (&evicted);
+}
+
+static void
+schedule_save_locked (void)
+{
+  if (save_scheduled)
+    return;
+  save_scheduled = TRUE;
+
+  dex_future_disown (dex_scheduler_spawn (
+      bz_get_io_scheduler (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) save_fiber,
+      NULL, NULL));
+}
+
+static DexFuture *
+save_fiber (gpointer data)
+{
+  g_autoptr (GError) local_error      = NULL;
+  g_autoptr (GMutexLocker) locker     = NULL;
+  g_autoptr (GVariantBuilder) builder = NULL;
+  g_autoptr (GVariant) variant        = NULL;
+  GHashTableIter   iter               = { 0 };
+  const char      *path               = NULL;
+  CacheRecord     *record             = NULL;
+  g_autofree char *module_dir         = NULL;
+  g_autofree char *index_path         = NULL;
+  gboolean         result             = FALSE;
+
+  /* Batch up the changes made while
+   * images are being loaded in bulk
+   */
+  dex_await (dex_timeout_new_seconds (SAVE_DELAY_SECONDS), NULL);
+
+  locker = g_mutex_locker_new (&index_mutex);
+  save_scheduled = FALSE;
+
+  builder = g_variant_builder_new (G_VARIANT_TYPE ("a{s(txxss)}"));
+  g_hash_table_iter_init (&iter, index_records);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &path, (gpointer *) &record))
+    g_variant_builder_add (
+        builder, "{s(txxss)}", path,
+        record->size, record->birth, record->last_access,
+        record->etag != NULL ? record->etag : "",
+        record->last_modified != NULL ? record->last_modified : "");
+  variant = g_variant_ref_sink (g_variant_new (
+      "(ua{s(txxss)})", (guint32) INDEX_VERSION, builder));
+  g_clear_pointer (&locker, g_mutex_locker_free);
+
+  module_dir = bz_dup_module_dir ();
+  index_path = g_build_filename (module_dir, INDEX_FILENAME, NULL);
+
+  if (g_mkdir_with_parents (module_dir, 0755) != 0)
+    return dex_future_new_reject (
+        G_IO_ERROR,
+        g_io_error_from_errno (errno),
+        "Failed to create image cache directory at %s: %s",
+        module_dir, g_strerror (errno));
+
+  result = g_file_set_contents (
+      index_path,
+      g_variant_get_data (variant),
+      g_variant_get_size (variant),
+      &local_error);
+  if (!result)
+    {
+      g_warning ("Failed to write image cache index to %s: %s",
+                 index_path, local_error->message);
+      return dex_future_new_for_error (g_steal_pointer (&local_error));
+    }
+
+  return dex_future_new_true ();
+}
+
+static DexFuture *
+sweep_legacy_fiber (gpointer data)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  g_autofree char *legacy_dir     = NULL;
+  g_autoptr (GFile) dir           = NULL;
+
+  legacy_dir = bz_dup_cache_dir (LEGACY_MODULE);
+  dir        = g_file_new_for_path (legacy_dir);
+  sweep_legacy_dir (dir, g_get_real_time () / G_USEC_PER_SEC);
+
+  /* Write out an index, even an empty one, so
+   * this only happens once
+   */
+  locker = g_mutex_locker_new (&index_mutex);
+  schedule_save_locked ();
+
+  return dex_future_new_true ();
+}
+
+/* Removes the metadata files which used to sit next
+ * to each cached image, along with the images they
+ * describe and any downscaled renditions the index
+ * doesn't know about
+ */
+static void
+sweep_legacy_dir (GFile  *dir,
+                  guint64 before)
+{
+  g_autoptr (GFileEnumerator) enumerator = NULL;
+
+  enumerator = g_file_enumerate_children (
+      dir,
+      G_FILE_ATTRIBUTE_STANDARD_NAME
+      "," G_FILE_ATTRIBUTE_STANDARD_TYPE
+      "," G_FILE_ATTRIBUTE_TIME_MODIFIED,
+      G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+      NULL, NULL);
+  if (enumerator == NULL)
+    return;
+
+  for (;;)
+    {
+      g_autoptr (GFileInfo) info = NULL;
+      g_autoptr (GFile) child    = NULL;
+      g_autofree char *path      = NULL;
+      const char      *name      = NULL;
+      gboolean         remove    = FALSE;
+
+      info = g_file_enumerator_next_file (enumerator, NULL, NULL);
+      if (info == NULL)
+        break;
+
+      name  = g_file_info_get_name (info);
+      child = g_file_enumerator_get_child (enumerator, info);
+      if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        {
+          sweep_legacy_dir (child, before);
+          continue;
+        }
+
+      path = g_file_get_path (child);
+      if (g_str_has_suffix (name, LEGACY_DATA_SUFFIX))
+        {
+          g_autofree char *image_path = NULL;
+
+          image_path = g_strndup (path, strlen (path) - strlen (LEGACY_DATA_SUFFIX));
+          g_mutex_lock (&index_mutex);
+          if (!g_hash_table_contains (index_records, image_path))
+            g_unlink (image_path);
+          g_mutex_unlock (&index_mutex);
+
+          remove = TRUE;
+        }
+      /* Renditions written since the sweep started are
+       * about to be recorded, so leave those alone
+       */
+      else if (strchr (name, '@') != NULL &&
+               g_str_has_suffix (name, ".png") &&
+               g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED) < before)
+        {
+          g_mutex_lock (&index_mutex);
+          remove = !g_hash_table_contains (index_records, path);
+          g_mutex_unlock (&index_mutex);
+        }
+
+      if (remove)
+        g_unlink (path);
+    }
+}
+
+static void
+remove_files (GPtrArray *paths)
+{
+  for (guint i = 0; i < paths->len; i++)
+    g_unlink (g_ptr_array_index (paths, i));
+}
+
+/* End of bz-image-cache.c */
@@ -0,0 +1,66 @@
+/* bz-image-cache.h
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  BZ_IMAGE_CACHE_MISS = 0,
+  BZ_IMAGE_CACHE_FRESH,
+  BZ_IMAGE_CACHE_STALE,
+} BzImageCacheState;
+
+void
+bz_image_cache_set_budget (guint64 bytes);
+
+guint64
+bz_image_cache_get_budget (void);
+
+gboolean
+bz_image_cache_lookup (const char *path,
+                       GTimeSpan   max_age);
+
+BzImageCacheState
+bz_image_cache_query (const char *path,
+                      GTimeSpan   max_age,
+                      char      **etag,
+                      char      **last_modified);
+
+void
+bz_image_cache_refresh (const char *path);
+
+void
+bz_image_cache_record (const char *path);
+
+void
+bz_image_cache_record_with_validators (const char *path,
+                                       const char *etag,
+                                       const char *last_modified);
+
+void
+bz_image_cache_forget (const char *path);
+
+G_END_DECLS
+
+/* End of bz-image-cache.h */
@@ -0,0 +1,121 @@
+/* bz-image-scale.c
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "BAZAAR::IMAGE-SCALE"
+
+#include "config.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "bz-image-scale.h"
+
+void
+bz_image_scale_fit (int  width,
+                    int  height,
+                    int  max_size,
+                    int *out_width,
+                    int *out_height)
+{
+  double scale = 0.0;
+
+  g_return_if_fail (out_width != NULL);
+  g_return_if_fail (out_height != NULL);
+
+  if (max_size <= 0 || MAX (width, height) <= max_size)
+    {
+      *out_width  = width;
+      *out_height = height;
+      return;
+    }
+
+  scale       = (double) max_size / (double) MAX (width, height);
+  *out_width  = MAX (1, (int) round (width * scale));
+  *out_height = MAX (1, (int) round (height * scale));
+}
+
+void
+bz_image_scale_rgba (const guint8 *src,
+                     int           src_width,
+                     int           src_height,
+                     gsize         src_stride,
+                     guint8       *dst,
+                     int           dst_width,
+                     int           dst_height,
+                     gsize         dst_stride)
+{
+  g_return_if_fail (src != NULL);
+  g_return_if_fail (dst != NULL);
+  g_return_if_fail (dst_width <= src_width && dst_height <= src_height);
+
+  if (dst_width == src_width && dst_height == src_height)
+    {
+      for (int y = 0; y < dst_height; y++)
+        memcpy (dst + (gsize) y * dst_stride,
+                src + (gsize) y * src_stride,
+                (gsize) dst_width * 4);
+      return;
+    }
+
+  for (int y = 0; y < dst_height; y++)
+    {
+      int y0 = 0;
+      int y1 = 0;
+
+      y0 = (int) ((gint64) y * src_height / dst_height);
+      y1 = MAX (y0 + 1, (int) ((gint64) (y + 1) * src_height / dst_height));
+
+      for (int x = 0; x < dst_width; x++)
+        {
+          int     x0       = 0;
+          int     x1       = 0;
+          guint   count    = 0;
+          guint32 sum[4]   = { 0 };
+          guint8 *dst_base = NULL;
+
+          x0 = (int) ((gint64) x * src_width / dst_width);
+          x1 = MAX (x0 + 1, (int) ((gint64) (x + 1) * src_width / dst_width));
+
+          for (int sy = y0; sy < y1; sy++)
+            {
+              const guint8 *row = src + (gsize) sy * src_stride;
+
+              for (int sx = x0; sx < x1; sx++)
+                {
+                  const guint8 *pixel = row + (gsize) sx * 4;
+
+                  sum[0] += pixel[0];
+                  sum[1] += pixel[1];
+                  sum[2] += pixel[2];
+                  sum[3] += pixel[3];
+                }
+            }
+          count = (guint) ((y1 - y0) * (x1 - x0));
+
+          dst_base    = dst + (gsize) y * dst_stride + (gsize) x * 4;
+          dst_base[0] = sum[0] / count;
+          dst_base[1] = sum[1] / count;
+          dst_base[2] = sum[2] / count;
+          dst_base[3] = sum[3] / count;
+        }
+    }
+}
+
+/* End of bz-image-scale.c */
@@ -0,0 +1,54 @@
+/* bz-image-scale.h
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Computes the size of an image scaled down to fit
+ * within @max_size, preserving its aspect ratio. Images
+ * that already fit are left at their original size
+ */
+void
+bz_image_scale_fit (int  width,
+                    int  height,
+                    int  max_size,
+                    int *out_width,
+                    int *out_height);
+
+/* Scales 8 bit premultiplied RGBA pixels from @src into
+ * @dst by averaging the area each output pixel covers.
+ * The destination must not be larger than the source
+ */
+void
+bz_image_scale_rgba (const guint8 *src,
+                     int           src_width,
+                     int           src_height,
+                     gsize         src_stride,
+                     guint8       *dst,
+                     int           dst_width,
+                     int           dst_height,
+                     gsize         dst_stride);
+
+G_END_DECLS
+
+/* End of bz-image-scale.h */
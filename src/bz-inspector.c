@@ -20,6 +20,7 @@
 
 #include "bz-inspector.h"
 #include "bz-entry-inspector.h"
+#include "bz-network-metrics.h"
 
 struct _BzInspector
 {
@@ -29,6 +30,9 @@ struct _BzInspector
 
   GtkEditable        *search_entry;
   GtkFilterListModel *filter_model;
+  GtkLabel           *network_summary;
+  GtkStringList      *network_requests;
+  GtkLabel           *trace_label;
 };
 
 G_DEFINE_FINAL_TYPE (BzInspector, bz_inspector, ADW_TYPE_WINDOW);
@@ -47,6 +51,12 @@ static gboolean
 filter_func (BzEntryGroup *group,
              BzInspector  *self);
 
+static void
+refresh_network (BzInspector *self);
+
+static char *
+format_record (const BzNetworkRecord *record);
+
 static void
 bz_inspector_dispose (GObject *object)
 {
@@ -130,6 +140,31 @@ decache_and_inspect_cb (GtkListItem *list_item,
     }
 }
 
+static void
+refresh_network_cb (BzInspector *self,
+                    GtkButton   *button)
+{
+  refresh_network (self);
+}
+
+static void
+export_trace_cb (BzInspector *self,
+                 GtkButton   *button)
+{
+  g_autoptr (GError) local_error = NULL;
+  g_autofree char *path          = NULL;
+  g_autofree char *text          = NULL;
+
+  path = bz_network_metrics_export_trace (&local_error);
+  if (path != NULL)
+    text = g_strdup_printf ("Trace written to %s", path);
+  else
+    text = g_strdup_printf ("Could not export trace: %s", local_error->message);
+
+  gtk_label_set_label (self->trace_label, text);
+  gtk_widget_set_visible (GTK_WIDGET (self->trace_label), TRUE);
+}
+
 static void
 bz_inspector_class_init (BzInspectorClass *klass)
 {
@@ -152,8 +187,13 @@ bz_inspector_class_init (BzInspectorClass *klass)
   gtk_widget_class_set_template_from_resource (widget_class, "/io/github/kolunmi/Bazaar/bz-inspector.ui");
   gtk_widget_class_bind_template_child (widget_class, BzInspector, search_entry);
   gtk_widget_class_bind_template_child (widget_class, BzInspector, filter_model);
+  gtk_widget_class_bind_template_child (widget_class, BzInspector, network_summary);
+  gtk_widget_class_bind_template_child (widget_class, BzInspector, network_requests);
+  gtk_widget_class_bind_template_child (widget_class, BzInspector, trace_label);
   gtk_widget_class_bind_template_callback (widget_class, decache_and_inspect_cb);
   gtk_widget_class_bind_template_callback (widget_class, entry_changed);
+  gtk_widget_class_bind_template_callback (widget_class, refresh_network_cb);
+  gtk_widget_class_bind_template_callback (widget_class, export_trace_cb);
 }
 
 static void
@@ -165,6 +205,8 @@ bz_inspector_init (BzInspector *self)
 
   filter = gtk_custom_filter_new ((GtkCustomFilterFunc) filter_func, self, NULL);
   gtk_filter_list_model_set_filter (self->filter_model, GTK_FILTER (filter));
+
+  refresh_network (self);
 }
 
 BzInspector *
@@ -216,4 +258,102 @@ filter_func (BzEntryGroup *group,
   return FALSE;
 }
 
+static void
+refresh_network (BzInspector *self)
+{
+  g_autoptr (GPtrArray) records = NULL;
+  g_autoptr (GPtrArray) rows    = NULL;
+  guint     n_network           = 0;
+  guint     n_cached            = 0;
+  GTimeSpan queue_wait          = 0;
+  GTimeSpan time_to_first_byte  = 0;
+  GTimeSpan total               = 0;
+  g_autofree char *summary      = NULL;
+
+  records = bz_network_metrics_dup_records ();
+  rows    = g_ptr_array_new_with_free_func (g_free);
+
+  /* Newest first */
+  for (guint i = records->len; i > 0; i--)
+    {
+      BzNetworkRecord *record = g_ptr_array_index (records, i - 1);
+
+      g_ptr_array_add (rows, format_record (record));
+
+      if (record->attempts == 0)
+        {
+          n_cached++;
+          continue;
+        }
+
+      n_network++;
+      queue_wait += record->queue_wait;
+      time_to_first_byte += record->time_to_first_byte;
+      total += record->total;
+    }
+  g_ptr_array_add (rows, NULL);
+
+  gtk_string_list_splice (
+      self->network_requests, 0,
+      g_list_model_get_n_items (G_LIST_MODEL (self->network_requests)),
+      (const char *const *) rows->pdata);
+
+  /* Queue wait is time spent behind our own per-host
+   * limit, time to first byte is mostly the server
+   */
+  if (n_network > 0)
+    summary = g_strdup_printf (
+        "%u requests, %u served from cache. "
+        "Over the network, mean queue wait %.1f ms, "
+        "mean time to first byte %.1f ms, mean total %.1f ms",
+        n_network + n_cached, n_cached,
+        queue_wait / (double) n_network / 1000.0,
+        time_to_first_byte / (double) n_network / 1000.0,
+        total / (double) n_network / 1000.0);
+  else
+    summary = g_strdup_printf (
+        "%u requests, %u served from cache",
+        n_cached, n_cached);
+  gtk_label_set_label (self->network_summary, summary);
+}
+
+static char *
+format_record (const BzNetworkRecord *record)
+{
+  g_autoptr (GDateTime) started = NULL;
+  g_autofree char *time         = NULL;
+  g_autofree char *outcome      = NULL;
+  g_autofree char *size         = NULL;
+
+  started = g_date_time_new_from_unix_local_usec (record->started_at);
+  time    = g_date_time_format (started, "%T");
+
+  if (record->error != NULL)
+    outcome = g_strdup_printf ("error (%s)", record->error);
+  else if (record->attempts == 0)
+    outcome = g_strdup ("---");
+  else
+    outcome = g_strdup_printf ("%u", record->status);
+
+  if (record->bytes >= 0)
+    size = g_format_size (record->bytes);
+  else
+    size = g_strdup ("streamed");
+
+  return g_strdup_printf (
+      "%s  %s %s%s  %s  cache %s  %s  "
+      "wait %.1f ms  ttfb %.1f ms  total %.1f ms%s",
+      time,
+      record->method,
+      record->host,
+      record->endpoint,
+      outcome,
+      bz_network_cache_status_to_string (record->cache),
+      size,
+      record->queue_wait / 1000.0,
+      record->time_to_first_byte / 1000.0,
+      record->total / 1000.0,
+      record->attempts > 1 ? "  retried" : "");
+}
+
 /* End of bz-inspector.c */
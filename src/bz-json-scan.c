@@ -0,0 +1,454 @@
+/* bz-json-scan.c
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN "BAZAAR::JSON-SCAN"
+
+/* Guards against pathological nesting, the
+ * documents we scan are only a few levels deep
+ */
+#define MAX_DEPTH 512
+
+#include "config.h"
+
+#include <string.h>
+
+#include <gio/gio.h>
+
+#include "bz-json-scan.h"
+
+typedef struct
+{
+  const char *pos;
+  const char *start;
+  const char *end;
+} Scanner;
+
+static gboolean
+fail (Scanner    *scanner,
+      const char *what,
+      GError    **error);
+
+static void
+skip_whitespace (Scanner *scanner);
+
+static gboolean
+expect (Scanner *scanner,
+        char     c,
+        GError **error);
+
+static gboolean
+read_hex4 (Scanner  *scanner,
+           gunichar *out);
+
+static gboolean
+read_string (Scanner *scanner,
+             GString *out,
+             GError **error);
+
+static gboolean
+skip_value (Scanner *scanner,
+            GError **error);
+
+static gboolean
+scan_object (Scanner    *scanner,
+             const char *field,
+             GString    *key,
+             char      **out_value,
+             GError    **error);
+
+GPtrArray *
+bz_json_scan_strings (const char *data,
+                      gsize       size,
+                      const char *array_member,
+                      const char *field,
+                      GError    **error)
+{
+  Scanner scanner               = { 0 };
+  g_autoptr (GString) key       = NULL;
+  g_autoptr (GPtrArray) strings = NULL;
+
+  g_return_val_if_fail (data != NULL || size == 0, NULL);
+  g_return_val_if_fail (array_member != NULL, NULL);
+  g_return_val_if_fail (field != NULL, NULL);
+
+  scanner.pos   = data;
+  scanner.start = data;
+  scanner.end   = data + size;
+
+  key     = g_string_new (NULL);
+  strings = g_ptr_array_new_with_free_func (g_free);
+
+  skip_whitespace (&scanner);
+  if (!expect (&scanner, '{', error))
+    return NULL;
+
+  skip_whitespace (&scanner);
+  if (scanner.pos < scanner.end && *scanner.pos == '}')
+    goto missing;
+
+  for (;;)
+    {
+      g_string_truncate (key, 0);
+      skip_whitespace (&scanner);
+      if (!read_string (&scanner, key, error))
+        return NULL;
+      skip_whitespace (&scanner);
+      if (!expect (&scanner, ':', error))
+        return NULL;
+      skip_whitespace (&scanner);
+
+      if (g_strcmp0 (key->str, array_member) == 0)
+        break;
+
+      if (!skip_value (&scanner, error))
+        return NULL;
+      skip_whitespace (&scanner);
+
+      if (scanner.pos < scanner.end && *scanner.pos == ',')
+        scanner.pos++;
+      else if (expect (&scanner, '}', error))
+        goto missing;
+      else
+        return NULL;
+    }
+
+  if (!expect (&scanner, '[', error))
+    return NULL;
+
+  skip_whitespace (&scanner);
+  if (scanner.pos < scanner.end && *scanner.pos == ']')
+    return g_steal_pointer (&strings);
+
+  for (;;)
+    {
+      skip_whitespace (&scanner);
+      if (scanner.pos < scanner.end && *scanner.pos == '{')
+        {
+          char *value = NULL;
+
+          if (!scan_object (&scanner, field, key, &value, error))
+            return NULL;
+          if (value != NULL)
+            g_ptr_array_add (strings, value);
+        }
+      else if (!skip_value (&scanner, error))
+        return NULL;
+      skip_whitespace (&scanner);
+
+      if (scanner.pos < scanner.end && *scanner.pos == ',')
+        scanner.pos++;
+      else if (expect (&scanner, ']', error))
+        break;
+      else
+        return NULL;
+    }
+
+  /* Whatever follows the array is of no interest */
+  return g_steal_pointer (&strings);
+
+missing:
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+               "JSON document has no member \"%s\"", array_member);
+  return NULL;
+}
+
+static gboolean
+fail (Scanner    *scanner,
+      const char *what,
+      GError    **error)
+{
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+               "Malformed JSON at offset %" G_GSIZE_FORMAT ": %s",
+               (gsize) (scanner->pos - scanner->start), what);
+  return FALSE;
+}
+
+static void
+skip_whitespace (Scanner *scanner)
+{
+  while (scanner->pos < scanner->end &&
+         (*scanner->pos == ' ' ||
+          *scanner->pos == '\t' ||
+          *scanner->pos == '\n' ||
+          *scanner->pos == '\r'))
+    scanner->pos++;
+}
+
+static gboolean
+expect (Scanner *scanner,
+        char     c,
+        GError **error)
+{
+  char what[] = "expected 'x'";
+
+  if (scanner->pos < scanner->end && *scanner->pos == c)
+    {
+      scanner->pos++;
+      return TRUE;
+    }
+
+  what[10] = c;
+  return fail (scanner, what, error);
+}
+
+static gboolean
+read_hex4 (Scanner  *scanner,
+           gunichar *out)
+{
+  gunichar value = 0;
+
+  if (scanner->end - scanner->pos < 4)
+    return FALSE;
+
+  for (int i = 0; i < 4; i++)
+    {
+      int digit = g_ascii_xdigit_value (scanner->pos[i]);
+
+      if (digit < 0)
+        return FALSE;
+      value = (value << 4) | digit;
+    }
+
+  scanner->pos += 4;
+  *out = value;
+  return TRUE;
+}
+
+/* With @out set to NULL the string is only
+ * stepped over, which is all most of them need
+ */
+static gboolean
+read_string (Scanner *scanner,
+             GString *out,
+             GError **error)
+{
+  if (!expect (scanner, '"', error))
+    return FALSE;
+
+  for (;;)
+    {
+      const char *run = scanner->pos;
+
+      while (scanner->pos < scanner->end &&
+             *scanner->pos != '"' &&
+             *scanner->pos != '\\')
+        scanner->pos++;
+      if (out != NULL)
+        g_string_append_len (out, run, scanner->pos - run);
+
+      if (scanner->pos >= scanner->end)
+        return fail (scanner, "unterminated string", error);
+      if (*scanner->pos++ == '"')
+        break;
+      if (scanner->pos >= scanner->end)
+        return fail (scanner, "unterminated escape", error);
+
+      switch (*scanner->pos++)
+        {
+        case '"':
+          if (out != NULL)
+            g_string_append_c (out, '"');
+          break;
+        case '\\':
+          if (out != NULL)
+            g_string_append_c (out, '\\');
+          break;
+        case '/':
+          if (out != NULL)
+            g_string_append_c (out, '/');
+          break;
+        case 'b':
+          if (out != NULL)
+            g_string_append_c (out, '\b');
+          break;
+        case 'f':
+          if (out != NULL)
+            g_string_append_c (out, '\f');
+          break;
+        case 'n':
+          if (out != NULL)
+            g_string_append_c (out, '\n');
+          break;
+        case 'r':
+          if (out != NULL)
+            g_string_append_c (out, '\r');
+          break;
+        case 't':
+          if (out != NULL)
+            g_string_append_c (out, '\t');
+          break;
+        case 'u':
+          {
+            gunichar unichar = 0;
+
+            if (!read_hex4 (scanner, &unichar))
+              return fail (scanner, "invalid unicode escape", error);
+
+            if (unichar >= 0xd800 && unichar < 0xdc00)
+              {
+                gunichar low = 0;
+
+                if (scanner->end - scanner->pos < 2 ||
+                    scanner->pos[0] != '\\' ||
+                    scanner->pos[1] != 'u')
+                  return fail (scanner, "unpaired surrogate", error);
+                scanner->pos += 2;
+                if (!read_hex4 (scanner, &low) ||
+                    low < 0xdc00 || low >= 0xe000)
+                  return fail (scanner, "unpaired surrogate", error);
+
+                unichar = 0x10000 + ((unichar - 0xd800) << 10) + (low - 0xdc00);
+              }
+            else if (unichar >= 0xdc00 && unichar < 0xe000)
+              return fail (scanner, "unpaired surrogate", error);
+
+            if (out != NULL)
+              g_string_append_unichar (out, unichar);
+          }
+          break;
+        default:
+          return fail (scanner, "invalid escape", error);
+        }
+    }
+
+  return TRUE;
+}
+
+/* Steps over a value of any kind. Containers are
+ * only checked for balanced brackets, their contents
+ * are never decoded
+ */
+static gboolean
+skip_value (Scanner *scanner,
+            GError **error)
+{
+  const char *start = scanner->pos;
+  guint       depth = 0;
+
+  if (scanner->pos >= scanner->end)
+    return fail (scanner, "expected a value", error);
+
+  switch (*scanner->pos)
+    {
+    case '"':
+      return read_string (scanner, NULL, error);
+    case '{':
+    case '[':
+      break;
+    default:
+      /* Numbers and literals */
+      while (scanner->pos < scanner->end &&
+             strchr (",:]} \t\n\r\"{[", *scanner->pos) == NULL)
+        scanner->pos++;
+      if (scanner->pos == start)
+        return fail (scanner, "expected a value", error);
+      return TRUE;
+    }
+
+  while (scanner->pos < scanner->end)
+    {
+      switch (*scanner->pos)
+        {
+        case '"':
+          if (!read_string (scanner, NULL, error))
+            return FALSE;
+          continue;
+        case '{':
+        case '[':
+          if (++depth > MAX_DEPTH)
+            return fail (scanner, "nested too deeply", error);
+          break;
+        case '}':
+        case ']':
+          if (--depth == 0)
+            {
+              scanner->pos++;
+              return TRUE;
+            }
+          break;
+        default:
+          break;
+        }
+      scanner->pos++;
+    }
+
+  return fail (scanner, "unterminated container", error);
+}
+
+static gboolean
+scan_object (Scanner    *scanner,
+             const char *field,
+             GString    *key,
+             char      **out_value,
+             GError    **error)
+{
+  g_autofree char *value = NULL;
+
+  if (!expect (scanner, '{', error))
+    return FALSE;
+
+  skip_whitespace (scanner);
+  if (scanner->pos < scanner->end && *scanner->pos == '}')
+    {
+      scanner->pos++;
+      *out_value = NULL;
+      return TRUE;
+    }
+
+  for (;;)
+    {
+      g_string_truncate (key, 0);
+      skip_whitespace (scanner);
+      if (!read_string (scanner, key, error))
+        return FALSE;
+      skip_whitespace (scanner);
+      if (!expect (scanner, ':', error))
+        return FALSE;
+      skip_whitespace (scanner);
+
+      if (value == NULL &&
+          g_strcmp0 (key->str, field) == 0 &&
+          scanner->pos < scanner->end &&
+          *scanner->pos == '"')
+        {
+          g_autoptr (GString) string = NULL;
+
+          string = g_string_new (NULL);
+          if (!read_string (scanner, string, error))
+            return FALSE;
+          value = g_string_free (g_steal_pointer (&string), FALSE);
+        }
+      else if (!skip_value (scanner, error))
+        return FALSE;
+      skip_whitespace (scanner);
+
+      if (scanner->pos < scanner->end && *scanner->pos == ',')
+        scanner->pos++;
+      else if (expect (scanner, '}', error))
+        break;
+      else
+        return FALSE;
+    }
+
+  *out_value = g_steal_pointer (&value);
+  return TRUE;
+}
+
+/* End of bz-json-scan.c */
@@ -0,0 +1,43 @@
+/* bz-json-scan.h
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Walks the JSON document in @data without building a
+ * tree and collects the string value of @field from each
+ * object in the top level @array_member. Elements that
+ * lack the field are skipped, and the rest of the
+ * document after the array is never looked at. Returns a
+ * #GPtrArray of strings owned by the array
+ */
+GPtrArray *
+bz_json_scan_strings (const char *data,
+                      gsize       size,
+                      const char *array_member,
+                      const char *field,
+                      GError    **error);
+
+G_END_DECLS
+
+/* End of bz-json-scan.h */
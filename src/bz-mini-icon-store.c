@@ -0,0 +1,442 @@
+/* bz-mini-icon-store.c
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN  "BAZAAR::MINI-ICON-STORE"
+#define BAZAAR_MODULE "mini-icon-store"
+
+#define STORE_FILENAME     "icons"
+#define STORE_VERSION      1
+#define SAVE_DELAY_SECONDS 5
+#define MINI_ICON_SIZE     24
+#define SERIALIZED_TAG     "bz-mini-icon"
+#define KEY_DATA           "bz-mini-icon-key"
+#define LEGACY_SUFFIX      "-24x24.png"
+#define LEGACY_MODULE      "entry"
+
+#include "config.h"
+
+#include <cairo.h>
+#include <errno.h>
+#include <glib/gstdio.h>
+
+#include "bz-env.h"
+#include "bz-io.h"
+#include "bz-mini-icon-store.h"
+
+/* Every 24x24 icon handed to the gnome-shell search provider
+ * lives in one packed file, which is mapped once and sliced
+ * into GBytesIcons. The shell then receives the pixels inline
+ * instead of opening a file for each result
+ */
+
+static GMutex       store_mutex    = { 0 };
+static GHashTable  *store_icons    = NULL;
+static GMappedFile *store_mapped   = NULL;
+static gboolean     save_scheduled = FALSE;
+
+static void
+ensure_store_locked (void);
+
+static GIcon *
+make_icon (const char *key,
+           GBytes     *bytes);
+
+static GBytes *
+render_mini_icon (const char *path);
+
+static void
+schedule_save_locked (void);
+
+static DexFuture *
+save_fiber (gpointer data);
+
+static DexFuture *
+sweep_legacy_fiber (gpointer data);
+
+GIcon *
+bz_mini_icon_store_lookup (const char *key)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  GBytes *bytes                   = NULL;
+
+  g_return_val_if_fail (key != NULL, NULL);
+
+  locker = g_mutex_locker_new (&store_mutex);
+  ensure_store_locked ();
+
+  bytes = g_hash_table_lookup (store_icons, key);
+  if (bytes == NULL)
+    return NULL;
+
+  return make_icon (key, bytes);
+}
+
+GIcon *
+bz_mini_icon_store_ensure (const char *key,
+                           const char *path)
+{
+  GIcon *icon                     = NULL;
+  g_autoptr (GBytes) bytes        = NULL;
+  g_autoptr (GMutexLocker) locker = NULL;
+  GBytes *existing                = NULL;
+
+  g_return_val_if_fail (key != NULL, NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+
+  icon = bz_mini_icon_store_lookup (key);
+  if (icon != NULL)
+    return icon;
+
+  bytes = render_mini_icon (path);
+  if (bytes == NULL)
+    return NULL;
+
+  locker = g_mutex_locker_new (&store_mutex);
+
+  /* Someone else may have beaten us to it */
+  existing = g_hash_table_lookup (store_icons, key);
+  if (existing != NULL)
+    return make_icon (key, existing);
+
+  g_hash_table_replace (store_icons, g_strdup (key), g_bytes_ref (bytes));
+  schedule_save_locked ();
+
+  return make_icon (key, bytes);
+}
+
+void
+bz_mini_icon_store_prune (GHashTable *keep)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  GHashTableIter iter             = { 0 };
+  const char    *key              = NULL;
+  guint          n_removed        = 0;
+
+  g_return_if_fail (keep != NULL);
+
+  locker = g_mutex_locker_new (&store_mutex);
+  ensure_store_locked ();
+
+  g_hash_table_iter_init (&iter, store_icons);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &key, NULL))
+    {
+      if (!g_hash_table_contains (keep, key))
+        {
+          g_hash_table_iter_remove (&iter);
+          n_removed++;
+        }
+    }
+
+  if (n_removed > 0)
+    {
+      g_debug ("Pruned %u mini icons no longer in the catalog", n_removed);
+      schedule_save_locked ();
+    }
+}
+
+GVariant *
+bz_mini_icon_store_serialize (GIcon *icon)
+{
+  const char *key = NULL;
+
+  g_return_val_if_fail (G_IS_ICON (icon), NULL);
+
+  key = g_object_get_data (G_OBJECT (icon), KEY_DATA);
+  if (key == NULL)
+    return g_icon_serialize (icon);
+
+  return g_variant_ref_sink (g_variant_new (
+      "(sv)", SERIALIZED_TAG, g_variant_new_string (key)));
+}
+
+GIcon *
+bz_mini_icon_store_deserialize (GVariant *variant)
+{
+  const char *tag              = NULL;
+  g_autoptr (GVariant) payload = NULL;
+
+  g_return_val_if_fail (variant != NULL, NULL);
+
+  if (!g_variant_is_of_type (variant, G_VARIANT_TYPE ("(sv)")))
+    return g_icon_deserialize (variant);
+
+  g_variant_get (variant, "(&sv)", &tag, &payload);
+  if (g_strcmp0 (tag, SERIALIZED_TAG) != 0)
+    return g_icon_deserialize (variant);
+
+  if (!g_variant_is_of_type (payload, G_VARIANT_TYPE_STRING))
+    return NULL;
+  return bz_mini_icon_store_lookup (g_variant_get_string (payload, NULL));
+}
+
+static void
+ensure_store_locked (void)
+{
+  g_autoptr (GError) local_error = NULL;
+  g_autofree char *module_dir    = NULL;
+  g_autofree char *store_path    = NULL;
+  g_autoptr (GBytes) bytes       = NULL;
+  g_autoptr (GVariant) variant   = NULL;
+  g_autoptr (GVariant) icons     = NULL;
+  guint32 version                = 0;
+  gsize   n_icons                = 0;
+
+  if (store_icons != NULL)
+    return;
+  store_icons = g_hash_table_new_full (
+      g_str_hash, g_str_equal,
+      g_free, (GDestroyNotify) g_bytes_unref);
+
+  module_dir   = bz_dup_module_dir ();
+  store_path   = g_build_filename (module_dir, STORE_FILENAME, NULL);
+  store_mapped = g_mapped_file_new (store_path, FALSE, &local_error);
+  if (store_mapped == NULL)
+    {
+      /* No store yet, so clear out the individual
+       * files older versions wrote instead
+       */
+      if (g_error_matches (local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        dex_future_disown (dex_scheduler_spawn (
+            bz_get_io_scheduler (),
+            bz_get_dex_stack_size (),
+            (DexFiberFunc) sweep_legacy_fiber,
+            NULL, NULL));
+      else
+        g_warning ("Failed to map mini icon store at %s: %s",
+                   store_path, local_error->message);
+      return;
+    }
+
+  bytes   = g_mapped_file_get_bytes (store_mapped);
+  variant = g_variant_new_from_bytes (G_VARIANT_TYPE ("(ua{say})"), bytes, FALSE);
+  g_variant_get_child (variant, 0, "u", &version);
+  if (version != STORE_VERSION)
+    {
+      g_debug ("Discarding mini icon store with version %u", version);
+      g_clear_pointer (&store_mapped, g_mapped_file_unref);
+      return;
+    }
+
+  /* The slices keep pointing into the mapping,
+   * nothing is copied here
+   */
+  icons   = g_variant_get_child_value (variant, 1);
+  n_icons = g_variant_n_children (icons);
+  for (gsize i = 0; i < n_icons; i++)
+    {
+      g_autoptr (GVariant) entry = NULL;
+      g_autoptr (GVariant) key   = NULL;
+      g_autoptr (GVariant) png   = NULL;
+
+      entry = g_variant_get_child_value (icons, i);
+      key   = g_variant_get_child_value (entry, 0);
+      png   = g_variant_get_child_value (entry, 1);
+
+      g_hash_table_replace (
+          store_icons,
+          g_variant_dup_string (key, NULL),
+          g_variant_get_data_as_bytes (png));
+    }
+
+  g_debug ("Loaded %u mini icons from %s",
+           g_hash_table_size (store_icons), store_path);
+}
+
+static GIcon *
+make_icon (const char *key,
+           GBytes     *bytes)
+{
+  GIcon *icon = NULL;
+
+  icon = g_bytes_icon_new (bytes);
+  g_object_set_data_full (G_OBJECT (icon), KEY_DATA, g_strdup (key), g_free);
+  return icon;
+}
+
+static cairo_status_t
+append_png_data (void                *closure,
+                 const unsigned char *data,
+                 unsigned int         length)
+{
+  g_byte_array_append (closure, data, length);
+  return CAIRO_STATUS_SUCCESS;
+}
+
+static GBytes *
+render_mini_icon (const char *path)
+{
+  cairo_surface_t *surface_in  = NULL;
+  int              width       = 0;
+  int              height      = 0;
+  cairo_surface_t *surface_out = NULL;
+  cairo_t         *cairo       = NULL;
+  GByteArray      *png         = NULL;
+  cairo_status_t   status      = CAIRO_STATUS_SUCCESS;
+
+  surface_in = cairo_image_surface_create_from_png (path);
+  if (cairo_surface_status (surface_in) != CAIRO_STATUS_SUCCESS)
+    {
+      g_debug ("Could not read %s to make a mini icon: %s",
+               path, cairo_status_to_string (cairo_surface_status (surface_in)));
+      cairo_surface_destroy (surface_in);
+      return NULL;
+    }
+  width  = cairo_image_surface_get_width (surface_in);
+  height = cairo_image_surface_get_height (surface_in);
+
+  surface_out = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, MINI_ICON_SIZE, MINI_ICON_SIZE);
+  cairo       = cairo_create (surface_out);
+
+  cairo_scale (cairo,
+               (double) MINI_ICON_SIZE / (double) width,
+               (double) MINI_ICON_SIZE / (double) height);
+  cairo_set_source_surface (cairo, surface_in, 0, 0);
+  cairo_paint (cairo);
+  cairo_destroy (cairo);
+  cairo_surface_flush (surface_out);
+
+  png    = g_byte_array_new ();
+  status = cairo_surface_write_to_png_stream (surface_out, append_png_data, png);
+  cairo_surface_destroy (surface_in);
+  cairo_surface_destroy (surface_out);
+
+  if (status != CAIRO_STATUS_SUCCESS)
+    {
+      g_byte_array_unref (png);
+      return NULL;
+    }
+  return g_byte_array_free_to_bytes (png);
+}
+
+static void
+schedule_save_locked (void)
+{
+  if (save_scheduled)
+    return;
+  save_scheduled = TRUE;
+
+  dex_future_disown (dex_scheduler_spawn (
+      bz_get_io_scheduler (),
+      bz_get_dex_stack_size (),
+      (DexFiberFunc) save_fiber,
+      NULL, NULL));
+}
+
+static DexFuture *
+save_fiber (gpointer data)
+{
+  g_autoptr (GError) local_error      = NULL;
+  g_autoptr (GMutexLocker) locker     = NULL;
+  g_autoptr (GVariantBuilder) builder = NULL;
+  g_autoptr (GVariant) variant        = NULL;
+  GHashTableIter   iter               = { 0 };
+  const char      *key                = NULL;
+  GBytes          *bytes              = NULL;
+  g_autofree char *module_dir         = NULL;
+  g_autofree char *store_path         = NULL;
+  gboolean         result             = FALSE;
+
+  /* Refreshes produce icons in bulk, so
+   * write them all out in one go
+   */
+  dex_await (dex_timeout_new_seconds (SAVE_DELAY_SECONDS), NULL);
+
+  locker = g_mutex_locker_new (&store_mutex);
+  save_scheduled = FALSE;
+
+  builder = g_variant_builder_new (G_VARIANT_TYPE ("a{say}"));
+  g_hash_table_iter_init (&iter, store_icons);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &key, (gpointer *) &bytes))
+    g_variant_builder_add (
+        builder, "{s@ay}", key,
+        g_variant_new_from_bytes (G_VARIANT_TYPE_BYTESTRING, bytes, TRUE));
+  variant = g_variant_ref_sink (g_variant_new (
+      "(ua{say})", (guint32) STORE_VERSION, builder));
+  g_clear_pointer (&locker, g_mutex_locker_free);
+
+  module_dir = bz_dup_module_dir ();
+  store_path = g_build_filename (module_dir, STORE_FILENAME, NULL);
+
+  if (g_mkdir_with_parents (module_dir, 0755) != 0)
+    return dex_future_new_reject (
+        G_IO_ERROR,
+        g_io_error_from_errno (errno),
+        "Failed to create mini icon store directory at %s: %s",
+        module_dir, g_strerror (errno));
+
+  /* This replaces the file by renaming over it, so
+   * the old mapping stays valid for existing slices
+   */
+  result = g_file_set_contents (
+      store_path,
+      g_variant_get_data (variant),
+      g_variant_get_size (variant),
+      &local_error);
+  if (!result)
+    {
+      g_warning ("Failed to write mini icon store to %s: %s",
+                 store_path, local_error->message);
+      return dex_future_new_for_error (g_steal_pointer (&local_error));
+    }
+
+  return dex_future_new_true ();
+}
+
+static DexFuture *
+sweep_legacy_fiber (gpointer data)
+{
+  g_autoptr (GMutexLocker) locker        = NULL;
+  g_autofree char *legacy_dir            = NULL;
+  g_autoptr (GFile) dir                  = NULL;
+  g_autoptr (GFileEnumerator) enumerator = NULL;
+
+  legacy_dir = bz_dup_cache_dir (LEGACY_MODULE);
+  dir        = g_file_new_for_path (legacy_dir);
+  enumerator = g_file_enumerate_children (
+      dir,
+      G_FILE_ATTRIBUTE_STANDARD_NAME,
+      G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+      NULL, NULL);
+
+  while (enumerator != NULL)
+    {
+      g_autoptr (GFileInfo) info = NULL;
+      g_autoptr (GFile) child    = NULL;
+
+      info = g_file_enumerator_next_file (enumerator, NULL, NULL);
+      if (info == NULL)
+        break;
+      if (!g_str_has_suffix (g_file_info_get_name (info), LEGACY_SUFFIX))
+        continue;
+
+      child = g_file_enumerator_get_child (enumerator, info);
+      g_file_delete (child, NULL, NULL);
+    }
+
+  /* Write out a store, even an empty one, so
+   * this only happens once
+   */
+  locker = g_mutex_locker_new (&store_mutex);
+  schedule_save_locked ();
+
+  return dex_future_new_true ();
+}
+
+/* End of bz-mini-icon-store.c */
@@ -0,0 +1,58 @@
+/* bz-mini-icon-store.h
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Returns the stored mini icon for @key as a #GBytesIcon,
+ * or %NULL if none has been made yet
+ */
+GIcon *
+bz_mini_icon_store_lookup (const char *key);
+
+/* Like bz_mini_icon_store_lookup(), but renders the PNG at
+ * @path into the store first if needed. Does blocking io
+ */
+GIcon *
+bz_mini_icon_store_ensure (const char *key,
+                           const char *path);
+
+/* Drops every stored icon whose key is not in the
+ * @keep set, and saves the store if anything changed
+ */
+void
+bz_mini_icon_store_prune (GHashTable *keep);
+
+/* Icons from the store serialize to a reference into
+ * it rather than their pixels, other icons are passed
+ * through g_icon_serialize() and g_icon_deserialize()
+ */
+GVariant *
+bz_mini_icon_store_serialize (GIcon *icon);
+
+GIcon *
+bz_mini_icon_store_deserialize (GVariant *variant);
+
+G_END_DECLS
+
+/* End of bz-mini-icon-store.h */
@@ -0,0 +1,327 @@
+/* bz-network-metrics.c
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#define G_LOG_DOMAIN  "BAZAAR::NETWORK-METRICS"
+#define BAZAAR_MODULE "network-metrics"
+
+#define RING_SIZE 256
+
+/* Endpoints are grouped by this many leading
+ * path segments
+ */
+#define MAX_ENDPOINT_SEGMENTS 2
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <json-glib/json-glib.h>
+
+#include "bz-io.h"
+#include "bz-network-metrics.h"
+
+static GMutex           ring_mutex      = { 0 };
+static BzNetworkRecord *ring[RING_SIZE] = { 0 };
+static guint            ring_next       = 0;
+
+G_DEFINE_QUARK (bz-network-cache-lookup-quark, bz_network_cache_lookup);
+
+static BzNetworkRecord *
+copy_record (const BzNetworkRecord *record);
+
+static char *
+classify_endpoint (const char *path);
+
+BzNetworkRecord *
+bz_network_record_new (const char *method,
+                       GUri       *uri)
+{
+  BzNetworkRecord *record = NULL;
+  const char      *host   = NULL;
+
+  g_return_val_if_fail (method != NULL, NULL);
+  g_return_val_if_fail (uri != NULL, NULL);
+
+  host = g_uri_get_host (uri);
+
+  record             = g_new0 (BzNetworkRecord, 1);
+  record->started_at = g_get_real_time ();
+  record->method     = g_strdup (method);
+  record->host       = g_strdup (host != NULL ? host : "");
+  record->endpoint   = classify_endpoint (g_uri_get_path (uri));
+  record->bytes      = -1;
+
+  return record;
+}
+
+void
+bz_network_record_free (BzNetworkRecord *record)
+{
+  if (record == NULL)
+    return;
+
+  g_free (record->method);
+  g_free (record->host);
+  g_free (record->endpoint);
+  g_free (record->error);
+  g_free (record);
+}
+
+const char *
+bz_network_cache_status_to_string (BzNetworkCacheStatus cache)
+{
+  switch (cache)
+    {
+    case BZ_NETWORK_CACHE_HIT:
+      return "hit";
+    case BZ_NETWORK_CACHE_STALE:
+      return "stale";
+    case BZ_NETWORK_CACHE_REVALIDATED:
+      return "revalidated";
+    case BZ_NETWORK_CACHE_MISS:
+      return "miss";
+    case BZ_NETWORK_CACHE_NONE:
+    default:
+      return "none";
+    }
+}
+
+void
+bz_network_metrics_take (BzNetworkRecord *record)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+
+  g_return_if_fail (record != NULL);
+
+  locker = g_mutex_locker_new (&ring_mutex);
+  g_clear_pointer (&ring[ring_next], bz_network_record_free);
+  ring[ring_next] = record;
+  ring_next       = (ring_next + 1) % RING_SIZE;
+}
+
+GPtrArray *
+bz_network_metrics_dup_records (void)
+{
+  g_autoptr (GMutexLocker) locker = NULL;
+  g_autoptr (GPtrArray) records   = NULL;
+
+  records = g_ptr_array_new_with_free_func ((GDestroyNotify) bz_network_record_free);
+
+  locker = g_mutex_locker_new (&ring_mutex);
+  for (guint i = 0; i < RING_SIZE; i++)
+    {
+      BzNetworkRecord *record = ring[(ring_next + i) % RING_SIZE];
+
+      if (record != NULL)
+        g_ptr_array_add (records, copy_record (record));
+    }
+
+  return g_steal_pointer (&records);
+}
+
+void
+bz_network_metrics_mark_cache_lookup (SoupMessage *message)
+{
+  g_return_if_fail (SOUP_IS_MESSAGE (message));
+  g_object_set_qdata (G_OBJECT (message), bz_network_cache_lookup_quark (), GINT_TO_POINTER (TRUE));
+}
+
+gboolean
+bz_network_metrics_is_cache_lookup (SoupMessage *message)
+{
+  g_return_val_if_fail (SOUP_IS_MESSAGE (message), FALSE);
+  return GPOINTER_TO_INT (g_object_get_qdata (G_OBJECT (message), bz_network_cache_lookup_quark ()));
+}
+
+char *
+bz_network_metrics_export_trace (GError **error)
+{
+  g_autoptr (GPtrArray) records       = NULL;
+  g_autoptr (JsonBuilder) builder     = NULL;
+  g_autoptr (JsonNode) root           = NULL;
+  g_autoptr (JsonGenerator) generator = NULL;
+  g_autofree char *module_dir         = NULL;
+  g_autoptr (GDateTime) now           = NULL;
+  g_autofree char *basename           = NULL;
+  g_autofree char *path               = NULL;
+  gboolean         result             = FALSE;
+
+  records = bz_network_metrics_dup_records ();
+  builder = json_builder_new ();
+
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "displayTimeUnit");
+  json_builder_add_string_value (builder, "ms");
+  json_builder_set_member_name (builder, "traceEvents");
+  json_builder_begin_array (builder);
+
+  for (guint i = 0; i < records->len; i++)
+    {
+      BzNetworkRecord *record = g_ptr_array_index (records, i);
+
+      /* Requests overlap freely, so each gets
+       * its own track
+       */
+      json_builder_begin_object (builder);
+      json_builder_set_member_name (builder, "name");
+      json_builder_add_string_value (builder, record->endpoint);
+      json_builder_set_member_name (builder, "cat");
+      json_builder_add_string_value (builder, record->host);
+      json_builder_set_member_name (builder, "ph");
+      json_builder_add_string_value (builder, "X");
+      json_builder_set_member_name (builder, "ts");
+      json_builder_add_int_value (builder, record->started_at);
+      json_builder_set_member_name (builder, "dur");
+      json_builder_add_int_value (builder, record->total);
+      json_builder_set_member_name (builder, "pid");
+      json_builder_add_int_value (builder, 1);
+      json_builder_set_member_name (builder, "tid");
+      json_builder_add_int_value (builder, i);
+
+      json_builder_set_member_name (builder, "args");
+      json_builder_begin_object (builder);
+      json_builder_set_member_name (builder, "method");
+      json_builder_add_string_value (builder, record->method);
+      json_builder_set_member_name (builder, "status");
+      json_builder_add_int_value (builder, record->status);
+      json_builder_set_member_name (builder, "cache");
+      json_builder_add_string_value (builder, bz_network_cache_status_to_string (record->cache));
+      json_builder_set_member_name (builder, "bytes");
+      json_builder_add_int_value (builder, record->bytes);
+      json_builder_set_member_name (builder, "attempts");
+      json_builder_add_int_value (builder, record->attempts);
+      json_builder_set_member_name (builder, "queue_wait_us");
+      json_builder_add_int_value (builder, record->queue_wait);
+      json_builder_set_member_name (builder, "time_to_first_byte_us");
+      json_builder_add_int_value (builder, record->time_to_first_byte);
+      if (record->error != NULL)
+        {
+          json_builder_set_member_name (builder, "error");
+          json_builder_add_string_value (builder, record->error);
+        }
+      json_builder_end_object (builder);
+      json_builder_end_object (builder);
+
+      if (record->queue_wait > 0)
+        {
+          json_builder_begin_object (builder);
+          json_builder_set_member_name (builder, "name");
+          json_builder_add_string_value (builder, "queued");
+          json_builder_set_member_name (builder, "cat");
+          json_builder_add_string_value (builder, record->host);
+          json_builder_set_member_name (builder, "ph");
+          json_builder_add_string_value (builder, "X");
+          json_builder_set_member_name (builder, "ts");
+          json_builder_add_int_value (builder, record->started_at);
+          json_builder_set_member_name (builder, "dur");
+          json_builder_add_int_value (builder, record->queue_wait);
+          json_builder_set_member_name (builder, "pid");
+          json_builder_add_int_value (builder, 1);
+          json_builder_set_member_name (builder, "tid");
+          json_builder_add_int_value (builder, i);
+          json_builder_end_object (builder);
+        }
+    }
+
+  json_builder_end_array (builder);
+  json_builder_end_object (builder);
+
+  root      = json_builder_get_root (builder);
+  generator = json_generator_new ();
+  json_generator_set_root (generator, root);
+
+  module_dir = bz_dup_module_dir ();
+  if (g_mkdir_with_parents (module_dir, 0755) != 0)
+    {
+      int errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Could not create %s: %s", module_dir, g_strerror (errsv));
+      return NULL;
+    }
+
+  now      = g_date_time_new_now_local ();
+  basename = g_date_time_format (now, "trace-%Y%m%d-%H%M%S.json");
+  path     = g_build_filename (module_dir, basename, NULL);
+
+  result = json_generator_to_file (generator, path, error);
+  if (!result)
+    return NULL;
+
+  return g_steal_pointer (&path);
+}
+
+static BzNetworkRecord *
+copy_record (const BzNetworkRecord *record)
+{
+  BzNetworkRecord *copy = NULL;
+
+  copy           = g_memdup2 (record, sizeof (*record));
+  copy->method   = g_strdup (record->method);
+  copy->host     = g_strdup (record->host);
+  copy->endpoint = g_strdup (record->endpoint);
+  copy->error    = g_strdup (record->error);
+
+  return copy;
+}
+
+/* Keeps the first few path segments, skipping api
+ * version prefixes and masking ids, so that requests
+ * for different apps land in the same class
+ */
+static char *
+classify_endpoint (const char *path)
+{
+  g_auto (GStrv) segments      = NULL;
+  g_autoptr (GString) endpoint = NULL;
+  gboolean leading             = TRUE;
+  guint    kept                = 0;
+
+  segments = g_strsplit (path != NULL ? path : "", "/", -1);
+  endpoint = g_string_new (NULL);
+
+  for (guint i = 0; segments[i] != NULL && kept < MAX_ENDPOINT_SEGMENTS; i++)
+    {
+      const char *segment = segments[i];
+
+      if (*segment == '\0')
+        continue;
+      if (leading &&
+          (g_strcmp0 (segment, "api") == 0 ||
+           (segment[0] == 'v' && g_ascii_isdigit (segment[1]))))
+        continue;
+      leading = FALSE;
+
+      g_string_append_c (endpoint, '/');
+      if (strchr (segment, '.') != NULL || g_ascii_isdigit (*segment))
+        g_string_append_c (endpoint, '*');
+      else
+        g_string_append (endpoint, segment);
+      kept++;
+    }
+
+  if (endpoint->len == 0)
+    g_string_append_c (endpoint, '/');
+
+  return g_string_free (g_steal_pointer (&endpoint), FALSE);
+}
+
+/* End of bz-network-metrics.c */
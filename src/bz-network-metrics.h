@@ -0,0 +1,97 @@
+/* bz-network-metrics.h
+ *
+ * Copyright 2025 Adam Masciola
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <libsoup/soup.h>
+
+G_BEGIN_DECLS
+
+typedef enum
+{
+  /* The request did not go through the disk cache */
+  BZ_NETWORK_CACHE_NONE = 0,
+  BZ_NETWORK_CACHE_HIT,
+  /* Served expired while revalidating in the background */
+  BZ_NETWORK_CACHE_STALE,
+  BZ_NETWORK_CACHE_REVALIDATED,
+  BZ_NETWORK_CACHE_MISS,
+} BzNetworkCacheStatus;
+
+/* Durations are in microseconds. @bytes is -1 when the
+ * body was handed to the caller unread
+ */
+typedef struct
+{
+  gint64               started_at;
+  char                *method;
+  char                *host;
+  char                *endpoint;
+  GTimeSpan            queue_wait;
+  GTimeSpan            time_to_first_byte;
+  GTimeSpan            total;
+  gint64               bytes;
+  guint                status;
+  guint                attempts;
+  BzNetworkCacheStatus cache;
+  char                *error;
+} BzNetworkRecord;
+
+BzNetworkRecord *
+bz_network_record_new (const char *method,
+                       GUri       *uri);
+
+void
+bz_network_record_free (BzNetworkRecord *record);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (BzNetworkRecord, bz_network_record_free)
+
+const char *
+bz_network_cache_status_to_string (BzNetworkCacheStatus cache);
+
+/* Adds @record to the ring of recent requests, dropping
+ * the oldest once it is full. Safe to call from any thread
+ */
+void
+bz_network_metrics_take (BzNetworkRecord *record);
+
+/* Returns copies of the recorded requests, oldest first */
+GPtrArray *
+bz_network_metrics_dup_records (void);
+
+/* Lets the request record of @message tell cache misses
+ * from revalidations
+ */
+void
+bz_network_metrics_mark_cache_lookup (SoupMessage *message);
+
+gboolean
+bz_network_metrics_is_cache_lookup (SoupMessage *message);
+
+/* Writes the recorded requests as a Chrome trace event
+ * file, which can be opened in Perfetto or about:tracing.
+ * Returns the path of the new file
+ */
+char *
+bz_network_metrics_export_trace (GError **error);
+
+G_END_DECLS
+
+/* End of bz-network-metrics.h */
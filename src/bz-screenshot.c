@@ -21,6 +21,11 @@
 #include "bz-screenshot.h"
 #include "bz-async-texture.h"
 
+/* Size hints are rounded up to this step so
+ * small resizes don't cause the texture to reload
+ */
+#define SIZE_HINT_STEP 256
+
 struct _BzScreenshot
 {
   GtkWidget parent_instance;
@@ -67,6 +72,10 @@ bz_screenshot_dispose (GObject *object)
       g_signal_handlers_disconnect_by_func (self->paintable, invalidate_contents, self);
       g_signal_handlers_disconnect_by_func (self->paintable, invalidate_size, self);
       g_signal_handlers_disconnect_by_func (self->paintable, async_loaded, self);
+      if (BZ_IS_ASYNC_TEXTURE (self->paintable))
+        bz_async_texture_remove_waiter (
+            BZ_ASYNC_TEXTURE (self->paintable),
+            BZ_ASYNC_TEXTURE_PRIORITY_PREFETCH);
     }
   g_clear_object (&self->paintable);
 
@@ -171,6 +180,23 @@ bz_screenshot_measure (GtkWidget     *widget,
     }
 }
 
+static void
+bz_screenshot_size_allocate (GtkWidget *widget,
+                             int        width,
+                             int        height,
+                             int        baseline)
+{
+  BzScreenshot *self = BZ_SCREENSHOT (widget);
+  int           size = 0;
+
+  if (!BZ_IS_ASYNC_TEXTURE (self->paintable) || width <= 0)
+    return;
+
+  size = MAX (width, height) * gtk_widget_get_scale_factor (widget);
+  size = (size + SIZE_HINT_STEP - 1) / SIZE_HINT_STEP * SIZE_HINT_STEP;
+  bz_async_texture_request_size (BZ_ASYNC_TEXTURE (self->paintable), size);
+}
+
 static void
 bz_screenshot_snapshot (GtkWidget   *widget,
                         GtkSnapshot *snapshot)
@@ -253,6 +279,7 @@ bz_screenshot_class_init (BzScreenshotClass *klass)
 
   widget_class->get_request_mode = bz_screenshot_get_request_mode;
   widget_class->measure          = bz_screenshot_measure;
+  widget_class->size_allocate    = bz_screenshot_size_allocate;
   widget_class->snapshot         = bz_screenshot_snapshot;
 }
 
@@ -281,6 +308,10 @@ bz_screenshot_set_paintable (BzScreenshot *self,
       g_signal_handlers_disconnect_by_func (self->paintable, invalidate_contents, self);
       g_signal_handlers_disconnect_by_func (self->paintable, invalidate_size, self);
       g_signal_handlers_disconnect_by_func (self->paintable, async_loaded, self);
+      if (BZ_IS_ASYNC_TEXTURE (self->paintable))
+        bz_async_texture_remove_waiter (
+            BZ_ASYNC_TEXTURE (self->paintable),
+            BZ_ASYNC_TEXTURE_PRIORITY_PREFETCH);
     }
   g_clear_object (&self->paintable);
 
@@ -292,8 +323,13 @@ bz_screenshot_set_paintable (BzScreenshot *self,
       g_signal_connect_swapped (paintable, "invalidate-size",
                                 G_CALLBACK (invalidate_size), self);
       if (BZ_IS_ASYNC_TEXTURE (paintable))
-        g_signal_connect_swapped (paintable, "notify::loaded",
-                                  G_CALLBACK (async_loaded), self);
+        {
+          g_signal_connect_swapped (paintable, "notify::loaded",
+                                    G_CALLBACK (async_loaded), self);
+          bz_async_texture_add_waiter (
+              BZ_ASYNC_TEXTURE (paintable),
+              BZ_ASYNC_TEXTURE_PRIORITY_PREFETCH);
+        }
     }
 
   gtk_widget_queue_resize (GTK_WIDGET (self));
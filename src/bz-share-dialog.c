@@ -142,6 +142,7 @@ populate_urls (BzShareDialog *self)
   g_object_get (self->entry, "share-urls", &urls_model, NULL);
   if (!urls_model)
     return;
+  g_signal_handlers_disconnect_by_func (self->entry, populate_urls, self);
 
   n_items = g_list_model_get_n_items (urls_model);
 
@@ -161,6 +162,8 @@ bz_share_dialog_dispose (GObject *object)
 {
   BzShareDialog *self = BZ_SHARE_DIALOG (object);
 
+  if (self->entry != NULL)
+    g_signal_handlers_disconnect_by_func (self->entry, populate_urls, self);
   g_clear_object (&self->entry);
 
   G_OBJECT_CLASS (bz_share_dialog_parent_class)->dispose (object);
@@ -195,8 +198,16 @@ bz_share_dialog_set_property (GObject      *object,
   switch (prop_id)
     {
     case PROP_ENTRY:
+      if (self->entry != NULL)
+        g_signal_handlers_disconnect_by_func (self->entry, populate_urls, self);
       g_clear_object (&self->entry);
       self->entry = g_value_dup_object (value);
+      if (self->entry != NULL)
+        /* Share urls are loaded lazily and may not be there yet */
+        g_signal_connect_object (
+            self->entry, "notify::share-urls",
+            G_CALLBACK (populate_urls), self,
+            G_CONNECT_SWAPPED);
       populate_urls (self);
       break;
     default:
@@ -31,6 +31,14 @@
 #include "bz-transaction-view.h"
 #include "bz-util.h"
 
+/* Bounds how far the backend can run ahead of the UI;
+ * it coalesces progress while the channel is full */
+#define TRANSACTION_CHANNEL_DEPTH 16
+
+/* Progress changes smaller than this aren't worth a
+ * notify, a bar is at most a few hundred pixels wide */
+#define PROGRESS_EPSILON 0.002
+
 /* clang-format off */
 G_DEFINE_QUARK (bz-transaction-mgr-error-quark, bz_transaction_mgr_error);
 /* clang-format on */
@@ -503,12 +511,16 @@ transaction_fiber (QueuedScheduleData *data)
   g_autoptr (GListStore) store   = NULL;
   g_autoptr (DexFuture) future   = NULL;
   g_autoptr (GHashTable) op_set  = NULL;
+  g_autofree char *last_status   = NULL;
+  int              last_pending  = -1;
 
   g_object_set (
       transaction,
       "status", "Starting up...",
       "progress", 0.0,
       NULL);
+  self->current_progress = 0.0;
+  g_object_notify_by_pspec (G_OBJECT (self), props[PROP_CURRENT_PROGRESS]);
 
 #define COUNT(type)                                  \
   G_STMT_START                                       \
@@ -644,15 +656,28 @@ transaction_fiber (QueuedScheduleData *data)
           total_progress = bz_backend_transaction_op_progress_payload_get_total_progress (
               BZ_BACKEND_TRANSACTION_OP_PROGRESS_PAYLOAD (object));
 
-          g_object_set (
-              transaction,
-              "pending", is_estimating,
-              "status", status,
-              "progress", total_progress,
-              NULL);
-
-          self->current_progress = total_progress;
-          g_object_notify_by_pspec (G_OBJECT (self), props[PROP_CURRENT_PROGRESS]);
+          /* Only touch what actually changed, under a
+           * single notify freeze */
+          g_object_freeze_notify (G_OBJECT (transaction));
+          if (last_pending != is_estimating)
+            {
+              g_object_set (transaction, "pending", is_estimating, NULL);
+              last_pending = is_estimating;
+            }
+          if (g_strcmp0 (last_status, status) != 0)
+            {
+              g_object_set (transaction, "status", status, NULL);
+              g_clear_pointer (&last_status, g_free);
+              last_status = g_strdup (status);
+            }
+          if (ABS (total_progress - self->current_progress) >= PROGRESS_EPSILON ||
+              (total_progress >= 1.0 && self->current_progress < 1.0))
+            {
+              g_object_set (transaction, "progress", total_progress, NULL);
+              self->current_progress = total_progress;
+              g_object_notify_by_pspec (G_OBJECT (self), props[PROP_CURRENT_PROGRESS]);
+            }
+          g_object_thaw_notify (G_OBJECT (transaction));
         }
     }
 
@@ -1130,7 +1155,7 @@ dispatch_next (BzTransactionManager *self)
     goto done;
 
   data              = g_queue_pop_tail (&self->queue);
-  data->channel     = dex_channel_new (0);
+  data->channel     = dex_channel_new (TRANSACTION_CHANNEL_DEPTH);
   data->timer       = g_timer_new ();
   data->cancellable = g_cancellable_new ();
 
@@ -18,30 +18,88 @@
  * SPDX-License-Identifier: GPL-3.0-or-later
  */
 
+#define _GNU_SOURCE
+
 #define G_LOG_DOMAIN "BAZAAR::DL-WORKER-SUBPROCESS"
 
+#define PROGRESS_INTERVAL_BYTES  (256 * 1024)
+#define COPY_CHUNK_SIZE          (64 * 1024)
+#define PART_VALIDATOR_ATTRIBUTE "xattr::bazaar-validator"
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gunixfdmessage.h>
+#include <gio/gunixinputstream.h>
+#include <gio/gunixoutputstream.h>
+#include <glycin-1/glycin.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bz-download-worker-protocol.h"
 #include "bz-env.h"
 #include "bz-global-state.h"
+#include "bz-image-scale.h"
 #include "bz-util.h"
 
 BZ_DEFINE_DATA (
     download,
     Download,
     {
-      char *src;
-      char *dest;
+      guint32  id;
+      char    *src;
+      char    *dest;
+      gboolean report_progress;
+      int      max_size;
+      guint64  last_reported;
     },
     BZ_RELEASE_DATA (src, g_free);
     BZ_RELEASE_DATA (dest, g_free));
 
+BZ_DEFINE_DATA (
+    reply,
+    Reply,
+    {
+      GBytes *frame;
+      int     fd;
+    },
+    BZ_RELEASE_DATA (frame, g_bytes_unref);
+    if (self->fd >= 0) close (self->fd);)
+
 static DexFuture *
 read_stdin (GMainLoop *loop);
 
 static DexFuture *
 download_fiber (DownloadData *data);
 
+static gboolean
+fetch_resumable (DownloadData *data,
+                 SoupMessage  *message,
+                 GError      **error);
+
+static int
+decode_into_memfd (DownloadData *data,
+                   guint32      *width,
+                   guint32      *height,
+                   guint32      *stride,
+                   GError      **error);
+
+static void
+download_progress (guint64       received,
+                   guint64       total,
+                   DownloadData *data);
+
+static void
+send_reply (guint32   id,
+            char      kind,
+            GVariant *payload,
+            int       fd);
+
 static DexFuture *
-print_fiber (char *output);
+write_fiber (ReplyData *data);
 
 int
 main (int   argc,
@@ -66,49 +124,43 @@ main (int   argc,
 static DexFuture *
 read_stdin (GMainLoop *loop)
 {
-  g_autoptr (GIOChannel) stdin_channel = NULL;
+  g_autoptr (GInputStream) stdin_stream = NULL;
 
-  stdin_channel = g_io_channel_unix_new (STDIN_FILENO);
+  stdin_stream = g_buffered_input_stream_new (
+      g_unix_input_stream_new (STDIN_FILENO, FALSE));
   for (;;)
     {
       g_autoptr (GError) local_error = NULL;
-      g_autofree char *string        = NULL;
-      char            *newline       = NULL;
       g_autoptr (GVariant) variant   = NULL;
+      guint32          id            = 0;
       g_autofree char *src_uri       = NULL;
       g_autofree char *dest_path     = NULL;
+      gboolean         progress      = FALSE;
+      int              max_size      = 0;
       g_autoptr (DownloadData) data  = NULL;
 
-      g_io_channel_read_line (
-          stdin_channel, &string, NULL, NULL, &local_error);
-      if (string == NULL)
+      variant = bz_download_worker_read_frame (
+          stdin_stream,
+          G_VARIANT_TYPE (BZ_DOWNLOAD_WORKER_REQUEST_FORMAT),
+          &local_error);
+      if (variant == NULL)
         {
           if (local_error != NULL)
-            g_critical ("FATAL: Failure reading stdin channel: %s", local_error->message);
+            g_critical ("FATAL: Failure reading stdin: %s", local_error->message);
           g_main_loop_quit (loop);
           return NULL;
         }
 
-      newline = g_utf8_strchr (string, -1, '\n');
-      if (newline != NULL)
-        *newline = '\0';
-
-      variant = g_variant_parse (
-          G_VARIANT_TYPE ("(ss)"),
-          string, NULL, NULL,
-          &local_error);
-      if (variant == NULL)
-        {
-          g_critical ("Failure parsing variant text '%s' into structure: %s\n",
-                      string, local_error->message);
-          continue;
-        }
-
-      g_variant_get (variant, "(ss)", &src_uri, &dest_path);
+      g_variant_get (
+          variant, BZ_DOWNLOAD_WORKER_REQUEST_FORMAT,
+          &id, &src_uri, &dest_path, &progress, &max_size);
 
-      data       = download_data_new ();
-      data->src  = g_steal_pointer (&src_uri);
-      data->dest = g_steal_pointer (&dest_path);
+      data                  = download_data_new ();
+      data->id              = id;
+      data->src             = g_steal_pointer (&src_uri);
+      data->dest            = g_steal_pointer (&dest_path);
+      data->report_progress = progress;
+      data->max_size        = max_size;
 
       dex_future_disown (dex_scheduler_spawn (
           dex_thread_pool_scheduler_get_default (),
@@ -123,54 +175,457 @@ read_stdin (GMainLoop *loop)
 static DexFuture *
 download_fiber (DownloadData *data)
 {
-  char *src                                 = data->src;
-  char *dest                                = data->dest;
-  g_autoptr (GError) local_error            = NULL;
-  g_autoptr (GFile) dest_file               = NULL;
-  g_autoptr (GFileOutputStream) dest_output = NULL;
-  g_autoptr (SoupMessage) message           = NULL;
-  gboolean success                          = FALSE;
-  g_autoptr (GVariant) variant              = NULL;
-  g_autofree char *output                   = NULL;
-
-  dest_file   = g_file_new_for_path (dest);
-  dest_output = g_file_replace (
-      dest_file, NULL, FALSE,
-      G_FILE_CREATE_REPLACE_DESTINATION,
-      NULL, &local_error);
-  if (dest_output == NULL)
+  char *src                            = data->src;
+  g_autoptr (GError) local_error       = NULL;
+  g_autoptr (SoupMessage) message      = NULL;
+  gboolean            success          = FALSE;
+  SoupMessageHeaders *response_headers = NULL;
+  const char         *etag             = NULL;
+  const char         *last_modified    = NULL;
+
+  message = soup_message_new (SOUP_METHOD_GET, src);
+  if (message == NULL)
     {
-      g_critical ("%s", local_error->message);
+      g_critical ("Invalid uri '%s'", src);
       goto done;
     }
 
-  message = soup_message_new (SOUP_METHOD_GET, src);
-  success = dex_await (bz_send_with_global_http_session_then_splice_into (
-                           message, G_OUTPUT_STREAM (dest_output)),
-                       &local_error);
+  success = fetch_resumable (data, message, &local_error);
   if (!success)
     {
       g_critical ("%s", local_error->message);
       goto done;
     }
 
+  /* Let the caller revalidate this file later */
+  response_headers = soup_message_get_response_headers (message);
+  etag             = soup_message_headers_get_one (response_headers, "ETag");
+  last_modified    = soup_message_headers_get_one (response_headers, "Last-Modified");
+
+  if (data->max_size >= 0)
+    {
+      guint32 width  = 0;
+      guint32 height = 0;
+      guint32 stride = 0;
+      int     fd     = -1;
+
+      /* Decoding here keeps glycin and the full size
+       * pixels out of the main process entirely
+       */
+      fd = decode_into_memfd (data, &width, &height, &stride, &local_error);
+      if (fd >= 0)
+        send_reply (
+            data->id,
+            BZ_DOWNLOAD_WORKER_REPLY_DECODED,
+            g_variant_new ("(uuu)", width, height, stride),
+            fd);
+      else
+        g_warning ("Could not decode %s: %s", src, local_error->message);
+    }
+
 done:
-  variant = g_variant_new ("(sb)", dest, success);
-  output  = g_variant_print (variant, TRUE);
+  send_reply (
+      data->id,
+      BZ_DOWNLOAD_WORKER_REPLY_FINISHED,
+      g_variant_new (
+          "(bss)", success,
+          etag != NULL ? etag : "",
+          last_modified != NULL ? last_modified : ""),
+      -1);
+
+  return NULL;
+}
+
+static void
+download_progress (guint64       received,
+                   guint64       total,
+                   DownloadData *data)
+{
+  if (received < data->last_reported + PROGRESS_INTERVAL_BYTES &&
+      received != total)
+    return;
+  data->last_reported = received;
+
+  send_reply (
+      data->id,
+      BZ_DOWNLOAD_WORKER_REPLY_PROGRESS,
+      g_variant_new ("(tt)", received, total),
+      -1);
+}
+
+/* Downloads into a sibling ".part" file and renames it over
+ * the destination only once the body is complete. An earlier
+ * attempt that was cut short is resumed with a range request,
+ * provided the server can confirm the file did not change
+ */
+static gboolean
+fetch_resumable (DownloadData *data,
+                 SoupMessage  *message,
+                 GError      **error)
+{
+  g_autofree char *part_path           = NULL;
+  g_autoptr (GFile) part_file          = NULL;
+  g_autoptr (GFileInfo) part_info      = NULL;
+  g_autofree char *part_validator      = NULL;
+  g_autoptr (GOutputStream) output     = NULL;
+  g_autoptr (GInputStream) input       = NULL;
+  SoupMessageHeaders *request_headers  = NULL;
+  SoupMessageHeaders *response_headers = NULL;
+  const char         *validator        = NULL;
+  int                 fd               = -1;
+  struct stat         fd_stat          = { 0 };
+  struct stat         path_stat        = { 0 };
+  guint               status           = SOUP_STATUS_NONE;
+  guint64             offset           = 0;
+  guint64             expected         = 0;
+  guint64             received         = 0;
+  int                 errsv            = 0;
+
+  part_path = g_strdup_printf ("%s.part", data->dest);
+  part_file = g_file_new_for_path (part_path);
+
+  fd = open (part_path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0)
+    goto errno_error;
+  output = g_unix_output_stream_new (fd, TRUE);
+
+  /* A timed out request for the same file may still be running
+   * here or in another worker. Also make sure the part file was
+   * not published out from under us while we waited for the lock
+   */
+  if (flock (fd, LOCK_EX | LOCK_NB) != 0 ||
+      fstat (fd, &fd_stat) != 0 ||
+      stat (part_path, &path_stat) != 0 ||
+      fd_stat.st_dev != path_stat.st_dev ||
+      fd_stat.st_ino != path_stat.st_ino)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                   "%s is already being downloaded", data->dest);
+      return FALSE;
+    }
+
+  part_info = g_file_query_info (
+      part_file, PART_VALIDATOR_ATTRIBUTE,
+      G_FILE_QUERY_INFO_NONE, NULL, NULL);
+  if (part_info != NULL)
+    part_validator = g_strdup (g_file_info_get_attribute_string (
+        part_info, PART_VALIDATOR_ATTRIBUTE));
+  if (part_validator != NULL)
+    offset = fd_stat.st_size;
+
+  request_headers = soup_message_get_request_headers (message);
+  if (offset > 0)
+    {
+      soup_message_headers_set_range (request_headers, offset, -1);
+      soup_message_headers_replace (request_headers, "If-Range", part_validator);
+    }
+
+  input = dex_await_object (bz_send_with_global_http_session (message), error);
+  if (input == NULL)
+    return FALSE;
+
+  status           = soup_message_get_status (message);
+  response_headers = soup_message_get_response_headers (message);
+  if (offset > 0 && status == SOUP_STATUS_PARTIAL_CONTENT)
+    {
+      goffset start = 0;
+      goffset end   = 0;
+      goffset total = 0;
+
+      if (!soup_message_headers_get_content_range (
+              response_headers, &start, &end, &total) ||
+          start != (goffset) offset)
+        {
+          /* Don't ask for this range again */
+          if (ftruncate (fd, 0) != 0)
+            goto errno_error;
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                       "The server resumed %s at the wrong offset", data->src);
+          return FALSE;
+        }
+      if (total > 0)
+        expected = total;
+
+      if (lseek (fd, offset, SEEK_SET) < 0)
+        goto errno_error;
+      g_debug ("Resuming %s at %" G_GUINT64_FORMAT " bytes", data->src, offset);
+    }
+  else if (SOUP_STATUS_IS_SUCCESSFUL (status))
+    {
+      /* Either a fresh start, or the file changed
+       * upstream and the server sent all of it
+       */
+      offset   = 0;
+      expected = soup_message_headers_get_content_length (response_headers);
+      if (ftruncate (fd, 0) != 0)
+        goto errno_error;
+
+      /* Weak validators are not allowed in If-Range */
+      validator = soup_message_headers_get_one (response_headers, "ETag");
+      if (validator == NULL || g_str_has_prefix (validator, "W/"))
+        validator = soup_message_headers_get_one (response_headers, "Last-Modified");
+
+      /* If the file system can't hold the validator
+       * the download simply won't be resumable
+       */
+      if (validator != NULL)
+        g_file_set_attribute_string (
+            part_file, PART_VALIDATOR_ATTRIBUTE, validator,
+            G_FILE_QUERY_INFO_NONE, NULL, NULL);
+      else
+        g_file_set_attribute (
+            part_file, PART_VALIDATOR_ATTRIBUTE,
+            G_FILE_ATTRIBUTE_TYPE_INVALID, NULL,
+            G_FILE_QUERY_INFO_NONE, NULL, NULL);
+    }
+  else
+    {
+      if (status == SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE &&
+          ftruncate (fd, 0) != 0)
+        goto errno_error;
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Request for %s failed with HTTP status %u",
+                   data->src, status);
+      return FALSE;
+    }
+
+  received = offset;
+  for (;;)
+    {
+      g_autoptr (GBytes) bytes = NULL;
+      gsize size               = 0;
+      gsize written            = 0;
+
+      bytes = dex_await_boxed (
+          dex_input_stream_read_bytes (input, COPY_CHUNK_SIZE, G_PRIORITY_DEFAULT),
+          error);
+      if (bytes == NULL)
+        return FALSE;
+
+      size = g_bytes_get_size (bytes);
+      if (size == 0)
+        break;
+
+      while (written < size)
+        {
+          g_autoptr (GBytes) remaining = NULL;
+          gint64 bytes_written         = 0;
+
+          remaining     = g_bytes_new_from_bytes (bytes, written, size - written);
+          bytes_written = dex_await_int64 (
+              dex_output_stream_write_bytes (output, remaining, G_PRIORITY_DEFAULT),
+              error);
+          if (bytes_written < 0)
+            return FALSE;
+          written += bytes_written;
+        }
+
+      received += size;
+      if (data->report_progress)
+        download_progress (received, expected, data);
+    }
+  g_input_stream_close (input, NULL, NULL);
+
+  /* Keep what we have so the next attempt can resume */
+  if (expected > 0 && received != expected)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                   "Expected %" G_GUINT64_FORMAT " bytes from %s but received %" G_GUINT64_FORMAT,
+                   expected, data->src, received);
+      return FALSE;
+    }
+
+  g_file_set_attribute (
+      part_file, PART_VALIDATOR_ATTRIBUTE,
+      G_FILE_ATTRIBUTE_TYPE_INVALID, NULL,
+      G_FILE_QUERY_INFO_NONE, NULL, NULL);
+
+  /* Still holding the lock, so nobody else can
+   * be writing to the file we publish
+   */
+  if (rename (part_path, data->dest) != 0)
+    goto errno_error;
+
+  return TRUE;
+
+errno_error:
+  errsv = errno;
+  g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+               "Could not download into %s: %s", part_path, g_strerror (errsv));
+  return FALSE;
+}
+
+static int
+decode_into_memfd (DownloadData *data,
+                   guint32      *width,
+                   guint32      *height,
+                   guint32      *stride,
+                   GError      **error)
+{
+  g_autoptr (GFile) file       = NULL;
+  g_autoptr (GlyLoader) loader = NULL;
+  g_autoptr (GlyImage) image   = NULL;
+  g_autoptr (GlyFrame) frame   = NULL;
+  GBytes *bytes                = NULL;
+  int     src_width            = 0;
+  int     src_height           = 0;
+  int     dst_width            = 0;
+  int     dst_height           = 0;
+  gsize   dst_stride           = 0;
+  gsize   size                 = 0;
+  int     fd                   = -1;
+  guint8 *dst                  = NULL;
+  int     errsv                = 0;
+
+  file   = g_file_new_for_path (data->dest);
+  loader = gly_loader_new (file);
+#ifdef SANDBOXED_LIBFLATPAK
+  gly_loader_set_sandbox_selector (loader, GLY_SANDBOX_SELECTOR_NOT_SANDBOXED);
+#endif
+  gly_loader_set_accepted_memory_formats (loader, GLY_MEMORY_SELECTION_R8G8B8A8_PREMULTIPLIED);
+
+  image = gly_loader_load (loader, error);
+  if (image == NULL)
+    return -1;
+  frame = gly_image_next_frame (image, error);
+  if (frame == NULL)
+    return -1;
+
+  if (gly_frame_get_memory_format (frame) != GLY_MEMORY_R8G8B8A8_PREMULTIPLIED)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   "The loader did not honor the requested memory format");
+      return -1;
+    }
+
+  src_width  = gly_frame_get_width (frame);
+  src_height = gly_frame_get_height (frame);
+  bytes      = gly_frame_get_buf_bytes (frame);
+
+  bz_image_scale_fit (src_width, src_height, data->max_size, &dst_width, &dst_height);
+  dst_stride = (gsize) dst_width * 4;
+  size       = dst_stride * dst_height;
+
+  fd = memfd_create ("bazaar-texture", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd < 0)
+    goto errno_error;
+  if (ftruncate (fd, size) != 0)
+    goto errno_error;
+
+  dst = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (dst == MAP_FAILED)
+    goto errno_error;
+  bz_image_scale_rgba (
+      g_bytes_get_data (bytes, NULL),
+      src_width, src_height, gly_frame_get_stride (frame),
+      dst, dst_width, dst_height, dst_stride);
+  munmap (dst, size);
+
+  /* Bazaar wraps this memory in a texture without
+   * copying it, so it must never change again
+   */
+  if (fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0)
+    goto errno_error;
+
+  *width  = dst_width;
+  *height = dst_height;
+  *stride = dst_stride;
+  return fd;
+
+errno_error:
+  errsv = errno;
+  g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+               "Could not share decoded pixels: %s", g_strerror (errsv));
+  if (fd >= 0)
+    close (fd);
+  return -1;
+}
+
+/* Takes ownership of @fd, which may be -1 */
+static void
+send_reply (guint32   id,
+            char      kind,
+            GVariant *payload,
+            int       fd)
+{
+  g_autoptr (GVariant) variant = NULL;
+  g_autoptr (ReplyData) data   = NULL;
+
+  variant = g_variant_ref_sink (g_variant_new (
+      BZ_DOWNLOAD_WORKER_REPLY_FORMAT,
+      id, (guchar) kind, payload));
+
+  data        = reply_data_new ();
+  data->frame = bz_download_worker_frame_new (variant);
+  data->fd    = fd;
 
   dex_future_disown (dex_scheduler_spawn (
       /* ensure we only output on main thread */
       dex_scheduler_get_default (),
       bz_get_dex_stack_size (),
-      (DexFiberFunc) print_fiber,
-      g_steal_pointer (&output), g_free));
-
-  return NULL;
+      (DexFiberFunc) write_fiber,
+      reply_data_ref (data), reply_data_unref));
 }
 
 static DexFuture *
-print_fiber (char *output)
+write_fiber (ReplyData *data)
 {
-  g_print ("%s\n", output);
+  static GOutputStream *stdout_stream = NULL;
+  static GSocket       *fd_socket     = NULL;
+  g_autoptr (GError) local_error      = NULL;
+  gboolean result                     = FALSE;
+
+  if (stdout_stream == NULL)
+    stdout_stream = g_unix_output_stream_new (STDOUT_FILENO, FALSE);
+
+  if (data->fd >= 0)
+    {
+      g_autoptr (GSocketControlMessage) message = NULL;
+      guchar        byte                        = 0;
+      GOutputVector vector                      = { &byte, sizeof (byte) };
+      gssize        bytes_sent                  = 0;
+
+      if (fd_socket == NULL)
+        fd_socket = g_socket_new_from_fd (BZ_DOWNLOAD_WORKER_FD_SOCKET, &local_error);
+      if (fd_socket == NULL)
+        {
+          g_critical ("Could not open the descriptor socket: %s", local_error->message);
+          return NULL;
+        }
+
+      message = g_unix_fd_message_new ();
+      result  = g_unix_fd_message_append_fd (
+          G_UNIX_FD_MESSAGE (message), data->fd, &local_error);
+      if (!result)
+        {
+          g_critical ("Could not attach decoded pixels: %s", local_error->message);
+          return NULL;
+        }
+
+      /* The descriptor goes out before the frame referring
+       * to it, so the reader always finds it waiting
+       */
+      bytes_sent = g_socket_send_message (
+          fd_socket, NULL, &vector, 1,
+          &message, 1, G_SOCKET_MSG_NONE,
+          NULL, &local_error);
+      if (bytes_sent < 0)
+        {
+          g_critical ("Could not send decoded pixels: %s", local_error->message);
+          return NULL;
+        }
+    }
+
+  /* Blocking on purpose, so that frames
+   * never interleave on the pipe
+   */
+  result = g_output_stream_write_all (
+      stdout_stream,
+      g_bytes_get_data (data->frame, NULL),
+      g_bytes_get_size (data->frame),
+      NULL, NULL, &local_error);
+  if (!result)
+    g_critical ("Failure writing to stdout: %s", local_error->message);
+
   return NULL;
 }